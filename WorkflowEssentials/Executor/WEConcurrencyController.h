@@ -0,0 +1,100 @@
+//
+//  WEConcurrencyController.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Adjusts a concurrency limit at runtime from the observed latency and error rate of operations, using additive
+ increase and multiplicative decrease (AIMD). Set it as `concurrencyController` of a workflow or of an executor,
+ which then never runs more operations at once than the controller's `limit`, nor more than its own maximum.
+ Samples are collected in windows as long as the limit at the start of the window. When a window is full,
+ the limit is multiplied by `backoffRatio` if the error rate of the window exceeded `errorRateThreshold`, or its
+ average latency exceeded `latencyTolerance` times the baseline latency, and grows by one otherwise.
+ The baseline is the lowest average latency of a window seen so far. It drifts up slowly while windows are slower,
+ so the controller settles after a lasting change of the workload instead of backing off forever.
+ The limit starts at the minimum and always stays within bounds. Thread safe.
+ */
+@interface WEConcurrencyController : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Initialize a new concurrency controller
+ @param minimumLimit lowest limit the controller may set. Must be positive.
+ @param maximumLimit highest limit the controller may set. Must not be less than `minimumLimit`.
+ @return an instance of `WEConcurrencyController`
+ */
+- (nonnull instancetype)initWithMinimumLimit:(NSUInteger)minimumLimit maximumLimit:(NSUInteger)maximumLimit NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) NSUInteger minimumLimit;
+@property (nonatomic, readonly) NSUInteger maximumLimit;
+
+/**
+ Ratio of the average latency of a window to the baseline above which the limit is decreased. Must be greater than 1, defaults to 2.
+ */
+@property (nonatomic, assign) double latencyTolerance;
+
+/**
+ Fraction of failed operations in a window above which the limit is decreased. Must be within [0, 1), defaults to 0.1.
+ */
+@property (nonatomic, assign) double errorRateThreshold;
+
+/**
+ Factor the limit is multiplied by when it is decreased. Must be within (0, 1), defaults to 0.5.
+ */
+@property (nonatomic, assign) double backoffRatio;
+
+/**
+ Records an operation that has finished. Workflows and executors the controller is set on call it for every
+ operation they perform, it can also be fed from elsewhere.
+ @param latency time it took the operation to complete, in seconds.
+ @param failed whether the operation failed.
+ */
+- (void)recordOperationWithLatency:(NSTimeInterval)latency failed:(BOOL)failed;
+
+
+#pragma mark - Metrics
+
+/**
+ Current concurrency limit.
+ */
+@property (nonatomic, readonly) NSUInteger limit;
+
+/**
+ Number of operations recorded.
+ */
+@property (nonatomic, readonly) NSUInteger sampleCount;
+
+/**
+ Number of windows after which the limit was increased, or would have been if it had not been at the maximum.
+ */
+@property (nonatomic, readonly) NSUInteger increaseCount;
+
+/**
+ Number of windows after which the limit was decreased, or would have been if it had not been at the minimum.
+ */
+@property (nonatomic, readonly) NSUInteger decreaseCount;
+
+/**
+ Latency the average latency of a window is compared to, `0` until the first window is full.
+ */
+@property (nonatomic, readonly) NSTimeInterval baselineLatency;
+
+/**
+ Average latency of the last full window, `0` until the first window is full.
+ */
+@property (nonatomic, readonly) NSTimeInterval lastWindowLatency;
+
+/**
+ Error rate of the last full window, `0` until the first window is full.
+ */
+@property (nonatomic, readonly) double lastWindowErrorRate;
+
+@end
@@ -0,0 +1,246 @@
+//
+//  WEConcurrencyController.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEConcurrencyController.h>
+
+#import <pthread.h>
+#import "WETools.h"
+
+// Growth of the baseline after each window slower than it, relative to the baseline.
+static const double WEBaselineDrift = 0.05;
+
+@implementation WEConcurrencyController
+{
+    NSUInteger _minimumLimit;
+    NSUInteger _maximumLimit;
+    
+    pthread_mutex_t _mutex;
+    double _latencyTolerance;
+    double _errorRateThreshold;
+    double _backoffRatio;
+    NSUInteger _limit;
+    NSUInteger _sampleCount;
+    NSUInteger _increaseCount;
+    NSUInteger _decreaseCount;
+    NSTimeInterval _baselineLatency;
+    NSTimeInterval _lastWindowLatency;
+    double _lastWindowErrorRate;
+    
+    // Current window.
+    NSUInteger _windowLength;
+    NSUInteger _windowSampleCount;
+    NSUInteger _windowFailureCount;
+    NSTimeInterval _windowTotalLatency;
+}
+
+@synthesize minimumLimit = _minimumLimit;
+@synthesize maximumLimit = _maximumLimit;
+
+- (instancetype)initWithMinimumLimit:(NSUInteger)minimumLimit maximumLimit:(NSUInteger)maximumLimit
+{
+    if (minimumLimit == 0) THROW_INVALID_PARAM(minimumLimit, nil);
+    if (maximumLimit < minimumLimit) THROW_INVALID_PARAM(maximumLimit, nil);
+    
+    if (self = [super init])
+    {
+        _minimumLimit = minimumLimit;
+        _maximumLimit = maximumLimit;
+        pthread_mutex_init(&_mutex, NULL);
+        _latencyTolerance = 2.0;
+        _errorRateThreshold = 0.1;
+        _backoffRatio = 0.5;
+        _limit = minimumLimit;
+        _windowLength = minimumLimit;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+
+#pragma mark - Properties
+
+- (double)latencyTolerance
+{
+    double tolerance;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    tolerance = _latencyTolerance;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return tolerance;
+}
+
+- (void)setLatencyTolerance:(double)latencyTolerance
+{
+    if (!(latencyTolerance > 1)) THROW_INVALID_PARAM(latencyTolerance, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _latencyTolerance = latencyTolerance;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (double)errorRateThreshold
+{
+    double threshold;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    threshold = _errorRateThreshold;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return threshold;
+}
+
+- (void)setErrorRateThreshold:(double)errorRateThreshold
+{
+    if (!(errorRateThreshold >= 0 && errorRateThreshold < 1)) THROW_INVALID_PARAM(errorRateThreshold, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _errorRateThreshold = errorRateThreshold;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (double)backoffRatio
+{
+    double ratio;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    ratio = _backoffRatio;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return ratio;
+}
+
+- (void)setBackoffRatio:(double)backoffRatio
+{
+    if (!(backoffRatio > 0 && backoffRatio < 1)) THROW_INVALID_PARAM(backoffRatio, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _backoffRatio = backoffRatio;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (NSUInteger)limit
+{
+    NSUInteger limit;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    limit = _limit;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return limit;
+}
+
+- (NSUInteger)sampleCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _sampleCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (NSUInteger)increaseCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _increaseCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (NSUInteger)decreaseCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _decreaseCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (NSTimeInterval)baselineLatency
+{
+    NSTimeInterval latency;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    latency = _baselineLatency;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return latency;
+}
+
+- (NSTimeInterval)lastWindowLatency
+{
+    NSTimeInterval latency;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    latency = _lastWindowLatency;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return latency;
+}
+
+- (double)lastWindowErrorRate
+{
+    double rate;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    rate = _lastWindowErrorRate;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return rate;
+}
+
+
+#pragma mark - Control
+
+- (void)recordOperationWithLatency:(NSTimeInterval)latency failed:(BOOL)failed
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    _sampleCount++;
+    _windowSampleCount++;
+    _windowTotalLatency += MAX(latency, 0);
+    if (failed) _windowFailureCount++;
+    
+    if (_windowSampleCount >= _windowLength)
+    {
+        [self _closeWindow];
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+// Must be called inside the critical section.
+- (void)_closeWindow
+{
+    _lastWindowLatency = _windowTotalLatency / _windowSampleCount;
+    _lastWindowErrorRate = (double)_windowFailureCount / _windowSampleCount;
+    
+    // The first window only establishes the baseline.
+    BOOL overloaded = _lastWindowErrorRate > _errorRateThreshold
+                   || (_baselineLatency > 0 && _lastWindowLatency > _baselineLatency * _latencyTolerance);
+    
+    if (_baselineLatency == 0 || _lastWindowLatency < _baselineLatency)
+    {
+        _baselineLatency = _lastWindowLatency;
+    }
+    else
+    {
+        _baselineLatency = MIN(_lastWindowLatency, _baselineLatency * (1 + WEBaselineDrift));
+    }
+    
+    if (overloaded)
+    {
+        _decreaseCount++;
+        _limit = MAX((NSUInteger)floor(_limit * _backoffRatio), _minimumLimit);
+    }
+    else
+    {
+        _increaseCount++;
+        _limit = MIN(_limit + 1, _maximumLimit);
+    }
+    
+    _windowLength = _limit;
+    _windowSampleCount = 0;
+    _windowFailureCount = 0;
+    _windowTotalLatency = 0;
+}
+
+@end
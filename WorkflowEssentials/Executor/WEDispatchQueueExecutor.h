@@ -0,0 +1,37 @@
+//
+//  WEDispatchQueueExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+#import <WorkflowEssentials/WEOperationExecutor.h>
+
+/**
+ Performs blocks asynchronously on a dispatch queue. A serial queue makes operations that share a resource,
+ like a database connection, run one at a time without locking of their own, and a queue with a target queue
+ places them in an existing queue hierarchy.
+ */
+@interface WEDispatchQueueExecutor : NSObject <WEOperationExecutor>
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Initialize a new dispatch queue executor
+ @param queue a queue to perform blocks on
+ @return an instance of `WEDispatchQueueExecutor`
+ */
+- (nonnull instancetype)initWithQueue:(nonnull dispatch_queue_t)queue NS_DESIGNATED_INITIALIZER;
+
+/**
+ Executor on the default priority global queue, which workflows use unless they are given another one.
+ */
++ (nonnull WEDispatchQueueExecutor *)globalQueueExecutor;
+
+@property (nonatomic, readonly, strong, nonnull) dispatch_queue_t queue;
+
+@end
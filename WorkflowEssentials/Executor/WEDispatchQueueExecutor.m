@@ -0,0 +1,48 @@
+//
+//  WEDispatchQueueExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEDispatchQueueExecutor.h>
+
+#import "WETools.h"
+
+@implementation WEDispatchQueueExecutor
+{
+    dispatch_queue_t _queue;
+}
+
+@synthesize queue = _queue;
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    if (queue == nil) THROW_INVALID_PARAM(queue, nil);
+    
+    if (self = [super init])
+    {
+        _queue = queue;
+    }
+    return self;
+}
+
++ (WEDispatchQueueExecutor *)globalQueueExecutor
+{
+    static WEDispatchQueueExecutor *executor;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        executor = [[WEDispatchQueueExecutor alloc] initWithQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    });
+    return executor;
+}
+
+- (void)executeBlock:(dispatch_block_t)block
+{
+    dispatch_async(_queue, block);
+}
+
+@end
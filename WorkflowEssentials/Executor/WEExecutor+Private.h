@@ -0,0 +1,43 @@
+//
+//  WEExecutor+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEExecutor.h>
+
+@interface WEExecutor ()
+
+/**
+ Returns one of the shared scheduler queues, distributing workflows evenly between them.
+ */
+- (nonnull dispatch_queue_t)_nextSchedulerQueue;
+
+/**
+ Requests a slot for one operation of a flow (workflow).
+ When the slot is granted, `grant` is dispatched to `queue`. The slot must be returned with `_releaseSlot`.
+ */
+- (void)_requestSlotForFlow:(nonnull id)flow weight:(double)weight queue:(nonnull dispatch_queue_t)queue grant:(nonnull dispatch_block_t)grant;
+
+/**
+ Takes a slot right away, even beyond the limit, for an operation that others already admitted are waiting for.
+ The slot must be returned with `_releaseSlot`.
+ */
+- (void)_takeSlot;
+
+/**
+ Returns a previously granted slot, admitting the next waiting operation if there is one.
+ */
+- (void)_releaseSlot;
+
+/**
+ Feeds an operation performed by one of the workflows to the concurrency controller, if there is one,
+ admitting waiting operations if the limit grew.
+ */
+- (void)_recordOperationWithLatency:(NSTimeInterval)latency failed:(BOOL)failed;
+
+@end
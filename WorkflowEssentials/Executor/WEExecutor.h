@@ -0,0 +1,62 @@
+//
+//  WEExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEConcurrencyController;
+
+/**
+ Executor shared by many concurrent workflows.
+ Workflows created on an executor do not create their own internal queues, instead they share a small
+ fixed set of scheduler queues owned by the executor, so the number of queues stays bounded no matter
+ how many workflows are alive.
+ The executor enforces a global limit on operations running concurrently across all its workflows.
+ When operations of several workflows are waiting for the executor, they are admitted using weighted fair
+ queuing: every workflow receives a share of the executor proportional to its weight.
+ Workflow's own `maximumConcurrentOperations` is still respected.
+ */
+@interface WEExecutor : NSObject
+
+/**
+ Initialize a new executor
+ @param maximumConcurrentOperations maximum number of operations that may be executed concurrently
+ across all workflows created on this executor. Value of `0` means the number of active processors.
+ @return an instance of `WEExecutor`
+ */
+- (nonnull instancetype)initWithMaximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations NS_DESIGNATED_INITIALIZER;
+
+/**
+ Maximum number of operations that may be executed concurrently across all workflows.
+ */
+@property (nonatomic, readonly) NSUInteger maximumConcurrentOperations;
+
+/**
+ Optional controller that adapts the number of operations admitted at once to their latency and error rate,
+ between the controller's bounds and `maximumConcurrentOperations`. It is fed every operation performed by
+ the executor's workflows.
+ */
+@property (nonatomic, strong, nullable) WEConcurrencyController *concurrencyController;
+
+/**
+ Number of operations currently admitted for execution.
+ */
+@property (nonatomic, readonly) NSUInteger activeOperationCount;
+
+/**
+ Number of ready operations of all workflows waiting to be admitted.
+ */
+@property (nonatomic, readonly) NSUInteger waitingOperationCount;
+
+/**
+ Number of scheduler queues shared by workflows created on this executor.
+ */
+@property (nonatomic, readonly) NSUInteger schedulerQueueCount;
+
+@end
@@ -0,0 +1,303 @@
+//
+//  WEExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEExecutor.h>
+#import <WorkflowEssentials/WEConcurrencyController.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WEExecutor+Private.h"
+
+// Per-flow fair queuing state.
+@interface _WEExecutorFlow : NSObject
+@end
+
+@implementation _WEExecutorFlow
+{
+@package
+    double _lastFinishTag;
+}
+@end
+
+// A single request for an execution slot.
+@interface _WEExecutorRequest : NSObject
+@end
+
+@implementation _WEExecutorRequest
+{
+@package
+    double _startTag;
+    double _finishTag;
+    uint64_t _sequence;
+    dispatch_queue_t _queue;
+    dispatch_block_t _grant;
+}
+@end
+
+static inline BOOL _WERequestPrecedes(__unsafe_unretained _WEExecutorRequest *first, __unsafe_unretained _WEExecutorRequest *second)
+{
+    if (first->_finishTag != second->_finishTag) return first->_finishTag < second->_finishTag;
+    return first->_sequence < second->_sequence;
+}
+
+static inline void _WEDispatchGrants(NSArray<_WEExecutorRequest *> *admitted)
+{
+    for (_WEExecutorRequest *request in admitted)
+    {
+        dispatch_async(request->_queue, request->_grant);
+    }
+}
+
+@implementation WEExecutor
+{
+    NSUInteger _maximumConcurrentOperations;
+    NSArray<dispatch_queue_t> *_schedulerQueues;
+
+    pthread_mutex_t _mutex;
+    NSUInteger _nextSchedulerQueueIndex;
+    NSUInteger _activeOperationCount;
+    WEConcurrencyController *_concurrencyController;
+
+    // Weighted fair queuing state.
+    // Each request is tagged with a virtual finish time, which advances by 1/weight for each request
+    // of the same flow. Requests are admitted in the order of their finish tags, which gives every flow
+    // a share of the executor proportional to its weight. Virtual time is the start tag of the most recently
+    // admitted request, so that a flow that was idle does not get credit for the time it did not use.
+    double _virtualTime;
+    uint64_t _nextSequence;
+    NSMapTable<id, _WEExecutorFlow *> *_flows;
+    // Binary min-heap of waiting requests, ordered by finish tag.
+    NSMutableArray<_WEExecutorRequest *> *_waitingRequests;
+}
+
+- (instancetype)init
+{
+    return [self initWithMaximumConcurrentOperations:0];
+}
+
+- (instancetype)initWithMaximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
+{
+    if (self = [super init])
+    {
+        NSUInteger processorCount = MAX([NSProcessInfo processInfo].activeProcessorCount, 1);
+        _maximumConcurrentOperations = (maximumConcurrentOperations > 0) ? maximumConcurrentOperations : processorCount;
+
+        NSMutableArray<dispatch_queue_t> *schedulerQueues = [[NSMutableArray alloc] initWithCapacity:processorCount];
+        for (NSUInteger i = 0; i < processorCount; i++)
+        {
+            [schedulerQueues addObject:dispatch_queue_create("we-executor.scheduler-queue", DISPATCH_QUEUE_SERIAL)];
+        }
+        _schedulerQueues = [schedulerQueues copy];
+
+        pthread_mutex_init(&_mutex, NULL);
+        NSPointerFunctionsOptions keyOptions = NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality;
+        _flows = [[NSMapTable alloc] initWithKeyOptions:keyOptions valueOptions:NSPointerFunctionsStrongMemory capacity:16];
+        _waitingRequests = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+
+#pragma mark - Properties
+
+@synthesize maximumConcurrentOperations = _maximumConcurrentOperations;
+
+- (WEConcurrencyController *)concurrencyController
+{
+    WEConcurrencyController *controller;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    controller = _concurrencyController;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return controller;
+}
+
+- (void)setConcurrencyController:(WEConcurrencyController *)concurrencyController
+{
+    NSArray<_WEExecutorRequest *> *admitted;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _concurrencyController = concurrencyController;
+    admitted = [self _admitWaitingRequests];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    _WEDispatchGrants(admitted);
+}
+
+- (NSUInteger)activeOperationCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _activeOperationCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (NSUInteger)waitingOperationCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _waitingRequests.count;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (NSUInteger)schedulerQueueCount
+{
+    return _schedulerQueues.count;
+}
+
+
+#pragma mark - Request heap
+
+static void _WEHeapPush(NSMutableArray<_WEExecutorRequest *> *heap, _WEExecutorRequest *request)
+{
+    [heap addObject:request];
+    NSUInteger index = heap.count - 1;
+    while (index > 0)
+    {
+        NSUInteger parent = (index - 1) / 2;
+        if (!_WERequestPrecedes(heap[index], heap[parent])) break;
+        [heap exchangeObjectAtIndex:index withObjectAtIndex:parent];
+        index = parent;
+    }
+}
+
+static _WEExecutorRequest *_WEHeapPop(NSMutableArray<_WEExecutorRequest *> *heap)
+{
+    _WEExecutorRequest *top = heap.firstObject;
+    NSUInteger count = heap.count;
+    if (count > 1) [heap exchangeObjectAtIndex:0 withObjectAtIndex:count - 1];
+    [heap removeLastObject];
+    count--;
+
+    NSUInteger index = 0;
+    for (;;)
+    {
+        NSUInteger left = 2 * index + 1;
+        NSUInteger right = left + 1;
+        NSUInteger smallest = index;
+        if (left < count && _WERequestPrecedes(heap[left], heap[smallest])) smallest = left;
+        if (right < count && _WERequestPrecedes(heap[right], heap[smallest])) smallest = right;
+        if (smallest == index) break;
+        [heap exchangeObjectAtIndex:index withObjectAtIndex:smallest];
+        index = smallest;
+    }
+    return top;
+}
+
+
+#pragma mark - Scheduling
+
+- (dispatch_queue_t)_nextSchedulerQueue
+{
+    NSUInteger index;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    index = _nextSchedulerQueueIndex;
+    _nextSchedulerQueueIndex = (_nextSchedulerQueueIndex + 1) % _schedulerQueues.count;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return _schedulerQueues[index];
+}
+
+// Must be called inside the critical section, returns requests that have been admitted.
+- (NSArray<_WEExecutorRequest *> *)_admitWaitingRequests
+{
+    NSMutableArray<_WEExecutorRequest *> *admitted;
+    // The controller never calls back into the executor, so taking its lock here cannot deadlock.
+    NSUInteger limit = _maximumConcurrentOperations;
+    if (_concurrencyController != nil) limit = MIN(limit, _concurrencyController.limit);
+
+    while (_activeOperationCount < limit && _waitingRequests.count > 0)
+    {
+        _WEExecutorRequest *request = _WEHeapPop(_waitingRequests);
+        _virtualTime = MAX(_virtualTime, request->_startTag);
+        _activeOperationCount++;
+
+        if (admitted == nil) admitted = [NSMutableArray new];
+        [admitted addObject:request];
+    }
+    return admitted;
+}
+
+- (void)_requestSlotForFlow:(id)flow weight:(double)weight queue:(dispatch_queue_t)queue grant:(dispatch_block_t)grant
+{
+    WEAssert(flow != nil);
+    WEAssert(queue != nil);
+    WEAssert(grant != nil);
+    WEAssert(weight > 0);
+
+    _WEExecutorRequest *request = [_WEExecutorRequest new];
+    request->_queue = queue;
+    request->_grant = [grant copy];
+
+    NSArray<_WEExecutorRequest *> *admitted;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+
+    _WEExecutorFlow *flowState = [_flows objectForKey:flow];
+    if (flowState == nil)
+    {
+        flowState = [_WEExecutorFlow new];
+        [_flows setObject:flowState forKey:flow];
+    }
+
+    request->_startTag = MAX(_virtualTime, flowState->_lastFinishTag);
+    request->_finishTag = request->_startTag + 1.0 / weight;
+    request->_sequence = _nextSequence++;
+    flowState->_lastFinishTag = request->_finishTag;
+
+    _WEHeapPush(_waitingRequests, request);
+    admitted = [self _admitWaitingRequests];
+
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    _WEDispatchGrants(admitted);
+}
+
+- (void)_takeSlot
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _activeOperationCount++;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)_releaseSlot
+{
+    NSArray<_WEExecutorRequest *> *admitted;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+
+    WEAssert(_activeOperationCount > 0);
+    _activeOperationCount--;
+    admitted = [self _admitWaitingRequests];
+
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    _WEDispatchGrants(admitted);
+}
+
+- (void)_recordOperationWithLatency:(NSTimeInterval)latency failed:(BOOL)failed
+{
+    NSArray<_WEExecutorRequest *> *admitted;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+
+    if (_concurrencyController != nil)
+    {
+        [_concurrencyController recordOperationWithLatency:latency failed:failed];
+        admitted = [self _admitWaitingRequests];
+    }
+
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    _WEDispatchGrants(admitted);
+}
+
+@end
@@ -0,0 +1,26 @@
+//
+//  WEInlineExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+#import <WorkflowEssentials/WEOperationExecutor.h>
+
+/**
+ Performs blocks synchronously on the thread that submits them. A workflow submits blocks on its internal queue,
+ so operations on an inline executor are prepared and started without a thread hop, which suits operations that
+ only start asynchronous work or complete right away. An operation that blocks stalls the workflow while it does.
+ */
+@interface WEInlineExecutor : NSObject <WEOperationExecutor>
+
+/**
+ Shared inline executor, it has no state.
+ */
++ (nonnull WEInlineExecutor *)sharedExecutor;
+
+@end
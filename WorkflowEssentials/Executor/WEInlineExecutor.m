@@ -0,0 +1,30 @@
+//
+//  WEInlineExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEInlineExecutor.h>
+
+@implementation WEInlineExecutor
+
++ (WEInlineExecutor *)sharedExecutor
+{
+    static WEInlineExecutor *executor;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        executor = [WEInlineExecutor new];
+    });
+    return executor;
+}
+
+- (void)executeBlock:(dispatch_block_t)block
+{
+    block();
+}
+
+@end
@@ -0,0 +1,56 @@
+//
+//  WEMainThreadExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+#import <WorkflowEssentials/WEOperationExecutor.h>
+
+/**
+ Executes blocks on the main thread, coalescing them into as few main queue turns as possible.
+ Blocks submitted while a batch is pending are appended to it and performed in the order they were submitted.
+ A single main queue turn performs blocks until the time budget is exhausted, the rest of the blocks are
+ carried over to the next turn, so that a burst of work does not stall the main run loop.
+ */
+@interface WEMainThreadExecutor : NSObject <WEOperationExecutor>
+
+/**
+ Initialize a main thread executor
+ @param timeBudget maximum time (in seconds) to spend performing blocks in a single main queue turn.
+ At least one block is always performed in each turn, so the budget may be exceeded by a single long block.
+ @return an instance of `WEMainThreadExecutor`
+ */
+- (nonnull instancetype)initWithTimeBudget:(NSTimeInterval)timeBudget NS_DESIGNATED_INITIALIZER;
+
+/**
+ Maximum time (in seconds) to spend performing blocks in a single main queue turn.
+ */
+@property (nonatomic, assign) NSTimeInterval timeBudget;
+
+/**
+ Total time (in seconds) spent performing blocks on the main thread.
+ */
+@property (nonatomic, readonly) NSTimeInterval consumedTime;
+
+/**
+ Number of main queue turns that performed at least one block.
+ */
+@property (nonatomic, readonly) NSUInteger batchCount;
+
+/**
+ Number of blocks performed.
+ */
+@property (nonatomic, readonly) NSUInteger executedBlockCount;
+
+/**
+ Schedules a block to be performed on the main thread.
+ @param block a block to perform
+ */
+- (void)executeBlock:(nonnull dispatch_block_t)block;
+
+@end
@@ -0,0 +1,184 @@
+//
+//  WEMainThreadExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEMainThreadExecutor.h>
+
+#import <pthread.h>
+#import "WETools.h"
+
+@implementation WEMainThreadExecutor
+{
+    pthread_mutex_t _mutex;
+    NSTimeInterval _timeBudget;
+    NSMutableArray<dispatch_block_t> *_pendingBlocks;
+    BOOL _drainScheduled;
+
+    // Statistics, protected by the same mutex
+    uint64_t _consumedTime;
+    NSUInteger _batchCount;
+    NSUInteger _executedBlockCount;
+}
+
+- (instancetype)init
+{
+    return [self initWithTimeBudget:0.008];
+}
+
+- (instancetype)initWithTimeBudget:(NSTimeInterval)timeBudget
+{
+    if (timeBudget < 0) THROW_INVALID_PARAM(timeBudget, nil);
+
+    if (self = [super init])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        _timeBudget = timeBudget;
+        _pendingBlocks = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+
+#pragma mark - Properties
+
+- (NSTimeInterval)timeBudget
+{
+    NSTimeInterval timeBudget;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    timeBudget = _timeBudget;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return timeBudget;
+}
+
+- (void)setTimeBudget:(NSTimeInterval)timeBudget
+{
+    if (timeBudget < 0) THROW_INVALID_PARAM(timeBudget, nil);
+
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _timeBudget = timeBudget;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (NSTimeInterval)consumedTime
+{
+    uint64_t consumedTime;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    consumedTime = _consumedTime;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return (NSTimeInterval)consumedTime / NSEC_PER_SEC;
+}
+
+- (NSUInteger)batchCount
+{
+    NSUInteger batchCount;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    batchCount = _batchCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return batchCount;
+}
+
+- (NSUInteger)executedBlockCount
+{
+    NSUInteger executedBlockCount;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    executedBlockCount = _executedBlockCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return executedBlockCount;
+}
+
+
+#pragma mark - Execution
+
+- (void)executeBlock:(dispatch_block_t)block
+{
+    if (block == nil) THROW_INVALID_PARAM(block, nil);
+
+    BOOL scheduleDrain = NO;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    [_pendingBlocks addObject:[block copy]];
+    if (!_drainScheduled)
+    {
+        _drainScheduled = YES;
+        scheduleDrain = YES;
+    }
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    // Only one drain is scheduled at a time, every block submitted before it runs joins the same batch.
+    if (scheduleDrain)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self _drainPendingBlocks];
+        });
+    }
+}
+
+- (void)_drainPendingBlocks
+{
+    WEAssert([NSThread isMainThread]);
+
+    uint64_t startTime = WEMonotonicTime();
+    uint64_t deadline = startTime + (uint64_t)(self.timeBudget * NSEC_PER_SEC);
+    NSUInteger executedBlocks = 0;
+    BOOL carryOver = NO;
+
+    for (;;)
+    {
+        dispatch_block_t block = nil;
+        ENTER_CRITICAL_SECTION(self, _mutex)
+        if (_pendingBlocks.count > 0)
+        {
+            block = _pendingBlocks.firstObject;
+            [_pendingBlocks removeObjectAtIndex:0];
+        }
+        else
+        {
+            _drainScheduled = NO;
+        }
+        LEAVE_CRITICAL_SECTION(self, _mutex)
+
+        if (block == nil) break;
+
+        block();
+        executedBlocks++;
+
+        // Always perform at least one block per turn to guarantee progress, then check the budget.
+        if (WEMonotonicTime() >= deadline)
+        {
+            carryOver = YES;
+            break;
+        }
+    }
+
+    uint64_t endTime = WEMonotonicTime();
+
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    if (executedBlocks > 0)
+    {
+        _consumedTime += endTime - startTime;
+        _batchCount++;
+        _executedBlockCount += executedBlocks;
+    }
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+
+    // Budget is exhausted, let the main run loop process other events and continue on the next turn.
+    // The drain remains scheduled, so new blocks will join the carried over batch.
+    if (carryOver)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self _drainPendingBlocks];
+        });
+    }
+}
+
+@end
@@ -0,0 +1,44 @@
+//
+//  WEOperationExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Performs work of operations on behalf of a workflow: preparing, starting and prefetching them.
+ A workflow hands every such block to an executor, see `-[WEWorkflow operationExecutor]` and
+ `-[WEOperation operationExecutor]`, and makes no assumptions about the thread the block is performed on.
+ Implementations must be thread safe. Built-in ones are `WEDispatchQueueExecutor`, `WEInlineExecutor`,
+ `WEWorkStealingExecutor` and `WEMainThreadExecutor`.
+ */
+@protocol WEOperationExecutor <NSObject>
+
+/**
+ Schedules a block for execution.
+ @param block a block to perform
+ */
+- (void)executeBlock:(nonnull dispatch_block_t)block;
+
+@optional
+
+/**
+ Schedules a block for execution on a preferred worker. An executor that implements this method and `currentWorkerIndex`
+ gets an operation made ready by a completion with the worker that performed its predecessor as the preferred one.
+ @param block a block to perform
+ @param workerIndex index of the preferred worker, or `NSNotFound` for no preference.
+ */
+- (void)executeBlock:(nonnull dispatch_block_t)block preferredWorker:(NSUInteger)workerIndex;
+
+/**
+ Index of the worker of this executor the caller is running on, or `NSNotFound` if the caller is not running
+ on one of its workers.
+ */
+@property (nonatomic, readonly) NSUInteger currentWorkerIndex;
+
+@end
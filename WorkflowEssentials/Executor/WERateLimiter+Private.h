@@ -0,0 +1,22 @@
+//
+//  WERateLimiter+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WERateLimiter.h>
+
+@interface WERateLimiter ()
+
+/**
+ Takes a token if there is one.
+ @param time current monotonic time, in nanoseconds
+ @return 0 if a token was taken, otherwise nanoseconds until the next token is due.
+ */
+- (uint64_t)_takeTokenAtTime:(uint64_t)time;
+
+@end
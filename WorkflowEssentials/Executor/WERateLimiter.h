@@ -0,0 +1,41 @@
+//
+//  WERateLimiter.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Token bucket limiting the rate at which operations assigned to it start, across all workflows
+ (see `-[WEOperation rateLimiter]`).
+ The bucket holds up to `burst` tokens and is refilled at `rate` tokens per second. Starting an operation takes a token.
+ An operation that is ready when the bucket is empty stays ready, other ready operations of the workflow may start
+ ahead of it, and the workflow retries when the next token is due.
+ The bucket is full when the limiter is created. Thread safe.
+ */
+@interface WERateLimiter : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Initialize a new rate limiter
+ @param rate number of operations per second that may start in the long run. Must be positive.
+ @param burst number of operations that may start at once after a quiet period. Must be positive.
+ @return an instance of `WERateLimiter`
+ */
+- (nonnull instancetype)initWithRate:(double)rate burst:(NSUInteger)burst NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) double rate;
+@property (nonatomic, readonly) NSUInteger burst;
+
+/**
+ Number of times a ready operation was held back because the bucket was empty.
+ */
+@property (nonatomic, readonly) NSUInteger throttledCount;
+
+@end
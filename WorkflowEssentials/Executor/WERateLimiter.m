@@ -0,0 +1,87 @@
+//
+//  WERateLimiter.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WERateLimiter.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WERateLimiter+Private.h"
+
+@implementation WERateLimiter
+{
+    double _rate;
+    NSUInteger _burst;
+    
+    pthread_mutex_t _mutex;
+    // Tokens are refilled lazily, when one is taken.
+    double _tokens;
+    uint64_t _refillTime;
+    NSUInteger _throttledCount;
+}
+
+@synthesize rate = _rate;
+@synthesize burst = _burst;
+
+- (instancetype)initWithRate:(double)rate burst:(NSUInteger)burst
+{
+    if (!(rate > 0)) THROW_INVALID_PARAM(rate, nil);
+    if (burst == 0) THROW_INVALID_PARAM(burst, nil);
+    
+    if (self = [super init])
+    {
+        _rate = rate;
+        _burst = burst;
+        pthread_mutex_init(&_mutex, NULL);
+        _tokens = burst;
+        _refillTime = WEMonotonicTime();
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (NSUInteger)throttledCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    count = _throttledCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return count;
+}
+
+- (uint64_t)_takeTokenAtTime:(uint64_t)time
+{
+    uint64_t delay = 0;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (time > _refillTime)
+    {
+        _tokens = MIN((double)_burst, _tokens + (double)(time - _refillTime) * _rate / NSEC_PER_SEC);
+        _refillTime = time;
+    }
+    
+    if (_tokens >= 1)
+    {
+        _tokens -= 1;
+    }
+    else
+    {
+        _throttledCount++;
+        delay = MAX((uint64_t)ceil((1 - _tokens) / _rate * NSEC_PER_SEC), 1);
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return delay;
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+//  WESimulationExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEWorkflow;
+@class WEWorkflowReport;
+@class WEConcurrencyController;
+
+typedef NS_ENUM(NSInteger, WESimulationSchedulingPolicy)
+{
+    // Ready operations start in the order they became ready, as they do in a real run.
+    WESimulationSchedulingFIFO,
+    // The ready operation with the longest chain of durations from its start to the end of the workflow starts first.
+    WESimulationSchedulingCriticalPathFirst,
+    // The ready operation with the shortest duration starts first.
+    WESimulationSchedulingShortestFirst
+};
+
+/**
+ Runs workflows on a virtual clock instead of executing their operations, to evaluate how they would be scheduled.
+ A simulation builds the same graph a run of the workflow would have and schedules it under the executor's concurrency
+ limit and scheduling policy. Operations are never prepared nor started: every operation takes its `simulatedDuration`
+ of virtual time and completes with its `simulatedResult`, which decides the segues it activates.
+ A trace of a real run can be replayed, in which case operations take as long as they did in that run.
+ The simulation is single-threaded and deterministic, and takes no real time beyond the bookkeeping, so the same
+ workflow can be simulated any number of times under different limits and policies, and their makespan and queueing
+ compared using the returned reports. Rate limiters, deduplication and streams are not simulated,
+ a stream is a plain dependency.
+ Not thread safe.
+ */
+@interface WESimulationExecutor : NSObject
+
+/**
+ Initialize a new simulation executor
+ @param maximumConcurrentOperations maximum number of operations that may be executed concurrently in a simulation.
+ Value of `0` means no limit.
+ @return an instance of `WESimulationExecutor`
+ */
+- (nonnull instancetype)initWithMaximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations NS_DESIGNATED_INITIALIZER;
+
+@property (nonatomic, readonly) NSUInteger maximumConcurrentOperations;
+
+/**
+ Order in which ready operations start. Default value is `WESimulationSchedulingFIFO`.
+ */
+@property (nonatomic, assign) WESimulationSchedulingPolicy schedulingPolicy;
+
+/**
+ Optional controller that adapts the concurrency limit during a simulation, fed with simulated durations and results.
+ */
+@property (nonatomic, strong, nullable) WEConcurrencyController *concurrencyController;
+
+/**
+ Optional report of a real run to replay. Operations that ran in it take as long as they executed, and operations that
+ did not take their `simulatedDuration`. Operations are matched by identity, or by name if the report comes from
+ another instance of the workflow.
+ */
+@property (nonatomic, strong, nullable) WEWorkflowReport *trace;
+
+/**
+ Simulates a run of the workflow, which must not have started. The workflow itself is not changed, except that its
+ operations added with factories are created. The workflow cannot be started while it is being simulated.
+ @param workflow workflow to simulate
+ @param error returns the error the run would have failed with
+ @return timing report of the simulated run in virtual time, or `nil` if the run would have failed or the workflow
+ has no operations
+ */
+- (nullable WEWorkflowReport *)simulateWorkflow:(nonnull WEWorkflow *)workflow error:(NSError * _Nullable * _Nullable)error;
+
+/**
+ Largest number of operations that were ready and waiting to start at once during the last simulation.
+ */
+@property (nonatomic, readonly) NSUInteger peakReadyCount;
+
+@end
@@ -0,0 +1,279 @@
+//
+//  WESimulationExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WESimulationExecutor.h>
+
+#import <WorkflowEssentials/WEConcurrencyController.h>
+#import <WorkflowEssentials/WEOperation.h>
+#import <WorkflowEssentials/WEWorkflowReport.h>
+#import "WETools.h"
+#import "WEWorkflow+Private.h"
+#import "WEWorkflowGraph.h"
+#import "WEWorkflowReport+Private.h"
+
+static inline uint64_t _WENanoseconds(NSTimeInterval seconds)
+{
+    return (seconds > 0) ? (uint64_t)llround(seconds * NSEC_PER_SEC) : 0;
+}
+
+// Active nodes in a binary min-heap ordered by the time they finish, then by the order they started.
+typedef struct
+{
+    WEGraphIndex *nodes;
+    WEGraphIndex count;
+    const uint64_t *finishTimes;
+    const uint64_t *startOrder;
+} _WEActiveHeap;
+
+static inline BOOL _WEFinishesBefore(const _WEActiveHeap *heap, WEGraphIndex first, WEGraphIndex second)
+{
+    if (heap->finishTimes[first] != heap->finishTimes[second]) return heap->finishTimes[first] < heap->finishTimes[second];
+    return heap->startOrder[first] < heap->startOrder[second];
+}
+
+static void _WEActiveHeapPush(_WEActiveHeap *heap, WEGraphIndex node)
+{
+    WEGraphIndex index = heap->count++;
+    heap->nodes[index] = node;
+    while (index > 0)
+    {
+        WEGraphIndex parent = (index - 1) / 2;
+        if (!_WEFinishesBefore(heap, heap->nodes[index], heap->nodes[parent])) break;
+        WEGraphIndex swap = heap->nodes[index];
+        heap->nodes[index] = heap->nodes[parent];
+        heap->nodes[parent] = swap;
+        index = parent;
+    }
+}
+
+static WEGraphIndex _WEActiveHeapPop(_WEActiveHeap *heap)
+{
+    WEGraphIndex top = heap->nodes[0];
+    heap->nodes[0] = heap->nodes[--heap->count];
+
+    WEGraphIndex index = 0;
+    for (;;)
+    {
+        WEGraphIndex left = 2 * index + 1;
+        WEGraphIndex right = left + 1;
+        WEGraphIndex smallest = index;
+        if (left < heap->count && _WEFinishesBefore(heap, heap->nodes[left], heap->nodes[smallest])) smallest = left;
+        if (right < heap->count && _WEFinishesBefore(heap, heap->nodes[right], heap->nodes[smallest])) smallest = right;
+        if (smallest == index) break;
+        WEGraphIndex swap = heap->nodes[index];
+        heap->nodes[index] = heap->nodes[smallest];
+        heap->nodes[smallest] = swap;
+        index = smallest;
+    }
+    return top;
+}
+
+// Length of the longest chain of durations from the start of every node to the end of the workflow, following
+// dependencies, segues and edges from operations of sub-workflows to their sub-workflows. Computed from the sinks
+// backwards, nodes on cycles of segues only count the successors that are not on the cycle.
+static void _WEComputeRemainingPaths(const WEWorkflowGraph *graph, const uint64_t *durations, uint64_t *paths)
+{
+    WEGraphIndex nodeCount = graph->nodeCount;
+    WEGraphIndex *outDegrees = calloc(nodeCount, sizeof(WEGraphIndex));
+    WEGraphIndex *predecessorOffsets = calloc((size_t)nodeCount + 1, sizeof(WEGraphIndex));
+    WEGraphIndex edgeCount = graph->dependencyCount + graph->segueCount + nodeCount;
+    WEGraphIndex *predecessors = malloc(MAX(edgeCount, 1) * sizeof(WEGraphIndex));
+    WEGraphIndex *queue = malloc(MAX(nodeCount, 1) * sizeof(WEGraphIndex));
+    uint64_t *successorPaths = calloc(nodeCount, sizeof(uint64_t));
+
+    for (WEGraphIndex node = 0; node < nodeCount; node++)
+    {
+        outDegrees[node] = (graph->dependentOffsets[node + 1] - graph->dependentOffsets[node])
+                         + (graph->segueOffsets[node + 1] - graph->segueOffsets[node])
+                         + (graph->barrierTargets[node] != WEGraphNoIndex ? 1 : 0);
+        predecessorOffsets[node + 1] = predecessorOffsets[node] + graph->dependsOnCounts[node] + graph->incomingSegueCounts[node] + graph->barrierCounts[node];
+    }
+
+    // The queue is not used yet, borrow it as the per-node insertion cursor.
+    memcpy(queue, predecessorOffsets, nodeCount * sizeof(WEGraphIndex));
+    for (WEGraphIndex node = 0; node < nodeCount; node++)
+    {
+        for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+        {
+            predecessors[queue[graph->dependents[edge]]++] = node;
+        }
+        for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+        {
+            predecessors[queue[graph->segueTargets[edge]]++] = node;
+        }
+        if (graph->barrierTargets[node] != WEGraphNoIndex) predecessors[queue[graph->barrierTargets[node]]++] = node;
+    }
+
+    WEGraphIndex head = 0;
+    WEGraphIndex tail = 0;
+    for (WEGraphIndex node = 0; node < nodeCount; node++)
+    {
+        if (outDegrees[node] == 0) queue[tail++] = node;
+    }
+    while (head < tail)
+    {
+        WEGraphIndex node = queue[head++];
+        paths[node] = durations[node] + successorPaths[node];
+        for (WEGraphIndex edge = predecessorOffsets[node], end = predecessorOffsets[node + 1]; edge < end; edge++)
+        {
+            WEGraphIndex predecessor = predecessors[edge];
+            successorPaths[predecessor] = MAX(successorPaths[predecessor], paths[node]);
+            if (--outDegrees[predecessor] == 0) queue[tail++] = predecessor;
+        }
+    }
+    for (WEGraphIndex node = 0; node < nodeCount; node++)
+    {
+        if (outDegrees[node] > 0) paths[node] = durations[node] + successorPaths[node];
+    }
+
+    free(successorPaths);
+    free(queue);
+    free(predecessors);
+    free(predecessorOffsets);
+    free(outDegrees);
+}
+
+@implementation WESimulationExecutor
+{
+    NSUInteger _maximumConcurrentOperations;
+    NSUInteger _peakReadyCount;
+}
+
+@synthesize maximumConcurrentOperations = _maximumConcurrentOperations;
+@synthesize peakReadyCount = _peakReadyCount;
+
+- (instancetype)init
+{
+    return [self initWithMaximumConcurrentOperations:0];
+}
+
+- (instancetype)initWithMaximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
+{
+    if (self = [super init])
+    {
+        _maximumConcurrentOperations = (maximumConcurrentOperations > 0) ? maximumConcurrentOperations : INT32_MAX;
+    }
+    return self;
+}
+
+- (void)_fillDurations:(uint64_t *)durations ofOperations:(NSArray<WEOperation *> *)operations
+{
+    NSMapTable<WEOperation *, NSNumber *> *tracedByOperation = [NSMapTable strongToStrongObjectsMapTable];
+    NSMutableDictionary<NSString *, NSNumber *> *tracedByName = [NSMutableDictionary new];
+    for (WEOperationReport *operationReport in _trace.operationReports)
+    {
+        NSNumber *executionTime = @(operationReport.executionTime);
+        [tracedByOperation setObject:executionTime forKey:operationReport.operation];
+        NSString *name = operationReport.operation.name;
+        if (name != nil) tracedByName[name] = executionTime;
+    }
+
+    NSUInteger i = 0;
+    for (WEOperation *operation in operations)
+    {
+        NSNumber *traced = [tracedByOperation objectForKey:operation];
+        if (traced == nil && operation.name != nil) traced = tracedByName[operation.name];
+        durations[i++] = _WENanoseconds((traced != nil) ? traced.doubleValue : operation.simulatedDuration);
+    }
+}
+
+// Position in the ready queue of the node to start next.
+static WEGraphIndex _WENextReadyPosition(const WEWorkflowGraph *graph, WESimulationSchedulingPolicy policy, const uint64_t *durations, const uint64_t *paths)
+{
+    WEGraphIndex best = graph->readyHead;
+    if (policy == WESimulationSchedulingFIFO) return best;
+
+    for (WEGraphIndex position = graph->readyHead + 1; position < graph->readyTail; position++)
+    {
+        WEGraphIndex node = graph->readyQueue[position];
+        WEGraphIndex bestNode = graph->readyQueue[best];
+        BOOL better = (policy == WESimulationSchedulingCriticalPathFirst) ? paths[node] > paths[bestNode] : durations[node] < durations[bestNode];
+        if (better) best = position;
+    }
+    return best;
+}
+
+- (WEWorkflowReport *)simulateWorkflow:(WEWorkflow *)workflow error:(NSError **)errorRef
+{
+    if (workflow == nil) THROW_INVALID_PARAM(workflow, nil);
+
+    _peakReadyCount = 0;
+    NSArray<WEOperation *> *operations;
+    WEWorkflowGraph *graph = [workflow _buildGraphForSimulationWithOperations:&operations error:errorRef];
+    if (graph == NULL) return nil;
+
+    WEGraphIndex nodeCount = graph->nodeCount;
+    uint64_t *durations = malloc(nodeCount * sizeof(uint64_t));
+    uint64_t *startOrder = malloc(nodeCount * sizeof(uint64_t));
+    uint64_t *paths = NULL;
+    [self _fillDurations:durations ofOperations:operations];
+    if (_schedulingPolicy == WESimulationSchedulingCriticalPathFirst)
+    {
+        paths = malloc(nodeCount * sizeof(uint64_t));
+        _WEComputeRemainingPaths(graph, durations, paths);
+    }
+
+    _WEActiveHeap active = {
+        .nodes = malloc(nodeCount * sizeof(WEGraphIndex)),
+        .count = 0,
+        .finishTimes = graph->finishTimes,
+        .startOrder = startOrder
+    };
+    WEOperationResult *successResult = [[WEOperationResult alloc] initWithResult:nil];
+    WEConcurrencyController *controller = _concurrencyController;
+    uint64_t now = 0;
+    uint64_t startCount = 0;
+
+    for (;;)
+    {
+        _peakReadyCount = MAX(_peakReadyCount, WEWorkflowGraphReadyCount(graph));
+        NSUInteger limit = (controller != nil) ? MIN(_maximumConcurrentOperations, controller.limit) : _maximumConcurrentOperations;
+        while (WEWorkflowGraphReadyCount(graph) > 0 && graph->activeCount < limit)
+        {
+            WEWorkflowGraphMoveReadyToFront(graph, _WENextReadyPosition(graph, _schedulingPolicy, durations, paths));
+            WEGraphIndex node = WEWorkflowGraphDequeueReady(graph);
+            graph->startTimes[node] = now;
+            // The finish time is planned when the node starts, and set again to the same time when it completes.
+            graph->finishTimes[node] = now + durations[node];
+            startOrder[node] = startCount++;
+            _WEActiveHeapPush(&active, node);
+        }
+        if (active.count == 0) break;
+
+        WEGraphIndex node = _WEActiveHeapPop(&active);
+        now = graph->finishTimes[node];
+        WEOperationResult *result = operations[node].simulatedResult ?: successResult;
+        [controller recordOperationWithLatency:(double)durations[node] / NSEC_PER_SEC failed:result.failed];
+        WEWorkflowGraphCompleteNode(graph, node, result, now, WEGraphNoIndex);
+    }
+
+    WEWorkflowReport *report = nil;
+    if (graph->completedCount + graph->skippedCount < nodeCount)
+    {
+        if (errorRef != NULL)
+        {
+            NSString *reason = [NSString stringWithFormat:@"Workflow %@ cannot proceed: completed %li of %li operations, but no operations are ready for execution or active.", workflow, (long)graph->completedCount, (long)nodeCount];
+            *errorRef = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDeadlocked userInfo:@{ NSLocalizedDescriptionKey: reason }];
+        }
+    }
+    else
+    {
+        report = [[WEWorkflowReport alloc] _initWithGraph:graph operations:operations startTime:0];
+    }
+
+    free(active.nodes);
+    free(paths);
+    free(startOrder);
+    free(durations);
+    WEWorkflowGraphDestroy(graph);
+    return report;
+}
+
+@end
@@ -0,0 +1,61 @@
+//
+//  WEWorkStealingExecutor.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+#import <WorkflowEssentials/WEOperationExecutor.h>
+
+/**
+ A thread pool with a work-stealing deque per worker thread, intended for CPU-bound operations.
+ A block submitted from a worker thread is pushed to that worker's own deque, and each worker performs
+ its most recently pushed block first, which keeps data the block works on hot in that worker's cache.
+ A worker that runs out of work steals the oldest block from another worker's deque.
+ Worker threads are created when the executor is initialized and exit when it is deallocated.
+ */
+@interface WEWorkStealingExecutor : NSObject <WEOperationExecutor>
+
+/**
+ Initialize a new work-stealing executor
+ @param threadCount number of worker threads. Value of `0` means the number of active processors.
+ @return an instance of `WEWorkStealingExecutor`
+ */
+- (nonnull instancetype)initWithThreadCount:(NSUInteger)threadCount NS_DESIGNATED_INITIALIZER;
+
+/**
+ Number of worker threads.
+ */
+@property (nonatomic, readonly) NSUInteger threadCount;
+
+/**
+ Number of blocks that were stolen by a worker from another worker's deque.
+ */
+@property (nonatomic, readonly) NSUInteger stealCount;
+
+/**
+ Index of the worker thread of this executor the caller is running on, or `NSNotFound` if the caller
+ is not running on one of this executor's worker threads.
+ */
+@property (nonatomic, readonly) NSUInteger currentWorkerIndex;
+
+/**
+ Schedules a block for execution. When called on a worker thread, the block is pushed to that worker's deque,
+ otherwise workers are chosen in round-robin order.
+ @param block a block to perform
+ */
+- (void)executeBlock:(nonnull dispatch_block_t)block;
+
+/**
+ Schedules a block for execution on a preferred worker. The block is pushed to the preferred worker's deque,
+ but may still be stolen by another worker if the preferred one is busy.
+ @param block a block to perform
+ @param workerIndex index of the preferred worker, or `NSNotFound` for no preference.
+ */
+- (void)executeBlock:(nonnull dispatch_block_t)block preferredWorker:(NSUInteger)workerIndex;
+
+@end
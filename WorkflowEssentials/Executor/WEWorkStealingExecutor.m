@@ -0,0 +1,315 @@
+//
+//  WEWorkStealingExecutor.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkStealingExecutor.h>
+
+#import <pthread.h>
+#import <stdatomic.h>
+#import "WETools.h"
+
+// A deque of blocks owned by a single worker.
+// The owner pushes and pops at the bottom (end of the array), thieves take from the top (beginning of the array).
+@interface _WEWorkerDeque : NSObject
+@end
+
+@implementation _WEWorkerDeque
+{
+@package
+    pthread_mutex_t _mutex;
+    NSMutableArray<dispatch_block_t> *_blocks;
+
+    // Owner of the deque sleeps on its own condition, so that a block pushed to the deque wakes up its owner
+    // rather than an arbitrary worker. Both are protected by the pool's idle mutex.
+    pthread_cond_t _wakeCondition;
+    BOOL _sleeping;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_wakeCondition, NULL);
+        _blocks = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_cond_destroy(&_wakeCondition);
+    pthread_mutex_destroy(&_mutex);
+}
+
+@end
+
+static inline void _WEDequePush(__unsafe_unretained _WEWorkerDeque *deque, dispatch_block_t block)
+{
+    ENTER_CRITICAL_SECTION(deque, _mutex)
+    [deque->_blocks addObject:block];
+    LEAVE_CRITICAL_SECTION(deque, _mutex)
+}
+
+static inline dispatch_block_t _WEDequeTake(__unsafe_unretained _WEWorkerDeque *deque, BOOL fromBottom)
+{
+    dispatch_block_t block = nil;
+    ENTER_CRITICAL_SECTION(deque, _mutex)
+    NSUInteger count = deque->_blocks.count;
+    if (count > 0)
+    {
+        NSUInteger index = fromBottom ? count - 1 : 0;
+        block = deque->_blocks[index];
+        [deque->_blocks removeObjectAtIndex:index];
+    }
+    LEAVE_CRITICAL_SECTION(deque, _mutex)
+    return block;
+}
+
+// State shared between the executor and its worker threads.
+// Workers do not retain the executor itself, so the executor can be deallocated, which shuts the workers down.
+@interface _WEWorkStealingPool : NSObject
+@end
+
+@implementation _WEWorkStealingPool
+{
+@package
+    NSArray<_WEWorkerDeque *> *_deques;
+    atomic_long _pendingBlocks;
+    atomic_ulong _stealCount;
+    atomic_ulong _nextWorker;
+
+    // Idle workers sleep on conditions of their deques until there are pending blocks.
+    pthread_mutex_t _idleMutex;
+    BOOL _shutdown;
+}
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount
+{
+    if (self = [super init])
+    {
+        NSMutableArray<_WEWorkerDeque *> *deques = [[NSMutableArray alloc] initWithCapacity:threadCount];
+        for (NSUInteger i = 0; i < threadCount; i++) [deques addObject:[_WEWorkerDeque new]];
+        _deques = [deques copy];
+
+        atomic_init(&_pendingBlocks, 0);
+        atomic_init(&_stealCount, 0);
+        atomic_init(&_nextWorker, 0);
+        pthread_mutex_init(&_idleMutex, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_idleMutex);
+}
+
+@end
+
+// Per-thread worker context, stored in thread-specific data of worker threads.
+@interface _WEWorkerContext : NSObject
+@end
+
+@implementation _WEWorkerContext
+{
+@package
+    _WEWorkStealingPool *_pool;
+    NSUInteger _index;
+}
+@end
+
+static pthread_key_t _WEWorkerContextKey;
+static pthread_once_t _WEWorkerContextKeyOnce = PTHREAD_ONCE_INIT;
+
+static void _WECreateWorkerContextKey(void)
+{
+    pthread_key_create(&_WEWorkerContextKey, NULL);
+}
+
+static inline _WEWorkerContext *_WECurrentWorkerContext(void)
+{
+    pthread_once(&_WEWorkerContextKeyOnce, _WECreateWorkerContextKey);
+    return (__bridge _WEWorkerContext *)pthread_getspecific(_WEWorkerContextKey);
+}
+
+static void _WEPoolPush(__unsafe_unretained _WEWorkStealingPool *pool, NSUInteger workerIndex, dispatch_block_t block)
+{
+    _WEDequePush(pool->_deques[workerIndex], block);
+    atomic_fetch_add(&pool->_pendingBlocks, 1);
+
+    // Wake up the owner of the deque if it sleeps, otherwise any sleeping worker, which will steal the block
+    // if the owner is still busy by then. Taking the mutex guarantees the wake-up is not lost between
+    // the worker checking pending count and starting to wait.
+    pthread_mutex_lock(&pool->_idleMutex);
+    NSArray<_WEWorkerDeque *> *deques = pool->_deques;
+    NSUInteger count = deques.count;
+    for (NSUInteger offset = 0; offset < count; offset++)
+    {
+        __unsafe_unretained _WEWorkerDeque *deque = deques[(workerIndex + offset) % count];
+        if (deque->_sleeping)
+        {
+            deque->_sleeping = NO;
+            pthread_cond_signal(&deque->_wakeCondition);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool->_idleMutex);
+}
+
+static dispatch_block_t _WEPoolTake(__unsafe_unretained _WEWorkStealingPool *pool, NSUInteger workerIndex)
+{
+    NSArray<_WEWorkerDeque *> *deques = pool->_deques;
+    NSUInteger count = deques.count;
+
+    // Own deque first, most recently pushed block first.
+    dispatch_block_t block = _WEDequeTake(deques[workerIndex], YES);
+
+    // Steal the oldest block of another worker.
+    for (NSUInteger offset = 1; block == nil && offset < count; offset++)
+    {
+        block = _WEDequeTake(deques[(workerIndex + offset) % count], NO);
+        if (block != nil) atomic_fetch_add(&pool->_stealCount, 1);
+    }
+
+    if (block != nil) atomic_fetch_sub(&pool->_pendingBlocks, 1);
+    return block;
+}
+
+static void *_WEWorkerMain(void *argument)
+{
+    _WEWorkerContext *context = (__bridge_transfer _WEWorkerContext *)argument;
+    _WEWorkStealingPool *pool = context->_pool;
+    NSUInteger index = context->_index;
+
+    pthread_once(&_WEWorkerContextKeyOnce, _WECreateWorkerContextKey);
+    pthread_setspecific(_WEWorkerContextKey, (__bridge void *)context);
+
+    for (;;)
+    {
+        dispatch_block_t block = _WEPoolTake(pool, index);
+        if (block != nil)
+        {
+            @autoreleasepool
+            {
+                block();
+            }
+            continue;
+        }
+
+        BOOL shutdown;
+        __unsafe_unretained _WEWorkerDeque *ownDeque = pool->_deques[index];
+        pthread_mutex_lock(&pool->_idleMutex);
+        while (atomic_load(&pool->_pendingBlocks) == 0 && !pool->_shutdown)
+        {
+            ownDeque->_sleeping = YES;
+            pthread_cond_wait(&ownDeque->_wakeCondition, &pool->_idleMutex);
+        }
+        ownDeque->_sleeping = NO;
+        shutdown = pool->_shutdown && atomic_load(&pool->_pendingBlocks) == 0;
+        pthread_mutex_unlock(&pool->_idleMutex);
+
+        if (shutdown) break;
+    }
+
+    pthread_setspecific(_WEWorkerContextKey, NULL);
+    return NULL;
+}
+
+@implementation WEWorkStealingExecutor
+{
+    _WEWorkStealingPool *_pool;
+    NSUInteger _threadCount;
+}
+
+- (instancetype)init
+{
+    return [self initWithThreadCount:0];
+}
+
+- (instancetype)initWithThreadCount:(NSUInteger)threadCount
+{
+    if (self = [super init])
+    {
+        _threadCount = (threadCount > 0) ? threadCount : MAX([NSProcessInfo processInfo].activeProcessorCount, 1);
+        _pool = [[_WEWorkStealingPool alloc] initWithThreadCount:_threadCount];
+
+        for (NSUInteger i = 0; i < _threadCount; i++)
+        {
+            _WEWorkerContext *context = [_WEWorkerContext new];
+            context->_pool = _pool;
+            context->_index = i;
+
+            pthread_attr_t attributes;
+            pthread_attr_init(&attributes);
+            pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+            pthread_t thread;
+            void *argument = (__bridge_retained void *)context;
+            if (pthread_create(&thread, &attributes, _WEWorkerMain, argument) != 0)
+            {
+                CFBridgingRelease(argument);
+                pthread_attr_destroy(&attributes);
+                THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to create a worker thread" });
+            }
+            pthread_attr_destroy(&attributes);
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    // Workers finish the blocks that are already scheduled and exit.
+    pthread_mutex_lock(&_pool->_idleMutex);
+    _pool->_shutdown = YES;
+    for (_WEWorkerDeque *deque in _pool->_deques)
+    {
+        pthread_cond_signal(&deque->_wakeCondition);
+    }
+    pthread_mutex_unlock(&_pool->_idleMutex);
+}
+
+
+#pragma mark - Properties
+
+@synthesize threadCount = _threadCount;
+
+- (NSUInteger)stealCount
+{
+    return (NSUInteger)atomic_load(&_pool->_stealCount);
+}
+
+- (NSUInteger)currentWorkerIndex
+{
+    _WEWorkerContext *context = _WECurrentWorkerContext();
+    if (context == nil || context->_pool != _pool) return NSNotFound;
+    return context->_index;
+}
+
+
+#pragma mark - Execution
+
+- (void)executeBlock:(dispatch_block_t)block
+{
+    [self executeBlock:block preferredWorker:NSNotFound];
+}
+
+- (void)executeBlock:(dispatch_block_t)block preferredWorker:(NSUInteger)workerIndex
+{
+    if (block == nil) THROW_INVALID_PARAM(block, nil);
+    if (workerIndex != NSNotFound && workerIndex >= _threadCount) THROW_INVALID_PARAM(workerIndex, nil);
+
+    if (workerIndex == NSNotFound) workerIndex = self.currentWorkerIndex;
+    if (workerIndex == NSNotFound) workerIndex = atomic_fetch_add(&_pool->_nextWorker, 1) % _threadCount;
+
+    _WEPoolPush(_pool, workerIndex, [block copy]);
+}
+
+@end
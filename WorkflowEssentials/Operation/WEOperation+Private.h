@@ -0,0 +1,40 @@
+//
+//  WEOperation+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEOperation.h>
+
+@interface WEOperation ()
+
+/**
+ Starts the operation like `startWithCompletion:completionQueue:`. If the completion queue is `nil`, the completion
+ is called synchronously on the thread that completes the operation, and must be quick. An operation that was cancelled
+ with `cancel` is not started, and the completion is called right away with the cancellation failure.
+ */
+- (void)_startWithCompletion:(nullable void (^)(WEOperationResult * _Nullable result))completion completionQueue:(nullable dispatch_queue_t)completionQueue;
+
+/**
+ Cancels the operation on behalf of the workflow, which has skipped its node already. Unlike `cancel`, the completion
+ is dropped. Returns YES if the operation was active, so its completion will never be called.
+ */
+- (BOOL)_cancel;
+
+/**
+ Completes an operation that was never started with the result of an identical operation whose flight it joined,
+ see `-[WEOperation deduplicationKey]`. Does nothing if the operation has started or was cancelled meanwhile.
+ */
+- (void)_completeWithJoinedResult:(nullable WEOperationResult *)result;
+
+/**
+ Returns a finished operation to the inactive state, so that an incremental workflow can start it again.
+ Does nothing if the operation has not finished.
+ */
+- (void)_resetForRerun;
+
+@end
@@ -12,6 +12,8 @@
 #import <WorkflowEssentials/WEOperationResult.h>
 
 @class WEWorkflowContext;
+@class WERateLimiter;
+@protocol WEOperationExecutor;
 
 @interface WEOperation<__covariant WEResultType : id<NSCopying> > : NSObject
 
@@ -38,11 +40,111 @@
  */
 - (void)prepareForExecutionWithContext:(nonnull __kindof WEWorkflowContext *)context;
 
+/**
+ Called by a workflow with speculative prefetch enabled when the operation is the target of a likely segue
+ whose source has started, before it is known whether the operation will run.
+ Allows an operation to get ahead with work like I/O setup, which it can then use when it is prepared and started.
+ Must not have side effects visible outside of the operation, because the operation may never run.
+ Is called on the same kind of thread as the operation would be prepared on, and always completes before
+ `prepareForExecutionWithContext:` or `discardPrefetch` is called.
+ Default implementation does nothing.
+ */
+- (void)prefetchWithContext:(nonnull __kindof WEWorkflowContext *)context;
+
+/**
+ Called after `prefetchWithContext:` when the operation will not run, so that it can release whatever it has prefetched.
+ Default implementation does nothing.
+ */
+- (void)discardPrefetch;
+
 /**
  Overridable method starting the operation. Subclasses must implement this method. Default implementation throws an exception.
  */
 - (void)start;
 
+/**
+ Called when an active operation is cancelled, so that it can stop work in progress. Its result is ignored,
+ so it does not need to complete. Is called on the thread that cancels the operation, and must be quick.
+ Default implementation does nothing.
+ */
+- (void)stop;
+
+
+#pragma mark - Incremental execution
+
+/**
+ Keys of context values the operation reads. A workflow with incremental execution enabled runs the operation again
+ only if one of these values or a result of an operation that precedes it has changed since the last run.
+ Default value is `nil`, meaning that the operation reads no context values. Must be set before the workflow starts.
+ */
+@property (nonatomic, copy, nullable) NSSet<id<NSCopying>> *inputContextKeys;
+
+
+#pragma mark - Deduplication
+
+/**
+ Key of identical operations, which need to be performed only once at a time across all workflows in the process,
+ e.g. refreshing an access token. When the operation is about to start while an operation with the same key
+ is in progress, it is not started, but completes with the result of that operation instead.
+ The operation is still prepared as usual. Default value is `nil`. Must be set before the workflow starts.
+ */
+@property (nonatomic, copy, nullable) NSString *deduplicationKey;
+
+
+#pragma mark - Rate limiting
+
+/**
+ Optional rate limiter the operation is assigned to. The operation does not start until the limiter has a token for it,
+ and stays ready while it waits. Operations of any workflows may share a limiter.
+ Default value is `nil`. Must be set before the workflow starts.
+ */
+@property (nonatomic, strong, nullable) WERateLimiter *rateLimiter;
+
+
+#pragma mark - Early termination
+
+/**
+ If YES, the workflow completes as soon as the operation completes successfully, without waiting for the rest of its
+ operations: the ones that are still running are cancelled, and the ones that have not started are skipped.
+ A terminal operation that fails does not end the workflow. Default value is NO. Must be set before the workflow starts.
+ */
+@property (nonatomic, assign, getter=isTerminal) BOOL terminal;
+
+/**
+ Name of a group of alternative operations of which only the first to complete successfully is needed,
+ e.g. reading the same data from a cache, from the network and from a replica. Once one operation of the group
+ completes successfully, the others are cancelled if they are running, and skipped along with the operations
+ that depend on them. Operations of the group that fail do not affect the others. Operations of a race group
+ that are also terminal end the workflow with the first success. Default value is `nil`.
+ Must be set before the workflow starts.
+ */
+@property (nonatomic, copy, nullable) NSString *raceGroup;
+
+
+#pragma mark - Execution
+
+/**
+ Optional executor the operation is prepared and started on, overriding the workflow's `operationExecutor`,
+ e.g. a serial queue shared by operations that use the same database connection.
+ Ignored if the operation requires main thread. Default value is `nil`. Must be set before the workflow starts.
+ */
+@property (nonatomic, strong, nullable) id<WEOperationExecutor> operationExecutor;
+
+
+#pragma mark - Simulation
+
+/**
+ Time (in seconds) the operation takes when a workflow is simulated, see `WESimulationExecutor`.
+ Default value is 0. Has no effect on real runs.
+ */
+@property (nonatomic, assign) NSTimeInterval simulatedDuration;
+
+/**
+ Result the operation completes with when a workflow is simulated, which decides the segues it activates.
+ Default value is `nil`, meaning a successful result with no value. Has no effect on real runs.
+ */
+@property (nonatomic, strong, nullable) WEOperationResult<WEResultType> *simulatedResult;
+
 
 #pragma mark - Operation state
 
@@ -86,4 +188,13 @@
  */
 - (void)completeWithResult:(nullable WEOperationResult<WEResultType> *)result;
 
+/**
+ Cancels the operation. If it is active, it is stopped and completes right away with a failed result, whose error is
+ `NSUserCancelledError` in `NSCocoaErrorDomain`, and completing it afterwards does nothing. A cancelled operation cannot
+ be started manually, a workflow that gets to it completes it with the same failed result without starting it.
+ Either way, the workflow that owns the operation goes on as with any other failed operation.
+ Does nothing if the operation has finished.
+ */
+- (void)cancel;
+
 @end
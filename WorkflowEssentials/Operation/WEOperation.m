@@ -12,6 +12,7 @@
 #import <pthread.h>
 #import <objc/runtime.h>
 #import "WETools.h"
+#import "WEOperation+Private.h"
 
 typedef enum
 {
@@ -30,9 +31,25 @@ typedef enum
     WEOperationResult<id<NSCopying>> *_result;
     void (^_completion)(WEOperationResult *result);
     dispatch_queue_t _completionQueue;
+    NSSet<id<NSCopying>> *_inputContextKeys;
+    NSString *_deduplicationKey;
+    BOOL _terminal;
+    NSString *_raceGroup;
+    WERateLimiter *_rateLimiter;
+    id<WEOperationExecutor> _operationExecutor;
+    NSTimeInterval _simulatedDuration;
+    WEOperationResult *_simulatedResult;
 }
 
 @synthesize name = _name;
+@synthesize inputContextKeys = _inputContextKeys;
+@synthesize deduplicationKey = _deduplicationKey;
+@synthesize terminal = _terminal;
+@synthesize raceGroup = _raceGroup;
+@synthesize rateLimiter = _rateLimiter;
+@synthesize operationExecutor = _operationExecutor;
+@synthesize simulatedDuration = _simulatedDuration;
+@synthesize simulatedResult = _simulatedResult;
 
 - (instancetype)init
 {
@@ -103,21 +120,43 @@ _IsOperationInState(__unsafe_unretained WEOperation *operation, WEOperationState
 - (void)startWithCompletion:(void (^)(WEOperationResult<id<NSCopying>> * _Nullable))completion completionQueue:(dispatch_queue_t)completionQueue
 {
     if ((completion != nil) ^ (completionQueue != nil)) THROW_INVALID_PARAMS(@{ NSLocalizedDescriptionKey: @"Either completion or completion queue is nil, but not both" });
+    if (self.cancelled) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Operation cannot start because it was cancelled" });
+    [self _startWithCompletion:completion completionQueue:completionQueue];
+}
 
+- (void)_startWithCompletion:(void (^)(WEOperationResult *))completion completionQueue:(dispatch_queue_t)completionQueue
+{
+    WEOperationResult *cancellation = nil;
+    
     ENTER_CRITICAL_SECTION(self, _mutex)
     
-    if (_state != WEOperationInactive)
+    if (_state == WEOperationCancelled && _result != nil)
+    {
+        cancellation = _result;
+    }
+    else if (_state != WEOperationInactive)
     {
         THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Operation cannot start because it is in an invalid state" });
     }
     
-    _state = WEOperationActive;
-    _completion = completion;
-    _completionQueue = completionQueue;
+    else
+    {
+        _state = WEOperationActive;
+        _completion = completion;
+        _completionQueue = completionQueue;
+    }
     
     LEAVE_CRITICAL_SECTION(self, _mutex)
     
-    [self start];
+    if (cancellation == nil)
+    {
+        [self start];
+    }
+    else if (completion != nil)
+    {
+        if (completionQueue != nil) dispatch_async(completionQueue, ^{ completion(cancellation); });
+        else completion(cancellation);
+    }
 }
 
 - (void)completeWithResult:(WEOperationResult *)result
@@ -129,6 +168,8 @@ _IsOperationInState(__unsafe_unretained WEOperation *operation, WEOperationState
     
     ENTER_CRITICAL_SECTION(self, _mutex)
     
+    // A cancelled operation may still complete the work it was doing, the result is ignored.
+    if (_state == WEOperationCancelled) return;
     if (_state != WEOperationActive)
     {
         THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Operation cannot be completed because it is in an invalid state" });
@@ -146,8 +187,89 @@ _IsOperationInState(__unsafe_unretained WEOperation *operation, WEOperationState
     
     if (completion != nil)
     {
-        dispatch_async(completionQueue, ^{ completion(result); });
+        if (completionQueue != nil) dispatch_async(completionQueue, ^{ completion(result); });
+        else completion(result);
+    }
+}
+
+- (void)cancel
+{
+    void (^completion)(WEOperationResult *result) = nil;
+    dispatch_queue_t completionQueue = nil;
+    WEOperationResult *result = nil;
+    BOOL wasActive = NO;
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_state == WEOperationInactive || _state == WEOperationActive)
+    {
+        wasActive = (_state == WEOperationActive);
+        result = [[WEOperationResult alloc] initWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSUserCancelledError userInfo:nil]];
+        completion = _completion;
+        completionQueue = _completionQueue;
+        
+        _state = WEOperationCancelled;
+        _completion = nil;
+        _completionQueue = nil;
+        // Kept for a workflow that gets to the operation later.
+        _result = result;
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    
+    if (!wasActive) return;
+    [self stop];
+    if (completion != nil)
+    {
+        if (completionQueue != nil) dispatch_async(completionQueue, ^{ completion(result); });
+        else completion(result);
+    }
+}
+
+- (BOOL)_cancel
+{
+    BOOL wasActive = NO;
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_state == WEOperationInactive || _state == WEOperationActive)
+    {
+        wasActive = (_state == WEOperationActive);
+        _state = WEOperationCancelled;
+        _completion = nil;
+        _completionQueue = nil;
     }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    
+    if (wasActive) [self stop];
+    return wasActive;
+}
+
+- (void)_completeWithJoinedResult:(WEOperationResult *)result
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_state == WEOperationInactive && result != nil)
+    {
+        _state = WEOperationComplete;
+        _result = result;
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)_resetForRerun
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_state == WEOperationComplete)
+    {
+        _state = WEOperationInactive;
+        _result = nil;
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
 }
 
 
@@ -163,10 +285,25 @@ _IsOperationInState(__unsafe_unretained WEOperation *operation, WEOperationState
     // Default implementation does nothing
 }
 
+- (void)prefetchWithContext:(__kindof WEWorkflowContext *)context
+{
+    // Default implementation does nothing
+}
+
+- (void)discardPrefetch
+{
+    // Default implementation does nothing
+}
+
 - (void)start
 {
     THROW_ABSTRACT(nil);
 }
 
+- (void)stop
+{
+    // Default implementation does nothing
+}
+
 
 @end
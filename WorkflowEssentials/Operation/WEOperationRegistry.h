@@ -0,0 +1,54 @@
+//
+//  WEOperationRegistry.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEOperation;
+
+/**
+ Creates a new operation of a registered type.
+ @param name name of the operation, or `nil` for an unnamed operation
+ @return a new operation, which must have the given name
+ */
+typedef WEOperation * _Nonnull (^WEOperationFactory)(NSString * _Nullable name);
+
+/**
+ Maps operation type names to factories, so that operations can be referred to by type in serialized
+ workflow definitions. Thread safe.
+ */
+@interface WEOperationRegistry : NSObject
+
+/**
+ Registry used by default when loading workflow definitions.
+ */
++ (nonnull WEOperationRegistry *)sharedRegistry;
+
+/**
+ Registers a factory for an operation type, replacing a factory previously registered for the same type.
+ @param type operation type name
+ @param factory a block creating operations of the type
+ */
+- (void)registerOperationType:(nonnull NSString *)type factory:(nonnull WEOperationFactory)factory;
+
+/**
+ Returns a factory registered for an operation type, or `nil` if the type is not registered.
+ @param type operation type name
+ */
+- (nullable WEOperationFactory)factoryForOperationType:(nonnull NSString *)type;
+
+/**
+ Creates an operation of a registered type.
+ @param type operation type name
+ @param name name of the operation, or `nil` for an unnamed operation
+ @return a new operation, or `nil` if the type is not registered
+ */
+- (nullable WEOperation *)operationWithType:(nonnull NSString *)type name:(nullable NSString *)name;
+
+@end
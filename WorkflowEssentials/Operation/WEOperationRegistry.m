@@ -0,0 +1,74 @@
+//
+//  WEOperationRegistry.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEOperationRegistry.h>
+
+#import <pthread.h>
+#import "WETools.h"
+
+@implementation WEOperationRegistry
+{
+    pthread_mutex_t _mutex;
+    NSMutableDictionary<NSString *, WEOperationFactory> *_factories;
+}
+
++ (WEOperationRegistry *)sharedRegistry
+{
+    static WEOperationRegistry *sharedRegistry;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedRegistry = [WEOperationRegistry new];
+    });
+    return sharedRegistry;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        _factories = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (void)registerOperationType:(NSString *)type factory:(WEOperationFactory)factory
+{
+    if (type == nil) THROW_INVALID_PARAM(type, nil);
+    if (factory == nil) THROW_INVALID_PARAM(factory, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    [_factories setObject:[factory copy] forKey:[type copy]];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (WEOperationFactory)factoryForOperationType:(NSString *)type
+{
+    if (type == nil) THROW_INVALID_PARAM(type, nil);
+    
+    WEOperationFactory factory;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    factory = [_factories objectForKey:type];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return factory;
+}
+
+- (WEOperation *)operationWithType:(NSString *)type name:(NSString *)name
+{
+    WEOperationFactory factory = [self factoryForOperationType:type];
+    return (factory != nil) ? factory(name) : nil;
+}
+
+@end
@@ -0,0 +1,20 @@
+//
+//  WEOperationResult+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEOperationResult.h>
+
+@interface WEOperationResult ()
+
+/**
+ YES for results initialized with a provider, whose value may not have been produced yet.
+ */
+@property (nonatomic, readonly, getter=_isLazy) BOOL _lazy;
+
+@end
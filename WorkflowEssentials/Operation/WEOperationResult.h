@@ -17,6 +17,13 @@
  @param result optional result value of an operation.
  */
 - (nonnull instancetype)initWithResult:(nullable WEResultType)result;
+/**
+ Initializes an operation result object as successfully completed with result data that is produced on demand.
+ The provider is called once, on the first access of `result` from any thread, and its value is copied then.
+ Results that are only checked for failure are never materialized.
+ @param provider block producing the result value of an operation (required).
+ */
+- (nonnull instancetype)initWithResultProvider:(WEResultType _Nullable (^ _Nonnull)(void))provider;
 /**
  Initializes an operation result object as failed with error.
  @param error an error object representing the failure (required).
@@ -9,12 +9,17 @@
 //
 
 #import <WorkflowEssentials/WEOperationResult.h>
+#import "WEOperationResult+Private.h"
 #import "WETools.h"
 
 @implementation WEOperationResult
 {
     id<NSCopying> _result;
     NSError *_error;
+    // Produces the result on first access, `nil` once it did, or for results that were given a value up front.
+    id<NSCopying> (^_provider)(void);
+    BOOL _lazy;
+    dispatch_once_t _materializeOnce;
 }
 
 - (instancetype)init
@@ -31,6 +36,18 @@
     return self;
 }
 
+- (instancetype)initWithResultProvider:(id<NSCopying> (^)(void))provider
+{
+    if (provider == nil) THROW_INVALID_PARAM(provider, nil);
+    
+    if (self = [super init])
+    {
+        _provider = [provider copy];
+        _lazy = YES;
+    }
+    return self;
+}
+
 - (instancetype)initWithError:(NSError *)error
 {
     if (error == nil) THROW_INVALID_PARAM(error, nil);
@@ -42,8 +59,20 @@
     return self;
 }
 
-@synthesize result = _result;
 @synthesize error  = _error;
+@synthesize _lazy = _lazy;
+
+- (id<NSCopying>)result
+{
+    if (_lazy)
+    {
+        dispatch_once(&_materializeOnce, ^{
+            self->_result = [self->_provider() copyWithZone:nil];
+            self->_provider = nil;
+        });
+    }
+    return _result;
+}
 
 - (BOOL)isFailed
 {
@@ -0,0 +1,28 @@
+//
+//  WEReduceOperation+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEReduceOperation.h>
+
+@protocol WEOperationExecutor;
+
+@interface WEReduceOperation ()
+
+/**
+ Called by a workflow when a run starts, before any of the sources completes. Partial results of a previous run
+ are dropped, including the ones that are still being combined.
+ */
+- (void)_beginReductionWithSourceCount:(NSUInteger)sourceCount executor:(nonnull id<WEOperationExecutor>)executor;
+
+/**
+ Called by the workflow when a source completes. May be called on any thread.
+ */
+- (void)_addResult:(nullable WEOperationResult *)result ofSourceAtIndex:(NSUInteger)index;
+
+@end
@@ -0,0 +1,37 @@
+//
+//  WEReduceOperation.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEOperation.h>
+
+/**
+ An operation that combines results of the operations it depends on (its sources) with an associative combine block.
+ Instead of combining all of them after the last source completes, results are combined pairwise as sources complete:
+ partial results of adjacent sources are combined in parallel on the operation's executor, so the merge that is left
+ once the last source completes is O(log N) deep, and partial results are released as soon as they are folded in.
+ - sources are ordered the way their operations were added to the workflow, and only adjacent partial results
+   are combined, so the combine block needs to be associative, but not commutative;
+ - a source whose result has no value is left out, and an operation without sources that have values completes
+   with a result without value;
+ - if any of the sources fails, the operation fails with the error of the first source that failed.
+ Sources must be connected with dependencies, and cannot be streams. Reduce operations cannot be added with factories.
+ */
+@interface WEReduceOperation<__covariant WEResultType : id<NSCopying> > : WEOperation<WEResultType>
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+- (nonnull instancetype)initWithName:(nullable NSString *)name NS_UNAVAILABLE;
+
+- (nonnull instancetype)initWithName:(nullable NSString *)name combine:(nonnull WEResultType _Nonnull (^)(WEResultType _Nonnull first, WEResultType _Nonnull second))combine;
+
+/**
+ Number of times the combine block was called during the last run.
+ */
+@property (nonatomic, readonly) NSUInteger combineCount;
+
+@end
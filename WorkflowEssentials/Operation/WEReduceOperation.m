@@ -0,0 +1,233 @@
+//
+//  WEReduceOperation.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEReduceOperation.h>
+
+#import <WorkflowEssentials/WEOperationExecutor.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WEReduceOperation+Private.h"
+
+@implementation WEReduceOperation
+{
+    pthread_mutex_t _reductionMutex;
+    id (^_combine)(id, id);
+    id<WEOperationExecutor> _executor;
+    // Incremented by every run, partial results of an earlier run are dropped when their combines finish.
+    NSUInteger _generation;
+    NSUInteger _sourceCount;
+    // Partial results that are not being combined, each of which covers a run of adjacent sources and can be found
+    // by either of its ends. `NSNotFound` where no such partial result starts or ends.
+    NSUInteger *_partialEnds;
+    NSUInteger *_partialStarts;
+    // Values of partial results by their starts, `NSNull` for partial results without a value.
+    NSMutableArray *_partialValues;
+    WEOperationResult *_failure;
+    WEOperationResult *_reducedResult;
+    BOOL _started;
+    NSUInteger _combineCount;
+}
+
+- (instancetype)initWithName:(NSString *)name combine:(id (^)(id, id))combine
+{
+    if (combine == nil) THROW_INVALID_PARAM(combine, nil);
+    
+    if (self = [super initWithName:name])
+    {
+        pthread_mutex_init(&_reductionMutex, NULL);
+        _combine = [combine copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_partialEnds);
+    free(_partialStarts);
+    pthread_mutex_destroy(&_reductionMutex);
+}
+
+- (BOOL)requiresMainThread
+{
+    return NO;
+}
+
+- (NSUInteger)combineCount
+{
+    NSUInteger count = 0;
+    ENTER_CRITICAL_SECTION(self, _reductionMutex)
+    count = _combineCount;
+    LEAVE_CRITICAL_SECTION(self, _reductionMutex)
+    return count;
+}
+
+- (void)start
+{
+    WEOperationResult *result = nil;
+    ENTER_CRITICAL_SECTION(self, _reductionMutex)
+    
+    if (_executor == nil)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"A reduce operation can only be started by a workflow." });
+    }
+    // Sources have all completed by now, but the last of their partial results may still be being combined.
+    _started = YES;
+    result = _reducedResult;
+    
+    LEAVE_CRITICAL_SECTION(self, _reductionMutex)
+    
+    if (result != nil) [self completeWithResult:result];
+}
+
+
+#pragma mark - Reduction
+
+- (void)_beginReductionWithSourceCount:(NSUInteger)sourceCount executor:(id<WEOperationExecutor>)executor
+{
+    if (executor == nil) THROW_INVALID_PARAM(executor, nil);
+    
+    NSUInteger *partialEnds = malloc(MAX(sourceCount, 1) * sizeof(NSUInteger));
+    NSUInteger *partialStarts = malloc(MAX(sourceCount, 1) * sizeof(NSUInteger));
+    if (partialEnds == NULL || partialStarts == NULL)
+    {
+        free(partialEnds);
+        free(partialStarts);
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate partial results" });
+    }
+    NSMutableArray *partialValues = [[NSMutableArray alloc] initWithCapacity:sourceCount];
+    for (NSUInteger i = 0; i < sourceCount; i++)
+    {
+        partialEnds[i] = NSNotFound;
+        partialStarts[i] = NSNotFound;
+        [partialValues addObject:[NSNull null]];
+    }
+    
+    ENTER_CRITICAL_SECTION(self, _reductionMutex)
+    
+    _generation++;
+    _sourceCount = sourceCount;
+    _executor = executor;
+    free(_partialEnds);
+    free(_partialStarts);
+    _partialEnds = partialEnds;
+    _partialStarts = partialStarts;
+    _partialValues = partialValues;
+    _failure = nil;
+    _reducedResult = (sourceCount == 0) ? [[WEOperationResult alloc] initWithResult:nil] : nil;
+    _started = NO;
+    _combineCount = 0;
+    
+    LEAVE_CRITICAL_SECTION(self, _reductionMutex)
+}
+
+- (void)_addResult:(WEOperationResult *)result ofSourceAtIndex:(NSUInteger)index
+{
+    NSUInteger generation = 0;
+    ENTER_CRITICAL_SECTION(self, _reductionMutex)
+    
+    if (index >= _sourceCount) THROW_INVALID_PARAM(index, nil);
+    if (result.failed && _failure == nil) _failure = result;
+    generation = _generation;
+    
+    LEAVE_CRITICAL_SECTION(self, _reductionMutex)
+    
+    [self _offerValue:(result.failed ? nil : result.result) from:index to:index generation:generation];
+}
+
+// Removes an available partial result, must be called within the critical section.
+- (id)_takePartialFrom:(NSUInteger)start to:(NSUInteger)end
+{
+    id value = _partialValues[start];
+    _partialValues[start] = [NSNull null];
+    _partialEnds[start] = NSNotFound;
+    _partialStarts[end] = NSNotFound;
+    return (value != [NSNull null]) ? value : nil;
+}
+
+// Combines a partial result with an available adjacent one, or makes it available if there is none. Partial results
+// without values are merged right away, values are combined on the executor, and the combined partial result is
+// offered again. The partial result that covers all sources is the result of the operation.
+- (void)_offerValue:(id)value from:(NSUInteger)start to:(NSUInteger)end generation:(NSUInteger)generation
+{
+    for (;;)
+    {
+        BOOL merged = NO;
+        id first = nil;
+        id second = nil;
+        NSUInteger combinedStart = start;
+        NSUInteger combinedEnd = end;
+        id<WEOperationExecutor> executor = nil;
+        WEOperationResult *reducedResult = nil;
+        ENTER_CRITICAL_SECTION(self, _reductionMutex)
+        
+        if (generation != _generation) return;
+        
+        if (start > 0 && _partialStarts[start - 1] != NSNotFound)
+        {
+            combinedStart = _partialStarts[start - 1];
+            first = [self _takePartialFrom:combinedStart to:start - 1];
+            second = value;
+            merged = YES;
+        }
+        else if (end + 1 < _sourceCount && _partialEnds[end + 1] != NSNotFound)
+        {
+            combinedEnd = _partialEnds[end + 1];
+            first = value;
+            second = [self _takePartialFrom:end + 1 to:combinedEnd];
+            merged = YES;
+        }
+        
+        if (merged)
+        {
+            // Once a source has failed, so has the operation, and there is nothing left to combine.
+            if (first != nil && second != nil && _failure == nil)
+            {
+                executor = _executor;
+                _combineCount++;
+            }
+        }
+        else if (start == 0 && end + 1 == _sourceCount)
+        {
+            _reducedResult = _failure ?: [[WEOperationResult alloc] initWithResult:value];
+            if (_started) reducedResult = _reducedResult;
+        }
+        else
+        {
+            _partialValues[start] = value ?: [NSNull null];
+            _partialEnds[start] = end;
+            _partialStarts[end] = start;
+        }
+        
+        LEAVE_CRITICAL_SECTION(self, _reductionMutex)
+        
+        if (!merged)
+        {
+            if (reducedResult != nil) [self completeWithResult:reducedResult];
+            return;
+        }
+        
+        if (executor == nil)
+        {
+            value = first ?: second;
+            start = combinedStart;
+            end = combinedEnd;
+            continue;
+        }
+        
+        id (^combine)(id, id) = _combine;
+        [executor executeBlock:^{
+            [self _offerValue:combine(first, second) from:combinedStart to:combinedEnd generation:generation];
+        }];
+        return;
+    }
+}
+
+@end
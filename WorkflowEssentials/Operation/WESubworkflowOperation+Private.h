@@ -0,0 +1,31 @@
+//
+//  WESubworkflowOperation+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WESubworkflowOperation.h>
+
+@interface WESubworkflowOperation ()
+
+/**
+ Returns operations and connections of the sub-workflow to a workflow that is starting.
+ No more operations or connections can be added afterwards.
+ */
+- (void)_sealWithOperations:(NSArray<WEOperation *> * _Nonnull * _Nonnull)operations
+               dependencies:(NSArray<WEDependencyDescription *> * _Nonnull * _Nonnull)dependencies
+                     segues:(NSArray<WESegueDescription *> * _Nonnull * _Nonnull)segues;
+
+/**
+ Returns operations and connections of the sub-workflow to a workflow that is being simulated.
+ The sub-workflow stays open for more operations and connections.
+ */
+- (void)_copyOperations:(NSArray<WEOperation *> * _Nonnull * _Nonnull)operations
+           dependencies:(NSArray<WEDependencyDescription *> * _Nonnull * _Nonnull)dependencies
+                 segues:(NSArray<WESegueDescription *> * _Nonnull * _Nonnull)segues;
+
+@end
@@ -0,0 +1,65 @@
+//
+//  WESubworkflowOperation.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEOperation.h>
+
+@class WEDependencyDescription;
+@class WESegueDescription;
+
+/**
+ An operation made of other operations and connections between them, a nested workflow.
+ Operations of a sub-workflow are scheduled by the workflow the sub-workflow is added to, under its limits
+ and on its executors, as if they were added to it directly:
+ - operations of the sub-workflow without connections inside of it start once the sub-workflow could start,
+   that is, its dependencies are fulfilled and one of its incoming segues is activated;
+ - the sub-workflow operation itself completes after every operation inside of it has completed or was skipped,
+   and only then its outgoing connections take effect;
+ - operations are skipped inside a sub-workflow the same way they are skipped in a workflow, and when the
+   sub-workflow is skipped, all of its operations are skipped.
+ Names inside a sub-workflow are only visible to connections of that sub-workflow. Operations of a sub-workflow
+ are given a view of the workflow context in the namespace of the sub-workflow (see `-[WEWorkflowContext contextForNamespace:]`),
+ and their results are visible from the workflow context as "<sub-workflow name>.<operation name>".
+ Sub-workflows can be nested. Operations and connections must be added before the workflow starts.
+ */
+@interface WESubworkflowOperation : WEOperation
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Initialize a sub-workflow
+ @param name name of the sub-workflow operation, which is also the namespace of its operations. Must not contain dots.
+ @return an instance of `WESubworkflowOperation`
+ */
+- (nonnull instancetype)initWithName:(nonnull NSString *)name NS_DESIGNATED_INITIALIZER;
+
+/**
+ Operations of the sub-workflow, in the order they were added.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<WEOperation *> *operations;
+
+/**
+ Adds an operation to the sub-workflow.
+ @param operation an operation to add, must not belong to another workflow or sub-workflow
+ */
+- (void)addOperation:(nonnull WEOperation *)operation;
+
+/**
+ Adds a dependency between two operations of the sub-workflow.
+ Operation names are resolved among operations of the sub-workflow.
+ */
+- (void)addDependency:(nonnull WEDependencyDescription *)dependency;
+
+/**
+ Adds a segue between two operations of the sub-workflow.
+ Operation names are resolved among operations of the sub-workflow.
+ */
+- (void)addSegue:(nonnull WESegueDescription *)segue;
+
+@end
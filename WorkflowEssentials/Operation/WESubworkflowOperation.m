@@ -0,0 +1,161 @@
+//
+//  WESubworkflowOperation.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WESubworkflowOperation.h>
+
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WESegueDescription.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WESubworkflowOperation+Private.h"
+
+@implementation WESubworkflowOperation
+{
+    pthread_mutex_t _mutex;
+    BOOL _sealed;
+    NSMutableArray<WEOperation *> *_operations;
+    NSMutableSet<WEOperation *> *_operationSet;
+    NSMutableArray<WEDependencyDescription *> *_dependencies;
+    NSMutableArray<WESegueDescription *> *_segues;
+}
+
+- (instancetype)initWithName:(NSString *)name
+{
+    if (name == nil || [name rangeOfString:@"."].location != NSNotFound) THROW_INVALID_PARAM(name, nil);
+    
+    if (self = [super initWithName:name])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        _operations = [NSMutableArray new];
+        _operationSet = [NSMutableSet new];
+        _dependencies = [NSMutableArray new];
+        _segues = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (NSArray<WEOperation *> *)operations
+{
+    NSArray<WEOperation *> *operations;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    operations = [_operations copy];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return operations;
+}
+
+
+#pragma mark - Operation Management
+
+- (void)addOperation:(WEOperation *)operation
+{
+    if (operation == nil || operation == self) THROW_INVALID_PARAM(operation, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_sealed)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot add an operation after the workflow had started." });
+    }
+    
+    if ([_operationSet containsObject:operation])
+    {
+        THROW_INVALID_PARAM(operation, @{ NSLocalizedDescriptionKey: @"Duplicate operation" });
+    }
+    
+    [_operations addObject:operation];
+    [_operationSet addObject:operation];
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)_verifyConnectionBeforeAdding:(WEConnectionDescription *)connection
+{
+    if (connection.sourceOperation == nil && connection.sourceOperationName == nil) THROW_INVALID_PARAM(connection, @{ NSLocalizedDescriptionKey: @"Source operation not specified" });
+    if (connection.targetOperation == nil && connection.targetOperationName == nil) THROW_INVALID_PARAM(connection, @{ NSLocalizedDescriptionKey: @"Target operation not specified" });
+    
+    if (_sealed)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot add a connection after the workflow had started." });
+    }
+    
+    // Verify that explicitly specified operations belong to the sub-workflow
+    WEOperation *sourceOperation = connection.sourceOperation;
+    if (sourceOperation != nil && ![_operationSet containsObject:sourceOperation])
+    {
+        THROW_INVALID_PARAM(connection, @{ NSLocalizedDescriptionKey: @"Source operation does not belong to the sub-workflow" });
+    }
+    WEOperation *targetOperation = connection.targetOperation;
+    if (targetOperation != nil && ![_operationSet containsObject:targetOperation])
+    {
+        THROW_INVALID_PARAM(connection, @{ NSLocalizedDescriptionKey: @"Target operation does not belong to the sub-workflow" });
+    }
+}
+
+- (void)addDependency:(WEDependencyDescription *)dependency
+{
+    if (dependency == nil) THROW_INVALID_PARAM(dependency, @{ NSLocalizedDescriptionKey: @"Dependency not specified" });
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    [self _verifyConnectionBeforeAdding:dependency];
+    [_dependencies addObject:[dependency copy]];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)addSegue:(WESegueDescription *)segue
+{
+    if (segue == nil) THROW_INVALID_PARAM(segue, @{ NSLocalizedDescriptionKey: @"Segue not specified" });
+    
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    [self _verifyConnectionBeforeAdding:segue];
+    [_segues addObject:[segue copy]];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)_sealWithOperations:(NSArray<WEOperation *> **)operations dependencies:(NSArray<WEDependencyDescription *> **)dependencies segues:(NSArray<WESegueDescription *> **)segues
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _sealed = YES;
+    *operations = [_operations copy];
+    *dependencies = [_dependencies copy];
+    *segues = [_segues copy];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (void)_copyOperations:(NSArray<WEOperation *> **)operations dependencies:(NSArray<WEDependencyDescription *> **)dependencies segues:(NSArray<WESegueDescription *> **)segues
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    *operations = [_operations copy];
+    *dependencies = [_dependencies copy];
+    *segues = [_segues copy];
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+
+#pragma mark - Overridables
+
+- (BOOL)requiresMainThread
+{
+    return NO;
+}
+
+- (void)start
+{
+    // Operations of the sub-workflow are performed by the workflow before the sub-workflow starts,
+    // so by now there is nothing left to do.
+    [self completeWithResult:[[WEOperationResult alloc] initWithResult:nil]];
+}
+
+@end
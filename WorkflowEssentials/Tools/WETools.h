@@ -48,5 +48,7 @@ do {                                                \
     pthread_mutex_unlock(&(object->mutex));         \
 }
 
+// Monotonic time in nanoseconds, suitable for measuring intervals.
+FOUNDATION_EXTERN uint64_t WEMonotonicTime(void);
 
 #endif
@@ -0,0 +1,25 @@
+//
+//  WETools.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+#include <mach/mach_time.h>
+#import "WETools.h"
+
+uint64_t WEMonotonicTime(void)
+{
+    // Read once for the whole process, times are taken on many threads at once.
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
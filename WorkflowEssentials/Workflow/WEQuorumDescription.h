@@ -0,0 +1,41 @@
+//
+//  WEQuorumDescription.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEDependencyDescription.h>
+
+/**
+ Quorum is a dependency that belongs to a group: all quorum connections to the same target form the target's quorum,
+ and the target can start as soon as `quorum` of their sources have completed successfully, without waiting
+ for the others, e.g. once 2 of 3 replicas have answered. Sources that fail do not count. If so many sources fail
+ or are skipped that the quorum can no longer be reached, the target is skipped. Other dependencies of the target
+ are still required, and a plain dependency between the same operations takes precedence over a quorum connection.
+ Results that reached the quorum are available to the target through `-[WEWorkflowContext quorumResultsOfOperation:]`,
+ in the order their sources completed.
+ All quorum connections to a target must have the same `quorum` and `cancelsRemainingSources`, and the quorum
+ cannot be larger than the number of sources.
+ Quorums are added to a workflow with `-[WEWorkflow addDependency:]`.
+ */
+@interface WEQuorumDescription : WEDependencyDescription
+
+/**
+ Number of sources that must complete successfully before the target can start. Default value is 1.
+ */
+@property (nonatomic, assign) NSUInteger quorum;
+
+/**
+ If YES, sources that have not completed when the quorum is reached are cancelled, and skipped along with
+ the operations that depend on them. Cannot be used with incremental execution. Default value is NO.
+ */
+@property (nonatomic, assign) BOOL cancelsRemainingSources;
+
++ (nonnull WEQuorumDescription *)quorumFromOperation:(nonnull WEOperation *)from toOperation:(nonnull WEOperation *)to quorum:(NSUInteger)quorum;
++ (nonnull WEQuorumDescription *)quorumFromOperationName:(nonnull NSString *)from toOperationName:(nonnull NSString *)to quorum:(NSUInteger)quorum;
+
+@end
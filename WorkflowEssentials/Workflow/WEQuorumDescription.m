@@ -0,0 +1,61 @@
+//
+//  WEQuorumDescription.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEQuorumDescription.h>
+
+#import "WETools.h"
+
+@implementation WEQuorumDescription
+
+@synthesize quorum = _quorum;
+@synthesize cancelsRemainingSources = _cancelsRemainingSources;
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _quorum = 1;
+    }
+    return self;
+}
+
+- (void)setQuorum:(NSUInteger)quorum
+{
+    if (quorum == 0) THROW_INVALID_PARAM(quorum, nil);
+    _quorum = quorum;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    WEQuorumDescription *copy = [super copyWithZone:zone];
+    copy->_quorum = _quorum;
+    copy->_cancelsRemainingSources = _cancelsRemainingSources;
+    return copy;
+}
+
++ (WEQuorumDescription *)quorumFromOperation:(WEOperation *)from toOperation:(WEOperation *)to quorum:(NSUInteger)quorum
+{
+    WEQuorumDescription *dependency = [[WEQuorumDescription alloc] init];
+    dependency.sourceOperation = from;
+    dependency.targetOperation = to;
+    dependency.quorum = quorum;
+    return dependency;
+}
+
++ (WEQuorumDescription *)quorumFromOperationName:(NSString *)from toOperationName:(NSString *)to quorum:(NSUInteger)quorum
+{
+    WEQuorumDescription *dependency = [[WEQuorumDescription alloc] init];
+    dependency.sourceOperationName = from;
+    dependency.targetOperationName = to;
+    dependency.quorum = quorum;
+    return dependency;
+}
+
+@end
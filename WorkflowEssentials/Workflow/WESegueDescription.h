@@ -25,6 +25,13 @@
  */
 @property (nonatomic, strong, nullable) NSPredicate *condition;
 
+/**
+ Marks the segue as likely to be activated. When the workflow has speculative prefetch enabled,
+ the target operation of a likely segue is asked to prefetch while the source operation is still running.
+ Default value is NO.
+ */
+@property (nonatomic, assign, getter=isLikely) BOOL likely;
+
 + (nonnull WESegueDescription *)segueFromOperationName:(nonnull NSString *)from toOperationName:(nonnull NSString *)to condition:(nullable NSPredicate *)condition;
 
 @end
@@ -13,11 +13,13 @@
 @implementation WESegueDescription
 
 @synthesize condition = _condition;
+@synthesize likely = _likely;
 
 - (id)copyWithZone:(NSZone *)zone
 {
     WESegueDescription *copy = [super copyWithZone:zone];
     copy->_condition = [_condition copyWithZone:zone];
+    copy->_likely = _likely;
     return copy;
 }
 
@@ -0,0 +1,38 @@
+//
+//  WESingleFlight.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEOperationResult;
+
+/**
+ Process-wide registry of in-flight operations with a deduplication key, see `-[WEOperation deduplicationKey]`.
+ The first operation of a key leads the flight and is performed, operations of the same key that join while it is
+ in flight get its result instead of being performed. Thread safe.
+ */
+@interface WESingleFlight : NSObject
+
++ (nonnull WESingleFlight *)sharedSingleFlight;
+
+/**
+ Leads or joins the flight of a key.
+ @param handler called with the result of the flight if the caller joins it. Called on the thread that finishes the flight.
+ @return YES if the caller leads the flight, in which case it must finish it with `finishKey:withResult:`,
+ and the handler is never called. NO if the caller joined a flight in progress.
+ */
+- (BOOL)joinKey:(nonnull NSString *)key handler:(nonnull void (^)(WEOperationResult * _Nullable result))handler;
+
+/**
+ Finishes the flight of a key, passing the result to all callers that joined it.
+ A caller that joins the key afterwards leads a new flight.
+ */
+- (void)finishKey:(nonnull NSString *)key withResult:(nullable WEOperationResult *)result;
+
+@end
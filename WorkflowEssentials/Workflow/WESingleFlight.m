@@ -0,0 +1,91 @@
+//
+//  WESingleFlight.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import "WESingleFlight.h"
+
+#import <pthread.h>
+#import "WETools.h"
+
+@implementation WESingleFlight
+{
+    pthread_mutex_t _mutex;
+    // Handlers of callers that joined, by key of a flight in progress.
+    NSMutableDictionary<NSString *, NSMutableArray<void (^)(WEOperationResult *)> *> *_flights;
+}
+
++ (WESingleFlight *)sharedSingleFlight
+{
+    static WESingleFlight *sharedSingleFlight;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedSingleFlight = [WESingleFlight new];
+    });
+    return sharedSingleFlight;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        _flights = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (BOOL)joinKey:(NSString *)key handler:(void (^)(WEOperationResult *))handler
+{
+    if (key == nil) THROW_INVALID_PARAM(key, nil);
+    if (handler == nil) THROW_INVALID_PARAM(handler, nil);
+    
+    BOOL leads;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    NSMutableArray<void (^)(WEOperationResult *)> *handlers = _flights[key];
+    leads = handlers == nil;
+    if (leads)
+    {
+        _flights[key] = [NSMutableArray new];
+    }
+    else
+    {
+        [handlers addObject:[handler copy]];
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return leads;
+}
+
+- (void)finishKey:(NSString *)key withResult:(WEOperationResult *)result
+{
+    if (key == nil) THROW_INVALID_PARAM(key, nil);
+    
+    NSArray<void (^)(WEOperationResult *)> *handlers;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    handlers = _flights[key];
+    WEAssert(handlers != nil);
+    [_flights removeObjectForKey:key];
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    
+    // Handlers are called outside of the critical section, they may join the same key again.
+    for (void (^handler)(WEOperationResult *) in handlers)
+    {
+        handler(result);
+    }
+}
+
+@end
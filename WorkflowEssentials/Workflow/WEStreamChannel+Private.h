@@ -0,0 +1,29 @@
+//
+//  WEStreamChannel+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEStreamChannel.h>
+
+@interface WEStreamChannel ()
+
+/**
+ Initialize a channel
+ @param firstChunkHandler called once, on the sending thread, after the first chunk is sent
+ */
+- (nonnull instancetype)_initWithSourceOperation:(nonnull WEOperation *)sourceOperation
+                                 targetOperation:(nonnull WEOperation *)targetOperation
+                                        capacity:(NSUInteger)capacity
+                               firstChunkHandler:(nonnull dispatch_block_t)firstChunkHandler;
+
+/**
+ Stops the channel for both sides: pending and future sends fail, and receives return `nil`.
+ */
+- (void)_cancel;
+
+@end
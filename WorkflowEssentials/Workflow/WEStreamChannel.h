@@ -0,0 +1,62 @@
+//
+//  WEStreamChannel.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEOperation;
+
+/**
+ Bounded channel of a stream between two operations, see `WEStreamDescription`.
+ The source sends chunks and the target receives them in the same order. Both sending and receiving block
+ the calling thread: sending while the channel is full, receiving while it is empty and not closed, so they must not
+ be called on the main thread. Thread safe.
+ */
+@interface WEStreamChannel<__covariant WEChunkType> : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly, weak, nullable) WEOperation *sourceOperation;
+@property (nonatomic, readonly, weak, nullable) WEOperation *targetOperation;
+
+/**
+ Maximum number of chunks the channel holds.
+ */
+@property (nonatomic, readonly) NSUInteger capacity;
+
+/**
+ Largest number of chunks the channel has held at the same time.
+ */
+@property (nonatomic, readonly) NSUInteger peakCount;
+
+/**
+ Returns YES once the source has finished sending.
+ */
+@property (nonatomic, readonly, getter=isClosed) BOOL closed;
+
+/**
+ Sends a chunk to the target, waiting while the channel is full.
+ @param chunk a chunk to send
+ @return YES if the chunk was sent, NO if the target will not receive any more chunks: it has completed,
+ or the workflow has failed. The source should stop producing then.
+ */
+- (BOOL)sendChunk:(nonnull WEChunkType)chunk;
+
+/**
+ Tells the target that there will be no more chunks. The channel is closed automatically when the source completes.
+ */
+- (void)close;
+
+/**
+ Receives the next chunk, waiting while the channel is empty and not closed.
+ @return the next chunk, or `nil` when the channel is closed and all chunks were received, or the workflow has failed.
+ */
+- (nullable WEChunkType)receiveChunk;
+
+@end
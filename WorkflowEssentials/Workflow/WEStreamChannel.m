@@ -0,0 +1,154 @@
+//
+//  WEStreamChannel.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEStreamChannel.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WEStreamChannel+Private.h"
+
+@implementation WEStreamChannel
+{
+    __weak WEOperation *_sourceOperation;
+    __weak WEOperation *_targetOperation;
+    NSUInteger _capacity;
+    
+    pthread_mutex_t _mutex;
+    // Senders wait for space, receivers wait for chunks.
+    pthread_cond_t _spaceCondition;
+    pthread_cond_t _chunkCondition;
+    NSMutableArray *_chunks;
+    NSUInteger _peakCount;
+    BOOL _closed;
+    BOOL _cancelled;
+    dispatch_block_t _firstChunkHandler;
+}
+
+@synthesize sourceOperation = _sourceOperation;
+@synthesize targetOperation = _targetOperation;
+@synthesize capacity = _capacity;
+
+- (instancetype)_initWithSourceOperation:(WEOperation *)sourceOperation targetOperation:(WEOperation *)targetOperation capacity:(NSUInteger)capacity firstChunkHandler:(dispatch_block_t)firstChunkHandler
+{
+    WEAssert(capacity > 0);
+    
+    if (self = [super init])
+    {
+        _sourceOperation = sourceOperation;
+        _targetOperation = targetOperation;
+        _capacity = capacity;
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_spaceCondition, NULL);
+        pthread_cond_init(&_chunkCondition, NULL);
+        _chunks = [[NSMutableArray alloc] initWithCapacity:capacity];
+        _firstChunkHandler = [firstChunkHandler copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_cond_destroy(&_chunkCondition);
+    pthread_cond_destroy(&_spaceCondition);
+    pthread_mutex_destroy(&_mutex);
+}
+
+- (NSUInteger)peakCount
+{
+    NSUInteger peakCount;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    peakCount = _peakCount;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return peakCount;
+}
+
+- (BOOL)isClosed
+{
+    BOOL closed;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    closed = _closed;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return closed;
+}
+
+- (BOOL)sendChunk:(id)chunk
+{
+    if (chunk == nil) THROW_INVALID_PARAM(chunk, nil);
+    
+    BOOL sent = NO;
+    dispatch_block_t firstChunkHandler = nil;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    if (_closed) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot send a chunk to a closed channel" });
+    
+    while (_chunks.count >= _capacity && !_cancelled)
+    {
+        pthread_cond_wait(&_spaceCondition, &_mutex);
+    }
+    
+    if (!_cancelled)
+    {
+        [_chunks addObject:chunk];
+        _peakCount = MAX(_peakCount, _chunks.count);
+        pthread_cond_signal(&_chunkCondition);
+        sent = YES;
+        
+        firstChunkHandler = _firstChunkHandler;
+        _firstChunkHandler = nil;
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    
+    if (firstChunkHandler != nil) firstChunkHandler();
+    return sent;
+}
+
+- (void)close
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _closed = YES;
+    _firstChunkHandler = nil;
+    pthread_cond_broadcast(&_chunkCondition);
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+- (id)receiveChunk
+{
+    id chunk = nil;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    
+    while (_chunks.count == 0 && !_closed && !_cancelled)
+    {
+        pthread_cond_wait(&_chunkCondition, &_mutex);
+    }
+    
+    if (!_cancelled && _chunks.count > 0)
+    {
+        chunk = _chunks.firstObject;
+        [_chunks removeObjectAtIndex:0];
+        pthread_cond_signal(&_spaceCondition);
+    }
+    
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return chunk;
+}
+
+- (void)_cancel
+{
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    _cancelled = YES;
+    _firstChunkHandler = nil;
+    [_chunks removeAllObjects];
+    pthread_cond_broadcast(&_spaceCondition);
+    pthread_cond_broadcast(&_chunkCondition);
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+}
+
+@end
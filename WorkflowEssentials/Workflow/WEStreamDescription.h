@@ -0,0 +1,35 @@
+//
+//  WEStreamDescription.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEDependencyDescription.h>
+
+/**
+ Stream is a dependency through which the source operation passes its result to the target in chunks, while it runs.
+ Chunks go through a bounded `WEStreamChannel`, which operations get from the workflow context
+ (see `-[WEWorkflowContext outputStreamsOfOperation:]` and `-[WEWorkflowContext inputStreamsOfOperation:]`).
+ The dependency is fulfilled as soon as the source sends the first chunk, or when the source completes, whichever
+ comes first, so the target can start consuming while the source is still producing. When the channel is full,
+ the source is paused until the target catches up, so no more than `capacity` chunks are held at any time.
+ The channel is closed when the source completes. The source and the target run at the same time: a target whose source
+ is still sending starts right away, even beyond the concurrency limits of the workflow and of its executor, and is not
+ held back by its rate limiter.
+ Streams are added to a workflow with `-[WEWorkflow addDependency:]`.
+ */
+@interface WEStreamDescription : WEDependencyDescription
+
+/**
+ Maximum number of chunks the channel holds. Default value is 1.
+ */
+@property (nonatomic, assign) NSUInteger capacity;
+
++ (nonnull WEStreamDescription *)streamFromOperation:(nonnull WEOperation *)from toOperation:(nonnull WEOperation *)to capacity:(NSUInteger)capacity;
++ (nonnull WEStreamDescription *)streamFromOperationName:(nonnull NSString *)from toOperationName:(nonnull NSString *)to capacity:(NSUInteger)capacity;
+
+@end
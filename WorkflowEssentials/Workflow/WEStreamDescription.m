@@ -0,0 +1,59 @@
+//
+//  WEStreamDescription.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEStreamDescription.h>
+
+#import "WETools.h"
+
+@implementation WEStreamDescription
+
+@synthesize capacity = _capacity;
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _capacity = 1;
+    }
+    return self;
+}
+
+- (void)setCapacity:(NSUInteger)capacity
+{
+    if (capacity == 0) THROW_INVALID_PARAM(capacity, nil);
+    _capacity = capacity;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    WEStreamDescription *copy = [super copyWithZone:zone];
+    copy->_capacity = _capacity;
+    return copy;
+}
+
++ (WEStreamDescription *)streamFromOperation:(WEOperation *)from toOperation:(WEOperation *)to capacity:(NSUInteger)capacity
+{
+    WEStreamDescription *stream = [[WEStreamDescription alloc] init];
+    stream.sourceOperation = from;
+    stream.targetOperation = to;
+    stream.capacity = capacity;
+    return stream;
+}
+
++ (WEStreamDescription *)streamFromOperationName:(NSString *)from toOperationName:(NSString *)to capacity:(NSUInteger)capacity
+{
+    WEStreamDescription *stream = [[WEStreamDescription alloc] init];
+    stream.sourceOperationName = from;
+    stream.targetOperationName = to;
+    stream.capacity = capacity;
+    return stream;
+}
+
+@end
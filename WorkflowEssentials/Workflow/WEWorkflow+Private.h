@@ -0,0 +1,29 @@
+//
+//  WEWorkflow+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflow.h>
+
+#import "WEWorkflowGraph.h"
+
+@interface WEWorkflow ()
+
+/**
+ Builds the graph a run of the workflow would have, without starting it. Throws if the workflow had started.
+ Nodes that are ready from the start are ready at time 0, stream dependencies have no channels.
+ Operations added with factories are all created, as if every one of them had become ready.
+ @param operations returns operations the graph refers to in node order, including operations of sub-workflows.
+ Must be kept alive as long as the graph.
+ @param error returns the error the run would fail with if the workflow is invalid
+ @return the graph, owned by the caller and freed with `WEWorkflowGraphDestroy`, or `NULL` if the workflow is invalid
+ or has no operations
+ */
+- (nullable WEWorkflowGraph *)_buildGraphForSimulationWithOperations:(NSArray<WEOperation *> * _Nullable * _Nonnull)operations error:(NSError * _Nullable * _Nullable)error;
+
+@end
@@ -9,11 +9,19 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <WorkflowEssentials/WEOperationRegistry.h>
 
 @class WEWorkflowContext;
 @class WEOperation;
+@class WEOperationResult;
 @class WEDependencyDescription;
 @class WESegueDescription;
+@class WEExecutor;
+@class WEWorkStealingExecutor;
+@protocol WEOperationExecutor;
+@class WEConcurrencyController;
+@class WEWorkflowDefinition;
+@class WEWorkflowReport;
 
 @class WEWorkflow;
 
@@ -23,6 +31,13 @@ FOUNDATION_EXPORT NSInteger const WEWorkflowDependencyCycle;
 FOUNDATION_EXPORT NSInteger const WEWorkflowDeadlocked;
 FOUNDATION_EXPORT NSInteger const WEWorkflowDuplicateNames;
 FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidSegue;
+FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidDefinition;
+
+/**
+ Block that is given operations of a workflow as they complete, see `-[WEWorkflow operationCompletionObserver]`.
+ Every operation is at the same position as its result.
+ */
+typedef void (^WEOperationCompletionObserver)(WEWorkflow * _Nonnull workflow, NSArray<WEOperation *> * _Nonnull operations, NSArray<WEOperationResult *> * _Nonnull results);
 
 @protocol WEWorkflowDelegate <NSObject>
 
@@ -36,6 +51,14 @@ FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidSegue;
  */
 - (void)workflow:(nonnull WEWorkflow *)workflow didFailWithError:(nonnull NSError *)error;
 
+@optional
+
+/**
+ Sent when operations are skipped because no path that could lead to their execution remains,
+ e.g. conditions of all their incoming segues evaluated to NO. Skipped operations are never prepared or started.
+ */
+- (void)workflow:(nonnull WEWorkflow *)workflow didSkipOperations:(nonnull NSArray<WEOperation *> *)operations;
+
 @end
 
 @interface WEWorkflow : NSObject
@@ -60,7 +83,54 @@ FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidSegue;
 - (nonnull instancetype)initWithContextClass:(nullable Class)contextClass
                  maximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
                                     delegate:(nullable id<WEWorkflowDelegate>)delegate
-                               delegateQueue:(nullable dispatch_queue_t)delegateQueue NS_DESIGNATED_INITIALIZER;
+                               delegateQueue:(nullable dispatch_queue_t)delegateQueue;
+
+/**
+ Initialize a new workflow on a shared executor
+ @param contextClass a context class, which must be a subclass of `WEWorkflowContext` or `nil`
+ @param maximumConcurrentOperations maximum number of operations that may be executed concurrently
+ @param delegate workflow delegate that will be notified of certain workflow events
+ @param delegateQueue a dispatch queue to be used for sending delegate events. Must be provided when a delegate is specified.
+ @param executor optional shared executor. When provided, workflow uses executor's scheduler queues and
+ every operation has to be admitted by the executor in addition to the workflow's own concurrency limit.
+ @return an instance of `WEWorkflow`
+ */
+- (nonnull instancetype)initWithContextClass:(nullable Class)contextClass
+                 maximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
+                                    delegate:(nullable id<WEWorkflowDelegate>)delegate
+                               delegateQueue:(nullable dispatch_queue_t)delegateQueue
+                                    executor:(nullable WEExecutor *)executor NS_DESIGNATED_INITIALIZER;
+
+/**
+ Shared executor the workflow was created on, if any.
+ */
+@property (nonatomic, readonly, strong, nullable) WEExecutor *executor;
+
+/**
+ Weight of the workflow in the shared executor's fair queuing. A workflow with weight 2 gets twice as many
+ operations admitted as a workflow with weight 1 when both have operations waiting. Must be positive.
+ Default value is 1. Has no effect if the workflow was not created on an executor.
+ */
+@property (nonatomic, assign) double executorWeight;
+
+/**
+ Optional controller that adapts the number of operations the workflow runs at once to their latency and error rate,
+ between the controller's bounds and `maximumConcurrentOperations`. It is fed every operation the workflow performs,
+ operations that reuse a kept result or join an identical operation in progress are not counted.
+ A controller may be shared by several workflows, each of them then runs up to its limit.
+ Must be set before the workflow starts.
+ */
+@property (nonatomic, strong, nullable) WEConcurrencyController *concurrencyController;
+
+/**
+ Optional observer of individual operations, which is given every operation that completes along with its result
+ while the rest of the workflow keeps running, e.g. to show early results. Operations that reuse a kept result or join
+ an identical operation in progress are included. Completions are coalesced, and delivered in batches in the order
+ operations completed, on the delegate queue, or on the main queue if the workflow has no delegate. All operations
+ of a successful run are delivered before the delegate is told that the workflow completed.
+ Must be set before the workflow starts.
+ */
+@property (nonatomic, copy, nullable) WEOperationCompletionObserver operationCompletionObserver;
 
 /**
  returns YES if the workflow is active, and NO otherwise
@@ -88,21 +158,136 @@ FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidSegue;
 @property (nonatomic, readonly, strong, nonnull) WEWorkflowContext *context;
 
 /**
- An array of operations added to the workflow
+ An array of operations added to the workflow. Operations added with factories are included once they have been created.
  */
 @property (nonatomic, readonly, nonnull) NSArray<WEOperation *> *operations;
 
 /**
- Total number of operations that were added to the workflow.
+ Total number of operations that were added to the workflow, not counting operations added with factories
+ that have not been created yet.
  */
 @property (nonatomic, readonly) NSUInteger operationCount;
 
+/**
+ Operations that were skipped during the run, in the order they were skipped.
+ An operation is skipped when all of its incoming segues have been resolved without any of them being activated,
+ or when an operation it depends on was skipped. Operations added with factories that were skipped before
+ they were ever created are not included.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<WEOperation *> *skippedOperations;
+
+/**
+ Executor that prepares and starts operations that do not require main thread and have no executor of their own
+ (see `-[WEOperation operationExecutor]`), e.g. a `WEDispatchQueueExecutor` with a custom queue or a thread pool.
+ Operations that require main thread are always performed on the main thread.
+ Default value is `nil`, meaning the default priority global queue. Must be set before the workflow starts.
+ */
+@property (nonatomic, strong, nullable) id<WEOperationExecutor> operationExecutor;
+
+/**
+ Work-stealing thread pool as the `operationExecutor`, `nil` if the operation executor is not one.
+ An operation made ready by a completion is pushed to the deque of the worker that performed its
+ predecessor, so that the data it works on stays hot in that worker's cache.
+ Must be set before the workflow starts.
+ */
+@property (nonatomic, strong, nullable) WEWorkStealingExecutor *workStealingExecutor;
+
+/**
+ Enables speculative prefetch. When a source of a segue marked as likely starts, the target of the segue
+ is asked to prefetch (see `-[WEOperation prefetchWithContext:]`) while the source is still running.
+ If the target does not run after all, it is asked to discard what it has prefetched.
+ Default value is NO. Must be set before the workflow starts.
+ */
+@property (nonatomic, assign, getter=isSpeculativePrefetchEnabled) BOOL speculativePrefetchEnabled;
+
+/**
+ Number of speculative prefetches the workflow has requested.
+ */
+@property (nonatomic, readonly) NSUInteger prefetchCount;
+
+/**
+ Number of speculative prefetches that were discarded because their operations did not run.
+ */
+@property (nonatomic, readonly) NSUInteger discardedPrefetchCount;
+
+/**
+ Enables incremental execution, which allows a completed workflow to run again with `restart`.
+ Every run keeps results of the operations that completed, along with values of their `inputContextKeys`.
+ The next run reuses a kept result instead of running the operation, unless one of those values has changed,
+ the operation was invalidated with `invalidateOperation:`, or an operation that precedes it ran again and produced
+ a different result. Operations that are sources or targets of streams always run.
+ Default value is NO. Must be set before the workflow starts.
+ */
+@property (nonatomic, assign, getter=isIncrementalExecutionEnabled) BOOL incrementalExecutionEnabled;
+
+/**
+ Number of operations whose kept results were reused during the last run instead of running them.
+ */
+@property (nonatomic, readonly) NSUInteger reusedOperationCount;
+
+/**
+ Number of operations that completed with a result of an identical operation in progress during the last run,
+ instead of being started. See `-[WEOperation deduplicationKey]`.
+ */
+@property (nonatomic, readonly) NSUInteger deduplicatedOperationCount;
+
+/**
+ Timing report of the run: when each operation became ready, started and finished, the critical path of the run
+ and slack of every operation. Available once the workflow completes successfully, before the delegate is notified.
+ `nil` until then, if the workflow failed or if it has no operations.
+ */
+@property (nonatomic, readonly, nullable) WEWorkflowReport *report;
+
+/**
+ Maximum time (in seconds) the workflow may spend on the main thread in a single main queue turn.
+ Operations that require main thread are prepared and started in batches, one main queue block per batch.
+ When the budget is exhausted, the rest of the batch is carried over to the next main queue turn.
+ Default value is 8 milliseconds.
+ */
+@property (nonatomic, assign) NSTimeInterval mainThreadTimeBudget;
+
+/**
+ Total time (in seconds) the workflow has spent on the main thread preparing and starting operations.
+ */
+@property (nonatomic, readonly) NSTimeInterval mainThreadTime;
+
+/**
+ Number of main queue turns the workflow has used to prepare and start operations.
+ */
+@property (nonatomic, readonly) NSUInteger mainThreadBatchCount;
+
+/**
+ Number of batches in which the workflow has processed completions of operations. Completions that arrive while
+ the workflow is busy are processed together, and operations they make ready are started once per batch.
+ */
+@property (nonatomic, readonly) NSUInteger completionBatchCount;
+
+/**
+ Number of operations that were started on the thread that completed their predecessor, without going through the scheduler.
+ An operation is fused with its predecessor when it is the only dependent of an operation without segues, depends on
+ nothing else, and both run on the same executor off the main thread. Operations with rate limiters or deduplication keys,
+ and operations of incremental runs, are never fused.
+ */
+@property (nonatomic, readonly) NSUInteger fusedOperationCount;
+
 /**
  Adds a single operation
  @param operation an operation to add
  */
 - (void)addOperation:(nonnull WEOperation *)operation;
 
+/**
+ Adds an operation that is created only when it becomes ready to start, so that operations of branches
+ that are never taken are never created. Connections must refer to the operation by name.
+ @param name name of the operation, unique in the workflow
+ @param factory creates the operation with the given name. Called on the workflow's internal queue at most once
+ per workflow, later runs of an incremental workflow reuse the operation. The operation must not be a sub-workflow
+ and cannot be the source or target of a stream. If the factory returns an operation with a different name,
+ the workflow fails with `WEWorkflowInvalidDefinition` error.
+ @discussion factories should be cheap, expensive setup belongs to `prepareForExecutionWithContext:`.
+ */
+- (void)addOperationWithName:(nonnull NSString *)name factory:(nonnull WEOperationFactory)factory;
+
 /**
  Add a dependency. Specifies that one operation depends on another.
  @param dependency describes the dependency to be added.
@@ -115,15 +300,51 @@ FOUNDATION_EXPORT NSInteger const WEWorkflowInvalidSegue;
  Add a segue. Specifies that one operation is conditionally set to start when another one completes.
  Segue may specify a condition (evaluated on its source operation result), if it does, the condition
  must evaluate to YES for the target operation to be set as ready to start.
+ Once all incoming segues of an operation are resolved and none of them was activated, the operation is skipped,
+ and so are operations that depend on it.
  @param segue describes the segue to be added.
  @discussion segue description will go through a set of quick sanity checks before being added.
  Segue will be copied by the workflow.
  */
 - (void)addSegue:(nonnull WESegueDescription *)segue;
 
+/**
+ Adds operations, dependencies and segues of a workflow definition, creating operations with factories
+ registered in the shared `WEOperationRegistry`.
+ @param definition a workflow definition
+ @param error set to an error in `WEWorkflowErrorDomain` with `WEWorkflowInvalidDefinition` code if an operation type is not registered.
+ @return YES if the definition was added, NO otherwise, in which case nothing was added.
+ @discussion the definition has been validated when it was created, so unlike adding connections one by one,
+ the whole definition is added in a single step.
+ */
+- (BOOL)addDefinition:(nonnull WEWorkflowDefinition *)definition error:(NSError * _Nullable * _Nullable)error;
+
+/**
+ Adds operations, dependencies and segues of a workflow definition.
+ @param definition a workflow definition
+ @param registry a registry with factories for operation types used in the definition
+ @param error set to an error in `WEWorkflowErrorDomain` with `WEWorkflowInvalidDefinition` code if an operation type is not registered.
+ @return YES if the definition was added, NO otherwise, in which case nothing was added.
+ */
+- (BOOL)addDefinition:(nonnull WEWorkflowDefinition *)definition registry:(nonnull WEOperationRegistry *)registry error:(NSError * _Nullable * _Nullable)error;
+
 /**
  Starts executing the workflow
  */
 - (void)start;
 
+/**
+ Starts a completed workflow with incremental execution enabled once again. Only operations affected by changes
+ since the previous run are performed, see `incrementalExecutionEnabled`.
+ Throws if incremental execution is not enabled or the workflow has not completed.
+ */
+- (void)restart;
+
+/**
+ Marks an operation as changed, so that the next run of an incremental workflow performs it, and operations that
+ follow it if its result changes. Invalidating a sub-workflow performs all of its operations.
+ @param operation an operation of the workflow
+ */
+- (void)invalidateOperation:(nonnull WEOperation *)operation;
+
 @end
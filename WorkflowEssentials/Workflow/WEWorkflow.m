@@ -10,14 +10,41 @@
 
 #import <WorkflowEssentials/WEWorkflow.h>
 
+#import <WorkflowEssentials/WEConcurrencyController.h>
 #import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WEDispatchQueueExecutor.h>
+#import <WorkflowEssentials/WEExecutor.h>
+#import <WorkflowEssentials/WEMainThreadExecutor.h>
 #import <WorkflowEssentials/WEOperation.h>
+#import <WorkflowEssentials/WEOperationRegistry.h>
+#import <WorkflowEssentials/WEQuorumDescription.h>
+#import <WorkflowEssentials/WERateLimiter.h>
+#import <WorkflowEssentials/WEReduceOperation.h>
 #import <WorkflowEssentials/WESegueDescription.h>
+#import <WorkflowEssentials/WEStreamChannel.h>
+#import <WorkflowEssentials/WEStreamDescription.h>
+#import <WorkflowEssentials/WESubworkflowOperation.h>
 #import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEWorkflowDefinition.h>
+#import <WorkflowEssentials/WEWorkflowReport.h>
+#import <WorkflowEssentials/WEWorkStealingExecutor.h>
 
 #import <pthread.h>
+#import <stdatomic.h>
 #import "WETools.h"
+#import "WEExecutor+Private.h"
+#import "WEOperation+Private.h"
+#import "WEOperationResult+Private.h"
+#import "WERateLimiter+Private.h"
+#import "WEReduceOperation+Private.h"
+#import "WESingleFlight.h"
+#import "WEStreamChannel+Private.h"
+#import "WESubworkflowOperation+Private.h"
+#import "WEWorkflow+Private.h"
+#import "WEWorkflowGraph.h"
 #import "WEWorkflowContext+Private.h"
+#import "WEWorkflowDefinition+Private.h"
+#import "WEWorkflowReport+Private.h"
 
 typedef enum
 {
@@ -32,78 +59,128 @@ NSInteger const WEWorkflowDependencyCycle = -10002;
 NSInteger const WEWorkflowDeadlocked = -10003;
 NSInteger const WEWorkflowDuplicateNames = -10004;
 NSInteger const WEWorkflowInvalidSegue = -10005;
+NSInteger const WEWorkflowInvalidDefinition = -10006;
 
-@class _WEOperationState;
+// Incremental execution state of a node in the current run.
+typedef enum : uint8_t
+{
+    _WEIncrementalValid,
+    // An operation preceding the node ran and produced a different result, or the node was invalidated.
+    _WEIncrementalInvalid,
+    // The node completed with its kept result.
+    _WEIncrementalReused
+} _WEIncrementalState;
 
-@interface _WEOutgoingSegue : NSObject
-- (instancetype)init NS_UNAVAILABLE;
-- (instancetype)initWithSegue:(nonnull WESegueDescription *)segue targetState:(nonnull _WEOperationState *)targetState;
+// Result of an operation kept for the next run of an incremental workflow, and the context values it was computed from.
+@interface _WEIncrementalRecord : NSObject
 @end
 
-@implementation _WEOutgoingSegue
+@implementation _WEIncrementalRecord
 {
 @package
-    __unsafe_unretained _WEOperationState *_targetState;
-    WESegueDescription *_segue;
+    WEOperationResult *_result;
+    NSDictionary *_inputs;
 }
+@end
+
+// Operation added by name with a factory, see `addOperationWithName:factory:`. Stands in for the operation until its node
+// becomes ready, and keeps it once it is created, so that later runs of the workflow reuse it.
+@interface _WELazyOperation : NSObject
+@end
 
-- (instancetype)initWithSegue:(WESegueDescription *)segue targetState:(_WEOperationState *)targetState
+@implementation _WELazyOperation
 {
-    WEAssert(segue != nil);
-    WEAssert(targetState != nil);
-    
-    if (self = [super init])
-    {
-        _targetState = targetState;
-        _segue = segue;
-    }
-    return self;
+@package
+    NSString *_name;
+    WEOperationFactory _factory;
+    WEOperation *_operation;
 }
 
-@end
-
-@interface _WEOperationState : NSObject
-- (instancetype)init NS_UNAVAILABLE;
-- (instancetype)initWithOperation:(nonnull WEOperation *)operation NS_DESIGNATED_INITIALIZER;
+- (NSString *)name
+{
+    return _name;
+}
 
-@property (nonatomic, readonly, assign, nonnull) WEOperation *operation;
+@end
 
+// Operations of a fused linear chain, starting with the one that is dispatched, see `_fuseLinearChains`. Captured on
+// the internal queue, so that the chain can proceed on executor threads without the graph, which is gone if the workflow fails.
+@interface _WEFusedChain : NSObject
 @end
 
-@implementation _WEOperationState
+@implementation _WEFusedChain
 {
 @package
-    __unsafe_unretained WEOperation *_operation;
-    
-    // Dependencies are unordered, all dependencies need to be fulfilled before their target can execute.
-    NSHashTable<_WEOperationState *> *_dependsOn;
-    NSHashTable<_WEOperationState *> *_dependents;
-    NSUInteger _completedDependsOnOperations;
-    
-    // Segues are ordered.
-    // Outgoing segues fire in the order they were added, except for segues targeting operations that have
-    // unfulfilled dependencies.
-    // Incoming segues fire immediately if the operation does not have unfulfilled dependencies, otherwise
-    // they fire in the order they were activated (in the order their sources completed).
-    NSMutableArray<_WEOutgoingSegue *> *_outgoingSegues;
-    BOOL _hasIncomingSegues;
-    NSMutableArray<WESegueDescription *> *_activatedIncomingSegues;
+    NSUInteger _count;
+    WEGraphIndex *_nodes;
+    NSArray<WEOperation *> *_operations;
+    NSArray<WEWorkflowContext *> *_contexts;
+}
+
+- (void)dealloc
+{
+    free(_nodes);
 }
 
-@synthesize operation = _operation;
+@end
+
+static inline BOOL _WEIsLazyOperation(id operation)
+{
+    return [operation isKindOfClass:[_WELazyOperation class]];
+}
 
-- (instancetype)initWithOperation:(WEOperation *)operation
+static inline NSDictionary *_WEInputsOfOperation(WEWorkflowContext *context, WEOperation *operation)
 {
-    WEAssert(operation != nil);
+    NSSet<id<NSCopying>> *keys = operation.inputContextKeys;
+    if (keys.count == 0) return @{};
     
-    if (self = [super init])
+    NSMutableDictionary *inputs = [[NSMutableDictionary alloc] initWithCapacity:keys.count];
+    for (id<NSCopying> key in keys)
     {
-        _operation = operation;
+        inputs[key] = [context contextValueForKey:key] ?: [NSNull null];
     }
-    return self;
+    return inputs;
 }
 
-@end
+static inline BOOL _WEObjectsAreEqual(id first, id second)
+{
+    return first == second || [first isEqual:second];
+}
+
+// Lazy results are never read here, as that would produce them on the internal queue, so they always count as changed.
+static inline BOOL _WEResultsAreEqual(WEOperationResult *first, WEOperationResult *second)
+{
+    return first == second || (first != nil && second != nil
+                                && !first._isLazy && !second._isLazy
+                                && first.failed == second.failed
+                                && _WEObjectsAreEqual(first.result, second.result)
+                                && _WEObjectsAreEqual(first.error, second.error));
+}
+
+// Completion of a node that is waiting to be processed on the internal queue. Completions are pushed by any thread
+// onto an intrusive lock-free stack, and the internal queue takes all of them at once.
+typedef struct _WECompletion
+{
+    struct _WECompletion *next;
+    WEGraphIndex node;
+    NSUInteger workerIndex;
+    uint64_t startTime;
+    // Time the operation finished if it was performed, zero if it completed with a kept or shared result.
+    uint64_t finishTime;
+    // Retained result, released when the completion is processed.
+    void *result;
+    // The node's fused successor has already been started on the thread that completed the node.
+    BOOL successorStarted;
+} _WECompletion;
+
+// Progress of a fused operation, tells whether its successor continues in a loop on the same thread, or is handed over
+// to the executor because the operation completed after its start had returned.
+typedef enum : int
+{
+    _WEFusedStepRunning,
+    _WEFusedStepReturned,
+    _WEFusedStepCompleted
+} _WEFusedStepPhase;
 
 @implementation WEWorkflow
 {
@@ -113,21 +190,97 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
     __weak id<WEWorkflowDelegate> _delegate;
     dispatch_queue_t _delegateQueue;
     
+    // Coalesces main thread work of all operations that require main thread.
+    WEMainThreadExecutor *_mainThreadExecutor;
+    
+    // Optional shared executor, admits operations across workflows.
+    WEExecutor *_executor;
+    double _executorWeight;
+    WEConcurrencyController *_concurrencyController;
+    WEOperationCompletionObserver _operationCompletionObserver;
+    // Completed operations and their results waiting for the observer, `nil` while no delivery is scheduled.
+    NSMutableArray<WEOperation *> *_undeliveredOperations;
+    NSMutableArray<WEOperationResult *> *_undeliveredResults;
+    
     pthread_mutex_t _operationMutex;
     WEWorkflowState _state;
+    // Set while a simulation builds its graph into the internal state below, which a run cannot use meanwhile.
+    BOOL _simulating;
     NSError *_error;
     NSMutableArray<WEOperation *> *_operations;
+    // Same operations as a set, for membership checks that stay cheap in large workflows.
+    NSMutableSet<WEOperation *> *_operationSet;
+    NSMutableArray<_WELazyOperation *> *_lazyOperations;
     NSMutableArray<WEDependencyDescription *> *_dependencies;
     NSMutableArray<WESegueDescription *> *_segues;
+    NSMutableArray<WEOperation *> *_skippedOperations;
+    id<WEOperationExecutor> _operationExecutor;
+    BOOL _speculativePrefetchEnabled;
+    NSUInteger _prefetchCount;
+    NSUInteger _discardedPrefetchCount;
+    WEWorkflowReport *_report;
+    BOOL _incrementalExecutionEnabled;
+    NSUInteger _reusedOperationCount;
+    NSUInteger _deduplicatedOperationCount;
+    NSMutableSet<WEOperation *> *_invalidatedOperations;
 
     // Internal queue and state that is only accessed on that queue
     dispatch_queue_t _workflowInternalQueue;
     BOOL _isFailedInternal;
-    NSArray<_WEOperationState *> *_allOperationStates;
-    NSUInteger _totalCompletedOperations;
-    NSMutableOrderedSet<_WEOperationState *> *_operationsReadyToExecute;
-    NSMutableSet<_WEOperationState *> *_activeOperations;
-    BOOL _hasSeguesInternal;
+    // Graph of the current run, see WEWorkflowGraph.h. The arrays retain operations and segue conditions
+    // the graph refers to. Operations added with factories that have not been created yet are `nil` in the graph,
+    // and are represented by their `_WELazyOperation` in the array.
+    WEWorkflowGraph *_graph;
+    NSMutableArray<WEOperation *> *_graphOperations;
+    // Position in the ready queue up to which operations of ready nodes have been created.
+    WEGraphIndex _instantiatedReadyTail;
+    NSArray<WESegueDescription *> *_graphSegues;
+    // Context of every node when the workflow has sub-workflows, operations of which get namespaced views.
+    NSArray<WEWorkflowContext *> *_graphContexts;
+    // Channels of stream dependencies of the current run, `nil` when there are none.
+    NSArray<WEStreamChannel *> *_graphChannels;
+    // Index of the source of every dependency into a reduce operation among sources of that operation, `WEGraphNoIndex`
+    // for other dependencies. `nil` when the run has no reduce operations.
+    NSData *_graphReductionSlots;
+    BOOL _hasRateLimitersInternal;
+    BOOL _hasTerminalOperationsInternal;
+    // Nodes of every race group of the current run that has no winner yet, `nil` when the run has no race groups.
+    NSMutableDictionary<NSString *, NSMutableArray<NSNumber *> *> *_graphRaceGroups;
+    // The first terminal node of the run that completed successfully, `WEGraphNoIndex` until there is one.
+    WEGraphIndex _terminalNodeInternal;
+    // Successful results of quorum sources of every node with a quorum, in the order they completed, up to the quorum.
+    // `nil` when the run has no quorums.
+    NSMutableDictionary<NSNumber *, NSMutableArray<WEOperationResult *> *> *_graphQuorumResults;
+    // Sources of every node whose quorum cancels remaining sources and has not been reached yet.
+    // `nil` when the run has no such quorums.
+    NSMutableDictionary<NSNumber *, NSMutableArray<NSNumber *> *> *_graphQuorumSources;
+    // Wakes the internal queue up to process pending completions, wakeups that arrive before it runs are coalesced.
+    dispatch_source_t _completionSource;
+    _Atomic(_WECompletion *) _pendingCompletions;
+    NSUInteger _completionBatchCount;
+    NSUInteger _fusedOperationCount;
+    // Wakes the scheduler up when a token is due for a ready operation held back by its rate limiter.
+    // Created on first use, disarmed while no operation is held back.
+    dispatch_source_t _throttleTimer;
+    uint64_t _throttleDeadline;
+    NSUInteger _requestedExecutorSlots;
+    id<WEOperationExecutor> _operationExecutorInternal;
+    // The operation executor has workers, and operations it performs prefer the worker of their predecessor.
+    BOOL _operationExecutorHasWorkersInternal;
+    WEConcurrencyController *_concurrencyControllerInternal;
+    WEOperationCompletionObserver _operationCompletionObserverInternal;
+    BOOL _speculativePrefetchEnabledInternal;
+    uint64_t _runStartTimeInternal;
+    // Incremented by every run, so that work a previous run left in progress can tell that its run is over.
+    NSUInteger _runGenerationInternal;
+    // Records of the last successful run of an incremental workflow. Records made during a run replace them
+    // only if the run succeeds, so a failed run never leaves records that are inconsistent with each other.
+    NSMapTable<WEOperation *, _WEIncrementalRecord *> *_incrementalRecords;
+    NSMapTable<WEOperation *, _WEIncrementalRecord *> *_runRecords;
+    // Context values operations of the current run read, captured when they are prepared.
+    NSMapTable<WEOperation *, NSDictionary *> *_runInputs;
+    // `_WEIncrementalState` of every node, `nil` unless the run is incremental.
+    NSMutableData *_incrementalStates;
 }
 
 - (instancetype)init
@@ -145,6 +298,15 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
          maximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
                             delegate:(id<WEWorkflowDelegate>)delegate
                        delegateQueue:(dispatch_queue_t)delegateQueue
+{
+    return [self initWithContextClass:contextClass maximumConcurrentOperations:maximumConcurrentOperations delegate:delegate delegateQueue:delegateQueue executor:nil];
+}
+
+- (instancetype)initWithContextClass:(Class)contextClass
+         maximumConcurrentOperations:(NSUInteger)maximumConcurrentOperations
+                            delegate:(id<WEWorkflowDelegate>)delegate
+                       delegateQueue:(dispatch_queue_t)delegateQueue
+                            executor:(WEExecutor *)executor
 {
     Class defaultClass = [WEWorkflowContext class];
     if (contextClass != nil && contextClass != defaultClass && ![contextClass isSubclassOfClass:defaultClass])
@@ -167,16 +329,37 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
         _delegate = delegate;
         _delegateQueue = delegateQueue;
         
+        _mainThreadExecutor = [WEMainThreadExecutor new];
+        _executor = executor;
+        _executorWeight = 1.0;
+        
         pthread_mutex_init(&_operationMutex, NULL);
         _operations = [NSMutableArray new];
+        _operationSet = [NSMutableSet new];
+        _lazyOperations = [NSMutableArray new];
+        atomic_init(&_pendingCompletions, NULL);
         _dependencies = [NSMutableArray new];
         _segues = [NSMutableArray new];
+        _skippedOperations = [NSMutableArray new];
+        _invalidatedOperations = [NSMutableSet new];
     }
     return self;
 }
 
 - (void)dealloc
 {
+    if (_throttleTimer != nil) dispatch_source_cancel(_throttleTimer);
+    if (_completionSource != nil) dispatch_source_cancel(_completionSource);
+    // Operations that completed after the workflow failed may have left completions nobody is going to process.
+    _WECompletion *completion = atomic_exchange(&_pendingCompletions, NULL);
+    while (completion != NULL)
+    {
+        _WECompletion *next = completion->next;
+        CFBridgingRelease(completion->result);
+        free(completion);
+        completion = next;
+    }
+    WEWorkflowGraphDestroy(_graph);
     pthread_mutex_destroy(&_operationMutex);
 }
 
@@ -184,6 +367,7 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
 #pragma mark - Properties
 
 @synthesize context = _context;
+@synthesize executor = _executor;
 
 - (BOOL)isActive
 {
@@ -221,11 +405,237 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
     return error;
 }
 
+- (double)executorWeight
+{
+    double weight;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    weight = _executorWeight;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return weight;
+}
+
+- (void)setExecutorWeight:(double)executorWeight
+{
+    if (!(executorWeight > 0)) THROW_INVALID_PARAM(executorWeight, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _executorWeight = executorWeight;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (WEConcurrencyController *)concurrencyController
+{
+    WEConcurrencyController *controller;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    controller = _concurrencyController;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return controller;
+}
+
+- (void)setConcurrencyController:(WEConcurrencyController *)concurrencyController
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot change the concurrency controller after the workflow had started." });
+    }
+    _concurrencyController = concurrencyController;
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (WEOperationCompletionObserver)operationCompletionObserver
+{
+    WEOperationCompletionObserver observer;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    observer = _operationCompletionObserver;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return observer;
+}
+
+- (void)setOperationCompletionObserver:(WEOperationCompletionObserver)operationCompletionObserver
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot change the operation completion observer after the workflow had started." });
+    }
+    _operationCompletionObserver = [operationCompletionObserver copy];
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (id<WEOperationExecutor>)operationExecutor
+{
+    id<WEOperationExecutor> executor;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    executor = _operationExecutor;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return executor;
+}
+
+- (void)setOperationExecutor:(id<WEOperationExecutor>)operationExecutor
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot change the executor after the workflow had started." });
+    }
+    _operationExecutor = operationExecutor;
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (WEWorkStealingExecutor *)workStealingExecutor
+{
+    id<WEOperationExecutor> executor = self.operationExecutor;
+    return [executor isKindOfClass:[WEWorkStealingExecutor class]] ? (WEWorkStealingExecutor *)executor : nil;
+}
+
+- (void)setWorkStealingExecutor:(WEWorkStealingExecutor *)workStealingExecutor
+{
+    self.operationExecutor = workStealingExecutor;
+}
+
+- (BOOL)isSpeculativePrefetchEnabled
+{
+    BOOL enabled;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    enabled = _speculativePrefetchEnabled;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return enabled;
+}
+
+- (void)setSpeculativePrefetchEnabled:(BOOL)speculativePrefetchEnabled
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot change speculative prefetch after the workflow had started." });
+    }
+    _speculativePrefetchEnabled = speculativePrefetchEnabled;
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (NSUInteger)prefetchCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    count = _prefetchCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
+- (NSUInteger)discardedPrefetchCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    count = _discardedPrefetchCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
+- (BOOL)isIncrementalExecutionEnabled
+{
+    BOOL enabled;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    enabled = _incrementalExecutionEnabled;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return enabled;
+}
+
+- (void)setIncrementalExecutionEnabled:(BOOL)incrementalExecutionEnabled
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot change incremental execution after the workflow had started." });
+    }
+    _incrementalExecutionEnabled = incrementalExecutionEnabled;
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (NSUInteger)reusedOperationCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    count = _reusedOperationCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
+- (NSUInteger)deduplicatedOperationCount
+{
+    NSUInteger count;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    count = _deduplicatedOperationCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
+- (WEWorkflowReport *)report
+{
+    WEWorkflowReport *report;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    report = _report;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return report;
+}
+
+- (NSTimeInterval)mainThreadTimeBudget
+{
+    return _mainThreadExecutor.timeBudget;
+}
+
+- (void)setMainThreadTimeBudget:(NSTimeInterval)mainThreadTimeBudget
+{
+    _mainThreadExecutor.timeBudget = mainThreadTimeBudget;
+}
+
+- (NSTimeInterval)mainThreadTime
+{
+    return _mainThreadExecutor.consumedTime;
+}
+
+- (NSUInteger)mainThreadBatchCount
+{
+    return _mainThreadExecutor.batchCount;
+}
+
+- (NSUInteger)completionBatchCount
+{
+    NSUInteger count = 0;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+        count = _completionBatchCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
+- (NSUInteger)fusedOperationCount
+{
+    NSUInteger count = 0;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+        count = _fusedOperationCount;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return count;
+}
+
 - (NSArray<WEOperation *> *)operations
 {
-    NSArray *operationsCopy;
+    NSMutableArray *operationsCopy;
     ENTER_CRITICAL_SECTION(self, _operationMutex)
-        operationsCopy = [_operations copy];
+        operationsCopy = [_operations mutableCopy];
+        for (_WELazyOperation *lazyOperation in _lazyOperations)
+        {
+            if (lazyOperation->_operation != nil) [operationsCopy addObject:lazyOperation->_operation];
+        }
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
     return operationsCopy;
 }
@@ -235,10 +645,23 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
     NSUInteger count = 0;
     ENTER_CRITICAL_SECTION(self, _operationMutex)
         count = _operations.count;
+        for (_WELazyOperation *lazyOperation in _lazyOperations)
+        {
+            if (lazyOperation->_operation != nil) count++;
+        }
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
     return count;
 }
 
+- (NSArray<WEOperation *> *)skippedOperations
+{
+    NSArray *skippedOperations;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    skippedOperations = [_skippedOperations copy];
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    return skippedOperations;
+}
+
 
 #pragma mark - Operation Management
 
@@ -253,12 +676,34 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
         THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot directly add an operation after the workflow had started." });
     }
     
-    if ([_operations containsObject:operation])
+    if ([_operationSet containsObject:operation])
     {
         THROW_INVALID_PARAM(operation, @{ NSLocalizedDescriptionKey: @"Duplicate operation" });
     }
     
     [_operations addObject:operation];
+    [_operationSet addObject:operation];
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+- (void)addOperationWithName:(NSString *)name factory:(WEOperationFactory)factory
+{
+    if (name == nil) THROW_INVALID_PARAM(name, nil);
+    if (factory == nil) THROW_INVALID_PARAM(factory, nil);
+    
+    _WELazyOperation *lazyOperation = [_WELazyOperation new];
+    lazyOperation->_name = [name copy];
+    lazyOperation->_factory = factory;
+    
+    // Duplicate names are reported when the graph is built, same as for operations added directly.
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot directly add an operation after the workflow had started." });
+    }
+    [_lazyOperations addObject:lazyOperation];
     
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
 }
@@ -272,12 +717,12 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
     
     // Verify that explicitly specified operations belong to the workflow
     WEOperation *sourceOperation = connection.sourceOperation;
-    if (sourceOperation != nil && ![_operations containsObject:sourceOperation])
+    if (sourceOperation != nil && ![_operationSet containsObject:sourceOperation])
     {
         THROW_INVALID_PARAM(dependency, @{ NSLocalizedDescriptionKey: @"Source operation does not belong to the workflow" });
     }
     WEOperation *targetOperation = connection.targetOperation;
-    if (targetOperation != nil && ![_operations containsObject:targetOperation])
+    if (targetOperation != nil && ![_operationSet containsObject:targetOperation])
     {
         THROW_INVALID_PARAM(dependency, @{ NSLocalizedDescriptionKey: @"Target operation does not belong to the workflow" });
     }
@@ -315,360 +760,2005 @@ NSInteger const WEWorkflowInvalidSegue = -10005;
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
 }
 
+- (BOOL)addDefinition:(WEWorkflowDefinition *)definition error:(NSError **)error
+{
+    return [self addDefinition:definition registry:[WEOperationRegistry sharedRegistry] error:error];
+}
 
-#pragma mark - Running the workflow
-
-- (void)start
+- (BOOL)addDefinition:(WEWorkflowDefinition *)definition registry:(WEOperationRegistry *)registry error:(NSError **)error
 {
-    BOOL start = NO;
-    ENTER_CRITICAL_SECTION(self, _operationMutex)
-    if (_state == WEWorkflowInactive)
+    if (definition == nil) THROW_INVALID_PARAM(definition, nil);
+    if (registry == nil) THROW_INVALID_PARAM(registry, nil);
+    
+    // Operations are created outside of the critical section, factories are resolved once per type.
+    NSUInteger operationCount = definition.operationCount;
+    NSMutableArray<WEOperation *> *operations = [[NSMutableArray alloc] initWithCapacity:operationCount];
+    NSMutableDictionary<NSString *, WEOperationFactory> *factories = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < operationCount; i++)
     {
-        _workflowInternalQueue = dispatch_queue_create("we-workflow.queue", DISPATCH_QUEUE_SERIAL);
-        _state = WEWorkflowActive;
-        start = YES;
+        NSString *type = [definition _typeOfOperationAtIndex:i];
+        WEOperationFactory factory = [factories objectForKey:type];
+        if (factory == nil)
+        {
+            factory = [registry factoryForOperationType:type];
+            if (factory == nil)
+            {
+                if (error != NULL)
+                {
+                    NSString *reason = [NSString stringWithFormat:@"Operation type \"%@\" is not registered.", type];
+                    *error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDefinition userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                }
+                return NO;
+            }
+            [factories setObject:factory forKey:type];
+        }
+        
+        NSString *name = [definition _nameOfOperationAtIndex:i];
+        WEOperation *operation = factory(name);
+        if (operation == nil || (operation.name != name && ![operation.name isEqualToString:name]))
+        {
+            THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Factory of operation type \"%@\" did not create an operation named \"%@\".", type, name] });
+        }
+        [operations addObject:operation];
     }
-    LEAVE_CRITICAL_SECTION(self, _operationMutex)
     
-    // dispatch outside of a critical section to avoid possible contention over the lock if queue qob is picked up quickly.
-    if (start)
+    if ([NSSet setWithArray:operations].count != operationCount)
     {
-        dispatch_async(_workflowInternalQueue, ^{
-            [self _prepareAndStartWorkflow];
-        });
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Operation factories returned the same operation more than once." });
     }
-}
-
-#pragma mark - Workflow internals
-
-- (void)_prepareAndStartWorkflow
-{
-    // Very first version - just perform operations in order they were added.
-    // Will change later.
     
-    NSArray<WEOperation *> *operations;
-    NSArray<WEDependencyDescription *> *dependencies;
-    NSArray<WESegueDescription *> *segues;
-    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    // Connections refer to operations directly, so they do not need to be resolved by name when the workflow starts.
+    NSUInteger dependencyCount = definition.dependencyCount;
+    NSMutableArray<WEDependencyDescription *> *dependencies = [[NSMutableArray alloc] initWithCapacity:dependencyCount];
+    for (NSUInteger i = 0; i < dependencyCount; i++)
+    {
+        NSUInteger source, target;
+        [definition _getDependencyAtIndex:i source:&source target:&target];
+        [dependencies addObject:[WEDependencyDescription dependencyFormOperation:operations[source] toOperation:operations[target]]];
+    }
+    
+    NSUInteger segueCount = definition.segueCount;
+    NSMutableArray<WESegueDescription *> *segues = [[NSMutableArray alloc] initWithCapacity:segueCount];
+    for (NSUInteger i = 0; i < segueCount; i++)
+    {
+        NSUInteger source, target;
+        BOOL likely;
+        [definition _getSegueAtIndex:i source:&source target:&target likely:&likely];
+        
+        WESegueDescription *segue = [WESegueDescription new];
+        segue.sourceOperation = operations[source];
+        segue.targetOperation = operations[target];
+        segue.condition = [definition _conditionOfSegueAtIndex:i];
+        segue.likely = likely;
+        [segues addObject:segue];
+    }
+    
+    // The definition was validated when it was created, and connections only refer to its own operations,
+    // so the whole definition is added at once without verifying every connection.
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot add a definition after the workflow had started." });
+    }
+    for (WEOperation *operation in operations)
+    {
+        if ([_operationSet containsObject:operation])
+        {
+            THROW_INVALID_PARAM(operation, @{ NSLocalizedDescriptionKey: @"Duplicate operation" });
+        }
+    }
+    
+    [_operations addObjectsFromArray:operations];
+    [_operationSet addObjectsFromArray:operations];
+    [_dependencies addObjectsFromArray:dependencies];
+    [_segues addObjectsFromArray:segues];
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    return YES;
+}
+
+
+#pragma mark - Running the workflow
+
+- (void)start
+{
+    BOOL start = NO;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    if (_simulating)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot start a workflow while it is being simulated." });
+    }
+    if (_state == WEWorkflowInactive)
+    {
+        // Workflows on a shared executor share its scheduler queues to keep the number of queues bounded.
+        _workflowInternalQueue = (_executor != nil) ? [_executor _nextSchedulerQueue] : dispatch_queue_create("we-workflow.queue", DISPATCH_QUEUE_SERIAL);
+        
+        __weak WEWorkflow *weakSelf = self;
+        _completionSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, _workflowInternalQueue);
+        dispatch_source_set_event_handler(_completionSource, ^{
+            [weakSelf _processPendingCompletions];
+        });
+        dispatch_resume(_completionSource);
+        _state = WEWorkflowActive;
+        start = YES;
+    }
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    // dispatch outside of a critical section to avoid possible contention over the lock if queue qob is picked up quickly.
+    if (start)
+    {
+        dispatch_async(_workflowInternalQueue, ^{
+            [self _prepareAndStartWorkflow];
+        });
+    }
+}
+
+- (void)restart
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (!_incrementalExecutionEnabled || _state != WEWorkflowComplete)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Only a completed workflow with incremental execution enabled can be restarted." });
+    }
+    _state = WEWorkflowActive;
+    _error = nil;
+    _report = nil;
+    _reusedOperationCount = 0;
+    _deduplicatedOperationCount = 0;
+    [_skippedOperations removeAllObjects];
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    dispatch_async(_workflowInternalQueue, ^{
+        [self _prepareAndStartWorkflow];
+    });
+}
+
+- (void)invalidateOperation:(WEOperation *)operation
+{
+    if (operation == nil) THROW_INVALID_PARAM(operation, nil);
+    
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (![_operationSet containsObject:operation])
+    {
+        THROW_INVALID_PARAM(operation, @{ NSLocalizedDescriptionKey: @"Operation does not belong to the workflow" });
+    }
+    [_invalidatedOperations addObject:operation];
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+}
+
+#pragma mark - Workflow internals
+
+- (void)_prepareAndStartWorkflow
+{
+    // Very first version - just perform operations in order they were added.
+    // Will change later.
+    
+    NSArray<WEOperation *> *operations;
+    NSArray<WEDependencyDescription *> *dependencies;
+    NSArray<WESegueDescription *> *segues;
+    NSSet<WEOperation *> *invalidatedOperations = nil;
+    BOOL incremental;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
     
     WEAssert(_state == WEWorkflowActive);
     
-    operations = [_operations copy];
+    operations = [self _operationsOfRun];
     dependencies = [_dependencies copy];
     segues = [_segues copy];
+    _operationExecutorInternal = _operationExecutor ?: [WEDispatchQueueExecutor globalQueueExecutor];
+    _operationExecutorHasWorkersInternal = [_operationExecutorInternal respondsToSelector:@selector(executeBlock:preferredWorker:)]
+                                        && [_operationExecutorInternal respondsToSelector:@selector(currentWorkerIndex)];
+    _concurrencyControllerInternal = _concurrencyController;
+    _operationCompletionObserverInternal = _operationCompletionObserver;
+    _speculativePrefetchEnabledInternal = _speculativePrefetchEnabled;
+    incremental = _incrementalExecutionEnabled;
+    if (incremental)
+    {
+        invalidatedOperations = [_invalidatedOperations copy];
+        [_invalidatedOperations removeAllObjects];
+    }
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
     
     if (operations.count == 0)
     {
-        [self _completeWorkflow];
+        [self _completeWorkflow];
+    }
+    else
+    {
+        _isFailedInternal = NO;
+        _terminalNodeInternal = WEGraphNoIndex;
+        _runStartTimeInternal = WEMonotonicTime();
+        _runGenerationInternal++;
+        
+        NSError *error = [self _buildGraphOfOperations:operations dependencies:dependencies segues:segues sealingSubworkflows:YES];
+        if (error == nil && _graphChannels != nil) [_context _setStreamChannels:_graphChannels];
+        BOOL cancellable = _hasTerminalOperationsInternal || _graphRaceGroups != nil || _graphQuorumSources != nil;
+        if (error == nil && incremental && cancellable)
+        {
+            NSString *reason = @"Terminal operations, race groups and quorums that cancel their remaining sources cannot be used with incremental execution.";
+            error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDefinition userInfo:@{ NSLocalizedDescriptionKey: reason }];
+        }
+        if (error == nil)
+        {
+            [self _beginReductions];
+            // Operations of an incremental run may reuse their kept results instead of running, which is decided by the scheduler.
+            // Operations that may be cancelled are only started by the scheduler, which knows whether they have started.
+            if (incremental) [self _prepareIncrementalRunWithInvalidatedOperations:invalidatedOperations];
+            else if (!cancellable) [self _fuseLinearChains];
+            _requestedExecutorSlots = 0;
+            [self _checkAndStartReadyOperation];
+        }
+        else
+        {
+            [self _completeWorkflowWithError:error];
+        }
+    }
+}
+
+// Operations added directly followed by operations added with factories, which stand in for their operations by name.
+// Must be called within the critical section.
+- (NSArray<WEOperation *> *)_operationsOfRun
+{
+    if (_lazyOperations.count == 0) return [_operations copy];
+    return [_operations arrayByAddingObjectsFromArray:(NSArray<WEOperation *> *)_lazyOperations];
+}
+
+// Builds the graph of a run, in which operations of sub-workflows become nodes of the workflow's own graph.
+// Operations that are ready from the start are ready at the start time of the run.
+// Sub-workflows are sealed when a run starts, and left open when the graph is only built to be simulated.
+- (NSError *)_buildGraphOfOperations:(NSArray<WEOperation *> *)operations
+                        dependencies:(NSArray<WEDependencyDescription *> *)dependencies
+                              segues:(NSArray<WESegueDescription *> *)segues
+                 sealingSubworkflows:(BOOL)seal
+{
+    NSUInteger namedOperationCount = operations.count;
+    NSData *barrierTargets = nil;
+    NSError *error = nil;
+    BOOL hasSubworkflows = NO;
+    for (WEOperation *operation in operations)
+    {
+        if ([operation isKindOfClass:[WESubworkflowOperation class]])
+        {
+            hasSubworkflows = YES;
+            break;
+        }
+    }
+    if (hasSubworkflows)
+    {
+        error = [self _flattenSubworkflowsOfOperations:&operations dependencies:&dependencies segues:&segues barrierTargets:&barrierTargets sealing:seal];
+    }
+    
+    if (error == nil)
+    {
+        error = [self _buildDependencyGraphWithOperations:operations namedOperationCount:namedOperationCount barrierTargets:barrierTargets.bytes dependencies:dependencies segues:segues];
+    }
+    return error;
+}
+
+- (WEWorkflowGraph *)_buildGraphForSimulationWithOperations:(NSArray<WEOperation *> **)operationsRef error:(NSError **)errorRef
+{
+    NSArray<WEOperation *> *operations;
+    NSArray<WEDependencyDescription *> *dependencies;
+    NSArray<WESegueDescription *> *segues;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_state != WEWorkflowInactive || _simulating)
+    {
+        THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Cannot simulate a workflow that had started or is being simulated." });
+    }
+    operations = [self _operationsOfRun];
+    dependencies = [_dependencies copy];
+    segues = [_segues copy];
+    // The workflow cannot start until the graph is built, so the internal state it is built into is not in use.
+    _simulating = (operations.count > 0);
+    
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    *operationsRef = nil;
+    if (errorRef != NULL) *errorRef = nil;
+    if (operations.count == 0) return NULL;
+    
+    // The simulation takes the graph over, and the workflow is left as if nothing had happened: sub-workflows stay open
+    // and channels of streams are never handed to the context.
+    _runStartTimeInternal = 0;
+    NSError *error = [self _buildGraphOfOperations:operations dependencies:dependencies segues:segues sealingSubworkflows:NO];
+    // The simulation plans with durations of all operations, so operations added with factories are created up front.
+    for (WEGraphIndex node = 0; error == nil && node < _graph->nodeCount; node++)
+    {
+        if (_graph->operations[node] == nil) error = [self _instantiateOperationOfNode:node];
+    }
+    if (error != nil)
+    {
+        WEWorkflowGraphDestroy(_graph);
+        _graph = NULL;
+    }
+    WEWorkflowGraph *graph = _graph;
+    *operationsRef = _graphOperations;
+    _graph = NULL;
+    [self _commonCompletion];
+    
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _simulating = NO;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (error != nil && errorRef != NULL) *errorRef = error;
+    return graph;
+}
+
+static inline WEGraphIndex _WEFindNode(
+                                       CFDictionaryRef nodesByOperation,
+                                       NSDictionary<NSString *, NSNumber *> *nodesByName,
+                                       WEOperation *operation,
+                                       NSString *operationName
+                                       )
+{
+    if (operation == nil)
+    {
+        NSNumber *node = [nodesByName objectForKey:operationName];
+        return (node != nil) ? (WEGraphIndex)node.unsignedIntValue : WEGraphNoIndex;
+    }
+    
+    // Values are stored off by one, so that a missing key (NULL) can be told apart from the first node.
+    uintptr_t value = (uintptr_t)CFDictionaryGetValue(nodesByOperation, (__bridge const void *)operation);
+    return (value != 0) ? (WEGraphIndex)(value - 1) : WEGraphNoIndex;
+}
+
+// A dependency resolved to node indexes. The key orders dependencies by source, then by target,
+// and position is the index of the dependency description, to report errors against it.
+typedef struct
+{
+    uint64_t key;
+    NSUInteger position;
+    BOOL stream;
+    BOOL quorum;
+} _WEResolvedDependency;
+
+static inline uint64_t _WEDependencyKey(WEGraphIndex from, WEGraphIndex to)
+{
+    return ((uint64_t)from << 32) | to;
+}
+
+static int _WECompareResolvedDependencies(const void *first, const void *second)
+{
+    const _WEResolvedDependency *a = first;
+    const _WEResolvedDependency *b = second;
+    if (a->key != b->key) return (a->key < b->key) ? -1 : 1;
+    if (a->stream != b->stream) return a->stream ? -1 : 1;
+    if (a->quorum != b->quorum) return b->quorum ? -1 : 1;
+    if (a->position != b->position) return (a->position < b->position) ? -1 : 1;
+    return 0;
+}
+
+static const _WEResolvedDependency *_WEFindResolvedDependency(const _WEResolvedDependency *sorted, NSUInteger count, uint64_t key)
+{
+    NSUInteger low = 0;
+    NSUInteger high = count;
+    while (low < high)
+    {
+        NSUInteger middle = low + (high - low) / 2;
+        if (sorted[middle].key < key) low = middle + 1;
+        else high = middle;
+    }
+    return (low < count && sorted[low].key == key) ? &sorted[low] : NULL;
+}
+
+static NSError *_WEInvalidSubworkflowError(WESubworkflowOperation *subworkflow, WEConnectionDescription *connection)
+{
+    NSString *reason = [NSString stringWithFormat:@"Invalid connection %@ in sub-workflow %@.", connection, subworkflow];
+    return [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+}
+
+static inline WEOperation *_WEResolveOperation(WEOperation *operation, NSString *name, NSDictionary<NSString *, WEOperation *> *operationsByName)
+{
+    return (operation != nil) ? operation : operationsByName[name];
+}
+
+// Flattens sub-workflows into operations and connections of the workflow itself, see WESubworkflowOperation.h.
+// Operations of sub-workflows are appended after operations of the workflow, and the sub-workflow that encloses each
+// of them is returned as its barrier target. Connections of sub-workflows are resolved within their sub-workflows,
+// and connections into a sub-workflow are copied to the operations of the sub-workflow that have no incoming connections
+// within it, so that they start when the sub-workflow could start.
+- (NSError *)_flattenSubworkflowsOfOperations:(NSArray<WEOperation *> **)operationsRef
+                                 dependencies:(NSArray<WEDependencyDescription *> **)dependenciesRef
+                                       segues:(NSArray<WESegueDescription *> **)seguesRef
+                               barrierTargets:(NSData **)barrierTargetsRef
+                                      sealing:(BOOL)seal
+{
+    NSMutableArray<WEOperation *> *operations = [*operationsRef mutableCopy];
+    NSMutableArray<WEDependencyDescription *> *dependencies = [*dependenciesRef mutableCopy];
+    NSMutableArray<WESegueDescription *> *segues = [*seguesRef mutableCopy];
+    NSMutableData *barrierTargets = [NSMutableData dataWithLength:operations.count * sizeof(WEGraphIndex)];
+    memset(barrierTargets.mutableBytes, 0xFF, barrierTargets.length);
+    NSMutableSet<WEOperation *> *allOperations = [NSMutableSet setWithArray:operations];
+    
+    // Names of the workflow's own operations, the first one wins. Duplicates are reported when the graph is built.
+    NSMutableDictionary<NSString *, WEOperation *> *operationsByName = [NSMutableDictionary new];
+    for (WEOperation *operation in operations)
+    {
+        NSString *name = operation.name;
+        if (name != nil && operationsByName[name] == nil) operationsByName[name] = operation;
+    }
+    
+    NSMapTable<WESubworkflowOperation *, NSArray<WEOperation *> *> *entriesBySubworkflow = [NSMapTable strongToStrongObjectsMapTable];
+    NSMapTable<WEOperation *, WEWorkflowContext *> *contexts = [NSMapTable strongToStrongObjectsMapTable];
+    
+    // Sub-workflows are expanded breadth first, operations appended in the loop are visited by it as well.
+    for (NSUInteger i = 0; i < operations.count; i++)
+    {
+        if (![operations[i] isKindOfClass:[WESubworkflowOperation class]]) continue;
+        WESubworkflowOperation *subworkflow = (WESubworkflowOperation *)operations[i];
+        
+        NSArray<WEOperation *> *children;
+        NSArray<WEDependencyDescription *> *childDependencies;
+        NSArray<WESegueDescription *> *childSegues;
+        if (seal) [subworkflow _sealWithOperations:&children dependencies:&childDependencies segues:&childSegues];
+        else [subworkflow _copyOperations:&children dependencies:&childDependencies segues:&childSegues];
+        
+        // Operations of a sub-workflow see the context in its namespace, nested in the namespace of the enclosing one.
+        WEWorkflowContext *enclosingContext = [contexts objectForKey:subworkflow] ?: _context;
+        WEWorkflowContext *childContext = [enclosingContext contextForNamespace:subworkflow.name];
+        
+        NSMutableDictionary<NSString *, WEOperation *> *childrenByName = [NSMutableDictionary new];
+        for (WEOperation *child in children)
+        {
+            if ([allOperations containsObject:child])
+            {
+                NSString *reason = [NSString stringWithFormat:@"Operation %@ of sub-workflow %@ belongs to the workflow more than once.", child, subworkflow];
+                return [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+            }
+            NSString *name = child.name;
+            if (name != nil && childrenByName[name] != nil)
+            {
+                NSString *reason = [NSString stringWithFormat:@"Duplicate operation name \"%@\" in sub-workflow %@: operations [%@, %@]", name, subworkflow, child, childrenByName[name]];
+                return [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDuplicateNames userInfo:@{ NSLocalizedDescriptionKey: reason }];
+            }
+            if (name != nil) childrenByName[name] = child;
+            
+            [allOperations addObject:child];
+            [operations addObject:child];
+            [contexts setObject:childContext forKey:child];
+            WEGraphIndex barrierTarget = (WEGraphIndex)i;
+            [barrierTargets appendBytes:&barrierTarget length:sizeof(barrierTarget)];
+        }
+        
+        // Connections of the sub-workflow are resolved to operations, operations that are targets of any of them
+        // are not entries of the sub-workflow.
+        NSMutableSet<WEOperation *> *targets = [NSMutableSet new];
+        for (WEDependencyDescription *childDependency in childDependencies)
+        {
+            WEDependencyDescription *dependency = [childDependency copy];
+            dependency.sourceOperation = _WEResolveOperation(dependency.sourceOperation, dependency.sourceOperationName, childrenByName);
+            dependency.targetOperation = _WEResolveOperation(dependency.targetOperation, dependency.targetOperationName, childrenByName);
+            if (dependency.sourceOperation == nil || dependency.targetOperation == nil) return _WEInvalidSubworkflowError(subworkflow, childDependency);
+            [targets addObject:dependency.targetOperation];
+            [dependencies addObject:dependency];
+        }
+        for (WESegueDescription *childSegue in childSegues)
+        {
+            WESegueDescription *segue = [childSegue copy];
+            segue.sourceOperation = _WEResolveOperation(segue.sourceOperation, segue.sourceOperationName, childrenByName);
+            segue.targetOperation = _WEResolveOperation(segue.targetOperation, segue.targetOperationName, childrenByName);
+            if (segue.sourceOperation == nil || segue.targetOperation == nil) return _WEInvalidSubworkflowError(subworkflow, childSegue);
+            [targets addObject:segue.targetOperation];
+            [segues addObject:segue];
+        }
+        
+        NSMutableArray<WEOperation *> *entries = [NSMutableArray new];
+        for (WEOperation *child in children)
+        {
+            if (![targets containsObject:child]) [entries addObject:child];
+        }
+        [entriesBySubworkflow setObject:entries forKey:subworkflow];
+    }
+    
+    // Connections into a sub-workflow are copied to its entries. Copies are appended and visited by the same loop,
+    // which copies them further into nested sub-workflows.
+    for (NSUInteger i = 0; i < dependencies.count; i++)
+    {
+        WEDependencyDescription *dependency = dependencies[i];
+        WEOperation *target = _WEResolveOperation(dependency.targetOperation, dependency.targetOperationName, operationsByName);
+        if (![target isKindOfClass:[WESubworkflowOperation class]]) continue;
+        for (WEOperation *entry in [entriesBySubworkflow objectForKey:(WESubworkflowOperation *)target])
+        {
+            WEDependencyDescription *copy = [dependency copy];
+            copy.targetOperation = entry;
+            [dependencies addObject:copy];
+        }
+    }
+    for (NSUInteger i = 0; i < segues.count; i++)
+    {
+        WESegueDescription *segue = segues[i];
+        WEOperation *target = _WEResolveOperation(segue.targetOperation, segue.targetOperationName, operationsByName);
+        if (![target isKindOfClass:[WESubworkflowOperation class]]) continue;
+        for (WEOperation *entry in [entriesBySubworkflow objectForKey:(WESubworkflowOperation *)target])
+        {
+            WESegueDescription *copy = [segue copy];
+            copy.targetOperation = entry;
+            [segues addObject:copy];
+        }
+    }
+    
+    NSMutableArray<WEWorkflowContext *> *graphContexts = [[NSMutableArray alloc] initWithCapacity:operations.count];
+    for (WEOperation *operation in operations)
+    {
+        [graphContexts addObject:[contexts objectForKey:operation] ?: _context];
+    }
+    _graphContexts = graphContexts;
+    
+    *operationsRef = operations;
+    *dependenciesRef = dependencies;
+    *seguesRef = segues;
+    *barrierTargetsRef = barrierTargets;
+    return nil;
+}
+
+- (NSError *)_buildDependencyGraphWithOperations:(NSArray<WEOperation *> *)operations
+                             namedOperationCount:(NSUInteger)namedOperationCount
+                                  barrierTargets:(const WEGraphIndex *)barrierTargets
+                                    dependencies:(NSArray<WEDependencyDescription *> *)dependencies
+                                          segues:(NSArray<WESegueDescription *> *)segues
+{
+    NSError *error = nil;
+    NSUInteger operationCount = operations.count;
+    NSUInteger dependencyCount = dependencies.count;
+    NSUInteger segueCount = segues.count;
+    WEAssert(operationCount < WEGraphNoIndex);
+    
+    CFMutableDictionaryRef nodesByOperation = CFDictionaryCreateMutable(kCFAllocatorDefault, (CFIndex)operationCount, NULL, NULL);
+    NSMutableDictionary<NSString *, NSNumber *> *nodesByName = [NSMutableDictionary new];
+    _WEResolvedDependency *resolvedDependencies = malloc(MAX(dependencyCount, 1) * sizeof(_WEResolvedDependency));
+    WEGraphIndex *segueEnds = malloc(MAX(segueCount, 1) * 2 * sizeof(WEGraphIndex));
+    NSUInteger resolvedDependencyCount = 0;
+    NSUInteger uniqueDependencyCount = 0;
+    NSMutableArray<WEStreamChannel *> *channels = nil;
+    
+    // Process operations, make vertices
+    for (NSUInteger i = 0; i < operationCount; i++)
+    {
+        WEOperation *operation = operations[i];
+        CFDictionarySetValue(nodesByOperation, (__bridge const void *)operation, (const void *)(uintptr_t)(i + 1));
+        
+        // Operations of sub-workflows are only referred to by name within their sub-workflows, and are already resolved.
+        NSString *name = (i < namedOperationCount) ? operation.name : nil;
+        if (name != nil)
+        {
+            NSNumber *existing = [nodesByName objectForKey:name];
+            if (existing != nil)
+            {
+                NSString *reason = [NSString stringWithFormat:@"Duplicate operation name \"%@\": operations [%@, %@]", name, operation, operations[existing.unsignedIntegerValue]];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDuplicateNames userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            [nodesByName setObject:@(i) forKey:name];
+        }
+    }
+    
+    // Process dependencies, first kind of edges.
+    // Dependencies are resolved to node indexes and sorted, which groups them by source for the adjacency arrays,
+    // and makes duplicates adjacent and reverse dependencies cheap to look up.
+    if (error == nil)
+    {
+        for (NSUInteger i = 0; i < dependencyCount; i++)
+        {
+            WEDependencyDescription *dependency = dependencies[i];
+            WEGraphIndex from = _WEFindNode(nodesByOperation, nodesByName, dependency.sourceOperation, dependency.sourceOperationName);
+            WEGraphIndex to = _WEFindNode(nodesByOperation, nodesByName, dependency.targetOperation, dependency.targetOperationName);
+            
+            if (from == WEGraphNoIndex || to == WEGraphNoIndex || from == to)
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid dependency %@: from %@ to %@.", dependency, (from != WEGraphNoIndex) ? @"valid" : @"invalid", (to != WEGraphNoIndex) ? @"valid" : @"invalid"];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            resolvedDependencies[i].key = _WEDependencyKey(from, to);
+            resolvedDependencies[i].position = i;
+            resolvedDependencies[i].stream = [dependency isKindOfClass:[WEStreamDescription class]];
+            resolvedDependencies[i].quorum = [dependency isKindOfClass:[WEQuorumDescription class]];
+            
+            // Channels are made along with the graph, and refer to both of their operations.
+            if (resolvedDependencies[i].stream && (_WEIsLazyOperation(operations[from]) || _WEIsLazyOperation(operations[to])))
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid stream %@: operations added with factories cannot be connected with streams.", dependency];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            // A reduce operation combines results of sources that completed.
+            if (resolvedDependencies[i].stream && [operations[to] isKindOfClass:[WEReduceOperation class]])
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid stream %@: reduce operations cannot be targets of streams.", dependency];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            // ...and every one of its sources has to complete.
+            if (resolvedDependencies[i].quorum && [operations[to] isKindOfClass:[WEReduceOperation class]])
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid quorum %@: reduce operations cannot be targets of quorums.", dependency];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            resolvedDependencyCount++;
+        }
+    }
+    
+    // Dependencies added before an invalid one are checked as well: errors are reported in the order dependencies
+    // were added, so a deadlock among them is reported instead.
+    if (resolvedDependencyCount > 0)
+    {
+        qsort(resolvedDependencies, resolvedDependencyCount, sizeof(_WEResolvedDependency), _WECompareResolvedDependencies);
+        
+        // Duplicate dependencies are ignored, the first one added is kept. A stream is preferred to a plain dependency
+        // between the same operations, which it implies, and a plain dependency is preferred to a quorum, which it overrides.
+        for (NSUInteger i = 0; i < resolvedDependencyCount; i++)
+        {
+            if (uniqueDependencyCount == 0 || resolvedDependencies[uniqueDependencyCount - 1].key != resolvedDependencies[i].key)
+            {
+                resolvedDependencies[uniqueDependencyCount++] = resolvedDependencies[i];
+            }
+        }
+        
+        // A dependency whose reverse is defined as well is a deadlock, reported against the one added later.
+        NSUInteger deadlockPosition = NSNotFound;
+        for (NSUInteger i = 0; i < uniqueDependencyCount; i++)
+        {
+            uint64_t key = resolvedDependencies[i].key;
+            uint64_t reverseKey = _WEDependencyKey((WEGraphIndex)key, (WEGraphIndex)(key >> 32));
+            const _WEResolvedDependency *reverse = _WEFindResolvedDependency(resolvedDependencies, uniqueDependencyCount, reverseKey);
+            if (reverse != NULL)
+            {
+                deadlockPosition = MIN(deadlockPosition, MAX(resolvedDependencies[i].position, reverse->position));
+            }
+        }
+        if (deadlockPosition != NSNotFound)
+        {
+            NSString *reason = [NSString stringWithFormat:@"Dependency %@ will introduce a deadlock because reverse dependency is already defined.", dependencies[deadlockPosition]];
+            error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDependencyCycle userInfo:@{ NSLocalizedDescriptionKey: reason }];
+        }
+    }
+    
+    // Quorum connections to an operation make up its quorum, and have to agree on it.
+    NSMutableDictionary<NSNumber *, WEQuorumDescription *> *quorumsByTarget = nil;
+    if (error == nil)
+    {
+        NSCountedSet<NSNumber *> *quorumSources = [NSCountedSet new];
+        for (NSUInteger i = 0; i < uniqueDependencyCount; i++)
+        {
+            if (!resolvedDependencies[i].quorum) continue;
+            
+            NSNumber *target = @((WEGraphIndex)resolvedDependencies[i].key);
+            WEQuorumDescription *quorum = (WEQuorumDescription *)dependencies[resolvedDependencies[i].position];
+            WEQuorumDescription *first = quorumsByTarget[target];
+            if (first == nil)
+            {
+                if (quorumsByTarget == nil) quorumsByTarget = [NSMutableDictionary new];
+                quorumsByTarget[target] = quorum;
+            }
+            else if (first.quorum != quorum.quorum || first.cancelsRemainingSources != quorum.cancelsRemainingSources)
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid quorum %@: it does not agree with quorum %@ to the same operation.", quorum, first];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            [quorumSources addObject:target];
+        }
+        
+        for (NSNumber *target in quorumsByTarget)
+        {
+            if (error != nil) break;
+            WEQuorumDescription *quorum = quorumsByTarget[target];
+            if (quorum.quorum > [quorumSources countForObject:target])
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid quorum %@: quorum of %lu is larger than the number of sources.", quorum, (unsigned long)quorum.quorum];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+            }
+        }
+    }
+    
+    // Process segues, second kind of edges
+    if (error == nil)
+    {
+        for (NSUInteger i = 0; i < segueCount; i++)
+        {
+            WESegueDescription *segue = segues[i];
+            WEGraphIndex from = _WEFindNode(nodesByOperation, nodesByName, segue.sourceOperation, segue.sourceOperationName);
+            WEGraphIndex to = _WEFindNode(nodesByOperation, nodesByName, segue.targetOperation, segue.targetOperationName);
+            
+            if (from == WEGraphNoIndex || to == WEGraphNoIndex || from == to)
+            {
+                NSString *reason = [NSString stringWithFormat:@"Invalid segue %@: from %@ to %@.", segue, (from != WEGraphNoIndex) ? @"valid" : @"invalid", (to != WEGraphNoIndex) ? @"valid" : @"invalid"];
+                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+                break;
+            }
+            segueEnds[2 * i] = from;
+            segueEnds[2 * i + 1] = to;
+        }
+    }
+    
+    WEWorkflowGraph *graph = NULL;
+    NSMutableArray<WEOperation *> *graphOperations = nil;
+    if (error == nil)
+    {
+        graph = WEWorkflowGraphCreate((WEGraphIndex)operationCount, (WEGraphIndex)uniqueDependencyCount, (WEGraphIndex)segueCount);
+        graphOperations = [operations mutableCopy];
+        _hasRateLimitersInternal = NO;
+        _hasTerminalOperationsInternal = NO;
+        _graphRaceGroups = nil;
+        _graphQuorumResults = nil;
+        _graphQuorumSources = nil;
+        for (NSUInteger i = 0; i < operationCount; i++)
+        {
+            WEOperation *operation = operations[i];
+            if (_WEIsLazyOperation(operation))
+            {
+                // Created by an earlier run, or created once the node becomes ready.
+                operation = ((_WELazyOperation *)operation)->_operation;
+                if (operation != nil) graphOperations[i] = operation;
+            }
+            graph->operations[i] = operation;
+            if (operation.rateLimiter != nil) _hasRateLimitersInternal = YES;
+            if (operation.terminal) _hasTerminalOperationsInternal = YES;
+            if (operation.raceGroup != nil) [self _addNode:(WEGraphIndex)i toRaceGroup:operation.raceGroup];
+        }
+        if (barrierTargets != NULL)
+        {
+            for (NSUInteger i = 0; i < operationCount; i++)
+            {
+                WEGraphIndex barrierTarget = barrierTargets[i];
+                graph->barrierTargets[i] = barrierTarget;
+                if (barrierTarget != WEGraphNoIndex) graph->barrierCounts[barrierTarget]++;
+            }
+        }
+        
+        // Dependencies are sorted by source, so offsets are a prefix sum of out-degrees.
+        for (NSUInteger i = 0; i < uniqueDependencyCount; i++)
+        {
+            uint64_t key = resolvedDependencies[i].key;
+            WEGraphIndex from = (WEGraphIndex)(key >> 32);
+            WEGraphIndex to = (WEGraphIndex)key;
+            graph->dependentOffsets[from + 1]++;
+            graph->dependents[i] = to;
+            
+            if (resolvedDependencies[i].quorum)
+            {
+                graph->dependencyQuorum[i] = 1;
+                graph->quorumSourceCounts[to]++;
+                if (quorumsByTarget[@(to)].cancelsRemainingSources) [self _addNode:from toQuorumSourcesOfNode:to];
+                continue;
+            }
+            graph->dependsOnCounts[to]++;
+            
+            if (resolvedDependencies[i].stream)
+            {
+                if (channels == nil) channels = [NSMutableArray new];
+                WEStreamDescription *stream = (WEStreamDescription *)dependencies[resolvedDependencies[i].position];
+                WEStreamChannel *channel = [self _makeChannelOfStream:stream edge:(WEGraphIndex)i from:from to:to operations:operations];
+                graph->dependencyChannels[i] = channel;
+                [channels addObject:channel];
+            }
+        }
+        for (NSUInteger i = 0; i < operationCount; i++)
+        {
+            graph->dependentOffsets[i + 1] += graph->dependentOffsets[i];
+        }
+        for (NSNumber *target in quorumsByTarget)
+        {
+            graph->quorumCounts[target.unsignedIntValue] = (WEGraphIndex)quorumsByTarget[target].quorum;
+            if (_graphQuorumResults == nil) _graphQuorumResults = [NSMutableDictionary new];
+            _graphQuorumResults[target] = [NSMutableArray new];
+        }
+        
+        // Segues keep the order they were added in, so they are placed with a stable counting sort by source.
+        for (NSUInteger i = 0; i < segueCount; i++)
+        {
+            graph->segueOffsets[segueEnds[2 * i] + 1]++;
+            graph->incomingSegueCounts[segueEnds[2 * i + 1]]++;
+        }
+        for (NSUInteger i = 0; i < operationCount; i++)
+        {
+            graph->segueOffsets[i + 1] += graph->segueOffsets[i];
+        }
+        // The ready queue is not used yet, borrow it as the per-source insertion cursor.
+        memcpy(graph->readyQueue, graph->segueOffsets, operationCount * sizeof(WEGraphIndex));
+        for (NSUInteger i = 0; i < segueCount; i++)
+        {
+            WEGraphIndex slot = graph->readyQueue[segueEnds[2 * i]]++;
+            graph->segueTargets[slot] = segueEnds[2 * i + 1];
+            graph->segueConditions[slot] = segues[i].condition;
+            graph->segueLikely[slot] = segues[i].likely;
+        }
+        
+        // Operations without incoming edges of any kind are ready to start.
+        for (NSUInteger i = 0; i < operationCount; i++)
+        {
+            if (graph->dependsOnCounts[i] == 0 && graph->quorumCounts[i] == 0 && graph->incomingSegueCounts[i] == 0 && graph->barrierCounts[i] == 0)
+            {
+                WEWorkflowGraphEnqueueReady(graph, (WEGraphIndex)i, WEGraphNoIndex, _runStartTimeInternal);
+            }
+        }
+        
+        if (WEWorkflowGraphReadyCount(graph) == 0)
+        {
+            // No independent operations means that each operation depends on at least another one, and nothing can start.
+            NSString *reason = @"Every operation in the workflow depends on at least one other operation. No operations are ready to start.";
+            error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDependencyCycle userInfo:@{ NSLocalizedDescriptionKey: reason }];
+            WEWorkflowGraphDestroy(graph);
+            graph = NULL;
+        }
+    }
+    
+    free(segueEnds);
+    free(resolvedDependencies);
+    CFRelease(nodesByOperation);
+    
+    if (error == nil)
+    {
+        // TODO: Perform a more complex check for cycles
+        _graph = graph;
+        _graphOperations = graphOperations;
+        _instantiatedReadyTail = 0;
+        _graphSegues = segues;
+        _graphChannels = channels;
+    }
+    
+    return error;
+}
+
+- (WEStreamChannel *)_makeChannelOfStream:(WEStreamDescription *)stream
+                                     edge:(WEGraphIndex)edge
+                                     from:(WEGraphIndex)from
+                                       to:(WEGraphIndex)to
+                               operations:(NSArray<WEOperation *> *)operations
+{
+    // The context keeps channels after the run, and must not keep the workflow that owns it.
+    __weak WEWorkflow *weakSelf = self;
+    dispatch_queue_t queue = _workflowInternalQueue;
+    return [[WEStreamChannel alloc] _initWithSourceOperation:operations[from] targetOperation:operations[to] capacity:stream.capacity firstChunkHandler:^{
+        dispatch_async(queue, ^{
+            [weakSelf _didSendFirstChunkOnEdge:edge from:from];
+        });
+    }];
+}
+
+// Main thread work is coalesced so that a burst of ready operations only takes one main queue turn.
+// Other operations run on their own executor if they have one, or on the workflow's.
+static inline id<WEOperationExecutor> _WEExecutorForOperation(__unsafe_unretained WEWorkflow *workflow, __unsafe_unretained WEOperation *operation)
+{
+    if (operation.requiresMainThread) return workflow->_mainThreadExecutor;
+    return operation.operationExecutor ?: workflow->_operationExecutorInternal;
+}
+
+// Workers are only recorded and preferred for operations on the workflow's executor, indexes of one executor
+// mean nothing to another.
+static inline BOOL _WEUsesWorkersOfWorkflow(__unsafe_unretained WEWorkflow *workflow, __unsafe_unretained id<WEOperationExecutor> executor)
+{
+    return workflow->_operationExecutorHasWorkersInternal && executor == workflow->_operationExecutorInternal;
+}
+
+- (void)_dispatchBlock:(dispatch_block_t)block forNode:(WEGraphIndex)node
+{
+    id<WEOperationExecutor> executor = _WEExecutorForOperation(self, _graph->operations[node]);
+    WEGraphIndex preferredWorker = _graph->preferredWorkers[node];
+    if (preferredWorker != WEGraphNoIndex && _WEUsesWorkersOfWorkflow(self, executor))
+    {
+        [executor executeBlock:block preferredWorker:preferredWorker];
+    }
+    else
+    {
+        [executor executeBlock:block];
+    }
+}
+
+- (void)_checkAndStartReadyOperation
+{
+    // If the workflow has failed already, do nothing. The ivar is safe to access on the private queue.
+    if (_isFailedInternal) return;
+    
+    // There may not be any operations ready to execute - all operations that are not running are waiting,
+    // or there are just running operations that are left.
+    if (WEWorkflowGraphReadyCount(_graph) == 0)
+    {
+        // If there are no operations ready and no operations active, either workflow is complete,
+        // or it had gotten to a buggy state when it is not doing anything and cannot proceed.
+        WEAssert(_graph->activeCount > 0);
+        return;
+    }
+    
+    // Operations added with factories are created as soon as their nodes become ready.
+    if (_instantiatedReadyTail < _graph->readyTail)
+    {
+        NSError *error = [self _instantiateReadyOperations];
+        if (error != nil)
+        {
+            [self _completeWorkflowWithError:error];
+            return;
+        }
+    }
+    
+    // Targets of streams whose sources are still sending start regardless of the limits.
+    if (_graphChannels != nil)
+    {
+        [self _startReadyTargetsOfOpenStreams];
+        if (WEWorkflowGraphReadyCount(_graph) == 0) return;
+    }
+    
+    // Only proceed if had not reached maximum number of operations allowed.
+    if (_graph->activeCount >= [self _concurrencyLimit]) return;
+    
+    // On a shared executor, every operation must be admitted by the executor before it starts.
+    // Request a slot for each ready operation that fits into the workflow's own limit, and start operations
+    // as slots are granted.
+    if (_executor != nil)
+    {
+        [self _requestExecutorSlots];
+        return;
+    }
+    
+    // Operations held back by their rate limiters stay ready until the throttle timer fires.
+    if (![self _startFirstReadyOperation]) return;
+    
+    // Start operations until reached the maximum concurrent count.
+    if (WEWorkflowGraphReadyCount(_graph) > 0)
+    {
+        [self _checkAndStartReadyOperation];
+    }
+}
+
+// Maximum number of operations the workflow may run at once, as adapted by the concurrency controller.
+- (NSUInteger)_concurrencyLimit
+{
+    if (_concurrencyControllerInternal == nil) return _maximumConcurrentOperations;
+    return MIN(_maximumConcurrentOperations, _concurrencyControllerInternal.limit);
+}
+
+- (void)_requestExecutorSlots
+{
+    double weight = self.executorWeight;
+    dispatch_queue_t queue = _workflowInternalQueue;
+    NSUInteger limit = [self _concurrencyLimit];
+    while (_requestedExecutorSlots < WEWorkflowGraphReadyCount(_graph)
+           && _graph->activeCount + _requestedExecutorSlots < limit)
+    {
+        _requestedExecutorSlots++;
+        [_executor _requestSlotForFlow:self weight:weight queue:queue grant:^{
+            [self _didReceiveExecutorSlot];
+        }];
+    }
+}
+
+- (void)_didReceiveExecutorSlot
+{
+    WEAssert(_requestedExecutorSlots > 0);
+    _requestedExecutorSlots--;
+    
+    // Ready operations may have been started by other slots, or the workflow may have failed or completed
+    // while the request was waiting. Return the slot so that other workflows can use it.
+    if (_isFailedInternal || WEWorkflowGraphReadyCount(_graph) == 0 || _graph->activeCount >= [self _concurrencyLimit])
+    {
+        [_executor _releaseSlot];
+        return;
+    }
+    
+    if (![self _startFirstReadyOperation]) [_executor _releaseSlot];
+}
+
+// Returns NO if no ready operation can start because all of them are held back by their rate limiters.
+- (BOOL)_startFirstReadyOperation
+{
+    WEAssert(WEWorkflowGraphReadyCount(_graph) > 0);
+    if (_hasRateLimitersInternal && ![self _moveFirstUnthrottledNodeToFront]) return NO;
+    
+    [self _startReadyNodeAtFront];
+    return YES;
+}
+
+// A source of a stream waits in `sendChunk:` for its target to make room, and keeps its place under the workflow's
+// limit and its executor slot meanwhile. Targets of sources that are still sending start right away, beyond the limit,
+// without waiting for a slot and not held back by their rate limiters: otherwise sources could take up all the places
+// their targets wait for, and the run would never complete.
+- (void)_startReadyTargetsOfOpenStreams
+{
+    WEWorkflowGraph *graph = _graph;
+    for (WEGraphIndex position = graph->readyHead; position < graph->readyTail; position++)
+    {
+        BOOL open = NO;
+        for (WEStreamChannel *channel in [_context inputStreamsOfOperation:graph->operations[graph->readyQueue[position]]])
+        {
+            if (!channel.closed)
+            {
+                open = YES;
+                break;
+            }
+        }
+        if (!open) continue;
+        
+        // The nodes before it move back by one, so the next position is the next node to look at.
+        WEWorkflowGraphMoveReadyToFront(graph, position);
+        [_executor _takeSlot];
+        [self _startReadyNodeAtFront];
+    }
+}
+
+- (void)_startReadyNodeAtFront
+{
+    WEGraphIndex node = WEWorkflowGraphDequeueReady(_graph);
+    
+    if (_incrementalStates != nil)
+    {
+        WEOperationResult *result = [self _reusableResultOfNode:node];
+        if (result != nil)
+        {
+            [self _reuseResult:result ofNode:node];
+            return;
+        }
+    }
+    
+    // An operation is never prepared while its prefetch is still in progress, it is prepared once the prefetch finishes.
+    if (_graph->prefetchStates[node] == WEGraphPrefetchInFlight)
+    {
+        _graph->prefetchStates[node] = WEGraphPrefetchInFlightAwaited;
+        return;
+    }
+    
+    [self _prepareNode:node];
+}
+
+
+#pragma mark - Lazy operations
+
+// Creates operations of nodes that became ready since the last call, if they were added with factories.
+// Nodes are only reordered within the ready queue once all of them have their operations.
+- (NSError *)_instantiateReadyOperations
+{
+    WEWorkflowGraph *graph = _graph;
+    for (; _instantiatedReadyTail < graph->readyTail; _instantiatedReadyTail++)
+    {
+        WEGraphIndex node = graph->readyQueue[_instantiatedReadyTail];
+        if (graph->operations[node] != nil) continue;
+        
+        NSError *error = [self _instantiateOperationOfNode:node];
+        if (error != nil) return error;
+    }
+    return nil;
+}
+
+- (NSError *)_instantiateOperationOfNode:(WEGraphIndex)node
+{
+    _WELazyOperation *lazyOperation = (_WELazyOperation *)_graphOperations[node];
+    WEAssert(_WEIsLazyOperation(lazyOperation) && lazyOperation->_operation == nil);
+    
+    NSString *name = lazyOperation->_name;
+    WEOperation *operation = lazyOperation->_factory(name);
+    NSString *reason = nil;
+    if (operation == nil || ![operation.name isEqualToString:name])
+    {
+        reason = [NSString stringWithFormat:@"Factory of operation \"%@\" did not create an operation with that name.", name];
+    }
+    else if ([operation isKindOfClass:[WESubworkflowOperation class]])
+    {
+        reason = [NSString stringWithFormat:@"Factory of operation \"%@\" created a sub-workflow, which cannot be added with a factory.", name];
+    }
+    else if ([operation isKindOfClass:[WEReduceOperation class]])
+    {
+        reason = [NSString stringWithFormat:@"Factory of operation \"%@\" created a reduce operation, which cannot be added with a factory.", name];
+    }
+    else if (_incrementalStates != nil && (operation.terminal || operation.raceGroup != nil))
+    {
+        reason = [NSString stringWithFormat:@"Factory of operation \"%@\" created a terminal or racing operation, which cannot be used with incremental execution.", name];
+    }
+    
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    if (reason == nil && [_operationSet containsObject:operation])
+    {
+        reason = [NSString stringWithFormat:@"Factory of operation \"%@\" created an operation that already belongs to the workflow.", name];
+    }
+    if (reason == nil)
+    {
+        // Created operations belong to the workflow like the ones added directly, e.g. they can be invalidated.
+        lazyOperation->_operation = operation;
+        lazyOperation->_factory = nil;
+        [_operationSet addObject:operation];
+    }
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (reason != nil)
+    {
+        return [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDefinition userInfo:@{ NSLocalizedDescriptionKey: reason }];
+    }
+    
+    _graphOperations[node] = operation;
+    _graph->operations[node] = operation;
+    if (operation.rateLimiter != nil) _hasRateLimitersInternal = YES;
+    if (operation.terminal) _hasTerminalOperationsInternal = YES;
+    if (operation.raceGroup != nil) [self _addNode:node toRaceGroup:operation.raceGroup];
+    return nil;
+}
+
+
+#pragma mark - Rate limiting
+
+// Finds the first ready node whose rate limiter, if any, has a token for it, and moves it to the front of the ready queue
+// keeping the order of the others. If there is none, arms the throttle timer for the earliest token that is due.
+- (BOOL)_moveFirstUnthrottledNodeToFront
+{
+    WEWorkflowGraph *graph = _graph;
+    uint64_t now = WEMonotonicTime();
+    uint64_t delay = UINT64_MAX;
+    for (WEGraphIndex position = graph->readyHead; position < graph->readyTail; position++)
+    {
+        WEGraphIndex node = graph->readyQueue[position];
+        WERateLimiter *rateLimiter = graph->operations[node].rateLimiter;
+        uint64_t nodeDelay = (rateLimiter != nil) ? [rateLimiter _takeTokenAtTime:now] : 0;
+        if (nodeDelay == 0)
+        {
+            WEWorkflowGraphMoveReadyToFront(graph, position);
+            return YES;
+        }
+        delay = MIN(delay, nodeDelay);
+    }
+    
+    [self _armThrottleTimerAt:now + delay];
+    return NO;
+}
+
+- (void)_armThrottleTimerAt:(uint64_t)deadline
+{
+    // An armed timer that fires earlier retries anyway.
+    if (_throttleDeadline != 0 && _throttleDeadline <= deadline) return;
+    
+    if (_throttleTimer == nil)
+    {
+        __weak WEWorkflow *weakSelf = self;
+        _throttleTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _workflowInternalQueue);
+        dispatch_source_set_event_handler(_throttleTimer, ^{
+            [weakSelf _throttleTimerDidFire];
+        });
+        dispatch_resume(_throttleTimer);
+    }
+    
+    _throttleDeadline = deadline;
+    uint64_t delay = deadline - MIN(deadline, WEMonotonicTime());
+    dispatch_source_set_timer(_throttleTimer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)delay), DISPATCH_TIME_FOREVER, 0);
+}
+
+- (void)_throttleTimerDidFire
+{
+    _throttleDeadline = 0;
+    dispatch_source_set_timer(_throttleTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    
+    // The run may have completed or failed since the timer was armed.
+    if (_graph == NULL || _isFailedInternal || WEWorkflowGraphReadyCount(_graph) == 0) return;
+    [self _checkAndStartReadyOperation];
+}
+
+static inline WEWorkflowContext *_WEContextForNode(__unsafe_unretained WEWorkflow *workflow, WEGraphIndex node)
+{
+    return (workflow->_graphContexts != nil) ? workflow->_graphContexts[node] : workflow->_context;
+}
+
+- (void)_prepareNode:(WEGraphIndex)node
+{
+    WEOperation *operation = _graph->operations[node];
+    WEWorkflowContext *context = _WEContextForNode(self, node);
+    if (_incrementalStates != nil)
+    {
+        // The operation may have run before. Values it reads are captured now, a value changed after that
+        // only makes the next run perform the operation again.
+        [operation _resetForRerun];
+        [_runInputs setObject:_WEInputsOfOperation(context, operation) forKey:operation];
+    }
+    // An operation cancelled from outside of the workflow is prepared as usual, and completes with its cancellation
+    // instead of starting.
+    WEAssert(!operation.active && !operation.finished);
+    if (_graph->quorumCounts[node] > 0) [_context _setQuorumResults:_graphQuorumResults[@(node)] ofOperation:operation];
+    
+    [self _dispatchBlock:^{
+        // TODO: pass explicit builder as the only facility an operation can amend the workflow.
+        [operation prepareForExecutionWithContext:context];
+        dispatch_async(self->_workflowInternalQueue, ^{
+            [self _runOperationIfStillPossible:node];
+        });
+    } forNode:node];
+}
+
+- (void)_runOperationIfStillPossible:(WEGraphIndex)node
+{
+    // If the workflow has failed already, or the operation was cancelled while it was being prepared, do nothing.
+    // The ivars are safe to access on the private queue.
+    if (_isFailedInternal || _graph == NULL || _graph->statuses[node] == WEGraphNodeSkipped)
+    {
+        [_executor _releaseSlot];
+        return;
+    }
+    
+    WEAssert(node < _graph->nodeCount);
+    WEAssert(_graph->statuses[node] == WEGraphNodeActive);
+    
+    // TODO: if an operation cannot run after preparation, remove it from the list of active
+    
+    // clear the activated segue count (TODO: in the future may add a block to run when segue-activated operation starts)
+    _graph->activatedIncomingSegueCounts[node] = 0;
+    
+    if (_speculativePrefetchEnabledInternal)
+    {
+        [self _prefetchLikelyTargetsOfNode:node];
+    }
+    
+    // An operation identical to one in progress completes with its result instead of starting.
+    WEOperation *operation = _graph->operations[node];
+    NSString *flightKey = operation.deduplicationKey;
+    if (flightKey != nil && ![self _leadFlightOfNode:node key:flightKey]) return;
+    
+    // dispatch operation execution on the executor that it requested.
+    id<WEOperationExecutor> executor = _WEExecutorForOperation(self, operation);
+    id<WEOperationExecutor> workerExecutor = _WEUsesWorkersOfWorkflow(self, executor) ? executor : nil;
+    _WEFusedChain *chain = (_graph->fusedSuccessors[node] != WEGraphNoIndex) ? [self _fusedChainFromNode:node] : nil;
+    [self _dispatchBlock:^{
+        [self _performOperation:operation ofNode:node flightKey:flightKey workerExecutor:workerExecutor chain:chain step:0];
+    } forNode:node];
+}
+
+// Performs an operation on the current thread. If it is followed by a fused successor, the successor is prepared and
+// performed as soon as the operation completes: on the same thread if the operation completed synchronously, in a loop
+// rather than recursively, or otherwise on the executor, preferring the same worker.
+- (void)_performOperation:(WEOperation *)operation
+                   ofNode:(WEGraphIndex)node
+                flightKey:(NSString *)flightKey
+           workerExecutor:(id<WEOperationExecutor>)workerExecutor
+                    chain:(_WEFusedChain *)chain
+                     step:(NSUInteger)step
+{
+    for (;;)
+    {
+        // Remember the worker, so that the operations this one makes ready prefer the same worker.
+        NSUInteger workerIndex = (workerExecutor != nil) ? workerExecutor.currentWorkerIndex : NSNotFound;
+        // The graph may be gone by now if the workflow failed, so the start time travels with the completion.
+        uint64_t startTime = WEMonotonicTime();
+        NSUInteger nextStep = step + 1;
+        __block atomic_int phase;
+        atomic_init(&phase, _WEFusedStepRunning);
+        [operation _startWithCompletion:^(WEOperationResult * _Nullable result) {
+            if (flightKey != nil) [[WESingleFlight sharedSingleFlight] finishKey:flightKey withResult:result];
+            BOOL fused = chain != nil && nextStep < chain->_count && [self _willStartFusedSuccessorOfOperation:operation context:chain->_contexts[nextStep - 1] result:result];
+            [self _enqueueCompletionOfNode:node executedOnWorker:workerIndex startTime:startTime finishTime:WEMonotonicTime() withResult:result successorStarted:fused];
+            
+            if (fused && atomic_exchange(&phase, _WEFusedStepCompleted) == _WEFusedStepReturned)
+            {
+                [self _dispatchStep:nextStep ofChain:chain workerExecutor:workerExecutor preferredWorker:workerIndex];
+            }
+        } completionQueue:nil];
+        
+        if (atomic_exchange(&phase, _WEFusedStepReturned) != _WEFusedStepCompleted) return;
+        
+        step = nextStep;
+        node = chain->_nodes[step];
+        operation = chain->_operations[step];
+        flightKey = nil;
+        [operation prepareForExecutionWithContext:chain->_contexts[step]];
+    }
+}
+
+// Feeds an operation that has been performed to the concurrency controllers of the workflow and of the executor.
+- (void)_recordOperationStartedAt:(uint64_t)startTime finishedAt:(uint64_t)finishTime withResult:(WEOperationResult *)result
+{
+    if (_concurrencyControllerInternal == nil && _executor == nil) return;
+    
+    NSTimeInterval latency = (double)(finishTime - startTime) / NSEC_PER_SEC;
+    BOOL failed = (result == nil || result.failed);
+    [_concurrencyControllerInternal recordOperationWithLatency:latency failed:failed];
+    [_executor _recordOperationWithLatency:latency failed:failed];
+}
+
+// Returns YES if the node leads the flight of its deduplication key and has to be started. Otherwise the node
+// completes with the result of the flight it joined.
+- (BOOL)_leadFlightOfNode:(WEGraphIndex)node key:(NSString *)key
+{
+    uint64_t startTime = WEMonotonicTime();
+    WEOperation *operation = _graph->operations[node];
+    BOOL leads = [[WESingleFlight sharedSingleFlight] joinKey:key handler:^(WEOperationResult * _Nullable result) {
+        [operation _completeWithJoinedResult:result];
+        [self _enqueueCompletionOfNode:node executedOnWorker:NSNotFound startTime:startTime finishTime:0 withResult:result];
+    }];
+    
+    if (!leads)
+    {
+        ENTER_CRITICAL_SECTION(self, _operationMutex)
+        _deduplicatedOperationCount++;
+        LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    }
+    return leads;
+}
+
+
+#pragma mark - Chain fusion
+
+// Fuses links of linear chains: a node with a single dependent and no segues, followed by a dependent that depends on
+// nothing else. Such a dependent always becomes ready when the node completes, so it is prepared and started right away
+// on the thread that completed the node, and only the bookkeeping goes through the internal queue.
+// Both operations must run on the same executor, off the main thread, and the dependent must not be held back
+// by a rate limiter or deduplicated, which are decided by the scheduler.
+- (void)_fuseLinearChains
+{
+    WEWorkflowGraph *graph = _graph;
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
+    {
+        WEGraphIndex edge = graph->dependentOffsets[node];
+        if (graph->dependentOffsets[node + 1] != edge + 1 || graph->segueOffsets[node + 1] != graph->segueOffsets[node]) continue;
+        
+        // A stream target may start before its source completes. A node must not complete its sub-workflow, which
+        // would make the sub-workflow ready along with the successor.
+        WEGraphIndex successor = graph->dependents[edge];
+        if (graph->dependsOnCounts[successor] != 1 || graph->incomingSegueCounts[successor] != 0
+            || graph->dependencyChannels[edge] != nil || graph->quorumCounts[successor] != 0
+            || graph->barrierCounts[successor] != 0 || graph->barrierTargets[successor] != graph->barrierTargets[node])
+        {
+            continue;
+        }
+        
+        // Operations added with factories that have not been created yet are left to the scheduler.
+        WEOperation *operation = graph->operations[node];
+        WEOperation *successorOperation = graph->operations[successor];
+        if (operation == nil || successorOperation == nil
+            || [operation isKindOfClass:[WESubworkflowOperation class]] || [successorOperation isKindOfClass:[WESubworkflowOperation class]])
+        {
+            continue;
+        }
+        
+        if (!operation.requiresMainThread && !successorOperation.requiresMainThread
+            && operation.operationExecutor == successorOperation.operationExecutor
+            && successorOperation.rateLimiter == nil && successorOperation.deduplicationKey == nil)
+        {
+            graph->fusedSuccessors[node] = successor;
+        }
+    }
+}
+
+- (_WEFusedChain *)_fusedChainFromNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    NSUInteger count = 1;
+    for (WEGraphIndex next = graph->fusedSuccessors[node]; next != WEGraphNoIndex; next = graph->fusedSuccessors[next])
+    {
+        count++;
+    }
+    
+    _WEFusedChain *chain = [_WEFusedChain new];
+    chain->_nodes = malloc(count * sizeof(WEGraphIndex));
+    if (chain->_nodes == NULL) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate a fused chain" });
+    chain->_count = count;
+    
+    NSMutableArray<WEOperation *> *operations = [[NSMutableArray alloc] initWithCapacity:count];
+    NSMutableArray<WEWorkflowContext *> *contexts = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++, node = graph->fusedSuccessors[node])
+    {
+        chain->_nodes[i] = node;
+        [operations addObject:graph->operations[node]];
+        [contexts addObject:_WEContextForNode(self, node)];
+    }
+    chain->_operations = operations;
+    chain->_contexts = contexts;
+    return chain;
+}
+
+// Called on the thread that completed a fused operation. Its result is made visible to the successor before the completion
+// is processed, unless the workflow has failed, in which case the successor is left to the scheduler.
+- (BOOL)_willStartFusedSuccessorOfOperation:(WEOperation *)operation context:(WEWorkflowContext *)context result:(WEOperationResult *)result
+{
+    if (result == nil || !self.active) return NO;
+    
+    NSString *operationName = operation.name;
+    if (operationName != nil) [context _setOperationResult:result forOperationName:operationName];
+    return YES;
+}
+
+// Performs a fused successor of an operation that completed after its start had returned, on whatever thread.
+- (void)_dispatchStep:(NSUInteger)step
+              ofChain:(_WEFusedChain *)chain
+       workerExecutor:(id<WEOperationExecutor>)workerExecutor
+      preferredWorker:(NSUInteger)workerIndex
+{
+    WEOperation *operation = chain->_operations[step];
+    dispatch_block_t block = ^{
+        [operation prepareForExecutionWithContext:chain->_contexts[step]];
+        [self _performOperation:operation ofNode:chain->_nodes[step] flightKey:nil workerExecutor:workerExecutor chain:chain step:step];
+    };
+    
+    if (workerExecutor != nil && workerIndex != NSNotFound)
+    {
+        [workerExecutor executeBlock:block preferredWorker:workerIndex];
+    }
+    else
+    {
+        [_WEExecutorForOperation(self, operation) executeBlock:block];
+    }
+}
+
+// Bookkeeping of a fused successor that was started when its predecessor completed. Completion of the predecessor has just
+// made it ready, and it becomes active in its place.
+- (void)_didStartFusedSuccessorOfNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    WEGraphIndex successor = graph->fusedSuccessors[node];
+    WEAssert(graph->readyTail > graph->readyHead && graph->readyQueue[graph->readyTail - 1] == successor);
+    WEWorkflowGraphMoveReadyToFront(graph, graph->readyTail - 1);
+    WEWorkflowGraphDequeueReady(graph);
+    
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _fusedOperationCount++;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (_speculativePrefetchEnabledInternal)
+    {
+        [self _prefetchLikelyTargetsOfNode:successor];
+    }
+}
+
+
+#pragma mark - Reduction
+
+// Sources of a reduce operation are the operations it depends on, in the order they were added, which is the order
+// of their nodes. Every reduce operation of the run is told how many sources it has before any of them completes.
+- (void)_beginReductions
+{
+    WEWorkflowGraph *graph = _graph;
+    WEGraphIndex *sourceCounts = NULL;
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
+    {
+        if ([graph->operations[node] isKindOfClass:[WEReduceOperation class]])
+        {
+            sourceCounts = calloc(graph->nodeCount, sizeof(WEGraphIndex));
+            if (sourceCounts == NULL) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate reduction sources" });
+            break;
+        }
+    }
+    if (sourceCounts == NULL) return;
+    
+    NSMutableData *slots = [NSMutableData dataWithLength:MAX(graph->dependencyCount, 1) * sizeof(WEGraphIndex)];
+    WEGraphIndex *slotBytes = slots.mutableBytes;
+    memset(slotBytes, 0xFF, slots.length);
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
+    {
+        for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+        {
+            WEGraphIndex target = graph->dependents[edge];
+            if ([graph->operations[target] isKindOfClass:[WEReduceOperation class]]) slotBytes[edge] = sourceCounts[target]++;
+        }
+    }
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
+    {
+        WEOperation *operation = graph->operations[node];
+        if (![operation isKindOfClass:[WEReduceOperation class]]) continue;
+        [(WEReduceOperation *)operation _beginReductionWithSourceCount:sourceCounts[node] executor:_WEExecutorForOperation(self, operation)];
+    }
+    free(sourceCounts);
+    _graphReductionSlots = slots;
+}
+
+- (void)_addResult:(WEOperationResult *)result ofNodeToReductions:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    const WEGraphIndex *slots = _graphReductionSlots.bytes;
+    for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+    {
+        if (slots[edge] == WEGraphNoIndex) continue;
+        [(WEReduceOperation *)graph->operations[graph->dependents[edge]] _addResult:result ofSourceAtIndex:slots[edge]];
+    }
+}
+
+
+#pragma mark - Early termination
+
+- (void)_addNode:(WEGraphIndex)node toRaceGroup:(NSString *)raceGroup
+{
+    if (_graphRaceGroups == nil) _graphRaceGroups = [NSMutableDictionary new];
+    NSMutableArray<NSNumber *> *nodes = _graphRaceGroups[raceGroup];
+    if (nodes == nil)
+    {
+        nodes = [NSMutableArray new];
+        _graphRaceGroups[raceGroup] = nodes;
     }
-    else
+    [nodes addObject:@(node)];
+}
+
+// The first operation of a race group to complete successfully wins, and the others are cancelled.
+- (void)_cancelRivalsOfNode:(WEGraphIndex)node inRaceGroup:(NSString *)raceGroup
+{
+    NSArray<NSNumber *> *nodes = _graphRaceGroups[raceGroup];
+    if (nodes == nil) return;
+    [_graphRaceGroups removeObjectForKey:raceGroup];
+    
+    WEWorkflowGraph *graph = _graph;
+    for (NSNumber *rival in nodes)
     {
-        _isFailedInternal = NO;
-        NSError *error = [self _buildDependencyGraphWithOperations:operations dependencies:dependencies segues:segues];
-        if (error == nil)
+        WEGraphNodeStatus status = graph->statuses[rival.unsignedIntValue];
+        if (status == WEGraphNodePending || status == WEGraphNodeReady || status == WEGraphNodeActive)
         {
-            _totalCompletedOperations = 0;
-            _activeOperations = [[NSMutableSet alloc] initWithCapacity:_maximumConcurrentOperations];
-            [self _checkAndStartReadyOperation];
+            [self _cancelNode:rival.unsignedIntValue cause:node];
         }
-        else
+    }
+}
+
+// Cancels every node that has not completed yet, so that the run can complete right away. Sub-workflows precede
+// their operations, so they are skipped before their operations could make them ready.
+- (void)_cancelRemainingNodesAfterNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    for (WEGraphIndex other = 0; other < graph->nodeCount; other++)
+    {
+        WEGraphNodeStatus status = graph->statuses[other];
+        if (status == WEGraphNodePending || status == WEGraphNodeReady || status == WEGraphNodeActive)
         {
-            [self _completeWorkflowWithError:error];
+            [self _cancelNode:other cause:node];
         }
     }
 }
 
-static _WEOperationState *_FindOperationState(
-                                              NSMutableArray<_WEOperationState *> *operationStates,
-                                              NSMutableDictionary<NSString *, _WEOperationState *> *namedOperations,
-                                              WEOperation *operation,
-                                              NSString *operationName
-                                              )
+// Cancels the operation of a node and skips the node along with everything that follows it. An operation that was
+// started and stopped never completes, so its executor slot is returned right away. Operations that are being prepared
+// or have joined a flight return their slots when that is done, and so does an operation shared with other workflows,
+// which is not cancelled because the other workflows still need it.
+- (void)_cancelNode:(WEGraphIndex)node cause:(WEGraphIndex)cause
 {
-    _WEOperationState *state;
-    if (operation == nil)
+    WEWorkflowGraph *graph = _graph;
+    WEOperation *operation = graph->operations[node];
+    BOOL stopped = (operation != nil && operation.deduplicationKey == nil && [operation _cancel]);
+    
+    // An operation that waits for its prefetch holds an executor slot, but will never be prepared.
+    if (graph->prefetchStates[node] == WEGraphPrefetchInFlightAwaited)
     {
-        state = [namedOperations objectForKey:operationName];
+        graph->prefetchStates[node] = WEGraphPrefetchInFlight;
+        stopped = YES;
     }
-    else
+    if (stopped) [_executor _releaseSlot];
+    
+    // Targets of streams from the operation that have started already are not waiting for more chunks.
+    if (_graphChannels != nil && graph->statuses[node] == WEGraphNodeActive)
     {
-        for (_WEOperationState *otherState in operationStates)
+        for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
         {
-            if (otherState->_operation == operation)
-            {
-                state = otherState;
-                break;
-            }
+            [graph->dependencyChannels[edge] close];
         }
     }
-    return state;
+    
+    WEGraphIndex position = WEWorkflowGraphCancelNode(graph, node, cause, WEMonotonicTime());
+    if (position < _instantiatedReadyTail) _instantiatedReadyTail--;
 }
 
-static inline NSHashTable<_WEOperationState *> *_CreateDependencyHashTable()
+
+#pragma mark - Quorums
+
+- (void)_addNode:(WEGraphIndex)node toQuorumSourcesOfNode:(WEGraphIndex)target
 {
-    NSPointerFunctionsOptions options = NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality;
-    return [[NSHashTable alloc] initWithOptions:options capacity:1];
+    if (_graphQuorumSources == nil) _graphQuorumSources = [NSMutableDictionary new];
+    NSMutableArray<NSNumber *> *sources = _graphQuorumSources[@(target)];
+    if (sources == nil)
+    {
+        sources = [NSMutableArray new];
+        _graphQuorumSources[@(target)] = sources;
+    }
+    [sources addObject:@(node)];
 }
 
-- (NSError *)_buildDependencyGraphWithOperations:(NSArray<WEOperation *> *)operations dependencies:(NSArray<WEDependencyDescription *> *)dependencies segues:(NSArray<WESegueDescription *> *)segues
+// Called before the graph counts the result, so a target that is still short of its quorum takes it.
+- (void)_addResult:(WEOperationResult *)result ofNodeToQuorums:(WEGraphIndex)node
 {
-    NSError *error = nil;
-    NSMutableArray<_WEOperationState *> *operationStates = [[NSMutableArray alloc] initWithCapacity:operations.count];
-    NSMutableDictionary<NSString *, _WEOperationState *> *namedOperations = [NSMutableDictionary new];
-    NSString *name;
-    NSMutableOrderedSet<_WEOperationState *> *independentOperations;
-    
-    // Process operations, make vertices
-    for (WEOperation *operation in operations)
+    WEWorkflowGraph *graph = _graph;
+    for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
     {
-        _WEOperationState *state = [[_WEOperationState alloc] initWithOperation:operation];
-        [operationStates addObject:state];
-        
-        name = operation.name;
-        if (name != nil)
+        WEGraphIndex target = graph->dependents[edge];
+        if (graph->dependencyQuorum[edge] && graph->statuses[target] == WEGraphNodePending
+            && graph->succeededQuorumCounts[target] < graph->quorumCounts[target])
         {
-            if ([namedOperations objectForKey:name] != nil)
-            {
-                NSString *reason = [NSString stringWithFormat:@"Duplicate operation name \"%@\": operations [%@, %@]", name, operation, [namedOperations objectForKey:name]];
-                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDuplicateNames userInfo:@{ NSLocalizedDescriptionKey: reason }];
-                break;
-            }
-            [namedOperations setObject:state forKey:name];
+            [_graphQuorumResults[@(target)] addObject:result];
         }
     }
-    
-    // Process dependencies, first kind of nodes.
-    // See note next to ivar declaration describing dependency data structure.
-    if (error == nil)
+}
+
+// Once the quorum of a target is reached, its sources that have not completed are no longer needed.
+- (void)_cancelRemainingQuorumSourcesAfterNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
     {
-        _allOperationStates = [operationStates copy];
-        independentOperations = [[NSMutableOrderedSet alloc] initWithArray:operationStates];
+        WEGraphIndex target = graph->dependents[edge];
+        if (!graph->dependencyQuorum[edge] || graph->succeededQuorumCounts[target] < graph->quorumCounts[target]) continue;
+        
+        NSArray<NSNumber *> *sources = _graphQuorumSources[@(target)];
+        if (sources == nil) continue;
+        [_graphQuorumSources removeObjectForKey:@(target)];
         
-        for (WEDependencyDescription *dependency in dependencies)
+        for (NSNumber *source in sources)
         {
-            _WEOperationState *fromState = _FindOperationState(operationStates, namedOperations, dependency.sourceOperation, dependency.sourceOperationName);
-            _WEOperationState *toState = _FindOperationState(operationStates, namedOperations, dependency.targetOperation, dependency.targetOperationName);
-            
-            if (fromState == nil || toState == nil || fromState == toState)
-            {
-                NSString *reason = [NSString stringWithFormat:@"Invalid dependency %@: from %@ to %@.", dependency, fromState ? @"valid" : @"invalid", toState ? @"valid" : @"invalid"];
-                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
-                break;
-            }
-            
-            // Check if dependency is not a duplicate, if it is - ignore
-            if (![fromState->_dependents containsObject:toState])
+            WEGraphNodeStatus status = graph->statuses[source.unsignedIntValue];
+            if (status == WEGraphNodePending || status == WEGraphNodeReady || status == WEGraphNodeActive)
             {
-                if ([toState->_dependents containsObject:fromState])
-                {
-                    // Deadlock, create an error and stop
-                    NSString *reason = [NSString stringWithFormat:@"Dependency %@ will introduce a deadlock because reverse dependency is already defined.", dependency];
-                    error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDependencyCycle userInfo:@{ NSLocalizedDescriptionKey: reason }];
-                    break;
-                }
-                
-                if (fromState->_dependents == nil) fromState->_dependents = _CreateDependencyHashTable();
-                if (toState->_dependsOn == nil) toState->_dependsOn = _CreateDependencyHashTable();
-                
-                [toState->_dependsOn addObject:fromState];
-                [fromState->_dependents addObject:toState];
-                [independentOperations removeObject:toState];
+                [self _cancelNode:source.unsignedIntValue cause:node];
             }
         }
     }
+}
+
+
+#pragma mark - Speculative prefetch
+
+// Asks targets of likely segues of an operation that is about to start to prefetch, so that their setup
+// overlaps with the operation instead of following it.
+- (void)_prefetchLikelyTargetsOfNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    NSUInteger prefetchCount = 0;
+    for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+    {
+        if (!graph->segueLikely[edge]) continue;
+        
+        WEGraphIndex target = graph->segueTargets[edge];
+        WEGraphNodeStatus status = graph->statuses[target];
+        if ((status != WEGraphNodePending && status != WEGraphNodeReady) || graph->prefetchStates[target] != WEGraphPrefetchNone) continue;
+        
+        // An operation added with a factory that has not been created yet has nothing to prefetch with.
+        WEOperation *operation = graph->operations[target];
+        if (operation == nil) continue;
+        
+        graph->prefetchStates[target] = WEGraphPrefetchInFlight;
+        prefetchCount++;
+        
+        WEWorkflowContext *context = _WEContextForNode(self, target);
+        NSUInteger generation = _runGenerationInternal;
+        [self _dispatchBlock:^{
+            [operation prefetchWithContext:context];
+            dispatch_async(self->_workflowInternalQueue, ^{
+                [self _didPrefetchNode:target operation:operation generation:generation];
+            });
+        } forNode:target];
+    }
+    
+    if (prefetchCount > 0)
+    {
+        ENTER_CRITICAL_SECTION(self, _operationMutex)
+        _prefetchCount += prefetchCount;
+        LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    }
+}
+
+- (void)_didPrefetchNode:(WEGraphIndex)node operation:(WEOperation *)operation generation:(NSUInteger)generation
+{
+    // The run may have completed or failed while the prefetch was in progress, and the next run may have started since.
+    WEWorkflowGraph *graph = _graph;
+    if (graph == NULL || generation != _runGenerationInternal)
+    {
+        [self _discardPrefetchOfOperation:operation];
+        return;
+    }
+    
+    WEAssert(graph->operations[node] == operation);
+    WEGraphPrefetchState state = graph->prefetchStates[node];
+    graph->prefetchStates[node] = WEGraphPrefetchDone;
+    
+    // A node of an incremental run may have reused its kept result instead of running.
+    BOOL reused = _incrementalStates != nil && ((_WEIncrementalState *)_incrementalStates.mutableBytes)[node] == _WEIncrementalReused;
+    if (graph->statuses[node] == WEGraphNodeSkipped || reused)
+    {
+        [self _discardPrefetchOfOperation:operation];
+    }
+    else if (state == WEGraphPrefetchInFlightAwaited)
+    {
+        [self _prepareNode:node];
+    }
+}
+
+- (void)_discardPrefetchOfOperation:(WEOperation *)operation
+{
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _discardedPrefetchCount++;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    // The graph may be gone already, so the block is dispatched based on the operation alone.
+    [_WEExecutorForOperation(self, operation) executeBlock:^{
+        [operation discardPrefetch];
+    }];
+}
+
+// Discards completed prefetches of operations that will not run because the workflow failed.
+// Prefetches still in progress are discarded when they finish.
+- (void)_discardPrefetchesOnFailure
+{
+    WEWorkflowGraph *graph = _graph;
+    if (graph == NULL) return;
     
-    // Process segues, second kind of nodes
-    // See note next to ivar declaration describing segue data structure and how they are activated.
-    if (error == nil && segues.count > 0)
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
     {
-        _hasSeguesInternal = YES;
-        for (WESegueDescription *segue in segues)
+        WEGraphNodeStatus status = graph->statuses[node];
+        switch (graph->prefetchStates[node])
         {
-            _WEOperationState *fromState = _FindOperationState(operationStates, namedOperations, segue.sourceOperation, segue.sourceOperationName);
-            _WEOperationState *toState = _FindOperationState(operationStates, namedOperations, segue.targetOperation, segue.targetOperationName);
-            
-            if (fromState == nil || toState == nil || fromState == toState)
-            {
-                NSString *reason = [NSString stringWithFormat:@"Invalid segue %@: from %@ to %@.", segue, fromState ? @"valid" : @"invalid", toState ? @"valid" : @"invalid"];
-                error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDependency userInfo:@{ NSLocalizedDescriptionKey: reason }];
+            case WEGraphPrefetchInFlightAwaited:
+                // The operation was started and holds an executor slot, but will never be prepared.
+                [_executor _releaseSlot];
+                break;
+            case WEGraphPrefetchDone:
+                if (status == WEGraphNodePending || status == WEGraphNodeReady)
+                {
+                    [self _discardPrefetchOfOperation:graph->operations[node]];
+                }
+                break;
+            default:
                 break;
-            }
-            
-            if (!toState->_hasIncomingSegues)
-            {
-                toState->_activatedIncomingSegues = [NSMutableArray new];
-                toState->_hasIncomingSegues = YES;
-            }
-            if (fromState->_outgoingSegues == nil) fromState->_outgoingSegues = [NSMutableArray new];
-            _WEOutgoingSegue *outgoingSegue = [[_WEOutgoingSegue alloc] initWithSegue:segue targetState:toState];
-            [fromState->_outgoingSegues addObject:outgoingSegue];
-            
-            [independentOperations removeObject:toState];
         }
     }
+}
+
+
+#pragma mark - Incremental execution
+
+- (void)_prepareIncrementalRunWithInvalidatedOperations:(NSSet<WEOperation *> *)invalidatedOperations
+{
+    WEWorkflowGraph *graph = _graph;
+    if (_incrementalRecords == nil) _incrementalRecords = [NSMapTable strongToStrongObjectsMapTable];
+    _runRecords = [NSMapTable strongToStrongObjectsMapTable];
+    _runInputs = [NSMapTable strongToStrongObjectsMapTable];
+    _incrementalStates = [NSMutableData dataWithLength:graph->nodeCount * sizeof(_WEIncrementalState)];
     
-    if (error == nil)
+    // Operations of sub-workflows follow their sub-workflows, so invalidation of a sub-workflow reaches all of them
+    // in a single pass.
+    _WEIncrementalState *states = _incrementalStates.mutableBytes;
+    for (WEGraphIndex node = 0; node < graph->nodeCount; node++)
     {
-        if (independentOperations.count == 0)
-        {
-            // No independent operations means that each operation depends on at least another one, and nothing can start.
-            NSString *reason = @"Every operation in the workflow depends on at least one other operation. No operations are ready to start.";
-            error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDependencyCycle userInfo:@{ NSLocalizedDescriptionKey: reason }];
-        }
-        else
+        WEGraphIndex barrierTarget = graph->barrierTargets[node];
+        if ([invalidatedOperations containsObject:graph->operations[node]]
+            || (barrierTarget != WEGraphNoIndex && states[barrierTarget] == _WEIncrementalInvalid))
         {
-            // TODO: Perform a more complex check for cycles
-            _operationsReadyToExecute = independentOperations;
+            states[node] = _WEIncrementalInvalid;
         }
     }
     
-    return error;
+    // Results of the previous run that are not reused must not be seen by operations of this one.
+    [_context _removeAllOperationResults];
 }
 
-static inline dispatch_queue_t _WEQueueForOperation(__unsafe_unretained WEOperation *operation)
+// Returns the kept result of a node that became ready, if it can be reused.
+- (WEOperationResult *)_reusableResultOfNode:(WEGraphIndex)node
 {
-    if (operation.requiresMainThread) return dispatch_get_main_queue();
+    if (((_WEIncrementalState *)_incrementalStates.mutableBytes)[node] != _WEIncrementalValid) return nil;
+    
+    WEOperation *operation = _graph->operations[node];
+    _WEIncrementalRecord *record = [_incrementalRecords objectForKey:operation];
+    if (record == nil) return nil;
+    
+    // Chunks of a stream are not kept, so both ends of it run.
+    if (_graphChannels != nil && ([_context inputStreamsOfOperation:operation].count > 0 || [_context outputStreamsOfOperation:operation].count > 0))
+    {
+        return nil;
+    }
     
-    // TODO: make priority-based decision
-    return dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    return _WEObjectsAreEqual(_WEInputsOfOperation(_WEContextForNode(self, node), operation), record->_inputs) ? record->_result : nil;
 }
 
-- (void)_checkAndStartReadyOperation
+- (void)_reuseResult:(WEOperationResult *)result ofNode:(WEGraphIndex)node
 {
-    // If the workflow has failed already, do nothing. The ivar is safe to access on the private queue.
-    if (_isFailedInternal) return;
+    ((_WEIncrementalState *)_incrementalStates.mutableBytes)[node] = _WEIncrementalReused;
     
-    // There may not be any operations ready to execute - all operations that are not running are waiting,
-    // or there are just running operations that are left.
-    if (_operationsReadyToExecute.count == 0)
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _reusedOperationCount++;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    // Prefetches still in progress are discarded when they finish.
+    if (_graph->prefetchStates[node] == WEGraphPrefetchDone)
     {
-        // If there are no operations ready and no operations active, either workflow is complete,
-        // or it had gotten to a buggy state when it is not doing anything and cannot proceed.
-        WEAssert(_activeOperations.count > 0);
-        return;
+        [self _discardPrefetchOfOperation:_graph->operations[node]];
     }
     
-    // Only proceed if had not reached maximum number of operations allowed.
-    if (_maximumConcurrentOperations > 0 && _activeOperations.count >= _maximumConcurrentOperations) return;
-    
-    _WEOperationState *firstReadyOperation = _operationsReadyToExecute.firstObject;
-    [_operationsReadyToExecute removeObject:firstReadyOperation];
-    WEAssert(firstReadyOperation != nil);
+    // Completes asynchronously like an operation that ran, so that a long chain of reused operations does not recurse.
+    [self _enqueueCompletionOfNode:node executedOnWorker:NSNotFound startTime:WEMonotonicTime() finishTime:0 withResult:result];
+}
+
+// Keeps the result of a completed node for the next run. A node that ran and produced a different result than before
+// invalidates the nodes that follow it, a node that produced the same result leaves them valid.
+- (void)_recordResult:(WEOperationResult *)result ofNode:(WEGraphIndex)node
+{
+    WEWorkflowGraph *graph = _graph;
+    _WEIncrementalState *states = _incrementalStates.mutableBytes;
+    WEOperation *operation = graph->operations[node];
+    _WEIncrementalRecord *record = [_incrementalRecords objectForKey:operation];
     
-    WEOperation *operation = firstReadyOperation->_operation;
-    WEAssert(!operation.active && !operation.finished && !operation.cancelled);
+    if (states[node] != _WEIncrementalReused)
+    {
+        BOOL changed = record == nil || !_WEResultsAreEqual(result, record->_result);
+        record = [_WEIncrementalRecord new];
+        record->_result = result;
+        record->_inputs = [_runInputs objectForKey:operation] ?: @{};
+        
+        if (changed)
+        {
+            for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+            {
+                states[graph->dependents[edge]] = _WEIncrementalInvalid;
+            }
+            for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+            {
+                states[graph->segueTargets[edge]] = _WEIncrementalInvalid;
+            }
+            WEGraphIndex barrierTarget = graph->barrierTargets[node];
+            if (barrierTarget != WEGraphNoIndex) states[barrierTarget] = _WEIncrementalInvalid;
+        }
+    }
     
-    [_activeOperations addObject:firstReadyOperation];
+    [_runRecords setObject:record forKey:operation];
+}
+
+
+#pragma mark - Completion
+
+- (void)_reportSkippedNodesFrom:(WEGraphIndex)first
+{
+    WEWorkflowGraph *graph = _graph;
+    NSMutableArray<WEOperation *> *operations = [[NSMutableArray alloc] initWithCapacity:graph->skippedCount - first];
+    for (WEGraphIndex i = first; i < graph->skippedCount; i++)
+    {
+        WEGraphIndex node = graph->skippedNodes[i];
+        // An operation added with a factory may be skipped before it was ever created.
+        if (graph->operations[node] == nil) continue;
+        [operations addObject:graph->operations[node]];
+        if (_graphChannels != nil) [self _cancelInputStreamsOfNode:node];
+        
+        // Prefetches still in progress are discarded when they finish.
+        if (graph->prefetchStates[node] == WEGraphPrefetchDone)
+        {
+            [self _discardPrefetchOfOperation:graph->operations[node]];
+        }
+    }
+    if (operations.count == 0) return;
     
-    dispatch_queue_t operationQueue = _WEQueueForOperation(operation);
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    [_skippedOperations addObjectsFromArray:operations];
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
     
-    dispatch_async(operationQueue, ^{
-        // TODO: pass explicit builder as the only facility an operation can amend the workflow.
-        [operation prepareForExecutionWithContext:self->_context];
-        dispatch_async(self->_workflowInternalQueue, ^{
-            [self _runOperationIfStillPossible:firstReadyOperation onQueue:operationQueue];
+    id<WEWorkflowDelegate> delegate = _delegate;
+    if ([delegate respondsToSelector:@selector(workflow:didSkipOperations:)])
+    {
+        dispatch_async(_delegateQueue, ^{
+            [delegate workflow:self didSkipOperations:operations];
         });
-    });
+    }
+}
+
+// The first chunk of a stream fulfills the dependency, so the target can start while the source is still running.
+- (void)_didSendFirstChunkOnEdge:(WEGraphIndex)edge from:(WEGraphIndex)from
+{
+    // The run may have failed, or the source may have completed and fulfilled the dependency already.
+    WEWorkflowGraph *graph = _graph;
+    if (_isFailedInternal || graph == NULL || graph->dependencyFulfilled[edge]) return;
     
-    // Start operations until reached the maximum concurrent count.
-    if (_operationsReadyToExecute.count > 0)
+    WEGraphIndex target = graph->dependents[edge];
+    WEAssert(graph->completedDependsOnCounts[target] < graph->dependsOnCounts[target]);
+    graph->dependencyFulfilled[edge] = 1;
+    graph->completedDependsOnCounts[target]++;
+    if (WEWorkflowGraphNodeIsEligible(graph, target))
     {
+        WEWorkflowGraphEnqueueReady(graph, target, from, WEMonotonicTime());
         [self _checkAndStartReadyOperation];
     }
 }
 
-- (void)_runOperationIfStillPossible:(_WEOperationState *)operationState onQueue:(dispatch_queue_t)queue
+// Channels of streams into an operation that will not receive any more chunks are cancelled, so that their sources
+// do not wait for room that will never be made.
+- (void)_cancelInputStreamsOfNode:(WEGraphIndex)node
 {
-    // If the workflow has failed already, do nothing. The ivar is safe to access on the private queue.
-    if (_isFailedInternal) return;
-    
-    WEAssert(operationState != nil);
-    WEAssert([_activeOperations containsObject:operationState]);
-    
-    // TODO: if an operation cannot run after preparation, remove it from the list of active
-    
-    // clear the activated segue list (TODO: in the future may add a block to run when segue-activated operation starts)
-    [operationState->_activatedIncomingSegues removeAllObjects];
-    
-    // dispatch operation execution on a queue that it requested.
-    dispatch_async(queue, ^{
-        [operationState->_operation startWithCompletion:^(WEOperationResult * _Nullable result) {
-            [self _completeOperation:operationState withResult:result];
-        } completionQueue:self->_workflowInternalQueue];
-    });
+    for (WEStreamChannel *channel in [_context inputStreamsOfOperation:_graph->operations[node]])
+    {
+        [channel _cancel];
+    }
 }
 
-- (void)_completeOperation:(_WEOperationState *)operationState withResult:(WEOperationResult *)result
+// Called on any thread. Only a push that finds the stack empty wakes the internal queue up: any other push is
+// preceded by one that did, and the wakeup it caused has not taken the stack yet.
+- (void)_enqueueCompletionOfNode:(WEGraphIndex)node
+                executedOnWorker:(NSUInteger)workerIndex
+                       startTime:(uint64_t)startTime
+                      finishTime:(uint64_t)finishTime
+                      withResult:(WEOperationResult *)result
 {
-    // If the workflow has failed already, do nothing. The ivar is safe to access on the private queue.
-    if (_isFailedInternal) return;
+    [self _enqueueCompletionOfNode:node executedOnWorker:workerIndex startTime:startTime finishTime:finishTime withResult:result successorStarted:NO];
+}
 
-    WEAssert(operationState != nil);
-    _totalCompletedOperations++;
+- (void)_enqueueCompletionOfNode:(WEGraphIndex)node
+                executedOnWorker:(NSUInteger)workerIndex
+                       startTime:(uint64_t)startTime
+                      finishTime:(uint64_t)finishTime
+                      withResult:(WEOperationResult *)result
+                successorStarted:(BOOL)successorStarted
+{
+    _WECompletion *completion = malloc(sizeof(_WECompletion));
+    if (completion == NULL) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate a completion" });
+    completion->node = node;
+    completion->workerIndex = workerIndex;
+    completion->startTime = startTime;
+    completion->finishTime = finishTime;
+    completion->result = (void *)CFBridgingRetain(result);
+    completion->successorStarted = successorStarted;
     
-    WEAssert([_activeOperations containsObject:operationState]);
-
-    [_activeOperations removeObject:operationState];
-    NSString *operationName = operationState->_operation.name;
-    if (operationName != nil)
+    _WECompletion *head = atomic_load_explicit(&_pendingCompletions, memory_order_relaxed);
+    do
     {
-        [_context _setOperationResult:result forOperationName:operationName];
+        completion->next = head;
     }
+    while (!atomic_compare_exchange_weak_explicit(&_pendingCompletions, &head, completion, memory_order_release, memory_order_relaxed));
+    
+    if (head == NULL) dispatch_source_merge_data(_completionSource, 1);
+}
 
-    // check if any operations depending on the one just completed can now run
-    for (_WEOperationState *dependent in operationState->_dependents)
+// Processes all pending completions as a single batch. Nodes are completed in the order their completions arrived,
+// skipped operations are reported, and ready operations are started once for the whole batch.
+- (void)_processPendingCompletions
+{
+    _WECompletion *completion = atomic_exchange_explicit(&_pendingCompletions, NULL, memory_order_acquire);
+    if (completion == NULL) return;
+    
+    // The stack holds the latest completion first.
+    _WECompletion *ordered = NULL;
+    while (completion != NULL)
     {
-        NSUInteger completed = ++(dependent->_completedDependsOnOperations);
-        NSUInteger totalDependsOn = dependent->_dependsOn.count;
-        WEAssert(completed <= totalDependsOn);
-        if (completed == totalDependsOn && (!dependent->_hasIncomingSegues || dependent->_activatedIncomingSegues.count > 0))
-        {
-            [_operationsReadyToExecute addObject:dependent];
-        }
+        _WECompletion *next = completion->next;
+        completion->next = ordered;
+        ordered = completion;
+        completion = next;
     }
     
-    // activate outgoing segues
-    if (operationState->_outgoingSegues != nil)
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    _completionBatchCount++;
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    // Operations completed by the batch make their successors ready at the same time.
+    uint64_t now = WEMonotonicTime();
+    WEGraphIndex skippedCount = (_graph != NULL) ? _graph->skippedCount : 0;
+    NSMutableArray<WEOperation *> *completedOperations = (_operationCompletionObserverInternal != nil) ? [NSMutableArray new] : nil;
+    NSMutableArray<WEOperationResult *> *completedResults = (completedOperations != nil) ? [NSMutableArray new] : nil;
+    while (ordered != NULL)
     {
-        for (_WEOutgoingSegue *segue in operationState->_outgoingSegues)
+        _WECompletion *next = ordered->next;
+        WEOperationResult *result = CFBridgingRelease(ordered->result);
+        if (ordered->finishTime != 0)
         {
-            // evaluate the segue condition
-            WESegueDescription *segueDescription = segue->_segue;
-            NSPredicate *condition = segueDescription.condition;
-            if (condition != nil && ![condition evaluateWithObject:result])
-            {
-                continue;
-            }
-            
-            _WEOperationState *targetState = segue->_targetState;
-            WEAssert(targetState->_hasIncomingSegues);
-
-            [targetState->_activatedIncomingSegues addObject:segueDescription];
-            
-            if (targetState->_completedDependsOnOperations == targetState->_dependsOn.count)
-            {
-                BOOL alreadyExecutes = [_operationsReadyToExecute containsObject:targetState];
-                if (!alreadyExecutes)
-                {
-                    WEOperation *targetOperation = targetState->_operation;
-                    alreadyExecutes = targetOperation.active || targetOperation.finished;
-                }
-                if (!alreadyExecutes)
-                {
-                    [_operationsReadyToExecute addObject:targetState];
-                }
-            }
+            [self _recordOperationStartedAt:ordered->startTime finishedAt:ordered->finishTime withResult:result];
+        }
+        BOOL completed = [self _completeOperation:ordered->node executedOnWorker:ordered->workerIndex startTime:ordered->startTime finishTime:now withResult:result successorStarted:ordered->successorStarted];
+        if (completed && completedOperations != nil && result != nil)
+        {
+            [completedOperations addObject:_graph->operations[ordered->node]];
+            [completedResults addObject:result];
         }
+        free(ordered);
+        ordered = next;
+    }
+    
+    // If the workflow has failed already, or the run has ended before the batch, do nothing.
+    // The ivars are safe to access on the private queue.
+    if (_isFailedInternal || _graph == NULL) return;
+    
+    if (completedOperations.count > 0)
+    {
+        [self _deliverCompletedOperations:completedOperations results:completedResults];
+    }
+    
+    // A terminal operation that completed successfully ends the run, whatever is still running or waiting is cancelled.
+    WEWorkflowGraph *graph = _graph;
+    if (_terminalNodeInternal != WEGraphNoIndex)
+    {
+        [self _cancelRemainingNodesAfterNode:_terminalNodeInternal];
+    }
+    if (graph->skippedCount > skippedCount)
+    {
+        [self _reportSkippedNodesFrom:skippedCount];
     }
     
     // check if workflow is complete.
-    if (_activeOperations.count == 0 && _operationsReadyToExecute.count == 0)
+    if (graph->activeCount == 0 && WEWorkflowGraphReadyCount(graph) == 0)
     {
-        if (!_hasSeguesInternal && _totalCompletedOperations < _allOperationStates.count)
+        if (graph->completedCount + graph->skippedCount < graph->nodeCount)
         {
-            // TODO: improve the check, maybe find a way to validate a workflow with segues.
-            NSString *reason = [NSString stringWithFormat:@"Workflow %@ cannot proceed: completed %li of %li operations, but no operations are ready for execution or active.", self, (long)_totalCompletedOperations, (long)_allOperationStates.count];
+            NSString *reason = [NSString stringWithFormat:@"Workflow %@ cannot proceed: completed %li of %li operations, but no operations are ready for execution or active.", self, (long)graph->completedCount, (long)graph->nodeCount];
             NSError *error = [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowDeadlocked userInfo:@{ NSLocalizedDescriptionKey: reason }];
             [self _completeWorkflowWithError:error];
         }
@@ -677,32 +2767,153 @@ static inline dispatch_queue_t _WEQueueForOperation(__unsafe_unretained WEOperat
             [self _completeWorkflow];
         }
     }
-    else if (_operationsReadyToExecute.count > 0)
+    else if (WEWorkflowGraphReadyCount(graph) > 0)
     {
         [self _checkAndStartReadyOperation];
     }
 }
 
+// Hands completed operations to the observer. Operations that complete while an earlier delivery is still waiting
+// for the queue join that delivery.
+- (void)_deliverCompletedOperations:(NSMutableArray<WEOperation *> *)operations results:(NSMutableArray<WEOperationResult *> *)results
+{
+    BOOL schedule = NO;
+    ENTER_CRITICAL_SECTION(self, _operationMutex)
+    if (_undeliveredOperations == nil)
+    {
+        _undeliveredOperations = operations;
+        _undeliveredResults = results;
+        schedule = YES;
+    }
+    else
+    {
+        [_undeliveredOperations addObjectsFromArray:operations];
+        [_undeliveredResults addObjectsFromArray:results];
+    }
+    LEAVE_CRITICAL_SECTION(self, _operationMutex)
+    
+    if (!schedule) return;
+    
+    WEOperationCompletionObserver observer = _operationCompletionObserverInternal;
+    dispatch_async(_delegateQueue ?: dispatch_get_main_queue(), ^{
+        NSArray<WEOperation *> *deliveredOperations;
+        NSArray<WEOperationResult *> *deliveredResults;
+        ENTER_CRITICAL_SECTION(self, _operationMutex)
+        deliveredOperations = self->_undeliveredOperations;
+        deliveredResults = self->_undeliveredResults;
+        self->_undeliveredOperations = nil;
+        self->_undeliveredResults = nil;
+        LEAVE_CRITICAL_SECTION(self, _operationMutex)
+        
+        observer(self, deliveredOperations, deliveredResults);
+    });
+}
+
+// Completes a node and updates the graph. Skipped operations are reported, and ready operations are started
+// by the batch the completion belongs to. A fused successor that was started already becomes active right away.
+// Returns NO if the completion was ignored, because the run is over or the operation was cancelled.
+- (BOOL)_completeOperation:(WEGraphIndex)node
+          executedOnWorker:(NSUInteger)workerIndex
+                 startTime:(uint64_t)startTime
+                finishTime:(uint64_t)finishTime
+                withResult:(WEOperationResult *)result
+          successorStarted:(BOOL)successorStarted
+{
+    // Executor slot is returned regardless of the workflow state. A fused successor takes over the slot of its predecessor.
+    if (!successorStarted) [_executor _releaseSlot];
+    
+    // If the workflow has failed already, or the run has ended, do nothing. The ivars are safe to access on the private queue.
+    if (_isFailedInternal || _graph == NULL) return NO;
+    
+    // An operation may complete after it was cancelled, when it did not stop in time or is shared with other workflows.
+    WEWorkflowGraph *graph = _graph;
+    WEAssert(node < graph->nodeCount);
+    if (graph->statuses[node] == WEGraphNodeSkipped) return NO;
+    WEAssert(graph->statuses[node] == WEGraphNodeActive);
+    
+    // A fused successor starts before the batch that completes its predecessor makes it ready.
+    graph->startTimes[node] = MAX(startTime, graph->readyTimes[node]);
+    
+    // A fused successor was only started once the result had been published.
+    NSString *operationName = graph->operations[node].name;
+    if (operationName != nil && !successorStarted)
+    {
+        [_WEContextForNode(self, node) _setOperationResult:result forOperationName:operationName];
+    }
+    if (_incrementalStates != nil) [self _recordResult:result ofNode:node];
+    // Reduce operations that depend on the operation fold its result in while their other sources are still running.
+    if (_graphReductionSlots != nil) [self _addResult:result ofNodeToReductions:node];
+    if (_graphQuorumResults != nil && result != nil && !result.failed) [self _addResult:result ofNodeToQuorums:node];
+    
+    // The operation will not receive any more chunks, and as the source of a stream it is done sending.
+    if (_graphChannels != nil)
+    {
+        [self _cancelInputStreamsOfNode:node];
+        for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+        {
+            [graph->dependencyChannels[edge] close];
+        }
+    }
+    
+    // The time the operation finished is also the time the operations it makes ready become ready.
+    WEGraphIndex preferredWorker = (workerIndex != NSNotFound) ? (WEGraphIndex)workerIndex : WEGraphNoIndex;
+    WEWorkflowGraphCompleteNode(graph, node, result, finishTime, preferredWorker);
+    if (successorStarted) [self _didStartFusedSuccessorOfNode:node];
+    
+    if (result != nil && !result.failed)
+    {
+        WEOperation *operation = graph->operations[node];
+        if (operation.raceGroup != nil) [self _cancelRivalsOfNode:node inRaceGroup:operation.raceGroup];
+        if (operation.terminal && _terminalNodeInternal == WEGraphNoIndex) _terminalNodeInternal = node;
+        if (_graphQuorumSources != nil) [self _cancelRemainingQuorumSourcesAfterNode:node];
+    }
+    return YES;
+}
+
 - (void)_commonCompletion
 {
-    _allOperationStates = nil;
-    _totalCompletedOperations = 0;
-    _operationsReadyToExecute = nil;
-    _activeOperations = nil;
+    // Operations still running after a failure do not touch the graph, so it can be freed right away.
+    WEWorkflowGraphDestroy(_graph);
+    _graph = NULL;
+    _graphOperations = nil;
+    _graphSegues = nil;
+    _graphContexts = nil;
+    _graphChannels = nil;
+    _graphReductionSlots = nil;
+    _graphRaceGroups = nil;
+    _graphQuorumResults = nil;
+    _graphQuorumSources = nil;
+    _runRecords = nil;
+    _runInputs = nil;
+    _incrementalStates = nil;
+    if (_throttleDeadline != 0)
+    {
+        _throttleDeadline = 0;
+        dispatch_source_set_timer(_throttleTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    }
 }
 
 - (void)_completeWorkflow
 {
-    WEAssert(_activeOperations.count == 0);
-    WEAssert(_operationsReadyToExecute.count == 0);
+    WEAssert(_graph == NULL || _graph->activeCount == 0);
+    WEAssert(WEWorkflowGraphReadyCount(_graph) == 0);
     WEAssert(!_isFailedInternal);
     
+    // The report is made before the graph is freed, and is in place by the time the delegate is notified.
+    WEWorkflowReport *report = nil;
+    if (_graph != NULL)
+    {
+        report = [[WEWorkflowReport alloc] _initWithGraph:_graph operations:_graphOperations startTime:_runStartTimeInternal];
+    }
+    if (_runRecords != nil) _incrementalRecords = _runRecords;
+    
     [self _commonCompletion];
     
     ENTER_CRITICAL_SECTION(self, _operationMutex)
     
     WEAssert(_state == WEWorkflowActive);
     _state = WEWorkflowComplete;
+    _report = report;
     
     LEAVE_CRITICAL_SECTION(self, _operationMutex)
 
@@ -721,6 +2932,12 @@ static inline dispatch_queue_t _WEQueueForOperation(__unsafe_unretained WEOperat
     WEAssert(!_isFailedInternal);
     
     _isFailedInternal = YES;
+    [self _discardPrefetchesOnFailure];
+    // Operations blocked on streams are released, the ones still running find out their streams were cancelled.
+    for (WEStreamChannel *channel in _graphChannels)
+    {
+        [channel _cancel];
+    }
     [self _commonCompletion];
     
     ENTER_CRITICAL_SECTION(self, _operationMutex)
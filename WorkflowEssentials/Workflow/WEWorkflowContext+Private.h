@@ -12,4 +12,7 @@
 
 @interface WEWorkflowContext ()
 - (void)_setOperationResult:(nonnull WEOperationResult *)result forOperationName:(nonnull NSString *)operationName;
+- (void)_removeAllOperationResults;
+- (void)_setStreamChannels:(nonnull NSArray<WEStreamChannel *> *)channels;
+- (void)_setQuorumResults:(nonnull NSArray<WEOperationResult *> *)results ofOperation:(nonnull WEOperation *)operation;
 @end
@@ -12,6 +12,8 @@
 
 @class WEWorkflow;
 @class WEOperationResult;
+@class WEOperation;
+@class WEStreamChannel;
 
 @interface WEWorkflowContext : NSObject
 
@@ -22,6 +24,52 @@
 
 - (nullable WEOperationResult *)resultForOperationName:(nonnull NSString *)name;
 
+/**
+ Budget, in bytes, for values of operation results retained by the context. Once retained values exceed the budget,
+ the oldest results are evicted from memory, and are mapped back from temporary files when looked up with
+ `resultForOperationName:`. Only values that are `NSData`, or can be archived with `NSSecureCoding`, are retained this way:
+ data counts towards the budget with its length, other values with the size of their archive, which is measured on
+ a background queue. Only evicted results are written to disk, also on the background queue. Data is written and
+ mapped back as is. Failed results, results initialized
+ with a provider, and results set before the budget are kept in memory. Default value is 0, which means no budget
+ and no spilling.
+ */
+@property (nonatomic, assign) NSUInteger resultMemoryBudget;
+
+/** Number of results evicted to disk to stay within `resultMemoryBudget`, and the bytes of their files. */
+@property (nonatomic, readonly) NSUInteger spilledResultCount;
+@property (nonatomic, readonly) NSUInteger spilledResultBytes;
+/** Number of lookups of results that were written to disk, and the bytes mapped back from disk for them. */
+@property (nonatomic, readonly) NSUInteger restoredResultCount;
+@property (nonatomic, readonly) NSUInteger restoredResultBytes;
+
+/**
+ Returns a view of the context in a namespace. Results are looked up in the view by name within the namespace,
+ that is, as "<namespace>.<name>" in this context, and context values are shared with this context.
+ Operations of a sub-workflow are given a view in the namespace of the sub-workflow, see `WESubworkflowOperation`.
+ @param name name of the namespace, must not be empty
+ */
+- (nonnull WEWorkflowContext *)contextForNamespace:(nonnull NSString *)name;
+
+/**
+ Channels of streams from an operation to other operations, see `WEStreamDescription`.
+ Available once the workflow has started.
+ */
+- (nonnull NSArray<WEStreamChannel *> *)outputStreamsOfOperation:(nonnull WEOperation *)operation;
+
+/**
+ Channels of streams to an operation from other operations, see `WEStreamDescription`.
+ Available once the workflow has started.
+ */
+- (nonnull NSArray<WEStreamChannel *> *)inputStreamsOfOperation:(nonnull WEOperation *)operation;
+
+/**
+ Successful results of quorum sources of an operation in the order they completed, see `WEQuorumDescription`.
+ Holds exactly as many results as the quorum once the operation is ready to start, results of sources that complete
+ later are not included. Empty for operations without a quorum.
+ */
+- (nonnull NSArray<WEOperationResult *> *)quorumResultsOfOperation:(nonnull WEOperation *)operation;
+
 - (nullable id)contextValueForKey:(nonnull id<NSCopying>)key;
 - (void)setContextValue:(nonnull id)value forKey:(nonnull id<NSCopying>)key;
 - (void)removeContextValueForKey:(nonnull id<NSCopying>)key;
@@ -10,17 +10,149 @@
 
 #import <WorkflowEssentials/WEWorkflowContext.h>
 #import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEOperationResult.h>
+#import <WorkflowEssentials/WEStreamChannel.h>
 
 #include <pthread.h>
+#include <unistd.h>
 #import "WETools.h"
+#import "WEOperationResult+Private.h"
 #import "WEWorkflowContext+Private.h"
 
+// View of a context in a namespace, which prefixes names of results and shares everything else with the root context.
+@interface _WENamespacedWorkflowContext : WEWorkflowContext
+- (instancetype)_initWithRoot:(WEWorkflowContext *)root prefix:(NSString *)prefix;
+@end
+
+// Value of an operation result that was written to a temporary file to keep the context within its memory budget.
+// The file is removed along with the spilled result, data mapped from it stays valid.
+@interface _WESpilledResult : NSObject
+{
+@public
+    NSString *_path;
+    NSUInteger _length;
+    // Data values are written as they are and mapped back without decoding, other values are archived, and are
+    // decoded as their own class.
+    Class _archivedClass;
+}
+@end
+
+@implementation _WESpilledResult
+
+- (void)dealloc
+{
+    unlink(_path.fileSystemRepresentation);
+}
+
+@end
+
+// Results that may be written to disk, checked without producing or archiving their values.
+static inline BOOL _WEIsSpillableResult(WEOperationResult *result)
+{
+    if (result.failed || result._lazy) return NO;
+    id value = result.result;
+    return [value isKindOfClass:[NSData class]] || [value conformsToProtocol:@protocol(NSSecureCoding)];
+}
+
+// Archives a value with secure coding. Returns nil if the value, or an object in it, cannot be archived.
+static NSData *_WEArchiveValue(id value)
+{
+    if (@available(iOS 12.0, macOS 10.14, *))
+    {
+        return [NSKeyedArchiver archivedDataWithRootObject:value requiringSecureCoding:YES error:NULL];
+    }
+    else
+    {
+        @try
+        {
+            return [NSKeyedArchiver archivedDataWithRootObject:value];
+        }
+        @catch (NSException *exception)
+        {
+            // A collection of objects that cannot be archived.
+            return nil;
+        }
+    }
+}
+
+// Decodes a value archived by `_WEArchiveValue`, as its own class or a property list of Foundation classes.
+static id _WEUnarchiveValue(NSData *data, Class archivedClass)
+{
+    id value = nil;
+    NSError *error = nil;
+    if (@available(iOS 12.0, macOS 10.14, *))
+    {
+        NSSet<Class> *classes = [NSSet setWithObjects:archivedClass, [NSArray class], [NSDictionary class], [NSSet class], [NSOrderedSet class],
+                                 [NSString class], [NSNumber class], [NSData class], [NSDate class], [NSURL class], [NSNull class], nil];
+        value = [NSKeyedUnarchiver unarchivedObjectOfClasses:classes fromData:data error:&error];
+    }
+    else
+    {
+        @try
+        {
+            value = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+        }
+        @catch (NSException *exception)
+        {
+            value = nil;
+        }
+    }
+    if (![value isKindOfClass:archivedClass])
+    {
+        THROW_INCONSISTENCY((@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to decode spilled result of class %@: %@", archivedClass, error.localizedDescription] }));
+    }
+    return value;
+}
+
+// Writes the value of a result to a temporary file, archiving it unless it is data. Returns nil if the value cannot be
+// archived or written.
+static _WESpilledResult *_WESpillResult(WEOperationResult *result)
+{
+    id value = result.result;
+    Class archivedClass = [value isKindOfClass:[NSData class]] ? Nil : [value classForKeyedArchiver];
+    NSData *data = archivedClass == Nil ? value : _WEArchiveValue(value);
+    if (data == nil) return nil;
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"WEResult-%@", [NSUUID UUID].UUIDString]];
+    if (![data writeToFile:path options:0 error:NULL]) return nil;
+    
+    _WESpilledResult *spilled = [_WESpilledResult new];
+    spilled->_path = path;
+    spilled->_length = data.length;
+    spilled->_archivedClass = archivedClass;
+    return spilled;
+}
+
+static WEOperationResult *_WERestoreResult(_WESpilledResult *spilled)
+{
+    NSData *data = [NSData dataWithContentsOfFile:spilled->_path options:NSDataReadingMappedAlways error:NULL];
+    if (data == nil) THROW_INCONSISTENCY((@{ NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to map spilled result from %@", spilled->_path] }));
+    
+    id value = spilled->_archivedClass != Nil ? _WEUnarchiveValue(data, spilled->_archivedClass) : data;
+    return [[WEOperationResult alloc] initWithResult:value];
+}
+
 @implementation WEWorkflowContext
 {
     __weak WEWorkflow *_workflow;
     pthread_mutex_t _contextMutex;
-    NSMutableDictionary<NSString *, WEOperationResult *> *_results;
+    // Results by name, either `WEOperationResult` or `_WESpilledResult`.
+    NSMutableDictionary<NSString *, id> *_results;
+    NSUInteger _resultMemoryBudget;
+    // Values other than data are measured, and evicted results are written, on a background queue.
+    dispatch_queue_t _spillQueue;
+    // Names of results that count towards the budget, oldest first, and the size of each of them, which is 0 until
+    // a value other than data is measured.
+    NSMutableArray<NSString *> *_retainedNames;
+    NSMutableDictionary<NSString *, NSNumber *> *_retainedSizes;
+    NSUInteger _retainedBytes;
+    NSUInteger _spilledResultCount;
+    NSUInteger _spilledResultBytes;
+    NSUInteger _restoredResultCount;
+    NSUInteger _restoredResultBytes;
     NSMutableDictionary<id<NSCopying>, id> *_userContext;
+    NSMapTable<WEOperation *, NSArray<WEStreamChannel *> *> *_outputStreams;
+    NSMapTable<WEOperation *, NSArray<WEStreamChannel *> *> *_inputStreams;
+    NSMapTable<WEOperation *, NSArray<WEOperationResult *> *> *_quorumResults;
 }
 
 @synthesize workflow = _workflow;
@@ -44,22 +176,266 @@
 - (WEOperationResult *)resultForOperationName:(NSString *)name
 {
     if (name == nil) THROW_INVALID_PARAM(name, nil);
-    WEOperationResult *result;
+    id result;
     
     ENTER_CRITICAL_SECTION(self, _contextMutex)
         result = _results[name];
     LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    if (![result isKindOfClass:[_WESpilledResult class]]) return result;
+    
+    // Mapped outside of the lock, the spilled result keeps its file until then.
+    _WESpilledResult *spilled = result;
+    result = _WERestoreResult(spilled);
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        _restoredResultCount++;
+        _restoredResultBytes += spilled->_length;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
 
     return result;
 }
 
+- (NSUInteger)resultMemoryBudget
+{
+    NSUInteger resultMemoryBudget;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        resultMemoryBudget = _resultMemoryBudget;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return resultMemoryBudget;
+}
+
+- (void)setResultMemoryBudget:(NSUInteger)resultMemoryBudget
+{
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        _resultMemoryBudget = resultMemoryBudget;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+}
+
+- (NSUInteger)spilledResultCount
+{
+    NSUInteger spilledResultCount;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        spilledResultCount = _spilledResultCount;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return spilledResultCount;
+}
+
+- (NSUInteger)spilledResultBytes
+{
+    NSUInteger spilledResultBytes;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        spilledResultBytes = _spilledResultBytes;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return spilledResultBytes;
+}
+
+- (NSUInteger)restoredResultCount
+{
+    NSUInteger restoredResultCount;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        restoredResultCount = _restoredResultCount;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return restoredResultCount;
+}
+
+- (NSUInteger)restoredResultBytes
+{
+    NSUInteger restoredResultBytes;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        restoredResultBytes = _restoredResultBytes;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return restoredResultBytes;
+}
+
+- (WEWorkflowContext *)contextForNamespace:(NSString *)name
+{
+    if (name.length == 0) THROW_INVALID_PARAM(name, nil);
+    return [[_WENamespacedWorkflowContext alloc] _initWithRoot:self prefix:[name stringByAppendingString:@"."]];
+}
+
 - (void)_setOperationResult:(WEOperationResult *)result forOperationName:(NSString *)operationName
 {
     WEAssert(result != nil);
     WEAssert(operationName != nil);
     
+    BOOL needsMeasuring = NO;
+    dispatch_queue_t spillQueue = nil;
     ENTER_CRITICAL_SECTION(self, _contextMutex)
+        [self _forgetRetainedResultNamed:operationName];
         _results[operationName] = result;
+        if (_resultMemoryBudget > 0 && _WEIsSpillableResult(result))
+        {
+            // Data counts with its length right away, other values once they are archived to measure them.
+            id value = result.result;
+            needsMeasuring = ![value isKindOfClass:[NSData class]];
+            [self _retainResultNamed:operationName size:needsMeasuring ? 0 : ((NSData *)value).length];
+            if (needsMeasuring || _retainedBytes > _resultMemoryBudget)
+            {
+                if (_spillQueue == nil) _spillQueue = dispatch_queue_create("WEWorkflowContext.spill", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+                spillQueue = _spillQueue;
+            }
+        }
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    
+    // Results are published on the scheduler's queue and on threads of operations, which must not wait for the disk.
+    if (spillQueue != nil)
+    {
+        dispatch_async(spillQueue, ^{
+            if (needsMeasuring) [self _measureResult:result named:operationName];
+            [self _evictResultsOverBudget];
+        });
+    }
+}
+
+// Must be called within the critical section.
+- (void)_retainResultNamed:(NSString *)name size:(NSUInteger)size
+{
+    if (_retainedNames == nil)
+    {
+        _retainedNames = [NSMutableArray new];
+        _retainedSizes = [NSMutableDictionary new];
+    }
+    [_retainedNames addObject:name];
+    _retainedSizes[name] = @(size);
+    _retainedBytes += size;
+}
+
+// Counts a value other than data towards the budget with the size of its archive, which is not kept: the value is
+// archived again only if it is evicted.
+- (void)_measureResult:(WEOperationResult *)result named:(NSString *)name
+{
+    NSUInteger size = _WEArchiveValue(result.result).length;
+    
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        // The result may have been replaced, removed or evicted while it was archived.
+        if (_results[name] == result && _retainedSizes[name] != nil)
+        {
+            if (size > 0)
+            {
+                _retainedSizes[name] = @(size);
+                _retainedBytes += size;
+            }
+            else
+            {
+                // A value that cannot be archived stays in memory, and does not count.
+                [self _forgetRetainedResultNamed:name];
+            }
+        }
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+}
+
+// Writes the oldest results to disk while retained results exceed the budget. Must be called on the spill queue.
+- (void)_evictResultsOverBudget
+{
+    while (YES)
+    {
+        NSString *name = nil;
+        WEOperationResult *result = nil;
+        ENTER_CRITICAL_SECTION(self, _contextMutex)
+            if (_resultMemoryBudget > 0 && _retainedBytes > _resultMemoryBudget)
+            {
+                name = _retainedNames.firstObject;
+                result = _results[name];
+                // The result no longer counts while it is written, a result that could not be written stays in memory.
+                [self _forgetRetainedResultNamed:name];
+            }
+        LEAVE_CRITICAL_SECTION(self, _contextMutex)
+        if (name == nil) return;
+        
+        _WESpilledResult *spilled = _WESpillResult(result);
+        if (spilled == nil) continue;
+        
+        ENTER_CRITICAL_SECTION(self, _contextMutex)
+            // The result may have been replaced or removed while it was written, its file is removed along with it.
+            if (_results[name] == result)
+            {
+                _results[name] = spilled;
+                _spilledResultCount++;
+                _spilledResultBytes += spilled->_length;
+            }
+        LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    }
+}
+
+// Must be called within the critical section.
+- (void)_forgetRetainedResultNamed:(NSString *)name
+{
+    NSNumber *size = _retainedSizes[name];
+    if (size == nil) return;
+    _retainedBytes -= size.unsignedIntegerValue;
+    [_retainedSizes removeObjectForKey:name];
+    [_retainedNames removeObject:name];
+}
+
+- (void)_removeAllOperationResults
+{
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        [_results removeAllObjects];
+        [_retainedNames removeAllObjects];
+        [_retainedSizes removeAllObjects];
+        _retainedBytes = 0;
+        [_quorumResults removeAllObjects];
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+}
+
+- (NSArray<WEStreamChannel *> *)outputStreamsOfOperation:(WEOperation *)operation
+{
+    if (operation == nil) THROW_INVALID_PARAM(operation, nil);
+    
+    NSArray<WEStreamChannel *> *channels;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        channels = [_outputStreams objectForKey:operation];
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return channels ?: @[];
+}
+
+- (NSArray<WEStreamChannel *> *)inputStreamsOfOperation:(WEOperation *)operation
+{
+    if (operation == nil) THROW_INVALID_PARAM(operation, nil);
+    
+    NSArray<WEStreamChannel *> *channels;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        channels = [_inputStreams objectForKey:operation];
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return channels ?: @[];
+}
+
+- (void)_setStreamChannels:(NSArray<WEStreamChannel *> *)channels
+{
+    NSMapTable<WEOperation *, NSArray<WEStreamChannel *> *> *outputStreams = [NSMapTable strongToStrongObjectsMapTable];
+    NSMapTable<WEOperation *, NSArray<WEStreamChannel *> *> *inputStreams = [NSMapTable strongToStrongObjectsMapTable];
+    for (WEStreamChannel *channel in channels)
+    {
+        WEOperation *source = channel.sourceOperation;
+        WEOperation *target = channel.targetOperation;
+        [outputStreams setObject:[([outputStreams objectForKey:source] ?: @[]) arrayByAddingObject:channel] forKey:source];
+        [inputStreams setObject:[([inputStreams objectForKey:target] ?: @[]) arrayByAddingObject:channel] forKey:target];
+    }
+    
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        _outputStreams = outputStreams;
+        _inputStreams = inputStreams;
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+}
+
+- (NSArray<WEOperationResult *> *)quorumResultsOfOperation:(WEOperation *)operation
+{
+    if (operation == nil) THROW_INVALID_PARAM(operation, nil);
+    
+    NSArray<WEOperationResult *> *results;
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        results = [_quorumResults objectForKey:operation];
+    LEAVE_CRITICAL_SECTION(self, _contextMutex)
+    return results ?: @[];
+}
+
+- (void)_setQuorumResults:(NSArray<WEOperationResult *> *)results ofOperation:(WEOperation *)operation
+{
+    WEAssert(results != nil);
+    WEAssert(operation != nil);
+    
+    ENTER_CRITICAL_SECTION(self, _contextMutex)
+        if (_quorumResults == nil) _quorumResults = [NSMapTable strongToStrongObjectsMapTable];
+        [_quorumResults setObject:[results copy] forKey:operation];
     LEAVE_CRITICAL_SECTION(self, _contextMutex)
 }
 
@@ -95,3 +471,109 @@
 }
 
 @end
+
+
+@implementation _WENamespacedWorkflowContext
+{
+    WEWorkflowContext *_root;
+    NSString *_prefix;
+}
+
+- (instancetype)_initWithRoot:(WEWorkflowContext *)root prefix:(NSString *)prefix
+{
+    WEWorkflow *workflow = root.workflow;
+    if (workflow == nil) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Workflow of the context is gone" });
+    
+    if (self = [super initWithWorkflow:workflow])
+    {
+        _root = root;
+        _prefix = prefix;
+    }
+    return self;
+}
+
+- (WEOperationResult *)resultForOperationName:(NSString *)name
+{
+    if (name == nil) THROW_INVALID_PARAM(name, nil);
+    return [_root resultForOperationName:[_prefix stringByAppendingString:name]];
+}
+
+- (WEWorkflowContext *)contextForNamespace:(NSString *)name
+{
+    if (name.length == 0) THROW_INVALID_PARAM(name, nil);
+    
+    // Nested views refer to the root directly, so that lookups do not go through a chain of views.
+    return [[_WENamespacedWorkflowContext alloc] _initWithRoot:_root prefix:[NSString stringWithFormat:@"%@%@.", _prefix, name]];
+}
+
+- (void)_setOperationResult:(WEOperationResult *)result forOperationName:(NSString *)operationName
+{
+    [_root _setOperationResult:result forOperationName:[_prefix stringByAppendingString:operationName]];
+}
+
+- (NSUInteger)resultMemoryBudget
+{
+    return _root.resultMemoryBudget;
+}
+
+- (void)setResultMemoryBudget:(NSUInteger)resultMemoryBudget
+{
+    _root.resultMemoryBudget = resultMemoryBudget;
+}
+
+- (NSUInteger)spilledResultCount
+{
+    return _root.spilledResultCount;
+}
+
+- (NSUInteger)spilledResultBytes
+{
+    return _root.spilledResultBytes;
+}
+
+- (NSUInteger)restoredResultCount
+{
+    return _root.restoredResultCount;
+}
+
+- (NSUInteger)restoredResultBytes
+{
+    return _root.restoredResultBytes;
+}
+
+- (NSArray<WEStreamChannel *> *)outputStreamsOfOperation:(WEOperation *)operation
+{
+    return [_root outputStreamsOfOperation:operation];
+}
+
+- (NSArray<WEStreamChannel *> *)inputStreamsOfOperation:(WEOperation *)operation
+{
+    return [_root inputStreamsOfOperation:operation];
+}
+
+- (NSArray<WEOperationResult *> *)quorumResultsOfOperation:(WEOperation *)operation
+{
+    return [_root quorumResultsOfOperation:operation];
+}
+
+- (void)_setQuorumResults:(NSArray<WEOperationResult *> *)results ofOperation:(WEOperation *)operation
+{
+    [_root _setQuorumResults:results ofOperation:operation];
+}
+
+- (id)contextValueForKey:(id<NSCopying>)key
+{
+    return [_root contextValueForKey:key];
+}
+
+- (void)setContextValue:(id)value forKey:(id<NSCopying>)key
+{
+    [_root setContextValue:value forKey:key];
+}
+
+- (void)removeContextValueForKey:(id<NSCopying>)key
+{
+    [_root removeContextValueForKey:key];
+}
+
+@end
@@ -0,0 +1,42 @@
+//
+//  WEWorkflowDefinition+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflowDefinition.h>
+
+// Binary layout of a workflow definition. Every field is a little-endian 32-bit unsigned integer.
+//   header:         magic, version, operation count, dependency count, segue count, string count
+//   string offsets: string count + 1 offsets into string bytes, the last one is the length of string bytes
+//   operations:     type string, name string
+//   dependencies:   source operation, target operation
+//   segues:         source operation, target operation, condition string, flags
+//   string bytes:   UTF-8 strings, not terminated
+// Strings are referred to by index, and a string used more than once is stored once.
+
+static const uint32_t WEDefinitionMagic = 0x44574557; // "WEWD"
+static const uint32_t WEDefinitionVersion = 1;
+static const uint32_t WEDefinitionNoString = UINT32_MAX;
+static const uint32_t WEDefinitionSegueLikely = 1 << 0;
+
+static const size_t WEDefinitionHeaderFields = 6;
+static const size_t WEDefinitionOperationFields = 2;
+static const size_t WEDefinitionDependencyFields = 2;
+static const size_t WEDefinitionSegueFields = 4;
+
+@interface WEWorkflowDefinition ()
+
+// Accessors below are only valid for indexes within counts of the definition, which has been validated.
+
+- (nonnull NSString *)_typeOfOperationAtIndex:(NSUInteger)index;
+- (nullable NSString *)_nameOfOperationAtIndex:(NSUInteger)index;
+- (void)_getDependencyAtIndex:(NSUInteger)index source:(nonnull NSUInteger *)source target:(nonnull NSUInteger *)target;
+- (void)_getSegueAtIndex:(NSUInteger)index source:(nonnull NSUInteger *)source target:(nonnull NSUInteger *)target likely:(nonnull BOOL *)likely;
+- (nullable NSPredicate *)_conditionOfSegueAtIndex:(NSUInteger)index;
+
+@end
@@ -0,0 +1,49 @@
+//
+//  WEWorkflowDefinition.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A serialized workflow definition: operations referred to by registered type name (see `WEOperationRegistry`),
+ dependencies and segues between them, and segue conditions.
+ The definition is stored in a compact binary format, produced by `WEWorkflowDefinitionBuilder`. The whole buffer
+ is validated once when a definition is created, after which it can be added to any number of workflows
+ with `-[WEWorkflow addDefinition:error:]`. Immutable and thread safe.
+ */
+@interface WEWorkflowDefinition : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Initialize a definition from its binary representation
+ @param data binary representation of a definition, is retained and not copied.
+ @param error set to an error in `WEWorkflowErrorDomain` with `WEWorkflowInvalidDefinition` code if the data is not a valid definition.
+ @return an instance of `WEWorkflowDefinition`, or `nil` if the data is not a valid definition
+ */
+- (nullable instancetype)initWithData:(nonnull NSData *)data error:(NSError * _Nullable * _Nullable)error NS_DESIGNATED_INITIALIZER;
+
+/**
+ Initialize a definition from a file, which is memory-mapped rather than read.
+ @param path path to a file with binary representation of a definition
+ @param error set to an error if the file cannot be read or is not a valid definition.
+ @return an instance of `WEWorkflowDefinition`, or `nil` in case of an error
+ */
+- (nullable instancetype)initWithContentsOfFile:(nonnull NSString *)path error:(NSError * _Nullable * _Nullable)error;
+
+/**
+ Binary representation of the definition.
+ */
+@property (nonatomic, readonly, nonnull) NSData *data;
+
+@property (nonatomic, readonly) NSUInteger operationCount;
+@property (nonatomic, readonly) NSUInteger dependencyCount;
+@property (nonatomic, readonly) NSUInteger segueCount;
+
+@end
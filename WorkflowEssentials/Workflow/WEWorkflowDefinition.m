@@ -0,0 +1,224 @@
+//
+//  WEWorkflowDefinition.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflowDefinition.h>
+
+#import <WorkflowEssentials/WEWorkflow.h>
+
+#import <libkern/OSByteOrder.h>
+#import "WETools.h"
+#import "WEWorkflowDefinition+Private.h"
+
+static inline uint32_t _WEReadField(const uint8_t *bytes, size_t fieldIndex)
+{
+    // Mapped or arbitrary data is not guaranteed to be aligned.
+    return OSReadLittleInt32(bytes, fieldIndex * sizeof(uint32_t));
+}
+
+static NSError *_WEInvalidDefinitionError(NSString *reason)
+{
+    return [NSError errorWithDomain:WEWorkflowErrorDomain code:WEWorkflowInvalidDefinition userInfo:@{ NSLocalizedDescriptionKey: reason }];
+}
+
+@implementation WEWorkflowDefinition
+{
+    NSData *_data;
+    NSUInteger _operationCount;
+    NSUInteger _dependencyCount;
+    NSUInteger _segueCount;
+    
+    // Pointers into the data.
+    const uint8_t *_operations;
+    const uint8_t *_dependencies;
+    const uint8_t *_segues;
+    
+    // Strings and conditions are decoded while validating, every string is decoded once.
+    NSArray<NSString *> *_strings;
+    NSArray *_conditions;
+}
+
+- (instancetype)initWithContentsOfFile:(NSString *)path error:(NSError **)error
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    if (data == nil) return nil;
+    return [self initWithData:data error:error];
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+    if (data == nil) THROW_INVALID_PARAM(data, nil);
+    
+    if (self = [super init])
+    {
+        _data = data;
+        NSString *reason = [self _validate];
+        if (reason != nil)
+        {
+            if (error != NULL) *error = _WEInvalidDefinitionError(reason);
+            return nil;
+        }
+    }
+    return self;
+}
+
+// Validates the whole definition in a single pass, returns a reason if it is invalid.
+- (NSString *)_validate
+{
+    const uint8_t *bytes = _data.bytes;
+    size_t length = _data.length;
+    size_t fieldSize = sizeof(uint32_t);
+    
+    if (length < WEDefinitionHeaderFields * fieldSize) return @"Definition is too short.";
+    if (_WEReadField(bytes, 0) != WEDefinitionMagic) return @"Definition has invalid format.";
+    if (_WEReadField(bytes, 1) != WEDefinitionVersion) return [NSString stringWithFormat:@"Definition version %u is not supported.", _WEReadField(bytes, 1)];
+    
+    uint64_t operationCount = _WEReadField(bytes, 2);
+    uint64_t dependencyCount = _WEReadField(bytes, 3);
+    uint64_t segueCount = _WEReadField(bytes, 4);
+    uint64_t stringCount = _WEReadField(bytes, 5);
+    
+    // Counts are 32-bit, so in 64-bit arithmetic sizes cannot overflow.
+    uint64_t fieldCount = WEDefinitionHeaderFields + (stringCount + 1)
+                        + operationCount * WEDefinitionOperationFields
+                        + dependencyCount * WEDefinitionDependencyFields
+                        + segueCount * WEDefinitionSegueFields;
+    if (fieldCount * fieldSize > length) return @"Definition is truncated.";
+    
+    const uint8_t *offsets = bytes + WEDefinitionHeaderFields * fieldSize;
+    const uint8_t *operations = offsets + (stringCount + 1) * fieldSize;
+    const uint8_t *dependencies = operations + operationCount * WEDefinitionOperationFields * fieldSize;
+    const uint8_t *segues = dependencies + dependencyCount * WEDefinitionDependencyFields * fieldSize;
+    const uint8_t *stringBytes = segues + segueCount * WEDefinitionSegueFields * fieldSize;
+    
+    uint64_t stringBytesLength = _WEReadField(offsets, stringCount);
+    if (fieldCount * fieldSize + stringBytesLength != length) return @"Definition length does not match its contents.";
+    
+    NSMutableArray<NSString *> *strings = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)stringCount];
+    uint32_t previousOffset = 0;
+    for (uint64_t i = 0; i < stringCount; i++)
+    {
+        uint32_t start = _WEReadField(offsets, (size_t)i);
+        uint32_t end = _WEReadField(offsets, (size_t)i + 1);
+        if (start != previousOffset || end < start) return @"Definition has invalid string table.";
+        previousOffset = end;
+        
+        NSString *string = [[NSString alloc] initWithBytes:stringBytes + start length:end - start encoding:NSUTF8StringEncoding];
+        if (string == nil) return [NSString stringWithFormat:@"Definition string %llu is not valid UTF-8.", i];
+        [strings addObject:string];
+    }
+    
+    for (uint64_t i = 0; i < operationCount; i++)
+    {
+        uint32_t type = _WEReadField(operations, (size_t)(i * WEDefinitionOperationFields));
+        uint32_t name = _WEReadField(operations, (size_t)(i * WEDefinitionOperationFields + 1));
+        if (type >= stringCount || (name != WEDefinitionNoString && name >= stringCount))
+        {
+            return [NSString stringWithFormat:@"Definition operation %llu refers to a missing string.", i];
+        }
+    }
+    
+    for (uint64_t i = 0; i < dependencyCount; i++)
+    {
+        uint32_t source = _WEReadField(dependencies, (size_t)(i * WEDefinitionDependencyFields));
+        uint32_t target = _WEReadField(dependencies, (size_t)(i * WEDefinitionDependencyFields + 1));
+        if (source >= operationCount || target >= operationCount || source == target)
+        {
+            return [NSString stringWithFormat:@"Definition dependency %llu is invalid.", i];
+        }
+    }
+    
+    NSMutableArray *conditions = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)segueCount];
+    for (uint64_t i = 0; i < segueCount; i++)
+    {
+        uint32_t source = _WEReadField(segues, (size_t)(i * WEDefinitionSegueFields));
+        uint32_t target = _WEReadField(segues, (size_t)(i * WEDefinitionSegueFields + 1));
+        uint32_t condition = _WEReadField(segues, (size_t)(i * WEDefinitionSegueFields + 2));
+        if (source >= operationCount || target >= operationCount || source == target)
+        {
+            return [NSString stringWithFormat:@"Definition segue %llu is invalid.", i];
+        }
+        
+        if (condition == WEDefinitionNoString)
+        {
+            [conditions addObject:[NSNull null]];
+            continue;
+        }
+        if (condition >= stringCount) return [NSString stringWithFormat:@"Definition segue %llu refers to a missing string.", i];
+        
+        NSPredicate *predicate;
+        @try
+        {
+            predicate = [NSPredicate predicateWithFormat:strings[condition] argumentArray:nil];
+        }
+        @catch (NSException *exception)
+        {
+            return [NSString stringWithFormat:@"Definition segue %llu has invalid condition \"%@\": %@", i, strings[condition], exception.reason];
+        }
+        [conditions addObject:predicate];
+    }
+    
+    _operationCount = (NSUInteger)operationCount;
+    _dependencyCount = (NSUInteger)dependencyCount;
+    _segueCount = (NSUInteger)segueCount;
+    _operations = operations;
+    _dependencies = dependencies;
+    _segues = segues;
+    _strings = [strings copy];
+    _conditions = [conditions copy];
+    return nil;
+}
+
+
+#pragma mark - Properties
+
+@synthesize data = _data;
+@synthesize operationCount = _operationCount;
+@synthesize dependencyCount = _dependencyCount;
+@synthesize segueCount = _segueCount;
+
+
+#pragma mark - Private
+
+- (NSString *)_typeOfOperationAtIndex:(NSUInteger)index
+{
+    WEAssert(index < _operationCount);
+    return _strings[_WEReadField(_operations, index * WEDefinitionOperationFields)];
+}
+
+- (NSString *)_nameOfOperationAtIndex:(NSUInteger)index
+{
+    WEAssert(index < _operationCount);
+    uint32_t name = _WEReadField(_operations, index * WEDefinitionOperationFields + 1);
+    return (name != WEDefinitionNoString) ? _strings[name] : nil;
+}
+
+- (void)_getDependencyAtIndex:(NSUInteger)index source:(NSUInteger *)source target:(NSUInteger *)target
+{
+    WEAssert(index < _dependencyCount);
+    *source = _WEReadField(_dependencies, index * WEDefinitionDependencyFields);
+    *target = _WEReadField(_dependencies, index * WEDefinitionDependencyFields + 1);
+}
+
+- (void)_getSegueAtIndex:(NSUInteger)index source:(NSUInteger *)source target:(NSUInteger *)target likely:(BOOL *)likely
+{
+    WEAssert(index < _segueCount);
+    *source = _WEReadField(_segues, index * WEDefinitionSegueFields);
+    *target = _WEReadField(_segues, index * WEDefinitionSegueFields + 1);
+    *likely = (_WEReadField(_segues, index * WEDefinitionSegueFields + 3) & WEDefinitionSegueLikely) != 0;
+}
+
+- (NSPredicate *)_conditionOfSegueAtIndex:(NSUInteger)index
+{
+    WEAssert(index < _segueCount);
+    id condition = _conditions[index];
+    return (condition != [NSNull null]) ? condition : nil;
+}
+
+@end
@@ -0,0 +1,55 @@
+//
+//  WEWorkflowDefinitionBuilder.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEWorkflowDefinition;
+
+/**
+ Produces binary workflow definitions. Operations are referred to by their index, in the order they were added.
+ Not thread safe.
+ */
+@interface WEWorkflowDefinitionBuilder : NSObject
+
+/**
+ Adds an operation
+ @param type operation type name, registered in an `WEOperationRegistry` by the time the definition is loaded
+ @param name optional operation name
+ @return index of the operation
+ */
+- (NSUInteger)addOperationWithType:(nonnull NSString *)type name:(nullable NSString *)name;
+
+/**
+ Adds a dependency between two operations
+ @param sourceIndex index of the source operation
+ @param targetIndex index of the target operation
+ */
+- (void)addDependencyFromOperationAtIndex:(NSUInteger)sourceIndex toOperationAtIndex:(NSUInteger)targetIndex;
+
+/**
+ Adds a segue between two operations
+ @param sourceIndex index of the source operation
+ @param targetIndex index of the target operation
+ @param condition optional condition, which must be representable as a predicate format string. Block predicates are not supported.
+ @param likely whether the segue is likely to be activated, see `-[WESegueDescription likely]`
+ */
+- (void)addSegueFromOperationAtIndex:(NSUInteger)sourceIndex toOperationAtIndex:(NSUInteger)targetIndex condition:(nullable NSPredicate *)condition likely:(BOOL)likely;
+
+/**
+ Binary representation of the definition built so far.
+ */
+- (nonnull NSData *)data;
+
+/**
+ Definition built so far.
+ */
+- (nonnull WEWorkflowDefinition *)definition;
+
+@end
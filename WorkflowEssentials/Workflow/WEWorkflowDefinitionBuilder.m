@@ -0,0 +1,174 @@
+//
+//  WEWorkflowDefinitionBuilder.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflowDefinitionBuilder.h>
+
+#import <libkern/OSByteOrder.h>
+#import "WETools.h"
+#import "WEWorkflowDefinition+Private.h"
+
+static inline void _WEAppendField(NSMutableData *data, uint32_t value)
+{
+    uint32_t littleEndian = OSSwapHostToLittleInt32(value);
+    [data appendBytes:&littleEndian length:sizeof(littleEndian)];
+}
+
+@implementation WEWorkflowDefinitionBuilder
+{
+    NSMutableArray<NSString *> *_strings;
+    NSMutableDictionary<NSString *, NSNumber *> *_stringIndexes;
+    
+    // Records are kept as fields in host byte order, in the layout of the binary format.
+    NSMutableData *_operations;
+    NSMutableData *_dependencies;
+    NSMutableData *_segues;
+    NSUInteger _operationCount;
+}
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _strings = [NSMutableArray new];
+        _stringIndexes = [NSMutableDictionary new];
+        _operations = [NSMutableData new];
+        _dependencies = [NSMutableData new];
+        _segues = [NSMutableData new];
+    }
+    return self;
+}
+
+- (uint32_t)_indexOfString:(NSString *)string
+{
+    if (string == nil) return WEDefinitionNoString;
+    
+    NSNumber *index = [_stringIndexes objectForKey:string];
+    if (index == nil)
+    {
+        index = @(_strings.count);
+        [_strings addObject:[string copy]];
+        [_stringIndexes setObject:index forKey:_strings.lastObject];
+    }
+    return index.unsignedIntValue;
+}
+
+static inline void _WEAppendRecord(NSMutableData *records, const uint32_t *fields, size_t count)
+{
+    [records appendBytes:fields length:count * sizeof(uint32_t)];
+}
+
+- (NSUInteger)addOperationWithType:(NSString *)type name:(NSString *)name
+{
+    if (type == nil) THROW_INVALID_PARAM(type, nil);
+    if (_operationCount >= WEDefinitionNoString - 1) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Too many operations" });
+    
+    uint32_t fields[] = { [self _indexOfString:type], [self _indexOfString:name] };
+    _WEAppendRecord(_operations, fields, WEDefinitionOperationFields);
+    return _operationCount++;
+}
+
+- (void)_verifySourceIndex:(NSUInteger)sourceIndex targetIndex:(NSUInteger)targetIndex
+{
+    if (sourceIndex >= _operationCount) THROW_INVALID_PARAM(sourceIndex, nil);
+    if (targetIndex >= _operationCount) THROW_INVALID_PARAM(targetIndex, nil);
+    if (sourceIndex == targetIndex) THROW_INVALID_PARAMS(@{ NSLocalizedDescriptionKey: @"Source and target are the same" });
+}
+
+- (void)addDependencyFromOperationAtIndex:(NSUInteger)sourceIndex toOperationAtIndex:(NSUInteger)targetIndex
+{
+    [self _verifySourceIndex:sourceIndex targetIndex:targetIndex];
+    
+    uint32_t fields[] = { (uint32_t)sourceIndex, (uint32_t)targetIndex };
+    _WEAppendRecord(_dependencies, fields, WEDefinitionDependencyFields);
+}
+
+- (void)addSegueFromOperationAtIndex:(NSUInteger)sourceIndex toOperationAtIndex:(NSUInteger)targetIndex condition:(NSPredicate *)condition likely:(BOOL)likely
+{
+    [self _verifySourceIndex:sourceIndex targetIndex:targetIndex];
+    
+    NSString *format = condition.predicateFormat;
+    if (condition != nil)
+    {
+        // Only conditions that survive a round trip through their format can be stored.
+        NSPredicate *parsed;
+        @try
+        {
+            parsed = [NSPredicate predicateWithFormat:format argumentArray:nil];
+        }
+        @catch (NSException *exception)
+        {
+            parsed = nil;
+        }
+        if (parsed == nil) THROW_INVALID_PARAM(condition, @{ NSLocalizedDescriptionKey: @"Condition cannot be represented as a predicate format" });
+    }
+    
+    uint32_t fields[] = {
+        (uint32_t)sourceIndex,
+        (uint32_t)targetIndex,
+        [self _indexOfString:format],
+        likely ? WEDefinitionSegueLikely : 0
+    };
+    _WEAppendRecord(_segues, fields, WEDefinitionSegueFields);
+}
+
+static void _WEAppendRecords(NSMutableData *data, NSData *records)
+{
+    const uint32_t *fields = records.bytes;
+    NSUInteger count = records.length / sizeof(uint32_t);
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        _WEAppendField(data, fields[i]);
+    }
+}
+
+- (NSData *)data
+{
+    NSMutableArray<NSData *> *encodedStrings = [[NSMutableArray alloc] initWithCapacity:_strings.count];
+    for (NSString *string in _strings)
+    {
+        [encodedStrings addObject:[string dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    
+    NSMutableData *data = [NSMutableData new];
+    _WEAppendField(data, WEDefinitionMagic);
+    _WEAppendField(data, WEDefinitionVersion);
+    _WEAppendField(data, (uint32_t)_operationCount);
+    _WEAppendField(data, (uint32_t)(_dependencies.length / (WEDefinitionDependencyFields * sizeof(uint32_t))));
+    _WEAppendField(data, (uint32_t)(_segues.length / (WEDefinitionSegueFields * sizeof(uint32_t))));
+    _WEAppendField(data, (uint32_t)_strings.count);
+    
+    uint32_t offset = 0;
+    _WEAppendField(data, offset);
+    for (NSData *encodedString in encodedStrings)
+    {
+        offset += (uint32_t)encodedString.length;
+        _WEAppendField(data, offset);
+    }
+    
+    _WEAppendRecords(data, _operations);
+    _WEAppendRecords(data, _dependencies);
+    _WEAppendRecords(data, _segues);
+    
+    for (NSData *encodedString in encodedStrings)
+    {
+        [data appendData:encodedString];
+    }
+    return [data copy];
+}
+
+- (WEWorkflowDefinition *)definition
+{
+    NSError *error;
+    WEWorkflowDefinition *definition = [[WEWorkflowDefinition alloc] initWithData:[self data] error:&error];
+    if (definition == nil) THROW_INCONSISTENCY(@{ NSUnderlyingErrorKey: error });
+    return definition;
+}
+
+@end
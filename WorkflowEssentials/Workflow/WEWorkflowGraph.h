@@ -0,0 +1,207 @@
+//
+//  WEWorkflowGraph.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEOperation;
+@class WEStreamChannel;
+
+// Index of a node (operation) in the graph.
+typedef uint32_t WEGraphIndex;
+
+// Marks an absent index, e.g. no preferred worker.
+static const WEGraphIndex WEGraphNoIndex = UINT32_MAX;
+
+typedef enum : uint8_t
+{
+    WEGraphNodePending,
+    WEGraphNodeReady,
+    WEGraphNodeActive,
+    WEGraphNodeComplete,
+    // Can no longer run: all of its incoming segues were resolved without activating, one of the operations
+    // it depends on was skipped, or its quorum can no longer be reached.
+    WEGraphNodeSkipped
+} WEGraphNodeStatus;
+
+typedef enum : uint8_t
+{
+    WEGraphPrefetchNone,
+    WEGraphPrefetchInFlight,
+    // Prefetch is in flight, and the node is already active and waits for it to finish before being prepared.
+    WEGraphPrefetchInFlightAwaited,
+    WEGraphPrefetchDone
+} WEGraphPrefetchState;
+
+// Execution graph of a single workflow run, laid out as a struct of arrays indexed by node.
+// Adjacency is stored in compressed sparse row form: outgoing edges of node `i` are
+// `dependents[dependentOffsets[i]]` up to `dependents[dependentOffsets[i + 1]]`, and the same for segues.
+// The structure and all of its arrays are carved out of a single allocation, which is made once per run
+// and freed when the run completes.
+// Operations, segue conditions and stream channels are not retained, the workflow keeps them alive for the duration of the run.
+typedef struct
+{
+    WEGraphIndex nodeCount;
+    WEGraphIndex dependencyCount;
+    WEGraphIndex segueCount;
+
+    WEOperation * __unsafe_unretained *operations;
+    WEGraphNodeStatus *statuses;
+
+    // Dependencies are unordered, all dependencies need to be fulfilled before their target can execute.
+    WEGraphIndex *dependentOffsets;
+    WEGraphIndex *dependents;
+    WEGraphIndex *dependsOnCounts;
+    WEGraphIndex *completedDependsOnCounts;
+    // A dependency that is a stream has a channel, and is fulfilled by the first chunk sent through it,
+    // or by completion of its source, whichever comes first.
+    WEStreamChannel * __unsafe_unretained *dependencyChannels;
+    uint8_t *dependencyFulfilled;
+    // Dependencies that are quorums are not counted in `dependsOnCounts`. A node with a quorum needs `quorumCounts` of its
+    // quorum sources to succeed, and is dead once so many of them failed or were skipped that it never can. Zero for
+    // nodes without a quorum.
+    uint8_t *dependencyQuorum;
+    WEGraphIndex *quorumCounts;
+    WEGraphIndex *quorumSourceCounts;
+    WEGraphIndex *succeededQuorumCounts;
+    WEGraphIndex *failedQuorumCounts;
+
+    // Segues are ordered, outgoing segues of a node fire in the order they were added.
+    // A condition is `nil` for an unconditional segue.
+    WEGraphIndex *segueOffsets;
+    WEGraphIndex *segueTargets;
+    NSPredicate * __unsafe_unretained *segueConditions;
+    uint8_t *segueLikely;
+    WEGraphIndex *incomingSegueCounts;
+    WEGraphIndex *activatedIncomingSegueCounts;
+    // Incoming segues whose source has completed or was skipped, whether they were activated or not.
+    WEGraphIndex *resolvedIncomingSegueCounts;
+
+    // Operations of a sub-workflow are barrier children of the sub-workflow's node, which cannot become ready
+    // until all of its barrier children have completed or were skipped. `WEGraphNoIndex` for top level nodes.
+    WEGraphIndex *barrierTargets;
+    WEGraphIndex *barrierCounts;
+    WEGraphIndex *resolvedBarrierCounts;
+
+    // Work-stealing locality: the worker that performed the predecessor which made the node ready.
+    WEGraphIndex *preferredWorkers;
+
+    // Linear chain fusion: the only dependent of a node, which depends on nothing else and is started on the thread
+    // that completes the node, without a round trip through the scheduler. `WEGraphNoIndex` for nodes that are not fused.
+    WEGraphIndex *fusedSuccessors;
+
+    // Speculative prefetch of targets of likely segues.
+    WEGraphPrefetchState *prefetchStates;
+
+    // Timeline of the run, in monotonic nanoseconds, zero for nodes that have not reached the stage.
+    // A node is ready when the predecessor that made it ready completes, and that predecessor is recorded
+    // (`WEGraphNoIndex` for nodes that were ready from the start). Segues activated while their target was pending
+    // and the order in which nodes completed are recorded as well, which is enough to reconstruct the realized graph of the run.
+    uint64_t *readyTimes;
+    uint64_t *startTimes;
+    uint64_t *finishTimes;
+    WEGraphIndex *readyPredecessors;
+    WEGraphIndex *completionOrder;
+    uint8_t *segueActivated;
+
+    // FIFO of ready nodes. Every node becomes ready at most once per run, so it never wraps around.
+    WEGraphIndex *readyQueue;
+    WEGraphIndex readyHead;
+    WEGraphIndex readyTail;
+
+    // Skipped nodes in the order they were skipped. Every node is skipped at most once per run.
+    WEGraphIndex *skippedNodes;
+
+    WEGraphIndex activeCount;
+    WEGraphIndex completedCount;
+    WEGraphIndex skippedCount;
+} WEWorkflowGraph;
+
+/**
+ Allocates a graph with all counters zeroed, no preferred workers, no barrier targets and no fused successors.
+ Offsets, targets and operations are filled in by the caller.
+ */
+FOUNDATION_EXTERN WEWorkflowGraph * _Nonnull WEWorkflowGraphCreate(WEGraphIndex nodeCount, WEGraphIndex dependencyCount, WEGraphIndex segueCount);
+
+/**
+ Frees the graph and all of its arrays. Does nothing for `NULL`.
+ */
+FOUNDATION_EXTERN void WEWorkflowGraphDestroy(WEWorkflowGraph * _Nullable graph);
+
+static inline WEGraphIndex WEWorkflowGraphReadyCount(const WEWorkflowGraph * _Nullable graph)
+{
+    return (graph != NULL) ? graph->readyTail - graph->readyHead : 0;
+}
+
+static inline void WEWorkflowGraphEnqueueReady(WEWorkflowGraph * _Nonnull graph, WEGraphIndex node, WEGraphIndex predecessor, uint64_t time)
+{
+    graph->statuses[node] = WEGraphNodeReady;
+    graph->readyPredecessors[node] = predecessor;
+    graph->readyTimes[node] = time;
+    graph->readyQueue[graph->readyTail++] = node;
+}
+
+// A node is dead once all of its incoming segues were resolved and none of them was activated.
+static inline BOOL WEWorkflowGraphNodeIsDead(const WEWorkflowGraph * _Nonnull graph, WEGraphIndex node)
+{
+    WEGraphIndex incoming = graph->incomingSegueCounts[node];
+    return incoming > 0 && graph->resolvedIncomingSegueCounts[node] == incoming && graph->activatedIncomingSegueCounts[node] == 0;
+}
+
+// A node's quorum is unreachable once fewer of its quorum sources are left than it still needs.
+static inline BOOL WEWorkflowGraphQuorumIsUnreachable(const WEWorkflowGraph * _Nonnull graph, WEGraphIndex node)
+{
+    return graph->quorumSourceCounts[node] - graph->failedQuorumCounts[node] < graph->quorumCounts[node];
+}
+
+// A pending node can become ready once all of its dependencies have completed, its quorum (if it has one) was reached,
+// one of its incoming segues (if it has any) was activated, and all of its barrier children were resolved.
+static inline BOOL WEWorkflowGraphNodeIsEligible(const WEWorkflowGraph * _Nonnull graph, WEGraphIndex node)
+{
+    return graph->statuses[node] == WEGraphNodePending
+        && graph->completedDependsOnCounts[node] == graph->dependsOnCounts[node]
+        && graph->succeededQuorumCounts[node] >= graph->quorumCounts[node]
+        && (graph->incomingSegueCounts[node] == 0 || graph->activatedIncomingSegueCounts[node] > 0)
+        && graph->resolvedBarrierCounts[node] == graph->barrierCounts[node];
+}
+
+// Moves the ready node at `position` of the ready queue to its front, keeping the order of the others.
+static inline void WEWorkflowGraphMoveReadyToFront(WEWorkflowGraph * _Nonnull graph, WEGraphIndex position)
+{
+    WEGraphIndex node = graph->readyQueue[position];
+    memmove(&graph->readyQueue[graph->readyHead + 1], &graph->readyQueue[graph->readyHead], (position - graph->readyHead) * sizeof(WEGraphIndex));
+    graph->readyQueue[graph->readyHead] = node;
+}
+
+static inline WEGraphIndex WEWorkflowGraphDequeueReady(WEWorkflowGraph * _Nonnull graph)
+{
+    WEGraphIndex node = graph->readyQueue[graph->readyHead++];
+    graph->statuses[node] = WEGraphNodeActive;
+    graph->activeCount++;
+    return node;
+}
+
+/**
+ Completes an active node at `time`, and propagates its completion through the graph.
+ Dependents whose dependencies are all fulfilled and targets of activated segues become ready, with the node as their
+ predecessor and `preferredWorker` as their preferred worker. A successful `result` counts towards quorums of the node's
+ dependents, and a failed one may make their quorums unreachable. A segue is activated if it has no condition, or its condition
+ holds on `result`. Targets of segues that were not activated may become dead, and are skipped along with everything
+ that follows them. When nothing is running or ready afterwards, pending nodes can only be waiting for segues from each
+ other, and are skipped as well. Skipped nodes are appended to `skippedNodes`.
+ Stream channels of the node's outgoing dependencies are left to the caller.
+ */
+FOUNDATION_EXTERN void WEWorkflowGraphCompleteNode(WEWorkflowGraph * _Nonnull graph, WEGraphIndex node, id _Nullable result, uint64_t time, WEGraphIndex preferredWorker);
+
+/**
+ Cancels a node that has not completed: a ready node is removed from the ready queue, and an active node stops counting
+ as active. The node is skipped along with everything that follows it, with `cause` as the node that led to skipping.
+ Returns the position the node had in the ready queue, or `WEGraphNoIndex` if it was not ready.
+ */
+FOUNDATION_EXTERN WEGraphIndex WEWorkflowGraphCancelNode(WEWorkflowGraph * _Nonnull graph, WEGraphIndex node, WEGraphIndex cause, uint64_t time);
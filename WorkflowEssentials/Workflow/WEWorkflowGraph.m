@@ -0,0 +1,325 @@
+//
+//  WEWorkflowGraph.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import "WEWorkflowGraph.h"
+
+#import <WorkflowEssentials/WEOperationResult.h>
+#import "WETools.h"
+
+static inline size_t _WEAlign(size_t size)
+{
+    return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+WEWorkflowGraph *WEWorkflowGraphCreate(WEGraphIndex nodeCount, WEGraphIndex dependencyCount, WEGraphIndex segueCount)
+{
+    // Arrays of times go first, followed by arrays of pointers, indexes and statuses, so every array is naturally aligned.
+    size_t nodeIndexes = (size_t)nodeCount * sizeof(WEGraphIndex);
+    size_t nodeTimes = (size_t)nodeCount * sizeof(uint64_t);
+    size_t offsetIndexes = ((size_t)nodeCount + 1) * sizeof(WEGraphIndex);
+    size_t size = _WEAlign(sizeof(WEWorkflowGraph))
+                + nodeTimes * 3
+                + (size_t)nodeCount * sizeof(void *)
+                + (size_t)segueCount * sizeof(void *)
+                + (size_t)dependencyCount * sizeof(void *)
+                + offsetIndexes * 2
+                + (size_t)dependencyCount * sizeof(WEGraphIndex)
+                + (size_t)segueCount * sizeof(WEGraphIndex)
+                + nodeIndexes * 18
+                + (size_t)nodeCount * sizeof(WEGraphNodeStatus)
+                + (size_t)nodeCount * sizeof(WEGraphPrefetchState)
+                + (size_t)segueCount * sizeof(uint8_t) * 2
+                + (size_t)dependencyCount * sizeof(uint8_t) * 2;
+
+    uint8_t *arena = calloc(1, size);
+    if (arena == NULL) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate the workflow graph" });
+
+    WEWorkflowGraph *graph = (WEWorkflowGraph *)arena;
+    uint8_t *cursor = arena + _WEAlign(sizeof(WEWorkflowGraph));
+
+    graph->nodeCount = nodeCount;
+    graph->dependencyCount = dependencyCount;
+    graph->segueCount = segueCount;
+
+    graph->readyTimes = (uint64_t *)(void *)cursor;
+    cursor += nodeTimes;
+    graph->startTimes = (uint64_t *)(void *)cursor;
+    cursor += nodeTimes;
+    graph->finishTimes = (uint64_t *)(void *)cursor;
+    cursor += nodeTimes;
+
+    graph->operations = (WEOperation * __unsafe_unretained *)(void *)cursor;
+    cursor += (size_t)nodeCount * sizeof(void *);
+    graph->segueConditions = (NSPredicate * __unsafe_unretained *)(void *)cursor;
+    cursor += (size_t)segueCount * sizeof(void *);
+    graph->dependencyChannels = (WEStreamChannel * __unsafe_unretained *)(void *)cursor;
+    cursor += (size_t)dependencyCount * sizeof(void *);
+
+    graph->dependentOffsets = (WEGraphIndex *)cursor;
+    cursor += offsetIndexes;
+    graph->segueOffsets = (WEGraphIndex *)cursor;
+    cursor += offsetIndexes;
+    graph->dependents = (WEGraphIndex *)cursor;
+    cursor += (size_t)dependencyCount * sizeof(WEGraphIndex);
+    graph->segueTargets = (WEGraphIndex *)cursor;
+    cursor += (size_t)segueCount * sizeof(WEGraphIndex);
+
+    graph->dependsOnCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->completedDependsOnCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->incomingSegueCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->activatedIncomingSegueCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->resolvedIncomingSegueCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->barrierTargets = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->barrierCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->resolvedBarrierCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->quorumCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->quorumSourceCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->succeededQuorumCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->failedQuorumCounts = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->preferredWorkers = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->fusedSuccessors = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->readyQueue = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->skippedNodes = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->readyPredecessors = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+    graph->completionOrder = (WEGraphIndex *)cursor;
+    cursor += nodeIndexes;
+
+    graph->statuses = (WEGraphNodeStatus *)cursor;
+    cursor += (size_t)nodeCount * sizeof(WEGraphNodeStatus);
+    graph->prefetchStates = (WEGraphPrefetchState *)cursor;
+    cursor += (size_t)nodeCount * sizeof(WEGraphPrefetchState);
+    graph->segueLikely = cursor;
+    cursor += (size_t)segueCount * sizeof(uint8_t);
+    graph->segueActivated = cursor;
+    cursor += (size_t)segueCount * sizeof(uint8_t);
+    graph->dependencyFulfilled = cursor;
+    cursor += (size_t)dependencyCount * sizeof(uint8_t);
+    graph->dependencyQuorum = cursor;
+    cursor += (size_t)dependencyCount * sizeof(uint8_t);
+    WEAssert(cursor == arena + size);
+
+    memset(graph->preferredWorkers, 0xFF, nodeIndexes);
+    memset(graph->barrierTargets, 0xFF, nodeIndexes);
+    memset(graph->fusedSuccessors, 0xFF, nodeIndexes);
+
+    return graph;
+}
+
+void WEWorkflowGraphDestroy(WEWorkflowGraph *graph)
+{
+    // The graph is the head of its own arena.
+    free(graph);
+}
+
+// Resolves a barrier child of a sub-workflow node, which makes the sub-workflow ready once its last child is resolved.
+// The predecessor is the completed node that the sub-workflow is ready after.
+static inline void _WEResolveBarrier(WEWorkflowGraph *graph, WEGraphIndex child, WEGraphIndex predecessor, uint64_t time)
+{
+    WEGraphIndex target = graph->barrierTargets[child];
+    if (target == WEGraphNoIndex) return;
+    
+    graph->resolvedBarrierCounts[target]++;
+    if (WEWorkflowGraphNodeIsEligible(graph, target))
+    {
+        WEWorkflowGraphEnqueueReady(graph, target, predecessor, time);
+    }
+}
+
+// Counts a source of a quorum that failed or was skipped. The target is skipped once its quorum cannot be reached.
+static inline void _WEFailQuorumSource(WEWorkflowGraph *graph, WEGraphIndex target)
+{
+    graph->failedQuorumCounts[target]++;
+    if (graph->statuses[target] == WEGraphNodePending && WEWorkflowGraphQuorumIsUnreachable(graph, target))
+    {
+        graph->statuses[target] = WEGraphNodeSkipped;
+        graph->skippedNodes[graph->skippedCount++] = target;
+    }
+}
+
+// Skips the node and propagates: dependents of a skipped node are skipped unless their quorum can still be reached without it,
+// and its outgoing segues are resolved without being activated, which may make their targets dead. A skipped node resolves
+// its barrier target.
+// The cause is the completed node that led to skipping.
+static void _WESkipNode(WEWorkflowGraph *graph, WEGraphIndex node, WEGraphIndex cause, uint64_t time)
+{
+    WEAssert(graph->statuses[node] == WEGraphNodePending);
+    
+    // Skipped nodes past the cursor are yet to be propagated.
+    WEGraphIndex cursor = graph->skippedCount;
+    graph->statuses[node] = WEGraphNodeSkipped;
+    graph->skippedNodes[graph->skippedCount++] = node;
+    
+    while (cursor < graph->skippedCount)
+    {
+        WEGraphIndex skipped = graph->skippedNodes[cursor++];
+        _WEResolveBarrier(graph, skipped, cause, time);
+        
+        for (WEGraphIndex edge = graph->dependentOffsets[skipped], end = graph->dependentOffsets[skipped + 1]; edge < end; edge++)
+        {
+            WEGraphIndex dependent = graph->dependents[edge];
+            if (graph->dependencyQuorum[edge])
+            {
+                _WEFailQuorumSource(graph, dependent);
+            }
+            else if (graph->statuses[dependent] == WEGraphNodePending)
+            {
+                graph->statuses[dependent] = WEGraphNodeSkipped;
+                graph->skippedNodes[graph->skippedCount++] = dependent;
+            }
+        }
+        
+        for (WEGraphIndex edge = graph->segueOffsets[skipped], end = graph->segueOffsets[skipped + 1]; edge < end; edge++)
+        {
+            WEGraphIndex target = graph->segueTargets[edge];
+            graph->resolvedIncomingSegueCounts[target]++;
+            if (graph->statuses[target] == WEGraphNodePending && WEWorkflowGraphNodeIsDead(graph, target))
+            {
+                graph->statuses[target] = WEGraphNodeSkipped;
+                graph->skippedNodes[graph->skippedCount++] = target;
+            }
+        }
+    }
+}
+
+void WEWorkflowGraphCompleteNode(WEWorkflowGraph *graph, WEGraphIndex node, id result, uint64_t time, WEGraphIndex preferredWorker)
+{
+    WEAssert(node < graph->nodeCount);
+    WEAssert(graph->statuses[node] == WEGraphNodeActive);
+    
+    graph->statuses[node] = WEGraphNodeComplete;
+    graph->finishTimes[node] = time;
+    graph->activeCount--;
+    graph->completionOrder[graph->completedCount++] = node;
+    
+    // check if any operations depending on the one just completed can now run
+    BOOL succeeded = (result != nil && ![(WEOperationResult *)result isFailed]);
+    for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+    {
+        // A stream may have fulfilled the dependency with its first chunk already.
+        if (graph->dependencyFulfilled[edge]) continue;
+        
+        WEGraphIndex dependent = graph->dependents[edge];
+        if (graph->dependencyQuorum[edge])
+        {
+            graph->dependencyFulfilled[edge] = 1;
+            if (!succeeded)
+            {
+                graph->failedQuorumCounts[dependent]++;
+                if (graph->statuses[dependent] == WEGraphNodePending && WEWorkflowGraphQuorumIsUnreachable(graph, dependent))
+                {
+                    _WESkipNode(graph, dependent, node, time);
+                }
+                continue;
+            }
+            graph->succeededQuorumCounts[dependent]++;
+            if (WEWorkflowGraphNodeIsEligible(graph, dependent))
+            {
+                graph->preferredWorkers[dependent] = preferredWorker;
+                WEWorkflowGraphEnqueueReady(graph, dependent, node, time);
+            }
+            continue;
+        }
+        
+        WEAssert(graph->completedDependsOnCounts[dependent] < graph->dependsOnCounts[dependent]);
+        graph->dependencyFulfilled[edge] = 1;
+        graph->completedDependsOnCounts[dependent]++;
+        if (WEWorkflowGraphNodeIsEligible(graph, dependent))
+        {
+            graph->preferredWorkers[dependent] = preferredWorker;
+            WEWorkflowGraphEnqueueReady(graph, dependent, node, time);
+        }
+    }
+    
+    // activate outgoing segues, targets of segues that were not activated may become dead.
+    for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+    {
+        WEGraphIndex target = graph->segueTargets[edge];
+        WEAssert(graph->incomingSegueCounts[target] > 0);
+        graph->resolvedIncomingSegueCounts[target]++;
+        
+        // evaluate the segue condition
+        NSPredicate *condition = graph->segueConditions[edge];
+        if (condition != nil && ![condition evaluateWithObject:result])
+        {
+            if (graph->statuses[target] == WEGraphNodePending && WEWorkflowGraphNodeIsDead(graph, target))
+            {
+                _WESkipNode(graph, target, node, time);
+            }
+            continue;
+        }
+        
+        graph->activatedIncomingSegueCounts[target]++;
+        // A segue activated after its target became ready does not constrain the target.
+        if (graph->statuses[target] == WEGraphNodePending) graph->segueActivated[edge] = 1;
+        
+        if (WEWorkflowGraphNodeIsEligible(graph, target))
+        {
+            graph->preferredWorkers[target] = preferredWorker;
+            WEWorkflowGraphEnqueueReady(graph, target, node, time);
+        }
+    }
+    
+    // the sub-workflow the operation belongs to may now be complete.
+    _WEResolveBarrier(graph, node, node, time);
+    
+    // When nothing is running or ready, operations that are still pending in a workflow with segues can only be
+    // waiting for segues from each other, none of which can ever be activated. Operations of sub-workflows follow
+    // their sub-workflows, so going backwards resolves sub-workflows before they are visited. Once a sub-workflow
+    // becomes ready, operations that wait for it are no longer stuck.
+    if (graph->activeCount == 0 && WEWorkflowGraphReadyCount(graph) == 0 && graph->segueCount > 0)
+    {
+        for (WEGraphIndex other = graph->nodeCount; other > 0 && WEWorkflowGraphReadyCount(graph) == 0; other--)
+        {
+            if (graph->statuses[other - 1] == WEGraphNodePending) _WESkipNode(graph, other - 1, node, time);
+        }
+    }
+}
+
+WEGraphIndex WEWorkflowGraphCancelNode(WEWorkflowGraph *graph, WEGraphIndex node, WEGraphIndex cause, uint64_t time)
+{
+    WEAssert(node < graph->nodeCount);
+    
+    WEGraphIndex position = WEGraphNoIndex;
+    switch (graph->statuses[node])
+    {
+        case WEGraphNodeReady:
+            for (position = graph->readyHead; graph->readyQueue[position] != node; position++) {}
+            memmove(&graph->readyQueue[position], &graph->readyQueue[position + 1], (graph->readyTail - position - 1) * sizeof(WEGraphIndex));
+            graph->readyTail--;
+            break;
+        case WEGraphNodeActive:
+            graph->activeCount--;
+            break;
+        default:
+            WEAssert(graph->statuses[node] == WEGraphNodePending);
+            break;
+    }
+    
+    graph->statuses[node] = WEGraphNodePending;
+    _WESkipNode(graph, node, cause, time);
+    return position;
+}
@@ -0,0 +1,25 @@
+//
+//  WEWorkflowReport+Private.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflowReport.h>
+
+#import "WEWorkflowGraph.h"
+
+@interface WEWorkflowReport ()
+
+/**
+ Analyzes the timeline of a run that completed successfully.
+ @param graph graph of the run, is only read during initialization
+ @param operations operations the graph refers to, in node order
+ @param startTime monotonic time the run started
+ */
+- (nonnull instancetype)_initWithGraph:(nonnull const WEWorkflowGraph *)graph operations:(nonnull NSArray<WEOperation *> *)operations startTime:(uint64_t)startTime;
+
+@end
@@ -0,0 +1,104 @@
+//
+//  WEWorkflowReport.h
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <Foundation/Foundation.h>
+
+@class WEOperation;
+
+/**
+ Timing of a single operation in a workflow run. All times are in seconds since the workflow run started.
+ */
+@interface WEOperationReport : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly, strong, nonnull) WEOperation *operation;
+
+/**
+ Time the operation became ready: all of its dependencies were fulfilled and, if it has incoming segues, one of them was activated.
+ */
+@property (nonatomic, readonly) NSTimeInterval readyTime;
+
+/**
+ Time the operation started executing, after it was admitted and prepared.
+ */
+@property (nonatomic, readonly) NSTimeInterval startTime;
+
+/**
+ Time the workflow received the result of the operation.
+ */
+@property (nonatomic, readonly) NSTimeInterval finishTime;
+
+/**
+ Time between the operation becoming ready and starting, which includes waiting for concurrency limits and preparation.
+ */
+@property (nonatomic, readonly) NSTimeInterval queueWaitTime;
+
+/**
+ Time between the operation starting and finishing.
+ */
+@property (nonatomic, readonly) NSTimeInterval executionTime;
+
+/**
+ How much later the operation could have finished without delaying the end of the run, given the realized
+ timing of operations that followed it. Zero for operations on the critical path.
+ */
+@property (nonatomic, readonly) NSTimeInterval slack;
+
+@property (nonatomic, readonly, getter=isOnCriticalPath) BOOL onCriticalPath;
+
+@end
+
+/**
+ Post-run analysis of a workflow that completed successfully, see `-[WEWorkflow report]`.
+ The realized graph of the run consists of operations that ran, dependencies between them, segues that were activated,
+ and edges from operations of sub-workflows to their sub-workflows.
+ The critical path is the chain of operations in that graph that determined when the run ended: it ends with
+ the operation that finished last, and each operation on it was made ready by the completion of the previous one.
+ Immutable and thread safe.
+ */
+@interface WEWorkflowReport : NSObject
+
+- (nullable instancetype)init NS_UNAVAILABLE;
+
+/**
+ Time (in seconds) from the start of the run until the last operation finished.
+ */
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+/**
+ Reports of operations that ran, in the order the operations were added to the workflow.
+ Skipped operations are not included.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<WEOperationReport *> *operationReports;
+
+/**
+ Reports of operations on the critical path, in the order they ran.
+ */
+@property (nonatomic, readonly, nonnull) NSArray<WEOperationReport *> *criticalPath;
+
+/**
+ Returns the report of an operation, or `nil` if the operation did not run.
+ */
+- (nullable WEOperationReport *)reportForOperation:(nonnull WEOperation *)operation;
+
+/**
+ Realized graph of the run in Graphviz DOT format. Critical path is highlighted, and every operation is labeled
+ with its queue wait, execution time and slack.
+ */
+- (nonnull NSString *)DOTRepresentation;
+
+/**
+ Report in JSON format: duration, operations with their timing, realized edges between operations and
+ the critical path, where operations are referred to by their position in `operationReports`.
+ */
+- (nonnull NSData *)JSONRepresentation;
+
+@end
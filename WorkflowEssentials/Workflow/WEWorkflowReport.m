@@ -0,0 +1,396 @@
+//
+//  WEWorkflowReport.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <WorkflowEssentials/WEWorkflowReport.h>
+
+#import <WorkflowEssentials/WEOperation.h>
+
+#import <pthread.h>
+#import "WETools.h"
+#import "WEWorkflowReport+Private.h"
+
+// Timing of an operation that ran, in nanoseconds since the start of the run.
+typedef struct
+{
+    WEGraphIndex node;
+    uint64_t readyTime;
+    uint64_t startTime;
+    uint64_t finishTime;
+    uint64_t slack;
+    BOOL onCriticalPath;
+} _WEOperationTiming;
+
+static inline NSTimeInterval _WESeconds(uint64_t nanoseconds)
+{
+    return (NSTimeInterval)nanoseconds / NSEC_PER_SEC;
+}
+
+@interface WEOperationReport ()
+- (instancetype)_initWithOperation:(WEOperation *)operation timing:(_WEOperationTiming)timing;
+@end
+
+@implementation WEOperationReport
+{
+    WEOperation *_operation;
+    _WEOperationTiming _timing;
+}
+
+- (instancetype)_initWithOperation:(WEOperation *)operation timing:(_WEOperationTiming)timing
+{
+    if (self = [super init])
+    {
+        _operation = operation;
+        _timing = timing;
+    }
+    return self;
+}
+
+@synthesize operation = _operation;
+
+- (NSTimeInterval)readyTime
+{
+    return _WESeconds(_timing.readyTime);
+}
+
+- (NSTimeInterval)startTime
+{
+    return _WESeconds(_timing.startTime);
+}
+
+- (NSTimeInterval)finishTime
+{
+    return _WESeconds(_timing.finishTime);
+}
+
+- (NSTimeInterval)queueWaitTime
+{
+    return _WESeconds(_timing.startTime - _timing.readyTime);
+}
+
+- (NSTimeInterval)executionTime
+{
+    return _WESeconds(_timing.finishTime - _timing.startTime);
+}
+
+- (NSTimeInterval)slack
+{
+    return _WESeconds(_timing.slack);
+}
+
+- (BOOL)isOnCriticalPath
+{
+    return _timing.onCriticalPath;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p; operation = %@; ready = %.6f; start = %.6f; finish = %.6f; slack = %.6f>", NSStringFromClass([self class]), self, _operation, self.readyTime, self.startTime, self.finishTime, self.slack];
+}
+
+@end
+
+@implementation WEWorkflowReport
+{
+    NSArray<WEOperation *> *_operations;
+    uint64_t _duration;
+    
+    // Operations that ran, in node order, and realized edges and critical path as indexes into timings.
+    _WEOperationTiming *_timings;
+    WEGraphIndex _timingCount;
+    WEGraphIndex *_edges;
+    WEGraphIndex _edgeCount;
+    WEGraphIndex *_criticalPath;
+    WEGraphIndex _criticalPathLength;
+    
+    // Report objects are only made when asked for, as most reports are never looked at in detail.
+    pthread_mutex_t _mutex;
+    NSArray<WEOperationReport *> *_operationReports;
+}
+
+- (instancetype)_initWithGraph:(const WEWorkflowGraph *)graph operations:(NSArray<WEOperation *> *)operations startTime:(uint64_t)startTime
+{
+    WEAssert(graph->completedCount > 0);
+    
+    if (self = [super init])
+    {
+        pthread_mutex_init(&_mutex, NULL);
+        _operations = operations;
+        
+        WEGraphIndex nodeCount = graph->nodeCount;
+        WEGraphIndex completedCount = graph->completedCount;
+        
+        // Latest finish of a node is the latest time it could have finished without delaying the end of the run.
+        // It is computed in reverse completion order, which is a reverse topological order of the realized graph,
+        // as the time each successor could have become ready at the latest, given its realized time from ready to finish.
+        uint64_t *latestFinishes = malloc(nodeCount * sizeof(uint64_t));
+        WEGraphIndex *timingIndexes = malloc(nodeCount * sizeof(WEGraphIndex));
+        _timings = malloc(completedCount * sizeof(_WEOperationTiming));
+        _criticalPath = malloc(completedCount * sizeof(WEGraphIndex));
+        if (latestFinishes == NULL || timingIndexes == NULL || _timings == NULL || _criticalPath == NULL)
+        {
+            free(latestFinishes);
+            free(timingIndexes);
+            THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate the workflow report" });
+        }
+        
+        WEGraphIndex lastNode = graph->completionOrder[completedCount - 1];
+        uint64_t endTime = graph->finishTimes[lastNode];
+        _duration = endTime - startTime;
+        
+        WEGraphIndex edgeCount = 0;
+        for (WEGraphIndex i = completedCount; i > 0; i--)
+        {
+            WEGraphIndex node = graph->completionOrder[i - 1];
+            uint64_t latestFinish = endTime;
+            
+            for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+            {
+                WEGraphIndex successor = graph->dependents[edge];
+                if (graph->statuses[successor] != WEGraphNodeComplete) continue;
+                edgeCount++;
+                // A stream target may be ready while its source is still running, such an edge does not constrain the source.
+                if (graph->readyTimes[successor] < graph->finishTimes[node]) continue;
+                latestFinish = MIN(latestFinish, latestFinishes[successor] - (graph->finishTimes[successor] - graph->readyTimes[successor]));
+            }
+            for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+            {
+                WEGraphIndex successor = graph->segueTargets[edge];
+                if (!graph->segueActivated[edge] || graph->statuses[successor] != WEGraphNodeComplete) continue;
+                latestFinish = MIN(latestFinish, latestFinishes[successor] - (graph->finishTimes[successor] - graph->readyTimes[successor]));
+                edgeCount++;
+            }
+            WEGraphIndex barrierTarget = graph->barrierTargets[node];
+            if (barrierTarget != WEGraphNoIndex && graph->statuses[barrierTarget] == WEGraphNodeComplete)
+            {
+                latestFinish = MIN(latestFinish, latestFinishes[barrierTarget] - (graph->finishTimes[barrierTarget] - graph->readyTimes[barrierTarget]));
+                edgeCount++;
+            }
+            
+            // A successor becomes ready no earlier than its predecessors finish, so latest finish is never earlier than finish.
+            WEAssert(latestFinish >= graph->finishTimes[node]);
+            latestFinishes[node] = latestFinish;
+        }
+        
+        for (WEGraphIndex node = 0; node < nodeCount; node++)
+        {
+            if (graph->statuses[node] != WEGraphNodeComplete)
+            {
+                timingIndexes[node] = WEGraphNoIndex;
+                continue;
+            }
+            
+            timingIndexes[node] = _timingCount;
+            _timings[_timingCount++] = (_WEOperationTiming){
+                .node = node,
+                .readyTime = graph->readyTimes[node] - startTime,
+                .startTime = graph->startTimes[node] - startTime,
+                .finishTime = graph->finishTimes[node] - startTime,
+                .slack = latestFinishes[node] - graph->finishTimes[node],
+            };
+        }
+        WEAssert(_timingCount == completedCount);
+        
+        // Walk back from the operation that finished last, through predecessors that made each operation ready.
+        for (WEGraphIndex node = lastNode; node != WEGraphNoIndex; node = graph->readyPredecessors[node])
+        {
+            _criticalPath[_criticalPathLength++] = timingIndexes[node];
+            _timings[timingIndexes[node]].onCriticalPath = YES;
+        }
+        for (WEGraphIndex i = 0; i < _criticalPathLength / 2; i++)
+        {
+            WEGraphIndex swap = _criticalPath[i];
+            _criticalPath[i] = _criticalPath[_criticalPathLength - 1 - i];
+            _criticalPath[_criticalPathLength - 1 - i] = swap;
+        }
+        
+        _edges = malloc(MAX(edgeCount, 1) * 2 * sizeof(WEGraphIndex));
+        if (_edges == NULL)
+        {
+            free(latestFinishes);
+            free(timingIndexes);
+            THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate the workflow report" });
+        }
+        for (WEGraphIndex i = 0; i < _timingCount; i++)
+        {
+            WEGraphIndex node = _timings[i].node;
+            for (WEGraphIndex edge = graph->dependentOffsets[node], end = graph->dependentOffsets[node + 1]; edge < end; edge++)
+            {
+                WEGraphIndex successor = graph->dependents[edge];
+                if (graph->statuses[successor] != WEGraphNodeComplete) continue;
+                _edges[2 * _edgeCount] = i;
+                _edges[2 * _edgeCount + 1] = timingIndexes[successor];
+                _edgeCount++;
+            }
+            for (WEGraphIndex edge = graph->segueOffsets[node], end = graph->segueOffsets[node + 1]; edge < end; edge++)
+            {
+                WEGraphIndex successor = graph->segueTargets[edge];
+                if (!graph->segueActivated[edge] || graph->statuses[successor] != WEGraphNodeComplete) continue;
+                _edges[2 * _edgeCount] = i;
+                _edges[2 * _edgeCount + 1] = timingIndexes[successor];
+                _edgeCount++;
+            }
+            WEGraphIndex barrierTarget = graph->barrierTargets[node];
+            if (barrierTarget != WEGraphNoIndex && graph->statuses[barrierTarget] == WEGraphNodeComplete)
+            {
+                _edges[2 * _edgeCount] = i;
+                _edges[2 * _edgeCount + 1] = timingIndexes[barrierTarget];
+                _edgeCount++;
+            }
+        }
+        WEAssert(_edgeCount == edgeCount);
+        
+        free(latestFinishes);
+        free(timingIndexes);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_timings);
+    free(_edges);
+    free(_criticalPath);
+    pthread_mutex_destroy(&_mutex);
+}
+
+
+#pragma mark - Properties
+
+- (NSTimeInterval)duration
+{
+    return _WESeconds(_duration);
+}
+
+- (NSArray<WEOperationReport *> *)operationReports
+{
+    NSArray<WEOperationReport *> *operationReports;
+    ENTER_CRITICAL_SECTION(self, _mutex)
+    if (_operationReports == nil)
+    {
+        NSMutableArray<WEOperationReport *> *reports = [[NSMutableArray alloc] initWithCapacity:_timingCount];
+        for (WEGraphIndex i = 0; i < _timingCount; i++)
+        {
+            [reports addObject:[[WEOperationReport alloc] _initWithOperation:_operations[_timings[i].node] timing:_timings[i]]];
+        }
+        _operationReports = [reports copy];
+    }
+    operationReports = _operationReports;
+    LEAVE_CRITICAL_SECTION(self, _mutex)
+    return operationReports;
+}
+
+- (NSArray<WEOperationReport *> *)criticalPath
+{
+    NSArray<WEOperationReport *> *operationReports = self.operationReports;
+    NSMutableArray<WEOperationReport *> *criticalPath = [[NSMutableArray alloc] initWithCapacity:_criticalPathLength];
+    for (WEGraphIndex i = 0; i < _criticalPathLength; i++)
+    {
+        [criticalPath addObject:operationReports[_criticalPath[i]]];
+    }
+    return [criticalPath copy];
+}
+
+- (WEOperationReport *)reportForOperation:(WEOperation *)operation
+{
+    if (operation == nil) THROW_INVALID_PARAM(operation, nil);
+    
+    for (WEOperationReport *report in self.operationReports)
+    {
+        if (report.operation == operation) return report;
+    }
+    return nil;
+}
+
+
+#pragma mark - Export
+
+static NSString *_WEDOTEscaped(NSString *string)
+{
+    return [[string stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"] stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+}
+
+- (NSString *)DOTRepresentation
+{
+    NSMutableString *dot = [NSMutableString stringWithFormat:@"digraph workflow {\n  label=\"duration %.3f ms\";\n  node [shape=box];\n", _WESeconds(_duration) * 1000];
+    for (WEGraphIndex i = 0; i < _timingCount; i++)
+    {
+        const _WEOperationTiming *timing = &_timings[i];
+        WEOperation *operation = _operations[timing->node];
+        NSString *name = operation.name ?: NSStringFromClass([operation class]);
+        [dot appendFormat:@"  n%u [label=\"%@\\nwait %.3f ms, exec %.3f ms, slack %.3f ms\"%@];\n",
+         (unsigned)i, _WEDOTEscaped(name),
+         _WESeconds(timing->startTime - timing->readyTime) * 1000,
+         _WESeconds(timing->finishTime - timing->startTime) * 1000,
+         _WESeconds(timing->slack) * 1000,
+         timing->onCriticalPath ? @", color=red, penwidth=2" : @""];
+    }
+    
+    // An edge is on the critical path when it connects consecutive operations of the path.
+    WEGraphIndex *pathPositions = malloc(MAX(_timingCount, 1) * sizeof(WEGraphIndex));
+    if (pathPositions == NULL) THROW_INCONSISTENCY(@{ NSLocalizedDescriptionKey: @"Failed to allocate the workflow report" });
+    memset(pathPositions, 0xFF, _timingCount * sizeof(WEGraphIndex));
+    for (WEGraphIndex i = 0; i < _criticalPathLength; i++) pathPositions[_criticalPath[i]] = i;
+    
+    for (WEGraphIndex i = 0; i < _edgeCount; i++)
+    {
+        WEGraphIndex from = _edges[2 * i], to = _edges[2 * i + 1];
+        BOOL critical = pathPositions[from] != WEGraphNoIndex && pathPositions[to] == pathPositions[from] + 1;
+        [dot appendFormat:@"  n%u -> n%u%@;\n", (unsigned)from, (unsigned)to, critical ? @" [color=red, penwidth=2]" : @""];
+    }
+    free(pathPositions);
+    [dot appendString:@"}\n"];
+    return [dot copy];
+}
+
+- (NSData *)JSONRepresentation
+{
+    NSMutableArray *operations = [[NSMutableArray alloc] initWithCapacity:_timingCount];
+    for (WEGraphIndex i = 0; i < _timingCount; i++)
+    {
+        const _WEOperationTiming *timing = &_timings[i];
+        NSMutableDictionary *operation = [@{
+                                            @"ready": @(_WESeconds(timing->readyTime)),
+                                            @"start": @(_WESeconds(timing->startTime)),
+                                            @"finish": @(_WESeconds(timing->finishTime)),
+                                            @"queueWait": @(_WESeconds(timing->startTime - timing->readyTime)),
+                                            @"execution": @(_WESeconds(timing->finishTime - timing->startTime)),
+                                            @"slack": @(_WESeconds(timing->slack)),
+                                            @"critical": @(timing->onCriticalPath),
+                                            } mutableCopy];
+        NSString *name = _operations[timing->node].name;
+        if (name != nil) operation[@"name"] = name;
+        [operations addObject:operation];
+    }
+    
+    NSMutableArray *edges = [[NSMutableArray alloc] initWithCapacity:_edgeCount];
+    for (WEGraphIndex i = 0; i < _edgeCount; i++)
+    {
+        [edges addObject:@[ @(_edges[2 * i]), @(_edges[2 * i + 1]) ]];
+    }
+    
+    NSMutableArray *criticalPath = [[NSMutableArray alloc] initWithCapacity:_criticalPathLength];
+    for (WEGraphIndex i = 0; i < _criticalPathLength; i++)
+    {
+        [criticalPath addObject:@(_criticalPath[i])];
+    }
+    
+    NSDictionary *report = @{
+                             @"duration": @(_WESeconds(_duration)),
+                             @"operations": operations,
+                             @"edges": edges,
+                             @"criticalPath": criticalPath,
+                             };
+    NSError *error;
+    NSData *data = [NSJSONSerialization dataWithJSONObject:report options:0 error:&error];
+    if (data == nil) THROW_INCONSISTENCY(@{ NSUnderlyingErrorKey: error });
+    return data;
+}
+
+@end
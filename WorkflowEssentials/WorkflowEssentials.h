@@ -19,8 +19,26 @@ FOUNDATION_EXPORT const unsigned char WorkflowEssentialsVersionString[];
 #import <WorkflowEssentials/WEBlockOperation.h>
 #import <WorkflowEssentials/WEOperation.h>
 #import <WorkflowEssentials/WEOperationResult.h>
+#import <WorkflowEssentials/WEOperationRegistry.h>
+#import <WorkflowEssentials/WEReduceOperation.h>
+#import <WorkflowEssentials/WESubworkflowOperation.h>
 #import <WorkflowEssentials/WEWorkflow.h>
 #import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEWorkflowDefinition.h>
+#import <WorkflowEssentials/WEWorkflowDefinitionBuilder.h>
+#import <WorkflowEssentials/WEWorkflowReport.h>
 #import <WorkflowEssentials/WEConnectionDescription.h>
 #import <WorkflowEssentials/WEDependencyDescription.h>
 #import <WorkflowEssentials/WESegueDescription.h>
+#import <WorkflowEssentials/WEStreamDescription.h>
+#import <WorkflowEssentials/WEQuorumDescription.h>
+#import <WorkflowEssentials/WEStreamChannel.h>
+#import <WorkflowEssentials/WEOperationExecutor.h>
+#import <WorkflowEssentials/WEDispatchQueueExecutor.h>
+#import <WorkflowEssentials/WEInlineExecutor.h>
+#import <WorkflowEssentials/WEMainThreadExecutor.h>
+#import <WorkflowEssentials/WEExecutor.h>
+#import <WorkflowEssentials/WEConcurrencyController.h>
+#import <WorkflowEssentials/WERateLimiter.h>
+#import <WorkflowEssentials/WESimulationExecutor.h>
+#import <WorkflowEssentials/WEWorkStealingExecutor.h>
@@ -0,0 +1,145 @@
+//
+//  WEConcurrencyControllerTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WEConcurrencyController.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+
+@interface WEConcurrencyControllerTests : XCTestCase
+@end
+
+@implementation WEConcurrencyControllerTests
+
+- (void)testConcurrencyControllerInvalidParametersThrow
+{
+    XCTAssertThrows([[WEConcurrencyController alloc] initWithMinimumLimit:0 maximumLimit:1]);
+    XCTAssertThrows([[WEConcurrencyController alloc] initWithMinimumLimit:2 maximumLimit:1]);
+    
+    WEConcurrencyController *controller = [[WEConcurrencyController alloc] initWithMinimumLimit:2 maximumLimit:8];
+    XCTAssertEqual(controller.limit, 2);
+    XCTAssertThrows(controller.latencyTolerance = 1);
+    XCTAssertThrows(controller.errorRateThreshold = 1);
+    XCTAssertThrows(controller.backoffRatio = 0);
+    XCTAssertThrows(controller.backoffRatio = 1);
+}
+
+- (void)testConcurrencyControllerIncreasesAdditivelyAndDecreasesMultiplicatively
+{
+    // Steady latency grows the limit by one per window up to the maximum. A window with a latency above the tolerance
+    // halves the limit, a window with failures above the threshold halves it again, without going below the minimum.
+    
+    WEConcurrencyController *controller = [[WEConcurrencyController alloc] initWithMinimumLimit:1 maximumLimit:4];
+    
+    // Windows of 1, 2, 3 and 4 samples, the last one finds the limit at the maximum already.
+    for (NSUInteger i = 0; i < 1 + 2 + 3 + 4; i++)
+    {
+        [controller recordOperationWithLatency:0.01 failed:NO];
+    }
+    XCTAssertEqual(controller.limit, 4);
+    XCTAssertEqual(controller.increaseCount, 4);
+    XCTAssertEqual(controller.decreaseCount, 0);
+    XCTAssertEqualWithAccuracy(controller.baselineLatency, 0.01, 0.0001);
+    
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        [controller recordOperationWithLatency:0.05 failed:NO];
+    }
+    XCTAssertEqual(controller.limit, 2);
+    XCTAssertEqual(controller.decreaseCount, 1);
+    XCTAssertEqualWithAccuracy(controller.lastWindowLatency, 0.05, 0.0001);
+    
+    [controller recordOperationWithLatency:0.01 failed:YES];
+    [controller recordOperationWithLatency:0.01 failed:NO];
+    XCTAssertEqual(controller.limit, 1);
+    XCTAssertEqual(controller.decreaseCount, 2);
+    XCTAssertEqualWithAccuracy(controller.lastWindowErrorRate, 0.5, 0.0001);
+    
+    [controller recordOperationWithLatency:0.01 failed:YES];
+    XCTAssertEqual(controller.limit, 1);
+    XCTAssertEqual(controller.decreaseCount, 3);
+    XCTAssertEqual(controller.sampleCount, 17);
+}
+
+- (void)testConcurrencyControllerBaselineDriftsTowardsLastingLatency
+{
+    // After the latency triples for good, the controller backs off at first, then the baseline catches up
+    // and the limit grows again.
+    
+    WEConcurrencyController *controller = [[WEConcurrencyController alloc] initWithMinimumLimit:1 maximumLimit:1];
+    [controller recordOperationWithLatency:0.01 failed:NO];
+    [controller recordOperationWithLatency:0.03 failed:NO];
+    XCTAssertEqual(controller.decreaseCount, 1);
+    
+    NSUInteger increaseCount = controller.increaseCount;
+    for (NSUInteger i = 0; i < 100; i++)
+    {
+        [controller recordOperationWithLatency:0.03 failed:NO];
+    }
+    XCTAssertGreaterThan(controller.increaseCount, increaseCount);
+    XCTAssertEqualWithAccuracy(controller.baselineLatency, 0.03, 0.0001);
+}
+
+- (void)testWorkflowConcurrencyIsAdapted
+{
+    // This test creates a workflow with 20 independent operations of equal duration and a controller that allows
+    // between 1 and 4 of them at once. The workflow starts with one operation at a time and must never run more than
+    // the controller allows, while the limit grows.
+    
+    static const NSUInteger operationCount = 20;
+    WEConcurrencyController *controller = [[WEConcurrencyController alloc] initWithMinimumLimit:1 maximumLimit:4];
+    controller.latencyTolerance = 10;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.concurrencyController = controller;
+    XCTAssertEqual(workflow.concurrencyController, controller);
+    
+    NSObject *lock = [NSObject new];
+    __block NSUInteger runningCount = 0;
+    __block NSUInteger peakRunningCount = 0;
+    __block BOOL exceededLimit = NO;
+    for (NSUInteger i = 0; i < operationCount; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (lock)
+            {
+                runningCount++;
+                peakRunningCount = MAX(peakRunningCount, runningCount);
+                if (runningCount > controller.limit) exceededLimit = YES;
+            }
+            usleep(2000);
+            @synchronized (lock)
+            {
+                runningCount--;
+            }
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [workflow addOperation:operation];
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    XCTAssertThrows(workflow.concurrencyController = nil);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertFalse(exceededLimit);
+    XCTAssertLessThanOrEqual(peakRunningCount, 4);
+    XCTAssertEqual(controller.sampleCount, operationCount);
+    XCTAssertGreaterThan(controller.limit, 1);
+}
+
+@end
@@ -0,0 +1,172 @@
+//
+//  WEExecutorTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <stdatomic.h>
+#import <WorkflowEssentials/WEExecutor.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+
+@interface WEExecutorTests : XCTestCase
+@end
+
+@implementation WEExecutorTests
+
+- (void)testExecutorInitialState
+{
+    WEExecutor *executor = [[WEExecutor alloc] initWithMaximumConcurrentOperations:3];
+    XCTAssertEqual(executor.maximumConcurrentOperations, 3);
+    XCTAssertEqual(executor.activeOperationCount, 0);
+    XCTAssertEqual(executor.waitingOperationCount, 0);
+    XCTAssertGreaterThan(executor.schedulerQueueCount, 0);
+
+    WEExecutor *defaultExecutor = [[WEExecutor alloc] initWithMaximumConcurrentOperations:0];
+    XCTAssertEqual(defaultExecutor.maximumConcurrentOperations, [NSProcessInfo processInfo].activeProcessorCount);
+}
+
+- (void)testExecutorEnforcesGlobalLimitAcrossWorkflows
+{
+    // This test creates several workflows without their own concurrency limit on an executor
+    // that allows 2 concurrent operations. It ensures that all workflows complete and that no more
+    // than 2 operations were running at any point.
+
+    static const NSUInteger workflowCount = 4;
+    static const NSUInteger operationsPerWorkflow = 3;
+
+    WEExecutor *executor = [[WEExecutor alloc] initWithMaximumConcurrentOperations:2];
+    __block atomic_int running;
+    atomic_init(&running, 0);
+    __block atomic_int maximumRunning;
+    atomic_init(&maximumRunning, 0);
+
+    NSMutableArray<WEWorkflow *> *workflows = [NSMutableArray new];
+    NSMutableArray<XCTestExpectation *> *expectations = [NSMutableArray new];
+
+    for (NSUInteger w = 0; w < workflowCount; w++)
+    {
+        OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+        WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue() executor:executor];
+        XCTAssertEqual(workflow.executor, executor);
+
+        for (NSUInteger o = 0; o < operationsPerWorkflow; o++)
+        {
+            [workflow addOperation:[[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+                int current = atomic_fetch_add(&running, 1) + 1;
+                int observed = atomic_load(&maximumRunning);
+                while (current > observed && !atomic_compare_exchange_strong(&maximumRunning, &observed, current))
+                {
+                    // A failed exchange loads the current maximum into `observed`.
+                }
+
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_MSEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    atomic_fetch_sub(&running, 1);
+                    completion([[WEOperationResult alloc] initWithResult:nil]);
+                });
+            }]];
+        }
+
+        XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+        [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+            [expectation fulfill];
+        }] workflowDidComplete:workflow];
+
+        [workflows addObject:workflow];
+        [expectations addObject:expectation];
+    }
+
+    for (WEWorkflow *workflow in workflows) [workflow start];
+
+    [self waitForExpectationsWithTimeout:2 handler:^(NSError * _Nullable error) {
+        for (WEWorkflow *workflow in workflows)
+        {
+            XCTAssertTrue(workflow.completed);
+            XCTAssertFalse(workflow.failed);
+        }
+        XCTAssertLessThanOrEqual(atomic_load(&maximumRunning), 2);
+        XCTAssertEqual(executor.activeOperationCount, 0);
+        XCTAssertEqual(executor.waitingOperationCount, 0);
+    }];
+}
+
+- (WEWorkflow *)_helperWorkflowOnExecutor:(WEExecutor *)executor weight:(double)weight tag:(NSString *)tag operationCount:(NSUInteger)operationCount startOrder:(NSMutableArray<NSString *> *)startOrder
+{
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:nil delegateQueue:nil executor:executor];
+    workflow.executorWeight = weight;
+    for (NSUInteger i = 0; i < operationCount; i++)
+    {
+        [workflow addOperation:[[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (startOrder)
+            {
+                [startOrder addObject:tag];
+            }
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }]];
+    }
+    return workflow;
+}
+
+- (void)testExecutorWeightedFairQueuing
+{
+    // This test blocks a single-slot executor with a gate operation, then queues operations of two workflows,
+    // one with weight 1 and another with weight 3. Once the gate opens, the heavier workflow must receive
+    // most of the first admitted slots.
+
+    WEExecutor *executor = [[WEExecutor alloc] initWithMaximumConcurrentOperations:1];
+    dispatch_semaphore_t gate = dispatch_semaphore_create(0);
+
+    WEWorkflow *gateWorkflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:nil delegateQueue:nil executor:executor];
+    [gateWorkflow addOperation:[[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }]];
+    [gateWorkflow start];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+    while (executor.activeOperationCount < 1 && [timeout timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertEqual(executor.activeOperationCount, 1);
+
+    NSMutableArray<NSString *> *startOrder = [NSMutableArray new];
+    WEWorkflow *light = [self _helperWorkflowOnExecutor:executor weight:1 tag:@"light" operationCount:4 startOrder:startOrder];
+    WEWorkflow *heavy = [self _helperWorkflowOnExecutor:executor weight:3 tag:@"heavy" operationCount:4 startOrder:startOrder];
+    XCTAssertThrows(heavy.executorWeight = 0);
+    [light start];
+    [heavy start];
+
+    timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+    while (executor.waitingOperationCount < 8 && [timeout timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertEqual(executor.waitingOperationCount, 8);
+
+    dispatch_semaphore_signal(gate);
+
+    timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+    while (!(light.completed && heavy.completed) && [timeout timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+
+    XCTAssertTrue(light.completed);
+    XCTAssertTrue(heavy.completed);
+    XCTAssertEqual(startOrder.count, 8);
+
+    NSArray<NSString *> *firstStarted = [startOrder subarrayWithRange:NSMakeRange(0, 4)];
+    NSUInteger heavyStarted = [[firstStarted indexesOfObjectsPassingTest:^BOOL(NSString *tag, NSUInteger idx, BOOL *stop) {
+        return [tag isEqualToString:@"heavy"];
+    }] count];
+    XCTAssertGreaterThanOrEqual(heavyStarted, 3);
+}
+
+@end
@@ -0,0 +1,73 @@
+//
+//  WEMainThreadExecutorTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <WorkflowEssentials/WEMainThreadExecutor.h>
+
+@interface WEMainThreadExecutorTests : XCTestCase
+@end
+
+@implementation WEMainThreadExecutorTests
+
+- (void)testMainThreadExecutorCoalescesBlocksIntoOneTurn
+{
+    // Blocks are submitted from the main thread, so none of them can run before the test starts waiting.
+    // With a generous budget all of them must be performed in a single main queue turn, in order.
+    WEMainThreadExecutor *executor = [[WEMainThreadExecutor alloc] initWithTimeBudget:10];
+    NSMutableArray<NSNumber *> *order = [NSMutableArray new];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until all blocks are performed"];
+
+    for (NSUInteger i = 0; i < 5; i++)
+    {
+        [executor executeBlock:^{
+            XCTAssertTrue([NSThread isMainThread]);
+            [order addObject:@(i)];
+            if (order.count == 5) [expectation fulfill];
+        }];
+    }
+
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        NSArray *expectedOrder = @[ @0, @1, @2, @3, @4 ];
+        XCTAssertEqualObjects(order, expectedOrder);
+        XCTAssertEqual(executor.batchCount, 1);
+        XCTAssertEqual(executor.executedBlockCount, 5);
+    }];
+}
+
+- (void)testMainThreadExecutorCarriesOverWhenBudgetIsExhausted
+{
+    // Zero budget means only one block is performed in each main queue turn, the rest are carried over.
+    WEMainThreadExecutor *executor = [[WEMainThreadExecutor alloc] initWithTimeBudget:0];
+    __block NSUInteger performed = 0;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until all blocks are performed"];
+
+    for (NSUInteger i = 0; i < 3; i++)
+    {
+        [executor executeBlock:^{
+            if (++performed == 3) [expectation fulfill];
+        }];
+    }
+
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertEqual(executor.batchCount, 3);
+        XCTAssertEqual(executor.executedBlockCount, 3);
+        XCTAssertGreaterThanOrEqual(executor.consumedTime, 0);
+    }];
+}
+
+- (void)testMainThreadExecutorNegativeBudgetThrows
+{
+    XCTAssertThrows([[WEMainThreadExecutor alloc] initWithTimeBudget:-1]);
+
+    WEMainThreadExecutor *executor = [WEMainThreadExecutor new];
+    XCTAssertThrows(executor.timeBudget = -1);
+}
+
+@end
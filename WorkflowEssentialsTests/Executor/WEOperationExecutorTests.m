@@ -0,0 +1,133 @@
+//
+//  WEOperationExecutorTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WEDispatchQueueExecutor.h>
+#import <WorkflowEssentials/WEInlineExecutor.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+
+static const void *const WETestQueueKey = &WETestQueueKey;
+
+@interface WEOperationExecutorTests : XCTestCase
+@end
+
+@implementation WEOperationExecutorTests
+
+- (void)_helperRunWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+
+    [workflow start];
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+- (dispatch_queue_t)_helperQueueWithName:(NSString *)name
+{
+    dispatch_queue_t queue = dispatch_queue_create(name.UTF8String, DISPATCH_QUEUE_SERIAL);
+    dispatch_queue_set_specific(queue, WETestQueueKey, (__bridge void *)name, NULL);
+    return queue;
+}
+
+- (void)testInlineExecutorPerformsBlockSynchronously
+{
+    __block BOOL performed = NO;
+    [[WEInlineExecutor sharedExecutor] executeBlock:^{
+        performed = YES;
+    }];
+    XCTAssertTrue(performed);
+}
+
+- (void)testDispatchQueueExecutorRequiresQueue
+{
+    dispatch_queue_t queue = nil;
+    XCTAssertThrows([[WEDispatchQueueExecutor alloc] initWithQueue:queue]);
+    XCTAssertNotNil([WEDispatchQueueExecutor globalQueueExecutor].queue);
+}
+
+- (void)testOperationsRunOnWorkflowAndOperationExecutors
+{
+    // Workflow has 4 independent operations and a serial "database" queue as its executor. One of the operations
+    // has an "other" queue executor of its own, and another one an inline executor.
+    // Operations must be prepared and started on their executors: the "database" queue, the "other" queue,
+    // and the workflow's internal queue for the inline one.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEDispatchQueueExecutor *databaseExecutor = [[WEDispatchQueueExecutor alloc] initWithQueue:[self _helperQueueWithName:@"database"]];
+    workflow.operationExecutor = databaseExecutor;
+    XCTAssertEqual(workflow.operationExecutor, databaseExecutor);
+    XCTAssertNil(workflow.workStealingExecutor);
+
+    NSMutableDictionary<NSString *, id> *queueNames = [NSMutableDictionary new];
+    WEBlockOperation *(^makeOperation)(NSString *) = ^(NSString *name) {
+        return [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            NSString *queueName = (__bridge NSString *)dispatch_get_specific(WETestQueueKey);
+            @synchronized (queueNames)
+            {
+                queueNames[name] = queueName ?: [NSNull null];
+            }
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+    };
+    WEBlockOperation *o1 = makeOperation(@"o1");
+    WEBlockOperation *o2 = makeOperation(@"o2");
+    WEBlockOperation *other = makeOperation(@"other");
+    other.operationExecutor = [[WEDispatchQueueExecutor alloc] initWithQueue:[self _helperQueueWithName:@"other"]];
+    WEBlockOperation *inlined = makeOperation(@"inlined");
+    inlined.operationExecutor = [WEInlineExecutor sharedExecutor];
+
+    [workflow addOperation:o1];
+    [workflow addOperation:o2];
+    [workflow addOperation:other];
+    [workflow addOperation:inlined];
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+    XCTAssertThrows(workflow.operationExecutor = nil);
+
+    XCTAssertEqualObjects(queueNames[@"o1"], @"database");
+    XCTAssertEqualObjects(queueNames[@"o2"], @"database");
+    XCTAssertEqualObjects(queueNames[@"other"], @"other");
+    XCTAssertEqualObjects(queueNames[@"inlined"], [NSNull null]);
+}
+
+- (void)testSerialQueueExecutorRunsOperationsOneAtATime
+{
+    // 20 independent operations share a serial queue executor, none of them may overlap with another.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.operationExecutor = [[WEDispatchQueueExecutor alloc] initWithQueue:[self _helperQueueWithName:@"serial"]];
+
+    __block NSInteger running = 0;
+    __block BOOL overlapped = NO;
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        [workflow addOperation:[[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            if (++running > 1) overlapped = YES;
+            usleep(1000);
+            running--;
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }]];
+    }
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+    XCTAssertFalse(overlapped);
+}
+
+@end
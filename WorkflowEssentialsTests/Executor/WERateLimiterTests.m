@@ -0,0 +1,86 @@
+//
+//  WERateLimiterTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WERateLimiter.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+
+@interface WERateLimiterTests : XCTestCase
+@end
+
+@implementation WERateLimiterTests
+
+- (void)testRateLimiterInvalidParametersThrow
+{
+    XCTAssertThrows([[WERateLimiter alloc] initWithRate:0 burst:1]);
+    XCTAssertThrows([[WERateLimiter alloc] initWithRate:-1 burst:1]);
+    XCTAssertThrows([[WERateLimiter alloc] initWithRate:1 burst:0]);
+    
+    WERateLimiter *rateLimiter = [[WERateLimiter alloc] initWithRate:2.5 burst:3];
+    XCTAssertEqual(rateLimiter.rate, 2.5);
+    XCTAssertEqual(rateLimiter.burst, 3);
+    XCTAssertEqual(rateLimiter.throttledCount, 0);
+}
+
+- (void)testWorkflowOperationsAreRateLimited
+{
+    // This test creates a workflow with 6 independent operations assigned to a rate limiter of 20 operations per second
+    // with a burst of 2, and one more operation that is not rate limited, added last.
+    // The first 2 limited operations start right away, the rest at least 50ms apart, so starting all of them takes
+    // at least 200ms. The operation that is not limited must not wait behind the throttled ones.
+    
+    static const NSUInteger limitedCount = 6;
+    WERateLimiter *rateLimiter = [[WERateLimiter alloc] initWithRate:20 burst:2];
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    NSMutableArray<NSDate *> *startDates = [NSMutableArray new];
+    __block NSDate *unlimitedStartDate = nil;
+    for (NSUInteger i = 0; i < limitedCount; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (startDates)
+            {
+                [startDates addObject:[NSDate date]];
+            }
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        operation.rateLimiter = rateLimiter;
+        [workflow addOperation:operation];
+    }
+    WEBlockOperation *unlimited = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        @synchronized (startDates)
+        {
+            unlimitedStartDate = [NSDate date];
+        }
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:unlimited];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:^(NSError * _Nullable error) {
+        XCTAssertEqual(startDates.count, limitedCount);
+        NSArray<NSDate *> *sortedDates = [startDates sortedArrayUsingSelector:@selector(compare:)];
+        XCTAssertGreaterThan([sortedDates.lastObject timeIntervalSinceDate:sortedDates.firstObject], 0.15);
+        XCTAssertLessThan([unlimitedStartDate timeIntervalSinceDate:sortedDates.firstObject], 0.05);
+        XCTAssertGreaterThan(rateLimiter.throttledCount, 0);
+    }];
+    [delegateMock verify];
+}
+
+@end
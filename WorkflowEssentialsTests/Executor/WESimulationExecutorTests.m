@@ -0,0 +1,226 @@
+//
+//  WESimulationExecutorTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WESimulationExecutor.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowReport.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WESegueDescription.h>
+#import <WorkflowEssentials/WESubworkflowOperation.h>
+
+@interface WESimulationExecutorTests : XCTestCase
+@end
+
+@implementation WESimulationExecutorTests
+
+- (WEBlockOperation *)_helperOperationWithName:(NSString *)name duration:(NSTimeInterval)duration
+{
+    WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Simulated operations must not start");
+    }];
+    operation.simulatedDuration = duration;
+    return operation;
+}
+
+- (void)testSimulationOfDiamondUnderConcurrencyLimits
+{
+    // a (1s) precedes b (2s) and c (3s), which both precede d (1s).
+    // Without a limit b and c run side by side and the run takes 5s, one at a time it takes 7s.
+    // Operations never start, and simulating the same workflow again gives the same result.
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    WEOperation *a = [self _helperOperationWithName:@"a" duration:1];
+    WEOperation *b = [self _helperOperationWithName:@"b" duration:2];
+    WEOperation *c = [self _helperOperationWithName:@"c" duration:3];
+    WEOperation *d = [self _helperOperationWithName:@"d" duration:1];
+    [workflow addOperation:a];
+    [workflow addOperation:b];
+    [workflow addOperation:c];
+    [workflow addOperation:d];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:a toOperation:b]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:a toOperation:c]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:b toOperation:d]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:c toOperation:d]];
+    
+    NSError *error = nil;
+    WESimulationExecutor *unlimited = [WESimulationExecutor new];
+    WEWorkflowReport *report = [unlimited simulateWorkflow:workflow error:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualWithAccuracy(report.duration, 5, 1e-6);
+    XCTAssertEqualWithAccuracy([report reportForOperation:d].startTime, 4, 1e-6);
+    XCTAssertEqual(report.criticalPath.count, 3);
+    XCTAssertEqual(unlimited.peakReadyCount, 2);
+    
+    WESimulationExecutor *serial = [[WESimulationExecutor alloc] initWithMaximumConcurrentOperations:1];
+    report = [serial simulateWorkflow:workflow error:&error];
+    XCTAssertEqualWithAccuracy(report.duration, 7, 1e-6);
+    XCTAssertEqualWithAccuracy([report reportForOperation:c].queueWaitTime, 2, 1e-6);
+    XCTAssertEqualWithAccuracy([serial simulateWorkflow:workflow error:&error].duration, 7, 1e-6);
+    
+    XCTAssertFalse(workflow.active);
+    XCTAssertFalse(workflow.completed);
+    XCTAssertNil(workflow.report);
+}
+
+- (void)testSimulationComparesSchedulingPolicies
+{
+    // x1 (1s), x2 (1s) and y (1s) are independent, y precedes z (4s), two operations may run at once.
+    // Ready operations in the order they became ready put z off until x1 and x2 are done, and the run takes 6s.
+    // Critical path first starts y right away, and the run takes 5s.
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    WEOperation *x1 = [self _helperOperationWithName:@"x1" duration:1];
+    WEOperation *x2 = [self _helperOperationWithName:@"x2" duration:1];
+    WEOperation *y = [self _helperOperationWithName:@"y" duration:1];
+    WEOperation *z = [self _helperOperationWithName:@"z" duration:4];
+    [workflow addOperation:x1];
+    [workflow addOperation:x2];
+    [workflow addOperation:y];
+    [workflow addOperation:z];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:y toOperation:z]];
+    
+    WESimulationExecutor *executor = [[WESimulationExecutor alloc] initWithMaximumConcurrentOperations:2];
+    XCTAssertEqual(executor.schedulingPolicy, WESimulationSchedulingFIFO);
+    XCTAssertEqualWithAccuracy([executor simulateWorkflow:workflow error:NULL].duration, 6, 1e-6);
+    
+    executor.schedulingPolicy = WESimulationSchedulingShortestFirst;
+    XCTAssertEqualWithAccuracy([executor simulateWorkflow:workflow error:NULL].duration, 6, 1e-6);
+    
+    executor.schedulingPolicy = WESimulationSchedulingCriticalPathFirst;
+    WEWorkflowReport *report = [executor simulateWorkflow:workflow error:NULL];
+    XCTAssertEqualWithAccuracy(report.duration, 5, 1e-6);
+    XCTAssertEqualWithAccuracy([report reportForOperation:y].startTime, 0, 1e-6);
+    XCTAssertEqualWithAccuracy([report reportForOperation:x2].startTime, 1, 1e-6);
+}
+
+- (void)testSimulatedResultsDecideSegues
+{
+    // o1 fails in the simulation, so the segue to o2 taken on success is not activated and o2 is skipped,
+    // while o3, reached on failure, runs.
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    WEOperation *o1 = [self _helperOperationWithName:@"o1" duration:1];
+    o1.simulatedResult = [[WEOperationResult alloc] initWithError:[NSError errorWithDomain:@"1" code:2 userInfo:nil]];
+    WEOperation *o2 = [self _helperOperationWithName:@"o2" duration:1];
+    WEOperation *o3 = [self _helperOperationWithName:@"o3" duration:2];
+    [workflow addOperation:o1];
+    [workflow addOperation:o2];
+    [workflow addOperation:o3];
+    
+    NSPredicate *successCondition = [NSPredicate predicateWithBlock:^BOOL(WEOperationResult * _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
+        return !evaluatedObject.isFailed;
+    }];
+    NSPredicate *errorCondition = [NSPredicate predicateWithBlock:^BOOL(WEOperationResult * _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
+        return evaluatedObject.isFailed;
+    }];
+    [workflow addSegue:[WESegueDescription segueFromOperationName:o1.name toOperationName:o2.name condition:successCondition]];
+    [workflow addSegue:[WESegueDescription segueFromOperationName:o1.name toOperationName:o3.name condition:errorCondition]];
+    
+    WEWorkflowReport *report = [[WESimulationExecutor new] simulateWorkflow:workflow error:NULL];
+    XCTAssertNil([report reportForOperation:o2]);
+    XCTAssertEqualWithAccuracy(report.duration, 3, 1e-6);
+}
+
+- (void)testSimulationLeavesSubworkflowsOpen
+{
+    // A sub-workflow is simulated with a single operation a (1s). It can still be changed afterwards, as the workflow
+    // has not started, and b (2s) added after a is part of the next simulation, which then takes 3s.
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    WESubworkflowOperation *subworkflow = [[WESubworkflowOperation alloc] initWithName:@"s"];
+    WEOperation *a = [self _helperOperationWithName:@"a" duration:1];
+    WEOperation *b = [self _helperOperationWithName:@"b" duration:2];
+    [subworkflow addOperation:a];
+    [workflow addOperation:subworkflow];
+    
+    WESimulationExecutor *executor = [WESimulationExecutor new];
+    XCTAssertEqualWithAccuracy([executor simulateWorkflow:workflow error:NULL].duration, 1, 1e-6);
+    
+    XCTAssertNoThrow([subworkflow addOperation:b]);
+    XCTAssertNoThrow([subworkflow addDependency:[WEDependencyDescription dependencyFormOperation:a toOperation:b]]);
+    XCTAssertEqualWithAccuracy([executor simulateWorkflow:workflow error:NULL].duration, 3, 1e-6);
+    XCTAssertFalse(workflow.active);
+}
+
+- (void)testSimulationIsFasterThanRealTime
+{
+    // A chain of 1000 operations taking an hour each is simulated without waiting for any of them.
+    
+    static const NSUInteger operationCount = 1000;
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    WEOperation *previous = nil;
+    for (NSUInteger i = 0; i < operationCount; i++)
+    {
+        WEOperation *operation = [self _helperOperationWithName:nil duration:3600];
+        [workflow addOperation:operation];
+        if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+        previous = operation;
+    }
+    
+    NSDate *startDate = [NSDate date];
+    WEWorkflowReport *report = [[WESimulationExecutor new] simulateWorkflow:workflow error:NULL];
+    XCTAssertLessThan(-[startDate timeIntervalSinceNow], 1);
+    XCTAssertEqualWithAccuracy(report.duration, operationCount * 3600.0, 1e-3);
+}
+
+- (void)testSimulationReplaysTrace
+{
+    // A chain of two operations runs for real, then is simulated with the report of that run as the trace.
+    // Each operation takes as long as it executed in the real run, instead of its simulated duration.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflow *copy = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0];
+    for (WEWorkflow *target in @[workflow, copy])
+    {
+        WEBlockOperation *first = [[WEBlockOperation alloc] initWithName:@"first" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            usleep(10000);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        WEBlockOperation *second = [[WEBlockOperation alloc] initWithName:@"second" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            usleep(20000);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        first.simulatedDuration = 100;
+        second.simulatedDuration = 100;
+        [target addOperation:first];
+        [target addOperation:second];
+        [target addDependency:[WEDependencyDescription dependencyFormOperation:first toOperation:second]];
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    WEWorkflowReport *trace = workflow.report;
+    NSTimeInterval executionTime = 0;
+    for (WEOperationReport *operationReport in trace.operationReports)
+    {
+        executionTime += operationReport.executionTime;
+    }
+    
+    WESimulationExecutor *executor = [WESimulationExecutor new];
+    executor.trace = trace;
+    XCTAssertThrows([executor simulateWorkflow:workflow error:NULL]);
+    WEWorkflowReport *report = [executor simulateWorkflow:copy error:NULL];
+    XCTAssertEqualWithAccuracy(report.duration, executionTime, 1e-6);
+    XCTAssertLessThan(report.duration, 1);
+}
+
+@end
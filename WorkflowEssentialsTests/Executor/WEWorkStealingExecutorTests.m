@@ -0,0 +1,251 @@
+//
+//  WEWorkStealingExecutorTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <WorkflowEssentials/WEWorkStealingExecutor.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+
+// Delegate that lets a benchmark wait for the workflow synchronously.
+@interface WEBenchmarkWorkflowDelegate : NSObject<WEWorkflowDelegate>
+@property (nonatomic, readonly, nonnull) dispatch_semaphore_t semaphore;
+@end
+
+@implementation WEBenchmarkWorkflowDelegate
+
+- (instancetype)init
+{
+    if (self = [super init])
+    {
+        _semaphore = dispatch_semaphore_create(0);
+    }
+    return self;
+}
+
+- (void)workflowDidComplete:(WEWorkflow *)workflow
+{
+    dispatch_semaphore_signal(_semaphore);
+}
+
+- (void)workflow:(WEWorkflow *)workflow didFailWithError:(NSError *)error
+{
+    dispatch_semaphore_signal(_semaphore);
+}
+
+@end
+
+// CPU-bound step of a benchmark, transforms the source buffer into the target buffer.
+static void _WEBenchmarkTransform(const uint32_t *source, uint32_t *target, NSUInteger count)
+{
+    for (NSUInteger pass = 0; pass < 4; pass++)
+    {
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            target[i] = source[i] * 1664525u + 1013904223u;
+        }
+        source = target;
+    }
+}
+
+static const NSUInteger WEBenchmarkBufferLength = 16 * 1024;
+static const NSUInteger WEBenchmarkChainLength = 256;
+static const NSUInteger WEBenchmarkTreeDepth = 8;
+
+@interface WEWorkStealingExecutorTests : XCTestCase
+@end
+
+@implementation WEWorkStealingExecutorTests
+
+#pragma mark - Executor
+
+- (void)testWorkStealingExecutorPerformsAllBlocks
+{
+    WEWorkStealingExecutor *executor = [[WEWorkStealingExecutor alloc] initWithThreadCount:3];
+    XCTAssertEqual(executor.threadCount, 3);
+    XCTAssertEqual(executor.currentWorkerIndex, NSNotFound);
+
+    static const NSUInteger blockCount = 100;
+    dispatch_group_t group = dispatch_group_create();
+    __block NSUInteger performed = 0;
+    NSObject *lock = [NSObject new];
+
+    for (NSUInteger i = 0; i < blockCount; i++)
+    {
+        dispatch_group_enter(group);
+        [executor executeBlock:^{
+            NSUInteger workerIndex = executor.currentWorkerIndex;
+            XCTAssertLessThan(workerIndex, 3);
+            @synchronized (lock)
+            {
+                performed++;
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+
+    long result = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+    XCTAssertEqual(result, 0);
+    XCTAssertEqual(performed, blockCount);
+}
+
+- (void)testWorkStealingExecutorIdleWorkersSteal
+{
+    // All blocks are pushed to the first worker's deque, and each of them takes a while.
+    // Other workers must steal some of them.
+    WEWorkStealingExecutor *executor = [[WEWorkStealingExecutor alloc] initWithThreadCount:2];
+    dispatch_group_t group = dispatch_group_create();
+
+    for (NSUInteger i = 0; i < 20; i++)
+    {
+        dispatch_group_enter(group);
+        [executor executeBlock:^{
+            usleep(5000);
+            dispatch_group_leave(group);
+        } preferredWorker:0];
+    }
+
+    long result = dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+    XCTAssertEqual(result, 0);
+    XCTAssertGreaterThan(executor.stealCount, 0);
+}
+
+- (void)testWorkStealingExecutorInvalidWorkerThrows
+{
+    WEWorkStealingExecutor *executor = [[WEWorkStealingExecutor alloc] initWithThreadCount:2];
+    XCTAssertThrows([executor executeBlock:^{} preferredWorker:2]);
+}
+
+- (void)testWorkflowOnWorkStealingExecutor
+{
+    // Background operations of a workflow with a work-stealing executor must run on its workers.
+    WEWorkStealingExecutor *executor = [[WEWorkStealingExecutor alloc] initWithThreadCount:2];
+    WEBenchmarkWorkflowDelegate *delegate = [WEBenchmarkWorkflowDelegate new];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegate delegateQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    workflow.workStealingExecutor = executor;
+    XCTAssertEqual(workflow.workStealingExecutor, executor);
+
+    WEOperation *previous = nil;
+    for (NSUInteger i = 0; i < 10; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            XCTAssertNotEqual(executor.currentWorkerIndex, NSNotFound);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [workflow addOperation:operation];
+        if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+        previous = operation;
+    }
+
+    [workflow start];
+    XCTAssertThrows(workflow.workStealingExecutor = nil);
+
+    long result = dispatch_semaphore_wait(delegate.semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+    XCTAssertEqual(result, 0);
+    XCTAssertTrue(workflow.completed);
+    XCTAssertFalse(workflow.failed);
+}
+
+
+#pragma mark - Benchmarks
+
+- (WEWorkflow *)_helperChainWorkflowWithDelegate:(WEBenchmarkWorkflowDelegate *)delegate buffer:(NSMutableData *)buffer
+{
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegate delegateQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    uint32_t *data = buffer.mutableBytes;
+
+    WEOperation *previous = nil;
+    for (NSUInteger i = 0; i < WEBenchmarkChainLength; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            _WEBenchmarkTransform(data, data, WEBenchmarkBufferLength);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [workflow addOperation:operation];
+        if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+        previous = operation;
+    }
+    return workflow;
+}
+
+- (WEWorkflow *)_helperTreeWorkflowWithDelegate:(WEBenchmarkWorkflowDelegate *)delegate buffers:(NSArray<NSMutableData *> *)buffers
+{
+    // Binary tree, each node transforms its parent's buffer into its own.
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegate delegateQueue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    NSMutableArray<WEOperation *> *nodes = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < buffers.count; i++)
+    {
+        uint32_t *target = buffers[i].mutableBytes;
+        const uint32_t *source = (i == 0) ? target : buffers[(i - 1) / 2].mutableBytes;
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            _WEBenchmarkTransform(source, target, WEBenchmarkBufferLength);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [workflow addOperation:operation];
+        if (i > 0) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:nodes[(i - 1) / 2] toOperation:operation]];
+        [nodes addObject:operation];
+    }
+    return workflow;
+}
+
+- (void)_measureChainWithExecutor:(WEWorkStealingExecutor *)executor
+{
+    NSMutableData *buffer = [NSMutableData dataWithLength:WEBenchmarkBufferLength * sizeof(uint32_t)];
+    [self measureBlock:^{
+        WEBenchmarkWorkflowDelegate *delegate = [WEBenchmarkWorkflowDelegate new];
+        WEWorkflow *workflow = [self _helperChainWorkflowWithDelegate:delegate buffer:buffer];
+        workflow.workStealingExecutor = executor;
+        [workflow start];
+        dispatch_semaphore_wait(delegate.semaphore, DISPATCH_TIME_FOREVER);
+        XCTAssertFalse(workflow.failed);
+    }];
+}
+
+- (void)_measureTreeWithExecutor:(WEWorkStealingExecutor *)executor
+{
+    NSMutableArray<NSMutableData *> *buffers = [NSMutableArray new];
+    NSUInteger nodeCount = (1 << WEBenchmarkTreeDepth) - 1;
+    for (NSUInteger i = 0; i < nodeCount; i++)
+    {
+        [buffers addObject:[NSMutableData dataWithLength:WEBenchmarkBufferLength * sizeof(uint32_t)]];
+    }
+
+    [self measureBlock:^{
+        WEBenchmarkWorkflowDelegate *delegate = [WEBenchmarkWorkflowDelegate new];
+        WEWorkflow *workflow = [self _helperTreeWorkflowWithDelegate:delegate buffers:buffers];
+        workflow.workStealingExecutor = executor;
+        [workflow start];
+        dispatch_semaphore_wait(delegate.semaphore, DISPATCH_TIME_FOREVER);
+        XCTAssertFalse(workflow.failed);
+    }];
+}
+
+- (void)testBenchmarkChainOnGlobalQueues
+{
+    [self _measureChainWithExecutor:nil];
+}
+
+- (void)testBenchmarkChainOnWorkStealingExecutor
+{
+    [self _measureChainWithExecutor:[WEWorkStealingExecutor new]];
+}
+
+- (void)testBenchmarkTreeOnGlobalQueues
+{
+    [self _measureTreeWithExecutor:nil];
+}
+
+- (void)testBenchmarkTreeOnWorkStealingExecutor
+{
+    [self _measureTreeWithExecutor:[WEWorkStealingExecutor new]];
+}
+
+@end
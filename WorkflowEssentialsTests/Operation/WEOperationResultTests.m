@@ -63,6 +63,42 @@
     XCTAssertEqualObjects(returnedData.string, @"result-copy");
 }
 
+- (void)testLazyResultIsMaterializedOnce
+{
+    // The provider must not be called until the result is read, and must be called once however many threads read it.
+    __block NSUInteger providerCalls = 0;
+    WEOperationResult<FancyCopier *> *result = [[WEOperationResult alloc] initWithResultProvider:^FancyCopier *{
+        providerCalls++;
+        return [[FancyCopier alloc] initWithString:@"result"];
+    }];
+    XCTAssertFalse(result.isFailed);
+    XCTAssertNil(result.error);
+    XCTAssertEqual(providerCalls, 0);
+    
+    NSMutableArray<FancyCopier *> *values = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 8; i++) [values addObject:(id)[NSNull null]];
+    dispatch_apply(values.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        FancyCopier *value = result.result;
+        @synchronized (values)
+        {
+            values[i] = value;
+        }
+    });
+    
+    XCTAssertEqual(providerCalls, 1);
+    XCTAssertEqualObjects(values.firstObject.string, @"result-copy");
+    for (FancyCopier *value in values)
+    {
+        XCTAssertEqual(value, values.firstObject);
+    }
+}
+
+- (void)testLazyResultThrowsWithNilProvider
+{
+    id<NSCopying> (^provider)(void) = nil;
+    XCTAssertThrows([[WEOperationResult alloc] initWithResultProvider:provider]);
+}
+
 -(void)testFailingResultWithError
 {
     NSError *error = [NSError errorWithDomain:@"ArbitraryDomain" code:-12345 userInfo:nil];
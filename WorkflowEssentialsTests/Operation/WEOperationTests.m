@@ -29,6 +29,29 @@ static NSString *const WEOperationSimpleSubclassResult = @"WEOperationSimpleSubc
 
 @end
 
+// Operation that keeps running until it is completed from outside, and counts how many times it was stopped.
+@interface WEOperationStoppableSubclass : WEOperation<NSString *>
+@property (atomic, assign) NSUInteger stopCount;
+@end
+
+@implementation WEOperationStoppableSubclass
+
+- (BOOL)requiresMainThread
+{
+    return NO;
+}
+
+- (void)start
+{
+}
+
+- (void)stop
+{
+    self.stopCount++;
+}
+
+@end
+
 @interface WEOperationTests : XCTestCase
 @end
 
@@ -64,4 +87,57 @@ static NSString *const WEOperationSimpleSubclassResult = @"WEOperationSimpleSubc
     }];
 }
 
+- (void)testOperationCancelledWhileActive
+{
+    // An active operation that is cancelled is stopped and completes once with the cancellation failure,
+    // and completing it afterwards does nothing.
+    
+    __block NSUInteger completionCount = 0;
+    WEOperationStoppableSubclass *operation = [[WEOperationStoppableSubclass alloc] initWithName:nil];
+    [operation startWithCompletion:^(WEOperationResult<NSString *> * _Nullable result) {
+        completionCount++;
+        XCTAssertTrue(result.failed);
+        XCTAssertEqual(result.error.code, NSUserCancelledError);
+    } completionQueue:dispatch_get_main_queue()];
+    XCTAssertTrue(operation.active);
+    
+    [operation cancel];
+    XCTAssertTrue(operation.cancelled);
+    XCTAssertFalse(operation.active);
+    XCTAssertEqual(operation.stopCount, 1);
+    XCTAssertTrue(operation.result.failed);
+    
+    XCTAssertNoThrow([operation completeWithResult:[[WEOperationResult alloc] initWithResult:@"late"]]);
+    XCTAssertFalse(operation.finished);
+    XCTAssertTrue(operation.result.failed);
+    
+    // Cancelling again does nothing.
+    [operation cancel];
+    XCTAssertEqual(operation.stopCount, 1);
+    
+    // Let the main queue run the completion.
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    XCTAssertEqual(completionCount, 1);
+}
+
+- (void)testOperationCancelledBeforeStart
+{
+    // An operation cancelled before it started is not stopped, and cannot be started. A finished operation
+    // cannot be cancelled.
+    
+    WEOperationStoppableSubclass *operation = [[WEOperationStoppableSubclass alloc] initWithName:nil];
+    [operation cancel];
+    XCTAssertTrue(operation.cancelled);
+    XCTAssertEqual(operation.stopCount, 0);
+    XCTAssertThrows([operation startWithCompletion:nil completionQueue:nil]);
+    
+    WEOperationStoppableSubclass *finished = [[WEOperationStoppableSubclass alloc] initWithName:nil];
+    [finished startWithCompletion:nil completionQueue:nil];
+    [finished completeWithResult:[[WEOperationResult alloc] initWithResult:@"done"]];
+    [finished cancel];
+    XCTAssertTrue(finished.finished);
+    XCTAssertFalse(finished.cancelled);
+    XCTAssertEqual(finished.stopCount, 0);
+}
+
 @end
@@ -0,0 +1,164 @@
+//
+//  WEReduceOperationTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WEReduceOperation.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WEStreamDescription.h>
+
+@interface WEReduceOperationTests : XCTestCase
+@end
+
+@implementation WEReduceOperationTests
+
+- (WEReduceOperation<NSString *> *)_helperConcatenatingOperationWithName:(NSString *)name
+{
+    // Concatenation is associative, but not commutative, so the order of sources must be kept.
+    return [[WEReduceOperation alloc] initWithName:name combine:^NSString * _Nonnull(NSString * _Nonnull first, NSString * _Nonnull second) {
+        usleep(1000);
+        return [first stringByAppendingString:second];
+    }];
+}
+
+- (WEBlockOperation *)_helperSourceWithResult:(WEOperationResult *)result delay:(useconds_t)delay
+{
+    return [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        usleep(delay);
+        completion(result);
+    }];
+}
+
+- (void)_helperRunWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+- (void)testReduceOperationCombinesSourcesInOrder
+{
+    // This test creates 16 sources that complete with letters "a" to "p" after random delays, and a reduce operation
+    // "all" that depends on all of them and concatenates their results, followed by operation "after".
+    // The result must be the letters in the order sources were added, made with 15 combines, and visible to "after".
+    
+    static const NSUInteger sourceCount = 16;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+    
+    WEReduceOperation<NSString *> *all = [self _helperConcatenatingOperationWithName:@"all"];
+    NSMutableString *expected = [NSMutableString new];
+    for (NSUInteger i = 0; i < sourceCount; i++)
+    {
+        NSString *letter = [NSString stringWithFormat:@"%c", (char)('a' + i)];
+        [expected appendString:letter];
+        WEBlockOperation *source = [self _helperSourceWithResult:[[WEOperationResult alloc] initWithResult:letter] delay:arc4random_uniform(5000)];
+        [workflow addOperation:source];
+        [workflow addDependency:[WEDependencyDescription dependencyFormOperation:source toOperation:all]];
+    }
+    __block id allResult = nil;
+    WEBlockOperation *after = [[WEBlockOperation alloc] initWithName:@"after" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        allResult = [context resultForOperationName:@"all"].result;
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:all];
+    [workflow addOperation:after];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:all toOperation:after]];
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+    
+    XCTAssertTrue(all.finished);
+    XCTAssertEqualObjects(all.result.result, expected);
+    XCTAssertEqualObjects(allResult, expected);
+    XCTAssertEqual(all.combineCount, sourceCount - 1);
+}
+
+- (void)testReduceOperationLeavesOutSourcesWithoutValues
+{
+    // Sources complete with "a", no value and "b". Only "a" and "b" must be combined.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEReduceOperation<NSString *> *reduce = [self _helperConcatenatingOperationWithName:nil];
+    [workflow addOperation:reduce];
+    for (NSString *value in @[ @"a", [NSNull null], @"b" ])
+    {
+        id result = (value != (id)[NSNull null]) ? value : nil;
+        WEBlockOperation *source = [self _helperSourceWithResult:[[WEOperationResult alloc] initWithResult:result] delay:0];
+        [workflow addOperation:source];
+        [workflow addDependency:[WEDependencyDescription dependencyFormOperation:source toOperation:reduce]];
+    }
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+    
+    XCTAssertEqualObjects(reduce.result.result, @"ab");
+    XCTAssertEqual(reduce.combineCount, 1);
+}
+
+- (void)testReduceOperationFailsWithFailedSource
+{
+    // One of 4 sources fails, the reduce operation must fail with its error, and the workflow must still complete.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEReduceOperation<NSString *> *reduce = [self _helperConcatenatingOperationWithName:nil];
+    NSError *error = [NSError errorWithDomain:@"WETestDomain" code:1 userInfo:nil];
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        WEOperationResult *result = (i == 2) ? [[WEOperationResult alloc] initWithError:error] : [[WEOperationResult alloc] initWithResult:@"x"];
+        WEBlockOperation *source = [self _helperSourceWithResult:result delay:1000];
+        [workflow addOperation:source];
+        [workflow addDependency:[WEDependencyDescription dependencyFormOperation:source toOperation:reduce]];
+    }
+    [workflow addOperation:reduce];
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+    
+    XCTAssertTrue(reduce.result.failed);
+    XCTAssertEqualObjects(reduce.result.error, error);
+}
+
+- (void)testReduceOperationCannotBeStreamTarget
+{
+    // A stream into a reduce operation must fail the workflow with an invalid dependency error.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEReduceOperation<NSString *> *reduce = [self _helperConcatenatingOperationWithName:nil];
+    WEBlockOperation *source = [self _helperSourceWithResult:[[WEOperationResult alloc] initWithResult:@"a"] delay:0];
+    [workflow addOperation:source];
+    [workflow addOperation:reduce];
+    [workflow addDependency:[WEStreamDescription streamFromOperation:source toOperation:reduce capacity:1]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+        return [error.domain isEqualToString:WEWorkflowErrorDomain] && error.code == WEWorkflowInvalidDependency;
+    }]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    XCTAssertFalse(reduce.finished);
+}
+
+@end
@@ -0,0 +1,228 @@
+//
+//  WESubworkflowOperationTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <stdatomic.h>
+#import <WorkflowEssentials/WESubworkflowOperation.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WESegueDescription.h>
+
+// Block operation that keeps the context it was prepared with.
+@interface WETestContextOperation : WEBlockOperation
+@property (atomic, strong, nullable) WEWorkflowContext *preparedContext;
+@end
+
+@implementation WETestContextOperation
+
+- (void)prepareForExecutionWithContext:(WEWorkflowContext *)context
+{
+    self.preparedContext = context;
+}
+
+@end
+
+@interface WESubworkflowOperationTests : XCTestCase
+@end
+
+@implementation WESubworkflowOperationTests
+{
+    NSMutableArray<NSString *> *_order;
+    atomic_int _activeCount;
+    atomic_int _maximumActiveCount;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _order = [NSMutableArray new];
+    atomic_init(&_activeCount, 0);
+    atomic_init(&_maximumActiveCount, 0);
+}
+
+- (WETestContextOperation *)_helperOperationWithName:(NSString *)name
+{
+    // Records the order operations ran in and the maximum number of operations running at the same time.
+    return [[WETestContextOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        int active = atomic_fetch_add(&self->_activeCount, 1) + 1;
+        int maximum = atomic_load(&self->_maximumActiveCount);
+        while (active > maximum && !atomic_compare_exchange_weak(&self->_maximumActiveCount, &maximum, active)) {}
+        usleep(2000);
+        @synchronized (self->_order)
+        {
+            [self->_order addObject:name];
+        }
+        atomic_fetch_sub(&self->_activeCount, 1);
+        completion([[WEOperationResult alloc] initWithResult:name]);
+    }];
+}
+
+- (void)testSubworkflowRunsUnderWorkflowLimits
+{
+    // This test creates a workflow with a limit of 2 concurrent operations and 3 operations: O1, S and O2,
+    // where S is a sub-workflow of 4 independent operations C1..C4 followed by C5, with the following connections:
+    // Dependency O1 -> S
+    // Dependency S -> O2
+    // Dependency C4 -> C5 inside of S
+    // Operations of S must run after O1 and before O2, never more than 2 at the same time, and see results
+    // of each other by their own names.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:2 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    WETestContextOperation *o1 = [self _helperOperationWithName:@"o1"];
+    WETestContextOperation *o2 = [self _helperOperationWithName:@"o2"];
+    WESubworkflowOperation *subworkflow = [[WESubworkflowOperation alloc] initWithName:@"s"];
+    NSMutableArray<WETestContextOperation *> *children = [NSMutableArray new];
+    for (NSUInteger i = 1; i <= 5; i++)
+    {
+        WETestContextOperation *child = [self _helperOperationWithName:[NSString stringWithFormat:@"c%lu", (unsigned long)i]];
+        [subworkflow addOperation:child];
+        [children addObject:child];
+    }
+    [subworkflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"c4" toOperationName:@"c5"]];
+    
+    [workflow addOperation:o1];
+    [workflow addOperation:subworkflow];
+    [workflow addOperation:o2];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"o1" toOperationName:@"s"]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:subworkflow toOperation:o2]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    XCTAssertThrows([subworkflow addOperation:[self _helperOperationWithName:@"late"]]);
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertEqual(self->_order.count, 7);
+        XCTAssertEqualObjects(self->_order.firstObject, @"o1");
+        XCTAssertEqualObjects(self->_order.lastObject, @"o2");
+        XCTAssertLessThan([self->_order indexOfObject:@"c4"], [self->_order indexOfObject:@"c5"]);
+        XCTAssertLessThanOrEqual(atomic_load(&self->_maximumActiveCount), 2);
+        XCTAssertTrue(subworkflow.finished);
+        
+        WEWorkflowContext *context = workflow.context;
+        XCTAssertEqualObjects([context resultForOperationName:@"s.c1"].result, @"c1");
+        XCTAssertNil([context resultForOperationName:@"c1"]);
+        XCTAssertEqualObjects([[context contextForNamespace:@"s"] resultForOperationName:@"c5"].result, @"c5");
+        XCTAssertEqualObjects([children[4].preparedContext resultForOperationName:@"c4"].result, @"c4");
+        XCTAssertEqualObjects([children[4].preparedContext resultForOperationName:@"c5"].result, @"c5");
+        XCTAssertEqual(o2.preparedContext, context);
+    }];
+}
+
+- (void)testSubworkflowNested
+{
+    // Sub-workflow S1 contains C1 and sub-workflow S2, which contains C2, with a dependency C1 -> S2.
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    WESubworkflowOperation *s1 = [[WESubworkflowOperation alloc] initWithName:@"s1"];
+    WESubworkflowOperation *s2 = [[WESubworkflowOperation alloc] initWithName:@"s2"];
+    WETestContextOperation *c1 = [self _helperOperationWithName:@"c1"];
+    WETestContextOperation *c2 = [self _helperOperationWithName:@"c2"];
+    [s2 addOperation:c2];
+    [s1 addOperation:c1];
+    [s1 addOperation:s2];
+    [s1 addDependency:[WEDependencyDescription dependencyFormOperation:c1 toOperation:s2]];
+    [workflow addOperation:s1];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertEqualObjects(self->_order, (@[ @"c1", @"c2" ]));
+        XCTAssertEqualObjects([workflow.context resultForOperationName:@"s1.s2.c2"].result, @"c2");
+        XCTAssertEqualObjects([c2.preparedContext resultForOperationName:@"c2"].result, @"c2");
+        XCTAssertTrue(s1.finished);
+        XCTAssertTrue(s2.finished);
+    }];
+}
+
+- (void)testSubworkflowSkipped
+{
+    // Segue O1 -> S never activates, so S and all of its operations are skipped.
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    WETestContextOperation *o1 = [self _helperOperationWithName:@"o1"];
+    WESubworkflowOperation *subworkflow = [[WESubworkflowOperation alloc] initWithName:@"s"];
+    WETestContextOperation *c1 = [self _helperOperationWithName:@"c1"];
+    WETestContextOperation *c2 = [self _helperOperationWithName:@"c2"];
+    [subworkflow addOperation:c1];
+    [subworkflow addOperation:c2];
+    [subworkflow addDependency:[WEDependencyDescription dependencyFormOperation:c1 toOperation:c2]];
+    [workflow addOperation:o1];
+    [workflow addOperation:subworkflow];
+    [workflow addSegue:[WESegueDescription segueFromOperationName:@"o1" toOperationName:@"s" condition:[NSPredicate predicateWithValue:NO]]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertEqualObjects(self->_order, @[ @"o1" ]);
+        XCTAssertEqualObjects([NSSet setWithArray:workflow.skippedOperations], ([NSSet setWithObjects:subworkflow, c1, c2, nil]));
+        XCTAssertFalse(subworkflow.finished);
+    }];
+}
+
+- (void)testSubworkflowNamesAreScoped
+{
+    // A connection inside of a sub-workflow cannot refer to an operation of the workflow by name.
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    WESubworkflowOperation *subworkflow = [[WESubworkflowOperation alloc] initWithName:@"s"];
+    [subworkflow addOperation:[self _helperOperationWithName:@"c1"]];
+    [subworkflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"o1" toOperationName:@"c1"]];
+    [workflow addOperation:[self _helperOperationWithName:@"o1"]];
+    [workflow addOperation:subworkflow];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+        return [error.domain isEqualToString:WEWorkflowErrorDomain] && error.code == WEWorkflowInvalidDependency;
+    }]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+}
+
+- (void)testSubworkflowInvalidInputThrows
+{
+    XCTAssertThrows([[WESubworkflowOperation alloc] initWithName:@"a.b"]);
+    
+    WESubworkflowOperation *subworkflow = [[WESubworkflowOperation alloc] initWithName:@"s"];
+    WETestContextOperation *c1 = [self _helperOperationWithName:@"c1"];
+    [subworkflow addOperation:c1];
+    XCTAssertThrows([subworkflow addOperation:c1]);
+    XCTAssertThrows([subworkflow addOperation:subworkflow]);
+    XCTAssertThrows([subworkflow addDependency:[WEDependencyDescription dependencyFormOperation:c1 toOperation:[self _helperOperationWithName:@"other"]]]);
+}
+
+@end
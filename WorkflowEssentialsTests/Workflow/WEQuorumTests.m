@@ -0,0 +1,168 @@
+//
+//  WEQuorumTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WEQuorumDescription.h>
+
+@interface WEQuorumTests : XCTestCase
+@end
+
+@implementation WEQuorumTests
+
+- (void)_helperRunWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+
+    [workflow start];
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+- (WEBlockOperation *)_helperReplicaWithName:(NSString *)name delay:(useconds_t)delay
+{
+    return [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        usleep(delay);
+        completion([[WEOperationResult alloc] initWithResult:name]);
+    }];
+}
+
+- (void)testQuorumTargetStartsOnceQuorumIsReached
+{
+    // Three replicas answer a read, two of them quickly and one after a long while. The merge needs two answers,
+    // and cancels the remaining replica once it has them. The merge must start without waiting for the slow replica,
+    // see the answers in the order they arrived, and the slow replica must be cancelled and skipped.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+    dispatch_semaphore_t slowRelease = dispatch_semaphore_create(0);
+
+    WEBlockOperation *first = [self _helperReplicaWithName:@"first" delay:10000];
+    WEBlockOperation *second = [self _helperReplicaWithName:@"second" delay:40000];
+    WEBlockOperation *slow = [[WEBlockOperation alloc] initWithName:@"slow" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_wait(slowRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"slow"]);
+    }];
+    __block NSArray<WEOperationResult *> *answers = nil;
+    __block WEOperation *merge = nil;
+    merge = [[WEBlockOperation alloc] initWithName:@"merge" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        answers = [context quorumResultsOfOperation:merge];
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+
+    [workflow addOperation:merge];
+    for (WEOperation *replica in @[ first, second, slow ])
+    {
+        [workflow addOperation:replica];
+        WEQuorumDescription *quorum = [WEQuorumDescription quorumFromOperation:replica toOperation:merge quorum:2];
+        quorum.cancelsRemainingSources = YES;
+        [workflow addDependency:quorum];
+    }
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+
+    XCTAssertTrue(merge.finished);
+    XCTAssertEqualObjects([answers valueForKey:@"result"], (@[ @"first", @"second" ]));
+    XCTAssertTrue(slow.cancelled);
+    XCTAssertEqualObjects(workflow.skippedOperations, @[ slow ]);
+
+    dispatch_semaphore_signal(slowRelease);
+}
+
+- (void)testQuorumTargetIsSkippedWhenQuorumIsUnreachable
+{
+    // Two of three replicas fail, so a quorum of two can no longer be reached. The merge must be skipped along with
+    // the operation that follows it, without the failures failing the workflow.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+
+    WEBlockOperation *replica = [self _helperReplicaWithName:@"replica" delay:20000];
+    WEBlockOperation *merge = [[WEBlockOperation alloc] initWithName:@"merge" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Operation with an unreachable quorum must not start");
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    WEBlockOperation *afterMerge = [[WEBlockOperation alloc] initWithName:@"afterMerge" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Operation following a skipped operation must not start");
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:replica];
+    [workflow addOperation:merge];
+    [workflow addOperation:afterMerge];
+    [workflow addDependency:[WEQuorumDescription quorumFromOperation:replica toOperation:merge quorum:2]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:merge toOperation:afterMerge]];
+    for (NSUInteger i = 0; i < 2; i++)
+    {
+        WEBlockOperation *failing = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithError:[NSError errorWithDomain:@"test" code:1 userInfo:nil]]);
+        }];
+        [workflow addOperation:failing];
+        [workflow addDependency:[WEQuorumDescription quorumFromOperation:failing toOperation:merge quorum:2]];
+    }
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+
+    XCTAssertFalse(workflow.failed);
+    XCTAssertTrue(replica.finished);
+    XCTAssertEqualObjects([NSSet setWithArray:workflow.skippedOperations], ([NSSet setWithObjects:merge, afterMerge, nil]));
+}
+
+- (void)testQuorumLargerThanSourcesFails
+{
+    // A quorum of three with two sources can never be reached, which is an invalid dependency.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEBlockOperation *merge = [self _helperReplicaWithName:@"merge" delay:0];
+    [workflow addOperation:merge];
+    for (NSUInteger i = 0; i < 2; i++)
+    {
+        WEBlockOperation *replica = [self _helperReplicaWithName:[NSString stringWithFormat:@"replica%lu", (unsigned long)i] delay:0];
+        [workflow addOperation:replica];
+        [workflow addDependency:[WEQuorumDescription quorumFromOperation:replica toOperation:merge quorum:3]];
+    }
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+        return error.code == WEWorkflowInvalidDependency;
+    }]];
+
+    [workflow start];
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+- (void)testQuorumDescriptionQuorum
+{
+    // Quorum defaults to a single source, is copied with the description along with cancellation, and cannot be zero.
+
+    WEQuorumDescription *quorum = [WEQuorumDescription quorumFromOperationName:@"o1" toOperationName:@"o2" quorum:2];
+    quorum.cancelsRemainingSources = YES;
+    WEQuorumDescription *copy = [quorum copy];
+    XCTAssertEqual(copy.quorum, 2);
+    XCTAssertTrue(copy.cancelsRemainingSources);
+    XCTAssertThrows(quorum.quorum = 0);
+    XCTAssertEqual([WEQuorumDescription new].quorum, 1);
+    XCTAssertFalse([WEQuorumDescription new].cancelsRemainingSources);
+}
+
+@end
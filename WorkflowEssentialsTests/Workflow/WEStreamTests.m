@@ -0,0 +1,187 @@
+//
+//  WEStreamTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <stdatomic.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WEStreamDescription.h>
+#import <WorkflowEssentials/WEStreamChannel.h>
+
+@interface WEStreamTests : XCTestCase
+@end
+
+@implementation WEStreamTests
+
+- (void)_helperRunWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+
+    [workflow start];
+
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+- (void)testStreamTargetConsumesWhileSourceProduces
+{
+    // Producer sends 10 chunks through a stream of capacity 2, consumer receives them until the channel is closed.
+    // A plain dependency between the same operations is added as well, the stream takes precedence.
+    // Consumer must start before producer completes, receive all chunks in order, and the channel must never hold
+    // more than 2 chunks.
+
+    static const NSUInteger chunkCount = 10;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+
+    __block atomic_bool producerCompleted;
+    atomic_init(&producerCompleted, false);
+    __block atomic_bool consumerStartedEarly;
+    atomic_init(&consumerStartedEarly, false);
+    NSMutableArray<NSNumber *> *received = [NSMutableArray new];
+
+    __block WEOperation *producer = nil;
+    producer = [[WEBlockOperation alloc] initWithName:@"producer" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        WEStreamChannel<NSNumber *> *channel = [context outputStreamsOfOperation:producer].firstObject;
+        for (NSUInteger i = 0; i < chunkCount; i++)
+        {
+            usleep(1000);
+            XCTAssertTrue([channel sendChunk:@(i)]);
+        }
+        atomic_store(&producerCompleted, true);
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    __block WEOperation *consumer = nil;
+    consumer = [[WEBlockOperation alloc] initWithName:@"consumer" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        if (!atomic_load(&producerCompleted)) atomic_store(&consumerStartedEarly, true);
+        WEStreamChannel<NSNumber *> *channel = [context inputStreamsOfOperation:consumer].firstObject;
+        NSNumber *chunk;
+        while ((chunk = [channel receiveChunk]) != nil)
+        {
+            [received addObject:chunk];
+        }
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+
+    [workflow addOperation:producer];
+    [workflow addOperation:consumer];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:producer toOperation:consumer]];
+    [workflow addDependency:[WEStreamDescription streamFromOperation:producer toOperation:consumer capacity:2]];
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+
+    XCTAssertTrue(atomic_load(&consumerStartedEarly));
+    XCTAssertEqual(received.count, chunkCount);
+    for (NSUInteger i = 0; i < received.count; i++)
+    {
+        XCTAssertEqualObjects(received[i], @(i));
+    }
+
+    WEStreamChannel *channel = [context outputStreamsOfOperation:producer].firstObject;
+    XCTAssertNotNil(channel);
+    XCTAssertEqual([context inputStreamsOfOperation:consumer].firstObject, channel);
+    XCTAssertEqual([context inputStreamsOfOperation:producer].count, 0);
+    XCTAssertTrue(channel.closed);
+    XCTAssertGreaterThan(channel.peakCount, 0);
+    XCTAssertLessThanOrEqual(channel.peakCount, 2);
+}
+
+- (void)testStreamSourceStopsWhenTargetCompletes
+{
+    // Consumer receives a single chunk and completes, producer tries to send more chunks than the channel can hold.
+    // Producer must not wait forever: sending fails once the consumer has completed.
+
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+
+    __block NSUInteger sentCount = 0;
+    __block WEOperation *producer = nil;
+    producer = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        WEStreamChannel *channel = [context outputStreamsOfOperation:producer].firstObject;
+        while (sentCount < 100 && [channel sendChunk:@(sentCount)])
+        {
+            sentCount++;
+        }
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    __block WEOperation *consumer = nil;
+    consumer = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTAssertEqualObjects([[context inputStreamsOfOperation:consumer].firstObject receiveChunk], @0);
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+
+    [workflow addOperation:producer];
+    [workflow addOperation:consumer];
+    [workflow addDependency:[WEStreamDescription streamFromOperation:producer toOperation:consumer capacity:1]];
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+
+    XCTAssertLessThan(sentCount, 100);
+}
+
+- (void)testStreamTargetStartsBeyondConcurrencyLimit
+{
+    // Only one operation may run at once. Producer sends more chunks than the channel holds, so it waits for the
+    // consumer while it still takes up the only place. The consumer must start anyway, and the workflow complete.
+
+    static const NSUInteger chunkCount = 5;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:1 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+
+    __block WEOperation *producer = nil;
+    producer = [[WEBlockOperation alloc] initWithName:@"producer" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        WEStreamChannel<NSNumber *> *channel = [context outputStreamsOfOperation:producer].firstObject;
+        for (NSUInteger i = 0; i < chunkCount; i++)
+        {
+            XCTAssertTrue([channel sendChunk:@(i)]);
+        }
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    __block NSUInteger receivedCount = 0;
+    __block WEOperation *consumer = nil;
+    consumer = [[WEBlockOperation alloc] initWithName:@"consumer" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        WEStreamChannel<NSNumber *> *channel = [context inputStreamsOfOperation:consumer].firstObject;
+        while ([channel receiveChunk] != nil)
+        {
+            receivedCount++;
+        }
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+
+    [workflow addOperation:producer];
+    [workflow addOperation:consumer];
+    [workflow addDependency:[WEStreamDescription streamFromOperation:producer toOperation:consumer capacity:1]];
+
+    [self _helperRunWorkflow:workflow delegate:delegateMock];
+
+    XCTAssertEqual(receivedCount, chunkCount);
+}
+
+- (void)testStreamDescriptionCapacity
+{
+    // Capacity defaults to a single chunk, is copied with the description, and cannot be zero.
+
+    WEStreamDescription *stream = [WEStreamDescription streamFromOperationName:@"o1" toOperationName:@"o2" capacity:3];
+    XCTAssertEqual(stream.capacity, 3);
+    XCTAssertEqual(((WEStreamDescription *)[stream copy]).capacity, 3);
+    XCTAssertThrows(stream.capacity = 0);
+    XCTAssertEqual([WEStreamDescription new].capacity, 1);
+}
+
+@end
@@ -0,0 +1,201 @@
+//
+//  WEWorkflowDefinitionTests.m
+//  Workflow Essentials
+//
+//  Created by Anton Vaneev.
+//  Copyright (c) 2016-present, Anton Vaneev. All rights reserved.
+//
+//  Distributed under BSD license. See LICENSE for details.
+//
+
+#import <XCTest/XCTest.h>
+#import <OCMock/OCMock.h>
+#import <WorkflowEssentials/WEWorkflow.h>
+#import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEWorkflowDefinition.h>
+#import <WorkflowEssentials/WEWorkflowDefinitionBuilder.h>
+#import <WorkflowEssentials/WEOperationRegistry.h>
+#import <WorkflowEssentials/WEBlockOperation.h>
+#import <WorkflowEssentials/WEDependencyDescription.h>
+#import <WorkflowEssentials/WESegueDescription.h>
+
+static const NSUInteger WEBenchmarkDefinitionLength = 10000;
+
+@interface WEWorkflowDefinitionTests : XCTestCase
+@end
+
+@implementation WEWorkflowDefinitionTests
+{
+    WEOperationRegistry *_registry;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    
+    // "test.name" operations produce their own name as a result.
+    _registry = [WEOperationRegistry new];
+    [_registry registerOperationType:@"test.name" factory:^WEOperation * _Nonnull(NSString * _Nullable name) {
+        return [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:name]);
+        }];
+    }];
+}
+
+- (WEWorkflowDefinition *)_helperDefinition
+{
+    // o1 -> o2 (dependency), o1 -> o3 (likely segue, activates when o1 produces "o1"), o2 -> o4 (segue that never activates)
+    WEWorkflowDefinitionBuilder *builder = [WEWorkflowDefinitionBuilder new];
+    NSUInteger o1 = [builder addOperationWithType:@"test.name" name:@"o1"];
+    NSUInteger o2 = [builder addOperationWithType:@"test.name" name:@"o2"];
+    NSUInteger o3 = [builder addOperationWithType:@"test.name" name:@"o3"];
+    NSUInteger o4 = [builder addOperationWithType:@"test.name" name:@"o4"];
+    [builder addDependencyFromOperationAtIndex:o1 toOperationAtIndex:o2];
+    [builder addSegueFromOperationAtIndex:o1 toOperationAtIndex:o3 condition:[NSPredicate predicateWithFormat:@"result == %@", @"o1"] likely:YES];
+    [builder addSegueFromOperationAtIndex:o2 toOperationAtIndex:o4 condition:[NSPredicate predicateWithValue:NO] likely:NO];
+    return [builder definition];
+}
+
+- (void)testDefinitionRoundTrip
+{
+    // This test builds a definition, loads it from its binary representation into a workflow and runs the workflow.
+    // It ensures that operations, names, dependencies, segue conditions are preserved.
+    
+    WEWorkflowDefinition *definition = [[WEWorkflowDefinition alloc] initWithData:[self _helperDefinition].data error:NULL];
+    XCTAssertNotNil(definition);
+    XCTAssertEqual(definition.operationCount, 4);
+    XCTAssertEqual(definition.dependencyCount, 1);
+    XCTAssertEqual(definition.segueCount, 2);
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    NSError *error;
+    XCTAssertTrue([workflow addDefinition:definition registry:_registry error:&error]);
+    XCTAssertNil(error);
+    XCTAssertEqual(workflow.operationCount, 4);
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        NSArray<WEOperation *> *operations = workflow.operations;
+        XCTAssertEqualObjects([operations valueForKey:@"name"], (@[ @"o1", @"o2", @"o3", @"o4" ]));
+        XCTAssertEqualObjects([workflow.context resultForOperationName:@"o2"].result, @"o2");
+        XCTAssertEqualObjects([workflow.context resultForOperationName:@"o3"].result, @"o3");
+        XCTAssertEqualObjects(workflow.skippedOperations, @[ operations[3] ]);
+    }];
+}
+
+- (void)testDefinitionFromMappedFile
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    XCTAssertTrue([[self _helperDefinition].data writeToFile:path atomically:YES]);
+    
+    NSError *error;
+    WEWorkflowDefinition *definition = [[WEWorkflowDefinition alloc] initWithContentsOfFile:path error:&error];
+    XCTAssertNotNil(definition);
+    XCTAssertNil(error);
+    XCTAssertEqual(definition.operationCount, 4);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testDefinitionInvalidDataFails
+{
+    NSData *data = [self _helperDefinition].data;
+    NSError *error;
+    
+    // Truncated
+    XCTAssertNil([[WEWorkflowDefinition alloc] initWithData:[data subdataWithRange:NSMakeRange(0, data.length - 1)] error:&error]);
+    XCTAssertEqualObjects(error.domain, WEWorkflowErrorDomain);
+    XCTAssertEqual(error.code, WEWorkflowInvalidDefinition);
+    
+    // Wrong magic
+    error = nil;
+    NSMutableData *corrupted = [data mutableCopy];
+    ((uint8_t *)corrupted.mutableBytes)[0] ^= 0xFF;
+    XCTAssertNil([[WEWorkflowDefinition alloc] initWithData:corrupted error:&error]);
+    XCTAssertEqual(error.code, WEWorkflowInvalidDefinition);
+    
+    // Dependency target out of range: the first dependency follows the header, string offsets and operations.
+    error = nil;
+    corrupted = [data mutableCopy];
+    uint32_t stringCount = OSReadLittleInt32(corrupted.bytes, 5 * sizeof(uint32_t));
+    size_t targetOffset = (6 + (stringCount + 1) + 4 * 2 + 1) * sizeof(uint32_t);
+    OSWriteLittleInt32(corrupted.mutableBytes, targetOffset, 100);
+    XCTAssertNil([[WEWorkflowDefinition alloc] initWithData:corrupted error:&error]);
+    XCTAssertEqual(error.code, WEWorkflowInvalidDefinition);
+}
+
+- (void)testDefinitionUnregisteredTypeFails
+{
+    WEWorkflowDefinitionBuilder *builder = [WEWorkflowDefinitionBuilder new];
+    [builder addOperationWithType:@"test.name" name:@"o1"];
+    [builder addOperationWithType:@"test.unknown" name:nil];
+    
+    WEWorkflow *workflow = [WEWorkflow new];
+    NSError *error;
+    XCTAssertFalse([workflow addDefinition:[builder definition] registry:_registry error:&error]);
+    XCTAssertEqual(error.code, WEWorkflowInvalidDefinition);
+    XCTAssertEqual(workflow.operationCount, 0);
+}
+
+- (void)testDefinitionBuilderRejectsInvalidInput
+{
+    WEWorkflowDefinitionBuilder *builder = [WEWorkflowDefinitionBuilder new];
+    NSUInteger o1 = [builder addOperationWithType:@"test.name" name:nil];
+    NSUInteger o2 = [builder addOperationWithType:@"test.name" name:nil];
+    
+    XCTAssertThrows([builder addDependencyFromOperationAtIndex:o1 toOperationAtIndex:o1]);
+    XCTAssertThrows([builder addDependencyFromOperationAtIndex:o1 toOperationAtIndex:2]);
+    
+    NSPredicate *blockCondition = [NSPredicate predicateWithBlock:^BOOL(id _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
+        return YES;
+    }];
+    XCTAssertThrows([builder addSegueFromOperationAtIndex:o1 toOperationAtIndex:o2 condition:blockCondition likely:NO]);
+}
+
+
+#pragma mark - Benchmarks
+
+- (void)testBenchmarkChainWithBuilderAPI
+{
+    [self measureBlock:^{
+        WEWorkflow *workflow = [WEWorkflow new];
+        WEOperation *previous = nil;
+        for (NSUInteger i = 0; i < WEBenchmarkDefinitionLength; i++)
+        {
+            WEOperation *operation = [self->_registry operationWithType:@"test.name" name:[NSString stringWithFormat:@"o%lu", (unsigned long)i]];
+            [workflow addOperation:operation];
+            if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+            previous = operation;
+        }
+        XCTAssertEqual(workflow.operationCount, WEBenchmarkDefinitionLength);
+    }];
+}
+
+- (void)testBenchmarkChainWithDefinition
+{
+    WEWorkflowDefinitionBuilder *builder = [WEWorkflowDefinitionBuilder new];
+    for (NSUInteger i = 0; i < WEBenchmarkDefinitionLength; i++)
+    {
+        [builder addOperationWithType:@"test.name" name:[NSString stringWithFormat:@"o%lu", (unsigned long)i]];
+        if (i > 0) [builder addDependencyFromOperationAtIndex:i - 1 toOperationAtIndex:i];
+    }
+    NSData *data = builder.data;
+    
+    // Loading includes validating the definition, as it would happen at startup.
+    [self measureBlock:^{
+        WEWorkflowDefinition *definition = [[WEWorkflowDefinition alloc] initWithData:data error:NULL];
+        WEWorkflow *workflow = [WEWorkflow new];
+        XCTAssertTrue([workflow addDefinition:definition registry:self->_registry error:NULL]);
+        XCTAssertEqual(workflow.operationCount, WEBenchmarkDefinitionLength);
+    }];
+}
+
+@end
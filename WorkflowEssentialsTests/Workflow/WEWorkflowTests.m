@@ -10,12 +10,50 @@
 
 #import <XCTest/XCTest.h>
 #import <OCMock/OCMock.h>
+#import <stdatomic.h>
 #import <WorkflowEssentials/WEWorkflow.h>
 #import <WorkflowEssentials/WEWorkflowContext.h>
+#import <WorkflowEssentials/WEWorkflowReport.h>
 #import <WorkflowEssentials/WEOperation.h>
 #import <WorkflowEssentials/WEBlockOperation.h>
 #import <WorkflowEssentials/WEDependencyDescription.h>
 #import <WorkflowEssentials/WESegueDescription.h>
+#import <WorkflowEssentials/WEQuorumDescription.h>
+
+// Block operation that records calls of speculative prefetch hooks.
+@interface WETestPrefetchingOperation : WEBlockOperation
+@property (nonatomic, strong, nullable) dispatch_semaphore_t prefetchSemaphore;
+// The first prefetch does not return until this semaphore is signalled, if set.
+@property (nonatomic, strong, nullable) dispatch_semaphore_t firstPrefetchRelease;
+@property (atomic, assign) NSUInteger prefetchCount;
+@property (atomic, assign) NSUInteger discardCount;
+@property (atomic, assign) BOOL prefetchedBeforePreparing;
+@end
+
+@implementation WETestPrefetchingOperation
+
+- (void)prefetchWithContext:(WEWorkflowContext *)context
+{
+    self.prefetchCount++;
+    if (self.prefetchSemaphore != nil) dispatch_semaphore_signal(self.prefetchSemaphore);
+    if (self.prefetchCount == 1 && self.firstPrefetchRelease != nil)
+    {
+        dispatch_semaphore_wait(self.firstPrefetchRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+    }
+}
+
+- (void)discardPrefetch
+{
+    self.discardCount++;
+}
+
+- (void)prepareForExecutionWithContext:(WEWorkflowContext *)context
+{
+    self.prefetchedBeforePreparing = self.prefetchCount > 0;
+    [super prepareForExecutionWithContext:context];
+}
+
+@end
 
 @interface WEWorkflowTests : XCTestCase
 @end
@@ -465,6 +503,69 @@
     }];
 }
 
+- (NSError *)_helperErrorOfStartingWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock
+{
+    __block NSError *error = nil;
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *e) {
+        error = e;
+        return YES;
+    }]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    return error;
+}
+
+- (void)testWorkflowDependencyErrorsAreReportedInOrderOfDependencies
+{
+    // This test adds dependencies first -> second, second -> first and first -> unknown. The deadlock introduced by
+    // the second dependency must be reported, rather than the invalid dependency added after it.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    for (NSString *name in @[ @"first", @"second" ])
+    {
+        [workflow addOperation:[[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            XCTFail(@"Should not start an operation of an invalid workflow");
+        }]];
+    }
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"first" toOperationName:@"second"]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"second" toOperationName:@"first"]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"first" toOperationName:@"unknown"]];
+    
+    NSError *error = [self _helperErrorOfStartingWorkflow:workflow delegate:delegateMock];
+    XCTAssertEqualObjects(error.domain, WEWorkflowErrorDomain);
+    XCTAssertEqual(error.code, WEWorkflowDependencyCycle);
+    XCTAssertTrue([error.localizedDescription containsString:@"from = (named = second), to = (named = first)"]);
+}
+
+- (void)testWorkflowDuplicateNamesErrorNamesBothOperations
+{
+    // Two operations share a name. The error must name both of them, the one added later first.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    NSMutableArray<WEOperation *> *operations = [NSMutableArray new];
+    for (NSUInteger i = 0; i < 2; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:@"same" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            XCTFail(@"Should not start an operation of an invalid workflow");
+        }];
+        [workflow addOperation:operation];
+        [operations addObject:operation];
+    }
+    
+    NSError *error = [self _helperErrorOfStartingWorkflow:workflow delegate:delegateMock];
+    XCTAssertEqual(error.code, WEWorkflowDuplicateNames);
+    NSString *expectedReason = [NSString stringWithFormat:@"Duplicate operation name \"same\": operations [%@, %@]", operations[1], operations[0]];
+    XCTAssertEqualObjects(error.localizedDescription, expectedReason);
+}
+
 
 #pragma mark - Workflow with Segues
 
@@ -539,6 +640,9 @@
         [expectation fulfill];
     }] workflowDidComplete:workflow];
     
+    // The operation on the branch that was not taken is skipped.
+    [[delegateMock expect] workflow:workflow didSkipOperations:@[ fromError ? o3 : o2 ]];
+    
     [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
     
     [workflow start];
@@ -560,7 +664,9 @@
             XCTAssertTrue(o3.finished);
             XCTAssertEqual(o3.result, r3);
         }
+        XCTAssertEqualObjects(workflow.skippedOperations, @[ fromError ? o3 : o2 ]);
         XCTAssertTrue(workflow.completed);
+        [delegateMock verify];
     }];
 }
 
@@ -644,6 +750,9 @@
         [expectation fulfill];
     }] workflowDidComplete:workflow];
     
+    // The operation on the branch that was not taken is skipped, but O4 still runs through the other branch.
+    [[delegateMock expect] workflow:workflow didSkipOperations:@[ fromError ? o3 : o2 ]];
+    
     [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
     
     [workflow start];
@@ -668,7 +777,9 @@
         XCTAssertTrue(o4.finished);
         XCTAssertEqual(o4.result, r4);
 
+        XCTAssertEqualObjects(workflow.skippedOperations, @[ fromError ? o3 : o2 ]);
         XCTAssertTrue(workflow.completed);
+        [delegateMock verify];
     }];
 }
 
@@ -744,6 +855,8 @@
         [expectation fulfill];
     }] workflowDidComplete:workflow];
     
+    [[delegateMock expect] workflow:workflow didSkipOperations:@[ o4 ]];
+    
     [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
     
     [workflow start];
@@ -755,6 +868,1384 @@
         XCTAssertEqual(o2.result, r2);
         XCTAssertTrue(o3.finished);
         XCTAssertEqual(o3.result, r3);
+        XCTAssertFalse(o4.finished);
+        XCTAssertEqualObjects(workflow.skippedOperations, @[ o4 ]);
+    }];
+}
+
+- (void)testWorkflowSkippedOperationsPropagateThroughDependencies
+{
+    // This test creates a workflow with 5 operations: O1, O2, O3, O4 and O5 with the following connections:
+    // Conditional segue with a condition that is always false O1 -> O2
+    // Dependency O2 -> O3
+    // Dependency O3 -> O4
+    // Dependency O1 -> O5
+    // O2 is dead once O1 completes, so O3 and O4, which can only run after it, are skipped as well, none of them
+    // is ever prepared. O5 runs, and the workflow completes without failing.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject mockForProtocol:@protocol(WEWorkflowDelegate)];
+    
+    void (^block)(void (^ _Nonnull)(WEOperationResult * _Nonnull)) = ^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    };
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:block];
+    WEBlockOperation *o2 = [[WEBlockOperation alloc] initWithName:@"o2" requiresMainThread:NO block:block];
+    WEBlockOperation *o3 = [[WEBlockOperation alloc] initWithName:@"o3" requiresMainThread:NO block:block];
+    WEBlockOperation *o4 = [[WEBlockOperation alloc] initWithName:@"o4" requiresMainThread:NO block:block];
+    WEBlockOperation *o5 = [[WEBlockOperation alloc] initWithName:@"o5" requiresMainThread:NO block:block];
+    
+    NSMutableArray *skippedMocks = [NSMutableArray new];
+    for (WEOperation *operation in @[ o2, o3, o4 ])
+    {
+        id operationMock = [OCMockObject partialMockForObject:operation];
+        [[operationMock reject] prepareForExecutionWithContext:[OCMArg any]];
+        [skippedMocks addObject:operationMock];
+    }
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    for (WEOperation *operation in @[ o1, o2, o3, o4, o5 ])
+    {
+        [workflow addOperation:operation];
+    }
+    
+    NSPredicate *alwaysFailingCondition = [NSPredicate predicateWithValue:NO];
+    [workflow addSegue:[WESegueDescription segueFromOperationName:o1.name toOperationName:o2.name condition:alwaysFailingCondition]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:o2.name toOperationName:o3.name]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:o3.name toOperationName:o4.name]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:o1.name toOperationName:o5.name]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [[delegateMock expect] workflow:workflow didSkipOperations:@[ o2, o3, o4 ]];
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertTrue(o1.finished);
+        XCTAssertTrue(o5.finished);
+        XCTAssertFalse(o2.finished);
+        XCTAssertFalse(o3.finished);
+        XCTAssertFalse(o4.finished);
+        XCTAssertEqualObjects(workflow.skippedOperations, (@[ o2, o3, o4 ]));
+        XCTAssertTrue(workflow.completed);
+        XCTAssertFalse(workflow.failed);
+        [delegateMock verify];
+        for (id operationMock in skippedMocks)
+        {
+            [operationMock verify];
+        }
+    }];
+}
+
+
+#pragma mark - Main thread execution
+
+- (void)testWorkflowMainThreadOperationsAreBatched
+{
+    // This test creates a workflow with several independent operations that require main thread.
+    // It ensures that they all run on the main thread, and that their preparation and start are
+    // coalesced into at most two main queue turns. The main thread is held until all preparations are
+    // queued, and every operation takes a few milliseconds, so that the remaining operations are
+    // queued while the first of them runs and join its turn.
+    
+    static const NSUInteger operationCount = 8;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject mockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.mainThreadTimeBudget = 1;
+    XCTAssertEqual(workflow.mainThreadTimeBudget, 1);
+    
+    NSMutableArray<WEBlockOperation *> *operations = [NSMutableArray new];
+    for (NSUInteger i = 0; i < operationCount; i++)
+    {
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:YES block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            XCTAssertTrue([NSThread isMainThread]);
+            [NSThread sleepForTimeInterval:0.01];
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [operations addObject:operation];
+        [workflow addOperation:operation];
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    [NSThread sleepForTimeInterval:0.1];
+    
+    [self waitForExpectationsWithTimeout:2 handler:^(NSError * _Nullable error) {
+        for (WEBlockOperation *operation in operations)
+        {
+            XCTAssertTrue(operation.finished);
+        }
+        XCTAssertTrue(workflow.completed);
+        XCTAssertGreaterThan(workflow.mainThreadBatchCount, 0);
+        XCTAssertLessThanOrEqual(workflow.mainThreadBatchCount, 2);
+        XCTAssertGreaterThan(workflow.mainThreadTime, 0);
+    }];
+}
+
+
+#pragma mark - Speculative prefetch
+
+- (void)_testWorkflowSpeculativePrefetchWithSegueActivated:(BOOL)activated
+{
+    // This test creates a workflow with 2 operations, O1 and O2, and a likely conditional segue O1 -> O2.
+    // O1 does not complete until O2 has prefetched, which ensures that the prefetch overlaps with O1.
+    // If the segue is activated, O2 runs and its prefetch is kept, otherwise O2 is skipped and its prefetch is discarded.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    
+    dispatch_semaphore_t prefetchSemaphore = dispatch_semaphore_create(0);
+    WETestPrefetchingOperation *o2 = [[WETestPrefetchingOperation alloc] initWithName:@"o2" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"r2"]);
+    }];
+    o2.prefetchSemaphore = prefetchSemaphore;
+    
+    __block BOOL prefetchedWhileRunning = NO;
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        prefetchedWhileRunning = dispatch_semaphore_wait(prefetchSemaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC)) == 0;
+        completion([[WEOperationResult alloc] initWithResult:@"r1"]);
+    }];
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.speculativePrefetchEnabled = YES;
+    XCTAssertTrue(workflow.speculativePrefetchEnabled);
+    [workflow addOperation:o1];
+    [workflow addOperation:o2];
+    
+    WESegueDescription *segue = [WESegueDescription segueFromOperationName:o1.name toOperationName:o2.name condition:[NSPredicate predicateWithValue:activated]];
+    segue.likely = YES;
+    [workflow addSegue:segue];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    XCTAssertThrows(workflow.speculativePrefetchEnabled = NO);
+    
+    [self waitForExpectationsWithTimeout:2 handler:^(NSError * _Nullable error) {
+        XCTAssertTrue(workflow.completed);
+        XCTAssertTrue(prefetchedWhileRunning);
+        XCTAssertEqual(o2.prefetchCount, 1);
+        XCTAssertEqual(workflow.prefetchCount, 1);
+        if (activated)
+        {
+            XCTAssertTrue(o2.finished);
+            XCTAssertTrue(o2.prefetchedBeforePreparing);
+            XCTAssertEqual(o2.discardCount, 0);
+            XCTAssertEqual(workflow.discardedPrefetchCount, 0);
+        }
+        else
+        {
+            XCTAssertFalse(o2.finished);
+            XCTAssertEqualObjects(workflow.skippedOperations, @[ o2 ]);
+            XCTAssertEqual(workflow.discardedPrefetchCount, 1);
+        }
+    }];
+    
+    if (!activated)
+    {
+        // Discard is dispatched asynchronously.
+        NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+        while (o2.discardCount == 0 && [timeout timeIntervalSinceNow] > 0)
+        {
+            [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+        }
+        XCTAssertEqual(o2.discardCount, 1);
+    }
+}
+
+- (void)testWorkflowSpeculativePrefetchOfPreviousRunIsDiscarded
+{
+    // This test creates an incremental workflow with O1, which produces context value "go", and a likely segue O1 -> O2
+    // taken if it is set. The first run skips O2 while its prefetch is still in progress. The restarted run prefetches O2
+    // again, and the late prefetch of the first run must be discarded instead of being taken for the new one.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.incrementalExecutionEnabled = YES;
+    workflow.speculativePrefetchEnabled = YES;
+    WEWorkflowContext *context = workflow.context;
+    dispatch_semaphore_t firstPrefetchRelease = dispatch_semaphore_create(0);
+    dispatch_semaphore_t o1Release = dispatch_semaphore_create(0);
+    
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        id go = [context contextValueForKey:@"go"];
+        if ([go boolValue]) dispatch_semaphore_wait(o1Release, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:go]);
+    }];
+    o1.inputContextKeys = [NSSet setWithObject:@"go"];
+    WETestPrefetchingOperation *o2 = [[WETestPrefetchingOperation alloc] initWithName:@"o2" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"r2"]);
+    }];
+    o2.firstPrefetchRelease = firstPrefetchRelease;
+    [workflow addOperation:o1];
+    [workflow addOperation:o2];
+    
+    NSPredicate *condition = [NSPredicate predicateWithBlock:^BOOL(WEOperationResult * _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
+        return [evaluatedObject.result boolValue];
+    }];
+    WESegueDescription *segue = [WESegueDescription segueFromOperationName:o1.name toOperationName:o2.name condition:condition];
+    segue.likely = YES;
+    [workflow addSegue:segue];
+    [context setContextValue:@NO forKey:@"go"];
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:NO];
+    XCTAssertEqualObjects(workflow.skippedOperations, @[ o2 ]);
+    
+    // O1 of the restarted run holds on until the late prefetch of the first run has been dealt with.
+    [context setContextValue:@YES forKey:@"go"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    [workflow restart];
+    
+    dispatch_semaphore_signal(firstPrefetchRelease);
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+    while (o2.discardCount == 0 && [timeout timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertEqual(o2.discardCount, 1);
+    dispatch_semaphore_signal(o1Release);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    XCTAssertTrue(o2.finished);
+    XCTAssertEqual(o2.prefetchCount, 2);
+    XCTAssertEqual(o2.discardCount, 1);
+}
+
+- (void)testWorkflowSpeculativePrefetchKeptWhenSegueActivates
+{
+    [self _testWorkflowSpeculativePrefetchWithSegueActivated:YES];
+}
+
+- (void)testWorkflowSpeculativePrefetchDiscardedWhenSegueDoesNotActivate
+{
+    [self _testWorkflowSpeculativePrefetchWithSegueActivated:NO];
+}
+
+
+#pragma mark - Run report
+
+- (void)testWorkflowReportCriticalPathAndSlack
+{
+    // This test creates a workflow with 4 operations: O1, O2, O3 and O4 with the following connections:
+    // Dependency O1 -> O3
+    // Dependency O2 -> O3
+    // Conditional segue with a condition that is always false O3 -> O4
+    // O1 takes much longer than O2, so O3 is made ready by O1, and the critical path is O1, O3. O2 could have
+    // finished as late as O1 without delaying the run, so its slack is at least the difference between them.
+    // O4 does not run and is not part of the report.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        usleep(50000);
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    void (^block)(void (^ _Nonnull)(WEOperationResult * _Nonnull)) = ^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    };
+    WEBlockOperation *o2 = [[WEBlockOperation alloc] initWithName:@"o2" requiresMainThread:NO block:block];
+    WEBlockOperation *o3 = [[WEBlockOperation alloc] initWithName:@"o\"3" requiresMainThread:NO block:block];
+    WEBlockOperation *o4 = [[WEBlockOperation alloc] initWithName:@"o4" requiresMainThread:NO block:block];
+    
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    for (WEOperation *operation in @[ o1, o2, o3, o4 ])
+    {
+        [workflow addOperation:operation];
+    }
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:o1 toOperation:o3]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:o2 toOperation:o3]];
+    [workflow addSegue:[WESegueDescription segueFromOperationName:o3.name toOperationName:o4.name condition:[NSPredicate predicateWithValue:NO]]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        // The report is in place by the time the delegate is notified.
+        XCTAssertNotNil(workflow.report);
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    XCTAssertNil(workflow.report);
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        WEWorkflowReport *report = workflow.report;
+        XCTAssertEqualObjects([report.operationReports valueForKey:@"operation"], (@[ o1, o2, o3 ]));
+        XCTAssertEqualObjects([report.criticalPath valueForKey:@"operation"], (@[ o1, o3 ]));
+        XCTAssertNil([report reportForOperation:o4]);
+        
+        WEOperationReport *r1 = [report reportForOperation:o1];
+        WEOperationReport *r2 = [report reportForOperation:o2];
+        WEOperationReport *r3 = [report reportForOperation:o3];
+        XCTAssertTrue(r1.onCriticalPath);
+        XCTAssertFalse(r2.onCriticalPath);
+        XCTAssertEqual(r1.slack, 0);
+        XCTAssertEqual(r3.slack, 0);
+        XCTAssertGreaterThanOrEqual(r2.slack, r1.finishTime - r2.finishTime - 0.000001);
+        XCTAssertGreaterThan(r2.slack, 0.03);
+        XCTAssertGreaterThanOrEqual(r1.executionTime, 0.05);
+        XCTAssertEqualWithAccuracy(r1.queueWaitTime + r1.executionTime, r1.finishTime - r1.readyTime, 0.000001);
+        XCTAssertEqualWithAccuracy(r3.readyTime, r1.finishTime, 0.000001);
+        XCTAssertEqualWithAccuracy(report.duration, r3.finishTime, 0.000001);
+        
+        NSDictionary *json = [NSJSONSerialization JSONObjectWithData:[report JSONRepresentation] options:0 error:NULL];
+        XCTAssertEqualObjects([json[@"operations"] valueForKey:@"name"], (@[ @"o1", @"o2", @"o\"3" ]));
+        XCTAssertEqualObjects(json[@"edges"], (@[ @[ @0, @2 ], @[ @1, @2 ] ]));
+        XCTAssertEqualObjects(json[@"criticalPath"], (@[ @0, @2 ]));
+        
+        NSString *dot = [report DOTRepresentation];
+        XCTAssertTrue([dot hasPrefix:@"digraph workflow {"]);
+        XCTAssertTrue([dot containsString:@"n0 -> n2 [color=red, penwidth=2];"]);
+        XCTAssertTrue([dot containsString:@"n1 -> n2;"]);
+        XCTAssertTrue([dot containsString:@"o\\\"3"]);
+    }];
+}
+
+- (void)testWorkflowReportIsNotMadeOnFailure
+{
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:o1];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperationName:@"o1" toOperationName:@"missing"]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg any]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertTrue(workflow.failed);
+        XCTAssertNil(workflow.report);
+    }];
+}
+
+
+#pragma mark - Incremental execution
+
+- (void)_helperRunWorkflow:(WEWorkflow *)workflow delegate:(OCMockObject<WEWorkflowDelegate> *)delegateMock restart:(BOOL)restart
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    if (restart) [workflow restart];
+    else [workflow start];
+    
+    [self waitForExpectationsWithTimeout:1 handler:nil];
+    [delegateMock verify];
+}
+
+- (void)testWorkflowIncrementalExecution
+{
+    // This test creates a workflow with 4 operations: Parity, Label, Print and Other with the following connections:
+    // Dependency Parity -> Label
+    // Dependency Label -> Print
+    // Parity reads context value "number" and produces its parity, Other reads context value "other".
+    // The workflow is run 5 times:
+    // 1. Everything runs.
+    // 2. "number" changes from 1 to 2: Parity, Label and Print run, Other is reused.
+    // 3. Nothing changes: everything is reused.
+    // 4. "number" changes from 2 to 4: Parity runs again and produces the same parity, so Label and Print are reused.
+    // 5. Label is invalidated: Label runs, produces the same result, and Print is reused.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.incrementalExecutionEnabled = YES;
+    WEWorkflowContext *context = workflow.context;
+    
+    NSCountedSet<NSString *> *runs = [NSCountedSet new];
+    WEOperation * (^makeOperation)(NSString *, id (^)(void)) = ^WEOperation *(NSString *name, id (^compute)(void)) {
+        return [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (runs)
+            {
+                [runs addObject:name];
+            }
+            completion([[WEOperationResult alloc] initWithResult:compute()]);
+        }];
+    };
+    
+    WEOperation *parity = makeOperation(@"parity", ^id{
+        return @([[context contextValueForKey:@"number"] integerValue] % 2);
+    });
+    parity.inputContextKeys = [NSSet setWithObject:@"number"];
+    WEOperation *label = makeOperation(@"label", ^id{
+        return [[context resultForOperationName:@"parity"].result integerValue] == 0 ? @"even" : @"odd";
+    });
+    WEOperation *print = makeOperation(@"print", ^id{
+        return [NSString stringWithFormat:@"number is %@", [context resultForOperationName:@"label"].result];
+    });
+    WEOperation *other = makeOperation(@"other", ^id{
+        return [context contextValueForKey:@"other"];
+    });
+    other.inputContextKeys = [NSSet setWithObject:@"other"];
+    
+    for (WEOperation *operation in @[ parity, label, print, other ])
+    {
+        [workflow addOperation:operation];
+    }
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:parity toOperation:label]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:label toOperation:print]];
+    [context setContextValue:@1 forKey:@"number"];
+    [context setContextValue:@"value" forKey:@"other"];
+    
+    XCTAssertThrows([workflow restart]);
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:NO];
+    XCTAssertThrows(workflow.incrementalExecutionEnabled = NO);
+    XCTAssertEqual(workflow.reusedOperationCount, 0);
+    XCTAssertEqualObjects([context resultForOperationName:@"print"].result, @"number is odd");
+    
+    [context setContextValue:@2 forKey:@"number"];
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    XCTAssertEqual(workflow.reusedOperationCount, 1);
+    XCTAssertEqualObjects([context resultForOperationName:@"print"].result, @"number is even");
+    XCTAssertEqualObjects([context resultForOperationName:@"other"].result, @"value");
+    XCTAssertEqual([runs countForObject:@"parity"], 2);
+    XCTAssertEqual([runs countForObject:@"print"], 2);
+    XCTAssertEqual([runs countForObject:@"other"], 1);
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    XCTAssertEqual(workflow.reusedOperationCount, 4);
+    XCTAssertEqualObjects([context resultForOperationName:@"print"].result, @"number is even");
+    XCTAssertEqual(runs.count, 4);
+    XCTAssertEqual([runs countForObject:@"parity"], 2);
+    
+    [context setContextValue:@4 forKey:@"number"];
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    XCTAssertEqual(workflow.reusedOperationCount, 3);
+    XCTAssertEqual([runs countForObject:@"parity"], 3);
+    XCTAssertEqual([runs countForObject:@"label"], 2);
+    
+    [workflow invalidateOperation:label];
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    XCTAssertEqual(workflow.reusedOperationCount, 3);
+    XCTAssertEqual([runs countForObject:@"label"], 3);
+    XCTAssertEqual([runs countForObject:@"print"], 2);
+    XCTAssertEqualObjects([context resultForOperationName:@"print"].result, @"number is even");
+}
+
+- (void)testWorkflowIncrementalExecutionDoesNotProduceLazyResults
+{
+    // This test creates a workflow where Source produces a lazy result from context value "number", and Sink follows it
+    // without reading it. Source runs again after "number" changes, and its new result is compared with the kept one.
+    // The comparison must not produce either of them, so a lazy result counts as changed and Sink runs again.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.incrementalExecutionEnabled = YES;
+    WEWorkflowContext *context = workflow.context;
+    
+    __block atomic_int providerCalls;
+    atomic_init(&providerCalls, 0);
+    __block atomic_int sinkRuns;
+    atomic_init(&sinkRuns, 0);
+    WEBlockOperation *source = [[WEBlockOperation alloc] initWithName:@"source" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        id number = [context contextValueForKey:@"number"];
+        completion([[WEOperationResult alloc] initWithResultProvider:^id<NSCopying>{
+            atomic_fetch_add(&providerCalls, 1);
+            return number;
+        }]);
+    }];
+    source.inputContextKeys = [NSSet setWithObject:@"number"];
+    WEBlockOperation *sink = [[WEBlockOperation alloc] initWithName:@"sink" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        atomic_fetch_add(&sinkRuns, 1);
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:source];
+    [workflow addOperation:sink];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:source toOperation:sink]];
+    [context setContextValue:@1 forKey:@"number"];
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:NO];
+    [context setContextValue:@2 forKey:@"number"];
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    
+    XCTAssertEqual(atomic_load(&providerCalls), 0);
+    XCTAssertEqual(atomic_load(&sinkRuns), 2);
+    XCTAssertEqual(workflow.reusedOperationCount, 0);
+    XCTAssertEqualObjects([context resultForOperationName:@"source"].result, @2);
+    XCTAssertEqual(atomic_load(&providerCalls), 1);
+}
+
+- (void)testWorkflowRestartRequiresIncrementalExecution
+{
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:o1];
+    XCTAssertThrows([workflow invalidateOperation:[[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {}]]);
+    
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:NO];
+    XCTAssertThrows([workflow restart]);
+}
+
+
+#pragma mark - Completion batching
+
+- (void)testWorkflowCompletionsArrivingTogetherAreProcessedInOneBatch
+{
+    // This test creates a workflow with operation "first", 8 independent workers, and operation "gate" that follows
+    // "first" through a segue and depends on all workers. First and workers hold on to their completions until
+    // the test completes them.
+    // "first" is completed, and while its segue condition is being evaluated on the workflow's queue, all workers
+    // are completed. Completions of the workers must be processed in a single batch, so the workflow must process
+    // completions in 3 batches: "first", all workers, and "gate".
+    
+    static const NSUInteger workerCount = 8;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t evaluating = dispatch_semaphore_create(0);
+    dispatch_semaphore_t released = dispatch_semaphore_create(0);
+    NSMutableArray *workerCompletions = [NSMutableArray new];
+    __block void (^firstCompletion)(WEOperationResult *) = nil;
+    
+    WEBlockOperation *first = [[WEBlockOperation alloc] initWithName:@"first" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        firstCompletion = completion;
+        dispatch_semaphore_signal(started);
+    }];
+    WEBlockOperation *gate = [[WEBlockOperation alloc] initWithName:@"gate" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:first];
+    [workflow addOperation:gate];
+    for (NSUInteger i = 0; i < workerCount; i++)
+    {
+        WEBlockOperation *worker = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (workerCompletions)
+            {
+                [workerCompletions addObject:completion];
+            }
+            dispatch_semaphore_signal(started);
+        }];
+        [workflow addOperation:worker];
+        [workflow addDependency:[WEDependencyDescription dependencyFormOperation:worker toOperation:gate]];
+    }
+    
+    WESegueDescription *segue = [WESegueDescription segueFromOperationName:@"first" toOperationName:@"gate" condition:[NSPredicate predicateWithBlock:^BOOL(id _Nullable evaluatedObject, NSDictionary<NSString *,id> * _Nullable bindings) {
+        dispatch_semaphore_signal(evaluating);
+        dispatch_semaphore_wait(released, DISPATCH_TIME_FOREVER);
+        return YES;
+    }]];
+    [workflow addSegue:segue];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    for (NSUInteger i = 0; i < workerCount + 1; i++)
+    {
+        XCTAssertEqual(dispatch_semaphore_wait(started, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC)), 0);
+    }
+    
+    firstCompletion([[WEOperationResult alloc] initWithResult:nil]);
+    XCTAssertEqual(dispatch_semaphore_wait(evaluating, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC)), 0);
+    for (void (^completion)(WEOperationResult *) in workerCompletions)
+    {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }
+    dispatch_semaphore_signal(released);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    XCTAssertTrue(gate.finished);
+    XCTAssertEqual(workflow.completionBatchCount, 3);
+}
+
+
+#pragma mark - Chain fusion
+
+- (void)testWorkflowLinearChainRunsOnOneThread
+{
+    // This test creates a chain of 10 operations, each of which depends on the previous one and reads its result.
+    // Operations after the first must be fused: started on the thread that performed the previous one, and see
+    // the result of the previous one in the context.
+    
+    static const NSUInteger chainLength = 10;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+    
+    NSMutableArray<NSThread *> *threads = [NSMutableArray new];
+    WEOperation *previous = nil;
+    for (NSUInteger i = 0; i < chainLength; i++)
+    {
+        NSString *previousName = previous.name;
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:[NSString stringWithFormat:@"o%lu", (unsigned long)i] requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            NSNumber *input = (previousName != nil) ? [context resultForOperationName:previousName].result : @0;
+            @synchronized (threads)
+            {
+                [threads addObject:[NSThread currentThread]];
+            }
+            completion([[WEOperationResult alloc] initWithResult:@(input.unsignedIntegerValue + 1)]);
+        }];
+        [workflow addOperation:operation];
+        if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+        previous = operation;
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertEqualObjects([context resultForOperationName:previous.name].result, @(chainLength));
+    XCTAssertEqual(workflow.fusedOperationCount, chainLength - 1);
+    XCTAssertEqual(threads.count, chainLength);
+    XCTAssertEqual([NSSet setWithArray:threads].count, 1);
+    
+    // A fused operation starts before its predecessor's completion is processed, the report must still be consistent.
+    WEWorkflowReport *report = workflow.report;
+    XCTAssertEqual(report.operationReports.count, chainLength);
+    XCTAssertEqual(report.criticalPath.count, chainLength);
+    for (WEOperationReport *operationReport in report.operationReports)
+    {
+        XCTAssertLessThanOrEqual(operationReport.readyTime, operationReport.startTime);
+        XCTAssertLessThanOrEqual(operationReport.startTime, operationReport.finishTime);
+    }
+}
+
+- (void)testWorkflowChainFusedAfterAsynchronousCompletion
+{
+    // This test creates a chain of operations "o1" and "o2", where o1 completes later on a queue of its own.
+    // o2 must still be fused, but must be performed on the workflow's executor, not on the queue that completed o1.
+    
+    static const void *const completionQueueKey = &completionQueueKey;
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    dispatch_queue_t completionQueue = dispatch_queue_create("completion", DISPATCH_QUEUE_SERIAL);
+    dispatch_queue_set_specific(completionQueue, completionQueueKey, (void *)completionQueueKey, NULL);
+    
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10 * NSEC_PER_MSEC)), completionQueue, ^{
+            completion([[WEOperationResult alloc] initWithResult:@"r1"]);
+        });
+    }];
+    __block BOOL o2OnCompletionQueue = YES;
+    __block id o2Input = nil;
+    WEWorkflowContext *context = workflow.context;
+    WEBlockOperation *o2 = [[WEBlockOperation alloc] initWithName:@"o2" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        o2OnCompletionQueue = dispatch_get_specific(completionQueueKey) != NULL;
+        o2Input = [context resultForOperationName:@"o1"].result;
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:o1];
+    [workflow addOperation:o2];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:o1 toOperation:o2]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertTrue(o2.finished);
+    XCTAssertFalse(o2OnCompletionQueue);
+    XCTAssertEqualObjects(o2Input, @"r1");
+    XCTAssertEqual(workflow.fusedOperationCount, 1);
+}
+
+- (void)testWorkflowBranchesAndMainThreadOperationsAreNotFused
+{
+    // This test creates a diamond "o1" -> ("o2", "o3") -> "o4", followed by a chain "o4" -> "o5" -> "o6" where o5
+    // requires main thread. Neither the branches nor the links to and from the main thread operation can be fused.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    NSMutableArray<WEBlockOperation *> *operations = [NSMutableArray new];
+    for (NSUInteger i = 1; i <= 6; i++)
+    {
+        BOOL requiresMainThread = (i == 5);
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:[NSString stringWithFormat:@"o%lu", (unsigned long)i] requiresMainThread:requiresMainThread block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            XCTAssertEqual([NSThread isMainThread], requiresMainThread);
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+        [workflow addOperation:operation];
+        [operations addObject:operation];
+    }
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[0] toOperation:operations[1]]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[0] toOperation:operations[2]]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[1] toOperation:operations[3]]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[2] toOperation:operations[3]]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[3] toOperation:operations[4]]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operations[4] toOperation:operations[5]]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    for (WEBlockOperation *operation in operations)
+    {
+        XCTAssertTrue(operation.finished);
+    }
+    XCTAssertEqual(workflow.fusedOperationCount, 0);
+}
+
+
+#pragma mark - Lazy operations
+
+- (void)testWorkflowLazyOperationsAreCreatedWhenReady
+{
+    // This test creates a workflow with an operation "o1" added directly, and operations "o2" and "o3" added
+    // with factories, such that o1 has a segue to o2 that activates and a segue to o3 that does not.
+    // The factory of o2 must be called once o1 completes, and the factory of o3 must never be called.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    
+    WEBlockOperation *o1 = [[WEBlockOperation alloc] initWithName:@"o1" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"r1"]);
+    }];
+    __block NSUInteger o2FactoryCallCount = 0;
+    __block BOOL o1FinishedBeforeFactory = NO;
+    __block WEBlockOperation *o2 = nil;
+    __block NSUInteger o3FactoryCallCount = 0;
+    
+    [workflow addOperation:o1];
+    [workflow addOperationWithName:@"o2" factory:^WEOperation * _Nonnull(NSString * _Nullable name) {
+        o2FactoryCallCount++;
+        o1FinishedBeforeFactory = o1.finished;
+        o2 = [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:@"r2"]);
+        }];
+        return o2;
+    }];
+    [workflow addOperationWithName:@"o3" factory:^WEOperation * _Nonnull(NSString * _Nullable name) {
+        o3FactoryCallCount++;
+        return [[WEBlockOperation alloc] initWithName:name requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:@"r3"]);
+        }];
+    }];
+    XCTAssertEqual(workflow.operationCount, 1);
+    
+    WESegueDescription *takenSegue = [WESegueDescription new];
+    takenSegue.sourceOperationName = @"o1";
+    takenSegue.targetOperationName = @"o2";
+    [workflow addSegue:takenSegue];
+    WESegueDescription *notTakenSegue = [WESegueDescription new];
+    notTakenSegue.sourceOperationName = @"o1";
+    notTakenSegue.targetOperationName = @"o3";
+    notTakenSegue.condition = [NSPredicate predicateWithValue:NO];
+    [workflow addSegue:notTakenSegue];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    XCTAssertThrows([workflow addOperationWithName:@"o4" factory:^WEOperation * _Nonnull(NSString * _Nullable name) {
+        return [WEOperation new];
+    }]);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertEqual(o2FactoryCallCount, 1);
+    XCTAssertTrue(o1FinishedBeforeFactory);
+    XCTAssertEqual(o3FactoryCallCount, 0);
+    XCTAssertTrue(o2.finished);
+    XCTAssertEqualObjects([workflow.context resultForOperationName:@"o2"].result, @"r2");
+    XCTAssertEqualObjects(workflow.operations, (@[ o1, o2 ]));
+    XCTAssertEqual(workflow.operationCount, 2);
+    XCTAssertEqual(workflow.skippedOperations.count, 0);
+}
+
+- (void)testWorkflowLazyOperationWithWrongNameFails
+{
+    // The factory of an operation that is ready from the start creates an operation with a different name.
+    // The workflow must fail with an invalid definition error.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    [workflow addOperationWithName:@"o1" factory:^WEOperation * _Nonnull(NSString * _Nullable name) {
+        return [[WEBlockOperation alloc] initWithName:@"other" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        }];
+    }];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+        return [error.domain isEqualToString:WEWorkflowErrorDomain] && error.code == WEWorkflowInvalidDefinition;
+    }]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    XCTAssertTrue(workflow.failed);
+}
+
+
+#pragma mark - Deduplication
+
+- (void)testWorkflowDeduplicatedOperationsShareResult
+{
+    // This test creates 3 workflows, each with a single "refresh" operation with the same deduplication key,
+    // which takes a while. Workflows are started at the same time, so only one of the operations must be performed,
+    // and all workflows and operations must complete with its result.
+    
+    NSString *key = [NSString stringWithFormat:@"refresh-%@", [NSUUID UUID].UUIDString];
+    __block NSUInteger performedCount = 0;
+    NSMutableArray<WEWorkflow *> *workflows = [NSMutableArray new];
+    NSMutableArray<WEOperation *> *operations = [NSMutableArray new];
+    NSMutableArray<OCMockObject<WEWorkflowDelegate> *> *delegates = [NSMutableArray new];
+    
+    for (NSUInteger i = 0; i < 3; i++)
+    {
+        OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+        WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+        WEBlockOperation *refresh = [[WEBlockOperation alloc] initWithName:@"refresh" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            @synchronized (workflows)
+            {
+                performedCount++;
+            }
+            usleep(100000);
+            completion([[WEOperationResult alloc] initWithResult:@(i)]);
+        }];
+        refresh.deduplicationKey = key;
+        [workflow addOperation:refresh];
+        [operations addObject:refresh];
+        
+        XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+        [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+            [expectation fulfill];
+        }] workflowDidComplete:workflow];
+        
+        [workflows addObject:workflow];
+        [delegates addObject:delegateMock];
+    }
+    
+    for (WEWorkflow *workflow in workflows)
+    {
+        [workflow start];
+    }
+    
+    [self waitForExpectationsWithTimeout:1 handler:^(NSError * _Nullable error) {
+        XCTAssertEqual(performedCount, 1);
+        id result = [workflows[0].context resultForOperationName:@"refresh"].result;
+        XCTAssertNotNil(result);
+        NSUInteger deduplicatedCount = 0;
+        for (WEWorkflow *workflow in workflows)
+        {
+            XCTAssertEqualObjects([workflow.context resultForOperationName:@"refresh"].result, result);
+            deduplicatedCount += workflow.deduplicatedOperationCount;
+        }
+        XCTAssertEqual(deduplicatedCount, 2);
+        for (WEOperation *operation in operations)
+        {
+            XCTAssertTrue(operation.finished);
+            XCTAssertEqualObjects(operation.result.result, result);
+        }
+    }];
+    for (OCMockObject<WEWorkflowDelegate> *delegateMock in delegates)
+    {
+        [delegateMock verify];
+    }
+}
+
+- (void)testWorkflowRestartCountsDeduplicatedOperationsOfItsRun
+{
+    // This test creates an incremental workflow whose "refresh" operation joins the flight of an identical operation
+    // of another workflow, and is counted as deduplicated. Restarted after the flight is over, the invalidated operation
+    // is performed itself, so the restarted run must count no deduplicated operations.
+    
+    NSString *key = [NSString stringWithFormat:@"refresh-%@", [NSUUID UUID].UUIDString];
+    dispatch_semaphore_t leaderStarted = dispatch_semaphore_create(0);
+    dispatch_semaphore_t leaderRelease = dispatch_semaphore_create(0);
+    
+    OCMockObject<WEWorkflowDelegate> *leaderDelegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *leaderWorkflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:leaderDelegateMock delegateQueue:dispatch_get_main_queue()];
+    WEBlockOperation *leader = [[WEBlockOperation alloc] initWithName:@"refresh" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_signal(leaderStarted);
+        dispatch_semaphore_wait(leaderRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"leader"]);
+    }];
+    leader.deduplicationKey = key;
+    [leaderWorkflow addOperation:leader];
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.incrementalExecutionEnabled = YES;
+    WEBlockOperation *refresh = [[WEBlockOperation alloc] initWithName:@"refresh" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"own"]);
+    }];
+    refresh.deduplicationKey = key;
+    [workflow addOperation:refresh];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [leaderWorkflow start];
+    XCTAssertEqual(dispatch_semaphore_wait(leaderStarted, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC)), 0);
+    [workflow start];
+    // The flight is joined asynchronously, and is only over once the leader is released.
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:1];
+    while (workflow.deduplicatedOperationCount == 0 && [timeout timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    XCTAssertEqual(workflow.deduplicatedOperationCount, 1);
+    dispatch_semaphore_signal(leaderRelease);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    XCTAssertEqualObjects(refresh.result.result, @"leader");
+    
+    [workflow invalidateOperation:refresh];
+    [self _helperRunWorkflow:workflow delegate:delegateMock restart:YES];
+    XCTAssertEqual(workflow.deduplicatedOperationCount, 0);
+    XCTAssertEqualObjects(refresh.result.result, @"own");
+}
+
+
+#pragma mark - Operation completion observer
+
+- (void)testWorkflowObserverIsGivenOperationsBeforeWorkflowCompletes
+{
+    // This test creates 4 quick operations and a slow one, which waits until the observer has been given all quick ones.
+    // The workflow can only complete if results are delivered while it is still running. Every operation must be
+    // delivered exactly once with its result, and all of them before the delegate is told that the workflow completed.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    dispatch_semaphore_t quickDelivered = dispatch_semaphore_create(0);
+    
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        [workflow addOperation:[[WEBlockOperation alloc] initWithName:[NSString stringWithFormat:@"quick%lu", (unsigned long)i] requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:@(i)]);
+        }]];
+    }
+    [workflow addOperation:[[WEBlockOperation alloc] initWithName:@"slow" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        long waited = dispatch_semaphore_wait(quickDelivered, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@(waited == 0)]);
+    }]];
+    
+    NSMutableDictionary<NSString *, id> *delivered = [NSMutableDictionary new];
+    __block NSUInteger deliveredCount = 0;
+    // The workflow retains its observer.
+    __weak WEWorkflow *weakWorkflow = workflow;
+    workflow.operationCompletionObserver = ^(WEWorkflow * _Nonnull observed, NSArray<WEOperation *> * _Nonnull operations, NSArray<WEOperationResult *> * _Nonnull results) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqual(observed, weakWorkflow);
+        XCTAssertEqual(operations.count, results.count);
+        for (NSUInteger i = 0; i < operations.count; i++)
+        {
+            delivered[operations[i].name] = results[i].result;
+            deliveredCount++;
+        }
+        if (delivered.count == 4 && delivered[@"slow"] == nil) dispatch_semaphore_signal(quickDelivered);
+    };
+    XCTAssertNotNil(workflow.operationCompletionObserver);
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        XCTAssertEqual(deliveredCount, 5);
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    XCTAssertThrows(workflow.operationCompletionObserver = nil);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertEqual(deliveredCount, 5);
+    XCTAssertEqualObjects(delivered[@"slow"], @YES);
+    for (NSUInteger i = 0; i < 4; i++)
+    {
+        XCTAssertEqualObjects(delivered[([NSString stringWithFormat:@"quick%lu", (unsigned long)i])], @(i));
+    }
+}
+
+
+#pragma mark - Early termination
+
+- (void)testWorkflowCompletesWhenTerminalOperationSucceeds
+{
+    // This test creates a terminal operation that fails right away, a terminal operation that succeeds shortly after,
+    // and a slow operation followed by another one. The failure must not end the workflow, the success must:
+    // the workflow must complete while the slow operation is still running, which is cancelled, and skipped along
+    // with the operation that follows it.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    dispatch_semaphore_t slowRelease = dispatch_semaphore_create(0);
+    
+    WEBlockOperation *failing = [[WEBlockOperation alloc] initWithName:@"failing" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithError:[NSError errorWithDomain:@"test" code:1 userInfo:nil]]);
+    }];
+    failing.terminal = YES;
+    WEBlockOperation *fetch = [[WEBlockOperation alloc] initWithName:@"fetch" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        usleep(50000);
+        completion([[WEOperationResult alloc] initWithResult:@"fetched"]);
+    }];
+    fetch.terminal = YES;
+    WEBlockOperation *slow = [[WEBlockOperation alloc] initWithName:@"slow" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_wait(slowRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"slow"]);
+    }];
+    WEBlockOperation *afterSlow = [[WEBlockOperation alloc] initWithName:@"afterSlow" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Operation following a cancelled operation must not start");
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    
+    [workflow addOperation:failing];
+    [workflow addOperation:fetch];
+    [workflow addOperation:slow];
+    [workflow addOperation:afterSlow];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:slow toOperation:afterSlow]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertTrue(workflow.completed);
+    XCTAssertFalse(workflow.failed);
+    XCTAssertTrue(failing.finished);
+    XCTAssertEqualObjects([workflow.context resultForOperationName:@"fetch"].result, @"fetched");
+    XCTAssertTrue(slow.cancelled);
+    XCTAssertEqualObjects([NSSet setWithArray:workflow.skippedOperations], ([NSSet setWithObjects:slow, afterSlow, nil]));
+    
+    // The slow operation completing afterwards has no effect.
+    dispatch_semaphore_signal(slowRelease);
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    XCTAssertNil([workflow.context resultForOperationName:@"slow"]);
+}
+
+- (void)testWorkflowRaceGroupCancelsRivalsOfFirstSuccess
+{
+    // This test races a cache that fails, a network operation that succeeds shortly after, and a slow replica followed
+    // by another operation. The failed cache must not decide the race. Once the network operation succeeds, the replica
+    // must be cancelled and skipped along with the operation that follows it, while an operation following the network
+    // operation runs, and the workflow completes without waiting for the replica.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    dispatch_semaphore_t replicaRelease = dispatch_semaphore_create(0);
+    
+    WEBlockOperation *cache = [[WEBlockOperation alloc] initWithName:@"cache" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithError:[NSError errorWithDomain:@"test" code:1 userInfo:nil]]);
+    }];
+    WEBlockOperation *network = [[WEBlockOperation alloc] initWithName:@"network" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        usleep(50000);
+        completion([[WEOperationResult alloc] initWithResult:@"network"]);
+    }];
+    WEBlockOperation *replica = [[WEBlockOperation alloc] initWithName:@"replica" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_wait(replicaRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"replica"]);
+    }];
+    for (WEOperation *operation in @[ cache, network, replica ])
+    {
+        operation.raceGroup = @"read";
+        [workflow addOperation:operation];
+    }
+    WEBlockOperation *parseNetwork = [[WEBlockOperation alloc] initWithName:@"parseNetwork" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"parsed"]);
+    }];
+    WEBlockOperation *parseReplica = [[WEBlockOperation alloc] initWithName:@"parseReplica" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Operation following a cancelled operation must not start");
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:parseNetwork];
+    [workflow addOperation:parseReplica];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:network toOperation:parseNetwork]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:replica toOperation:parseReplica]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertTrue(cache.finished);
+    XCTAssertEqualObjects([workflow.context resultForOperationName:@"parseNetwork"].result, @"parsed");
+    XCTAssertTrue(replica.cancelled);
+    XCTAssertEqualObjects([NSSet setWithArray:workflow.skippedOperations], ([NSSet setWithObjects:replica, parseReplica, nil]));
+    
+    dispatch_semaphore_signal(replicaRelease);
+}
+
+- (void)testWorkflowRaceWinnerReachesConsumerThroughQuorum
+{
+    // This test races a fast and a slow operation, both connected to the operation that shows the winner with quorum
+    // dependencies of one. A plain dependency on the losing racer would skip the consumer along with it, a quorum of one
+    // must start it with the result of the winner, while the loser alone is cancelled and skipped.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+    dispatch_semaphore_t slowRelease = dispatch_semaphore_create(0);
+    
+    WEBlockOperation *fast = [[WEBlockOperation alloc] initWithName:@"fast" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"fast"]);
+    }];
+    WEBlockOperation *slow = [[WEBlockOperation alloc] initWithName:@"slow" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_wait(slowRelease, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"slow"]);
+    }];
+    __block NSArray<WEOperationResult *> *winners = nil;
+    __block WEOperation *show = nil;
+    show = [[WEBlockOperation alloc] initWithName:@"show" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        winners = [context quorumResultsOfOperation:show];
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    [workflow addOperation:show];
+    for (WEOperation *operation in @[ fast, slow ])
+    {
+        operation.raceGroup = @"profile";
+        [workflow addOperation:operation];
+        [workflow addDependency:[WEQuorumDescription quorumFromOperation:operation toOperation:show quorum:1]];
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertTrue(show.finished);
+    XCTAssertEqualObjects([winners valueForKey:@"result"], @[ @"fast" ]);
+    XCTAssertTrue(slow.cancelled);
+    XCTAssertEqualObjects(workflow.skippedOperations, @[ slow ]);
+    
+    dispatch_semaphore_signal(slowRelease);
+}
+
+- (void)testWorkflowCompletesWhenRunningOperationIsCancelledFromOutside
+{
+    // This test cancels a running operation from outside of the workflow, and another operation before the workflow
+    // gets to it. Both must complete with the cancellation failure like any failed operation, so that the operations
+    // that follow them run and the workflow completes.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t release = dispatch_semaphore_create(0);
+    
+    WEBlockOperation *running = [[WEBlockOperation alloc] initWithName:@"running" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        dispatch_semaphore_signal(started);
+        dispatch_semaphore_wait(release, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC));
+        completion([[WEOperationResult alloc] initWithResult:@"late"]);
+    }];
+    WEBlockOperation *pending = [[WEBlockOperation alloc] initWithName:@"pending" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        XCTFail(@"Operation cancelled before it started must not start");
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    WEBlockOperation *after = [[WEBlockOperation alloc] initWithName:@"after" requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:@"after"]);
+    }];
+    [workflow addOperation:running];
+    [workflow addOperation:pending];
+    [workflow addOperation:after];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:running toOperation:pending]];
+    [workflow addDependency:[WEDependencyDescription dependencyFormOperation:pending toOperation:after]];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    XCTAssertEqual(dispatch_semaphore_wait(started, dispatch_time(DISPATCH_TIME_NOW, (int64_t)NSEC_PER_SEC)), 0);
+    [pending cancel];
+    [running cancel];
+    // The block does not stop by itself, its late completion is ignored.
+    dispatch_semaphore_signal(release);
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    XCTAssertFalse(workflow.failed);
+    XCTAssertEqual([workflow.context resultForOperationName:@"running"].error.code, NSUserCancelledError);
+    XCTAssertEqual([workflow.context resultForOperationName:@"pending"].error.code, NSUserCancelledError);
+    XCTAssertEqualObjects([workflow.context resultForOperationName:@"after"].result, @"after");
+}
+
+- (void)testWorkflowTerminalOperationsRequireNonIncrementalExecution
+{
+    // Operations of a run that may be cancelled cannot be kept for the next run, so an incremental workflow
+    // with a terminal operation fails.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    workflow.incrementalExecutionEnabled = YES;
+    WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+        completion([[WEOperationResult alloc] initWithResult:nil]);
+    }];
+    operation.terminal = YES;
+    [workflow addOperation:operation];
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow fails"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflow:workflow didFailWithError:[OCMArg checkWithBlock:^BOOL(NSError *error) {
+        return error.code == WEWorkflowInvalidDefinition;
+    }]];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+}
+
+
+#pragma mark - Result spilling
+
+- (void)testWorkflowSpillsOldestResultsOverMemoryBudget
+{
+    // This test creates a chain of three operations, each producing about 4 KB: a dictionary that is archived,
+    // and two data values. The chain is fused, so results are published on the threads of operations. With a budget
+    // of 6 KB, the first two results must be spilled once the next one arrives, exactly once each, and all three must
+    // read back unchanged.
+    
+    OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject niceMockForProtocol:@protocol(WEWorkflowDelegate)];
+    WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+    WEWorkflowContext *context = workflow.context;
+    context.resultMemoryBudget = 6000;
+    
+    NSMutableData *data = [NSMutableData dataWithLength:4096];
+    memset(data.mutableBytes, 0x5A, data.length);
+    NSArray<id<NSCopying>> *values = @[ @{ @"payload": [data copy] }, [data copy], [data copy] ];
+    WEOperation *previous = nil;
+    for (NSUInteger i = 0; i < values.count; i++)
+    {
+        id<NSCopying> value = values[i];
+        WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:[NSString stringWithFormat:@"o%lu", (unsigned long)i] requiresMainThread:NO block:^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:value]);
+        }];
+        [workflow addOperation:operation];
+        if (previous != nil) [workflow addDependency:[WEDependencyDescription dependencyFormOperation:previous toOperation:operation]];
+        previous = operation;
+    }
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+    [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+        [expectation fulfill];
+    }] workflowDidComplete:workflow];
+    
+    [workflow start];
+    
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    [delegateMock verify];
+    
+    // Results are written in the background, and may still be on their way to disk.
+    [self expectationForPredicate:[NSPredicate predicateWithFormat:@"spilledResultCount == 2"] evaluatedWithObject:context handler:nil];
+    [self waitForExpectationsWithTimeout:2 handler:nil];
+    XCTAssertGreaterThan(context.spilledResultBytes, 8192);
+    XCTAssertEqual(context.restoredResultCount, 0);
+    for (NSUInteger i = 0; i < values.count; i++)
+    {
+        XCTAssertEqualObjects([context resultForOperationName:[NSString stringWithFormat:@"o%lu", (unsigned long)i]].result, values[i]);
+    }
+    XCTAssertEqual(context.restoredResultCount, 2);
+    XCTAssertEqual(context.restoredResultBytes, context.spilledResultBytes);
+}
+
+
+#pragma mark - Performance
+
+- (void)testWorkflowLargeGraphPerformance
+{
+    // This test measures a workflow with a single source operation, 100k operations depending on it, and a sink
+    // operation depending on all of them. It covers building the graph and the completion of operations
+    // with a very large number of dependents and dependencies.
+    
+    static const NSUInteger operationCount = 100000;
+    
+    [self measureBlock:^{
+        OCMockObject<WEWorkflowDelegate> *delegateMock = [OCMockObject mockForProtocol:@protocol(WEWorkflowDelegate)];
+        WEWorkflow *workflow = [[WEWorkflow alloc] initWithContextClass:nil maximumConcurrentOperations:0 delegate:delegateMock delegateQueue:dispatch_get_main_queue()];
+        
+        void (^block)(void (^ _Nonnull)(WEOperationResult * _Nonnull)) = ^(void (^ _Nonnull completion)(WEOperationResult * _Nonnull)) {
+            completion([[WEOperationResult alloc] initWithResult:nil]);
+        };
+        WEBlockOperation *source = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:block];
+        WEBlockOperation *sink = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:block];
+        [workflow addOperation:source];
+        [workflow addOperation:sink];
+        for (NSUInteger i = 0; i < operationCount; i++)
+        {
+            WEBlockOperation *operation = [[WEBlockOperation alloc] initWithName:nil requiresMainThread:NO block:block];
+            [workflow addOperation:operation];
+            [workflow addDependency:[WEDependencyDescription dependencyFormOperation:source toOperation:operation]];
+            [workflow addDependency:[WEDependencyDescription dependencyFormOperation:operation toOperation:sink]];
+        }
+        
+        XCTestExpectation *expectation = [self expectationWithDescription:@"wait until workflow completes"];
+        [[[delegateMock expect] andDo:^(NSInvocation *invocation) {
+            [expectation fulfill];
+        }] workflowDidComplete:workflow];
+        [[delegateMock reject] workflow:[OCMArg any] didFailWithError:[OCMArg any]];
+        
+        [workflow start];
+        
+        [self waitForExpectationsWithTimeout:60 handler:^(NSError * _Nullable error) {
+            XCTAssertTrue(workflow.completed);
+            XCTAssertTrue(sink.finished);
+        }];
     }];
 }
 